@@ -0,0 +1,44 @@
+#version 450
+
+layout(push_constant) uniform PushConstants {
+	mat4 viewProjection;
+	vec4 origin; /* Unused, each chunk's origin is per instance. */
+} constants;
+
+/* A ChunkVertex, see world/mesher.h. */
+layout(location = 0) in uint inPosition;
+layout(location = 1) in uint inBlock;
+
+/* The origin of the chunk's ChunkDrawRecord, its minimum corner. */
+layout(location = 2) in vec3 inOrigin;
+
+layout(location = 0) out vec3 fragColor;
+
+/* The depth pre-pass and the main pass run this shader in different
+ * pipelines, and the main pass tests for equal depth. */
+invariant gl_Position;
+
+/* Indexed by BlockId, unknown blocks are magenta. */
+const vec3 blockColors[4] = vec3[](
+	vec3(1.0, 0.0, 1.0),
+	vec3(0.50, 0.50, 0.52),
+	vec3(0.47, 0.33, 0.22),
+	vec3(0.36, 0.62, 0.27)
+);
+
+/* Indexed by ChunkFace, lit from above. */
+const float faceShades[6] = float[](0.7, 0.8, 0.5, 1.0, 0.75, 0.85);
+
+void main() {
+	vec3 position = vec3(inPosition & 0x3fu,
+	                     (inPosition >> 6) & 0x3fu,
+	                     (inPosition >> 12) & 0x3fu);
+	uint face = (inPosition >> 18) & 0x7u;
+	uint level = (inPosition >> 21) & 0x7u;
+	uint block = inBlock & 0xffffu;
+
+	/* Each block of a coarser level stands for 2^level blocks to a side. */
+	gl_Position = constants.viewProjection
+	              * vec4(position * float(1u << level) + inOrigin, 1.0);
+	fragColor = blockColors[block < 4u ? block : 0u] * faceShades[face];
+}
@@ -1,11 +1,21 @@
 #version 450
 
+layout(push_constant) uniform PushConstants {
+	mat4 viewProjection;
+	vec4 origin;
+} constants;
+
 layout(location = 0) in vec2 inPositions;
 layout(location = 1) in vec3 inColors;
 
 layout(location = 0) out vec3 fragColor;
 
+/* The depth pre-pass and the main pass run this shader in different
+ * pipelines, and the main pass tests for equal depth. */
+invariant gl_Position;
+
 void main() {
-	gl_Position = vec4(inPositions, 0.0, 1.0);
+	gl_Position = constants.viewProjection
+	              * vec4(vec3(inPositions, 0.0) + constants.origin.xyz, 1.0);
 	fragColor = inColors;
-}
\ No newline at end of file
+}
@@ -0,0 +1,655 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "engine/core/debug.h"
+#include "engine/core/logger.h"
+#include "engine/core/timer.h"
+#include "engine/core/jobs.h"
+#include "engine/core/profiler.h"
+#include "engine/core/window.h"
+#include "engine/renderer/renderer.h"
+#include "engine/world/world.h"
+#include "engine/world/mesh_pipeline.h"
+
+#define ARRAY_SIZE(arr) sizeof(arr) / sizeof(arr[0])
+
+#define TERRAIN_SIZE_X         16 /* Chunks along each axis. */
+#define TERRAIN_SIZE_Y         8
+#define TERRAIN_SIZE_Z         16
+#define TERRAIN_SEED           1
+#define TERRAIN_ORBIT_FRAMES   3600 /* Frames the camera takes to circle the
+                                       world. */
+#define TERRAIN_EDITS_PER_FRAME 8   /* Blocks changed each frame, so chunks are
+                                       remeshed while the camera moves. */
+
+/******************************************************************************
+ * @name  BenchmarkScene
+ * @brief A scripted scene that is set up once and updated every frame before
+ *        the renderer draws it.
+******************************************************************************/
+struct BenchmarkScene
+{
+	const char *name;
+	ENGINE_ERROR (*setup)();
+	void (*update)(uint32_t frame);
+	void (*teardown)();
+	uint32_t (*occluded)(); /*< Meshes not drawn as they cannot be seen. */
+};
+
+/******************************************************************************
+ * @name  BenchmarkOptions
+ * @brief Options parsed from the command line.
+******************************************************************************/
+struct BenchmarkOptions
+{
+	uint32_t frames;
+	uint32_t warmup_frames;
+	uint32_t width;
+	uint32_t height;
+	uint32_t frames_in_flight;
+	uint8_t windowed;
+	uint8_t depth_prepass;
+	uint8_t cpu_culling;
+	uint8_t occlusion_culling;
+	uint32_t lod_levels;
+	RendererPresentMode present_mode;
+	uint32_t swap_chain_images;
+	const char *scene;
+	const char *output;
+	const char *trace;
+};
+
+/******************************************************************************
+ * @name  BenchmarkSamples
+ * @brief Per frame timings collected while the benchmark runs.
+******************************************************************************/
+struct BenchmarkSamples
+{
+	double *frame_ms;
+	double *record_ms;
+	double *cull_ms;
+	double *submit_ms;
+	double *gpu_ms;
+	double *occluded;
+	uint32_t count;
+	uint32_t gpu_count;
+	uint32_t over_budget_count; /*< Frames whose recording exceeded the budget. */
+	uint32_t gpu_culled_count;  /*< Frames whose chunks were culled on the device. */
+
+	GpuScopeTiming *gpu_scopes; /*< Sections of the last profiled frame. */
+	uint32_t gpu_scope_count;
+};
+
+static ENGINE_ERROR triangle_setup()
+{
+	return ENGINE_OK;
+}
+
+static void triangle_update(uint32_t frame)
+{
+}
+
+static void triangle_teardown()
+{
+}
+
+static uint32_t triangle_occluded()
+{
+	return 0;
+}
+
+static World *terrain_world;
+static MeshPipeline *terrain_meshes;
+static uint32_t terrain_random;
+static uint8_t terrain_occlusion;
+static uint32_t terrain_lod_levels;
+
+static ENGINE_ERROR terrain_setup()
+{
+	ENGINE_ERROR error;
+
+	error = world_create(&terrain_world, TERRAIN_SIZE_X, TERRAIN_SIZE_Y, TERRAIN_SIZE_Z);
+	ENGINE_RETURN_IF_ERROR(error);
+
+	error = world_generate(terrain_world, TERRAIN_SEED);
+	if (error == ENGINE_OK)
+	{
+		error = mesh_pipeline_create(&terrain_meshes,
+		                             terrain_world,
+		                             terrain_occlusion,
+		                             terrain_lod_levels);
+	}
+
+	if (error != ENGINE_OK)
+	{
+		world_destroy(terrain_world);
+		return error;
+	}
+
+	terrain_random = TERRAIN_SEED;
+	return ENGINE_OK;
+}
+
+static void terrain_update(uint32_t frame)
+{
+	float width = (float)(TERRAIN_SIZE_X * CHUNK_SIZE);
+	float height = (float)(TERRAIN_SIZE_Y * CHUNK_SIZE);
+	float depth = (float)(TERRAIN_SIZE_Z * CHUNK_SIZE);
+	float angle = (float)(frame % TERRAIN_ORBIT_FRAMES) / TERRAIN_ORBIT_FRAMES * 6.28318531f;
+	RendererCamera camera = {
+		.position = {width * (0.5f + 0.4f * cosf(angle)),
+		             height,
+		             depth * (0.5f + 0.4f * sinf(angle))},
+		.target = {width * 0.5f, height * 0.5f, depth * 0.5f},
+		.fov_y = 1.2217305f,
+		.near = 0.1f
+	};
+
+	/* The same edits every run, digging and filling around the middle of
+	 * the world where the surface is. */
+	for (uint32_t i = 0; i < TERRAIN_EDITS_PER_FRAME; i++)
+	{
+		int32_t position[3];
+
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			terrain_random = terrain_random * 1664525u + 1013904223u;
+			position[axis] = (int32_t)(terrain_random >> 8);
+		}
+
+		world_set_block(terrain_world,
+		                position[0] % (int32_t)width,
+		                (int32_t)(height * 0.25f) + position[1] % (int32_t)(height * 0.5f),
+		                position[2] % (int32_t)depth,
+		                (BlockId)(position[0] & 1 ? BLOCK_AIR : BLOCK_STONE));
+	}
+
+	renderer_set_camera(&camera);
+	mesh_pipeline_update(terrain_meshes, camera.position);
+}
+
+static void terrain_teardown()
+{
+	mesh_pipeline_destroy(terrain_meshes);
+	world_destroy(terrain_world);
+}
+
+static uint32_t terrain_occluded()
+{
+	return terrain_meshes->occluded;
+}
+
+static const struct BenchmarkScene scenes[] = {
+	{"triangle", triangle_setup, triangle_update, triangle_teardown, triangle_occluded},
+	{"terrain", terrain_setup, terrain_update, terrain_teardown, terrain_occluded}
+};
+
+static void print_usage(const char *program)
+{
+	fprintf(stderr,
+	        "Usage: %s [options]\n"
+	        "  --frames N            Frames to measure (default 1000)\n"
+	        "  --warmup N            Frames to draw before measuring (default 60)\n"
+	        "  --width N             Render width (default 800)\n"
+	        "  --height N            Render height (default 600)\n"
+	        "  --frames-in-flight N  Frames the CPU may run ahead (default %d)\n"
+	        "  --scene NAME          triangle or terrain (default triangle)\n"
+	        "  --windowed            Present to a window instead of rendering offscreen\n"
+	        "  --present-mode NAME   immediate, mailbox, fifo or fifo_relaxed when windowed\n"
+	        "                        (default immediate)\n"
+	        "  --swap-images N       Swap chain images to request when windowed\n"
+	        "  --depth-prepass       Lay down depth before shading\n"
+	        "  --cpu-cull            Cull and draw chunks on the CPU even if the device can\n"
+	        "  --no-occlusion        Draw chunks hidden behind solid ground\n"
+	        "  --lod N               Levels of detail for distant terrain, 1 to %d\n"
+	        "                        (default 1)\n"
+	        "  --output PATH         Write the JSON report to PATH, - for stdout\n"
+	        "                        (default benchmark.json)\n"
+	        "  --trace PATH          Write a Chrome trace of the measured frames to PATH\n"
+	        "                        (needs a build with -Dprofile=true)\n",
+	        program,
+	        RENDERER_DEFAULT_FRAMES_IN_FLIGHT,
+	        LOD_MAX_LEVELS);
+}
+
+static int parse_options(int argc, char **argv, struct BenchmarkOptions *options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (strcmp(argv[i], "--windowed") == 0)
+		{
+			options->windowed = 1;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--depth-prepass") == 0)
+		{
+			options->depth_prepass = 1;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--cpu-cull") == 0)
+		{
+			options->cpu_culling = 1;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--no-occlusion") == 0)
+		{
+			options->occlusion_culling = 0;
+			continue;
+		}
+
+		if (value == NULL)
+		{
+			return 0;
+		}
+
+		if (strcmp(argv[i], "--frames") == 0)
+		{
+			options->frames = strtoul(value, NULL, 10);
+		}
+		else if (strcmp(argv[i], "--warmup") == 0)
+		{
+			options->warmup_frames = strtoul(value, NULL, 10);
+		}
+		else if (strcmp(argv[i], "--width") == 0)
+		{
+			options->width = strtoul(value, NULL, 10);
+		}
+		else if (strcmp(argv[i], "--height") == 0)
+		{
+			options->height = strtoul(value, NULL, 10);
+		}
+		else if (strcmp(argv[i], "--frames-in-flight") == 0)
+		{
+			options->frames_in_flight = strtoul(value, NULL, 10);
+		}
+		else if (strcmp(argv[i], "--present-mode") == 0)
+		{
+			if (renderer_parse_present_mode(value, &options->present_mode) != ENGINE_OK)
+			{
+				return 0;
+			}
+		}
+		else if (strcmp(argv[i], "--swap-images") == 0)
+		{
+			options->swap_chain_images = strtoul(value, NULL, 10);
+		}
+		else if (strcmp(argv[i], "--lod") == 0)
+		{
+			options->lod_levels = strtoul(value, NULL, 10);
+		}
+		else if (strcmp(argv[i], "--scene") == 0)
+		{
+			options->scene = value;
+		}
+		else if (strcmp(argv[i], "--output") == 0)
+		{
+			options->output = value;
+		}
+		else if (strcmp(argv[i], "--trace") == 0)
+		{
+			options->trace = value;
+		}
+		else
+		{
+			return 0;
+		}
+
+		i++;
+	}
+
+	return options->frames > 0
+	       && options->frames_in_flight > 0
+	       && options->lod_levels >= 1
+	       && options->lod_levels <= LOD_MAX_LEVELS;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+	double lhs = *(const double*)a;
+	double rhs = *(const double*)b;
+
+	return (lhs > rhs) - (lhs < rhs);
+}
+
+/******************************************************************************
+ * @name         write_distribution()
+ * @brief        Writes the mean, percentiles and maximum of a set of samples as
+ *               a JSON object. The samples are sorted in place.
+ * @param[in]    file    The file to write to.
+ * @param[in]    name    The key of the JSON object.
+ * @param[inout] samples The samples to summarise.
+ * @param        count   The number of samples.
+ * @return       void
+******************************************************************************/
+static void write_distribution(FILE *file,
+                               const char *name,
+                               double *samples,
+                               uint32_t count)
+{
+	double sum = 0.0;
+
+	if (count == 0)
+	{
+		fprintf(file, "  \"%s\": null", name);
+		return;
+	}
+
+	qsort(samples, count, sizeof(double), compare_doubles);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		sum += samples[i];
+	}
+
+	/* Nearest rank percentiles. */
+	#define PERCENTILE(p) samples[(uint32_t)((p) * (count - 1) + 0.5)]
+
+	fprintf(file,
+	        "  \"%s\": {\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, "
+	        "\"p99\": %.4f, \"max\": %.4f}",
+	        name,
+	        sum / count,
+	        PERCENTILE(0.50),
+	        PERCENTILE(0.95),
+	        PERCENTILE(0.99),
+	        samples[count - 1]);
+
+	#undef PERCENTILE
+}
+
+/******************************************************************************
+ * @name       copy_gpu_scopes()
+ * @brief      Keeps the GPU section timings of the last profiled frame so they
+ *             can be reported after the renderer is deinitalised.
+ * @param[out] samples The samples to store the timings in.
+ * @return     void
+******************************************************************************/
+static void copy_gpu_scopes(struct BenchmarkSamples *samples)
+{
+	const GpuScopeTiming *timings;
+	uint32_t count = renderer_get_gpu_timings(&timings);
+
+	/* Names are static strings, only the array needs copying. */
+	samples->gpu_scopes = malloc(sizeof(GpuScopeTiming) * count);
+	samples->gpu_scope_count = samples->gpu_scopes != NULL ? count : 0;
+	memcpy(samples->gpu_scopes, timings, sizeof(GpuScopeTiming) * samples->gpu_scope_count);
+}
+
+static void write_report(FILE *file,
+                         const struct BenchmarkOptions *options,
+                         struct BenchmarkSamples *samples,
+                         double total_ms)
+{
+	fprintf(file, "{\n");
+	fprintf(file, "  \"benchmark\": \"renderer\",\n");
+	fprintf(file, "  \"scene\": \"%s\",\n", options->scene);
+	fprintf(file, "  \"headless\": %s,\n", options->windowed ? "false" : "true");
+	fprintf(file, "  \"width\": %u,\n", options->width);
+	fprintf(file, "  \"height\": %u,\n", options->height);
+	fprintf(file, "  \"frames_in_flight\": %u,\n", options->frames_in_flight);
+	fprintf(file, "  \"depth_prepass\": %s,\n", options->depth_prepass ? "true" : "false");
+	fprintf(file, "  \"gpu_culled_frames\": %u,\n", samples->gpu_culled_count);
+	fprintf(file, "  \"occlusion_culling\": %s,\n", options->occlusion_culling ? "true" : "false");
+	fprintf(file, "  \"lod_levels\": %u,\n", options->lod_levels);
+	fprintf(file, "  \"frames\": %u,\n", samples->count);
+	fprintf(file, "  \"total_ms\": %.4f,\n", total_ms);
+	fprintf(file, "  \"fps\": %.2f,\n", samples->count / (total_ms / 1000.0));
+	fprintf(file, "  \"record_over_budget_frames\": %u,\n", samples->over_budget_count);
+	write_distribution(file, "frame_ms", samples->frame_ms, samples->count);
+	fprintf(file, ",\n");
+	write_distribution(file, "cpu_record_ms", samples->record_ms, samples->count);
+	fprintf(file, ",\n");
+	write_distribution(file, "cpu_cull_ms", samples->cull_ms, samples->count);
+	fprintf(file, ",\n");
+	write_distribution(file, "submit_ms", samples->submit_ms, samples->count);
+	fprintf(file, ",\n");
+	write_distribution(file, "gpu_ms", samples->gpu_ms, samples->gpu_count);
+	fprintf(file, ",\n");
+	write_distribution(file, "occluded_meshes", samples->occluded, samples->count);
+	fprintf(file, ",\n  \"gpu_scopes\": [");
+	for (uint32_t i = 0; i < samples->gpu_scope_count; i++)
+	{
+		fprintf(file,
+		        "%s\n    {\"name\": \"%s\", \"depth\": %u, \"ms\": %.4f}",
+		        i == 0 ? "" : ",",
+		        samples->gpu_scopes[i].name,
+		        samples->gpu_scopes[i].depth,
+		        samples->gpu_scopes[i].ms);
+	}
+	fprintf(file, "\n  ]\n}\n");
+}
+
+/******************************************************************************
+ * @name      free_samples()
+ * @brief     Frees the samples' arrays, any of which may be NULL.
+ * @param[in] samples The samples to free.
+ * @return    void
+******************************************************************************/
+static void free_samples(struct BenchmarkSamples *samples)
+{
+	free(samples->frame_ms);
+	free(samples->record_ms);
+	free(samples->cull_ms);
+	free(samples->submit_ms);
+	free(samples->gpu_ms);
+	free(samples->occluded);
+	free(samples->gpu_scopes);
+}
+
+int main(int argc, char **argv)
+{
+	struct BenchmarkOptions options = {
+		.frames = 1000,
+		.warmup_frames = 60,
+		.width = 800,
+		.height = 600,
+		.frames_in_flight = RENDERER_DEFAULT_FRAMES_IN_FLIGHT,
+		.windowed = 0,
+		.depth_prepass = 0,
+		.cpu_culling = 0,
+		.occlusion_culling = 1,
+		.lod_levels = 1,
+		.present_mode = RENDERER_PRESENT_MODE_IMMEDIATE,
+		.swap_chain_images = 0,
+		.scene = "triangle",
+		.output = "benchmark.json", /* Log messages go to stdout. */
+		.trace = NULL
+	};
+	const struct BenchmarkScene *scene = NULL;
+	struct BenchmarkSamples samples;
+	Window *window = NULL;
+	uint64_t start, end;
+	ENGINE_ERROR error;
+	FILE *output;
+
+	if (!parse_options(argc, argv, &options))
+	{
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (uint32_t i = 0; i < ARRAY_SIZE(scenes); i++)
+	{
+		if (strcmp(scenes[i].name, options.scene) == 0)
+		{
+			scene = &scenes[i];
+		}
+	}
+
+	if (scene == NULL)
+	{
+		LOG_ERROR("Unknown benchmark scene %s", options.scene);
+		return EXIT_FAILURE;
+	}
+
+	samples.frame_ms = calloc(options.frames, sizeof(double));
+	samples.record_ms = calloc(options.frames, sizeof(double));
+	samples.cull_ms = calloc(options.frames, sizeof(double));
+	samples.submit_ms = calloc(options.frames, sizeof(double));
+	samples.gpu_ms = calloc(options.frames, sizeof(double));
+	samples.occluded = calloc(options.frames, sizeof(double));
+	samples.gpu_scopes = NULL;
+	samples.count = 0;
+	samples.gpu_count = 0;
+	samples.over_budget_count = 0;
+	samples.gpu_culled_count = 0;
+
+	if (samples.frame_ms == NULL
+	    || samples.record_ms == NULL
+	    || samples.cull_ms == NULL
+	    || samples.submit_ms == NULL
+	    || samples.gpu_ms == NULL
+	    || samples.occluded == NULL)
+	{
+		LOG_ERROR("Failed to allocate samples for %u frames", options.frames);
+		free_samples(&samples);
+		return EXIT_FAILURE;
+	}
+
+	RendererSettings settings = {
+		.frames_in_flight = options.frames_in_flight,
+		.headless = !options.windowed,
+		.headless_width = options.width,
+		.headless_height = options.height,
+		.headless_readback = 0,
+		.present_mode = options.present_mode,
+		.swap_chain_images = options.swap_chain_images,
+		.depth_prepass = options.depth_prepass,
+		.cpu_culling = options.cpu_culling
+	};
+
+	error = job_system_create(0);
+	if (error != ENGINE_OK)
+	{
+		LOG_ERROR("Job system failed to initalise");
+		free_samples(&samples);
+		return EXIT_FAILURE;
+	}
+
+	if (options.windowed)
+	{
+		if (!glfwInit())
+		{
+			LOG_ERROR("GLFW failed to initalise");
+			free_samples(&samples);
+			return EXIT_FAILURE;
+		}
+
+		error = window_create(&window);
+		if (error != ENGINE_OK)
+		{
+			glfwTerminate();
+			free_samples(&samples);
+			return EXIT_FAILURE;
+		}
+	}
+
+	error = renderer_init(window, &settings);
+	if (error != ENGINE_OK)
+	{
+		LOG_ERROR("Renderer failed to initalise");
+		free_samples(&samples);
+		return EXIT_FAILURE;
+	}
+
+	terrain_occlusion = options.occlusion_culling;
+	terrain_lod_levels = options.lod_levels;
+
+	error = scene->setup();
+	if (error != ENGINE_OK)
+	{
+		LOG_ERROR("Benchmark scene %s failed to set up", scene->name);
+		renderer_deinit();
+		free_samples(&samples);
+		return EXIT_FAILURE;
+	}
+
+	for (uint32_t i = 0; i < options.warmup_frames; i++)
+	{
+		if (window != NULL)
+		{
+			window_update(window);
+		}
+		scene->update(i);
+		renderer_draw();
+	}
+
+	start = timer_now_ns();
+
+	for (uint32_t i = 0; i < options.frames; i++)
+	{
+		RendererFrameStats stats;
+		uint64_t frame_start = timer_now_ns();
+
+		PROFILE_FRAME();
+
+		if (window != NULL)
+		{
+			window_update(window);
+		}
+		scene->update(options.warmup_frames + i);
+		renderer_draw();
+
+		renderer_get_frame_stats(&stats);
+
+		samples.frame_ms[samples.count] = timer_ns_to_ms(timer_now_ns() - frame_start);
+		samples.record_ms[samples.count] = stats.record_ms;
+		samples.cull_ms[samples.count] = stats.cull_ms;
+		samples.submit_ms[samples.count] = stats.submit_ms;
+		samples.occluded[samples.count] = scene->occluded();
+		samples.over_budget_count += stats.record_over_budget;
+		samples.gpu_culled_count += stats.gpu_culled;
+		samples.count++;
+
+		if (stats.gpu_ms >= 0.0)
+		{
+			samples.gpu_ms[samples.gpu_count++] = stats.gpu_ms;
+		}
+	}
+
+	end = timer_now_ns();
+
+	copy_gpu_scopes(&samples);
+
+	if (options.trace != NULL)
+	{
+		profiler_export(options.trace);
+	}
+
+	scene->teardown();
+	renderer_deinit();
+
+	if (window != NULL)
+	{
+		window_destroy(window);
+		glfwTerminate();
+	}
+
+	job_system_destroy();
+
+	output = strcmp(options.output, "-") != 0 ? fopen(options.output, "w") : stdout;
+	if (output == NULL)
+	{
+		LOG_ERROR("Failed to open %s", options.output);
+		free_samples(&samples);
+		return EXIT_FAILURE;
+	}
+
+	write_report(output, &options, &samples, timer_ns_to_ms(end - start));
+
+	if (output != stdout)
+	{
+		fclose(output);
+	}
+
+	free_samples(&samples);
+
+	return EXIT_SUCCESS;
+}
@@ -2,23 +2,50 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 
 #include <GLFW/glfw3.h>
 
 #include "logger.h"
+#include "jobs.h"
+#include "profiler.h"
+#include "timer.h"
 
-#include "renderer/renderer.h"
+#define APPLICATION_PROFILE_KEY  GLFW_KEY_F12
+#define APPLICATION_PROFILE_PATH "./logs/trace.json"
+
+#define APPLICATION_WORLD_SIZE_X   16 /* Chunks along each axis. */
+#define APPLICATION_WORLD_SIZE_Y   8
+#define APPLICATION_WORLD_SIZE_Z   16
+#define APPLICATION_WORLD_SEED     1
+#define APPLICATION_ORBIT_PERIOD_S 120.0 /* Time the camera takes to circle
+                                            the world. */
+#define APPLICATION_CAMERA_FOV_Y   1.2217305f /* 70 degrees. */
+#define APPLICATION_CAMERA_NEAR    0.1f
+#define APPLICATION_TWO_PI         6.28318531
 
 static Application application = { NULL };
 
-ENGINE_ERROR application_initialise()
+ENGINE_ERROR application_initialise(const ApplicationSettings *settings)
 {
 	ENGINE_ERROR error;
-	
+	RendererSettings renderer_settings = {
+		.frames_in_flight = RENDERER_DEFAULT_FRAMES_IN_FLIGHT,
+		.present_mode = settings->present_mode,
+		.swap_chain_images = settings->swap_chain_images
+	};
+
+	frame_limiter_init(&application.frame_limiter, settings->frame_rate);
+
+	error = job_system_create(0);
+	ENGINE_RETURN_IF_ERROR(error);
+
 	if (!glfwInit())
 	{
-		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_INIT_FAILED,
-		                           "GLFW failed to initalise");
+		error = ENGINE_ERROR_INIT_FAILED;
+		ENGINE_LOG_GOTO_IF_ERROR(error,
+		                         "GLFW failed to initalise",
+		                         glfw_init_fail);
 	}
 
 	error = window_create(&application.window);
@@ -26,31 +53,117 @@ ENGINE_ERROR application_initialise()
 	                         "Window failed to be initalised",
 	                         window_create_fail);
 
-	error = renderer_init(application.window);
+	error = renderer_init(application.window, &renderer_settings);
 	ENGINE_GOTO_IF_ERROR(error, renderer_init_fail)
 
+	error = world_create(&application.world,
+	                     APPLICATION_WORLD_SIZE_X,
+	                     APPLICATION_WORLD_SIZE_Y,
+	                     APPLICATION_WORLD_SIZE_Z);
+	ENGINE_GOTO_IF_ERROR(error, world_create_fail);
+
+	error = world_generate(application.world, APPLICATION_WORLD_SEED);
+	ENGINE_GOTO_IF_ERROR(error, mesh_pipeline_create_fail);
+
+	error = mesh_pipeline_create(&application.mesh_pipeline,
+	                             application.world,
+	                             1,
+	                             LOD_MAX_LEVELS);
+	ENGINE_GOTO_IF_ERROR(error, mesh_pipeline_create_fail);
+
+	application.start_ns = timer_now_ns();
+
 	return ENGINE_OK;
 
+mesh_pipeline_create_fail:
+	world_destroy(application.world);
+world_create_fail:
+	renderer_deinit();
 renderer_init_fail:
 	window_destroy(application.window);
 window_create_fail:
 	glfwTerminate();
+glfw_init_fail:
+	job_system_destroy();
 	return error;
 }
 
 void application_destroy()
 {
+	/* Meshes belong to the renderer and must go first. */
+	mesh_pipeline_destroy(application.mesh_pipeline);
+	world_destroy(application.world);
+
 	renderer_deinit();
 
 	window_destroy(application.window);
 	glfwTerminate();
+
+	job_system_destroy();
+}
+
+/******************************************************************************
+ * @name   update_camera()
+ * @brief  Circles the camera around the world, looking at its centre, and
+ *         meshes the chunks it is nearest first.
+ * @return void
+******************************************************************************/
+static void update_camera()
+{
+	const World *world = application.world;
+	float width = (float)(world->size[0] * CHUNK_SIZE);
+	float height = (float)(world->size[1] * CHUNK_SIZE);
+	float depth = (float)(world->size[2] * CHUNK_SIZE);
+	double seconds = timer_ns_to_ms(timer_now_ns() - application.start_ns) / 1000.0;
+	float angle = (float)(seconds / APPLICATION_ORBIT_PERIOD_S * APPLICATION_TWO_PI);
+	RendererCamera camera = {
+		.position = {width * (0.5f + 0.4f * cosf(angle)),
+		             height,
+		             depth * (0.5f + 0.4f * sinf(angle))},
+		.target = {width * 0.5f, height * 0.5f, depth * 0.5f},
+		.fov_y = APPLICATION_CAMERA_FOV_Y,
+		.near = APPLICATION_CAMERA_NEAR
+	};
+
+	renderer_set_camera(&camera);
+	mesh_pipeline_update(application.mesh_pipeline, camera.position);
 }
 
 void application_run()
 {
+	int export_key_state = GLFW_RELEASE;
+
+	PROFILE_ZONE("application_run");
+
 	while (!glfwWindowShouldClose(application.window->handle))
 	{
+		int key_state;
+
+		PROFILE_FRAME();
+
+		/* Wait before polling so input is as recent as possible when drawn. */
+		PROFILE_BEGIN("frame_limiter_wait");
+		frame_limiter_wait(&application.frame_limiter);
+		PROFILE_END();
+
 		window_update(application.window);
+		job_process_main();
+
+		if (application.window->resized)
+		{
+			application.window->resized = 0;
+			renderer_resize();
+		}
+
+		update_camera();
 		renderer_draw();
+
+		/* Export a trace of the last few seconds when the key is pressed. */
+		key_state = glfwGetKey(application.window->handle, APPLICATION_PROFILE_KEY);
+		if (key_state == GLFW_PRESS && export_key_state == GLFW_RELEASE)
+		{
+			profiler_export(APPLICATION_PROFILE_PATH);
+		}
+		export_key_state = key_state;
 	}
 }
\ No newline at end of file
@@ -3,6 +3,24 @@
 
 #include "window.h"
 #include "debug.h"
+#include "frame_limiter.h"
+
+#include "renderer/renderer.h"
+#include "world/world.h"
+#include "world/mesh_pipeline.h"
+
+/******************************************************************************
+ * @name  _ApplicationSettings
+ * @brief Options chosen when the application starts. Zero initialise for the
+ *        defaults.
+******************************************************************************/
+struct _ApplicationSettings
+{
+	RendererPresentMode present_mode;
+	uint32_t swap_chain_images; /*< 0 for the renderer's default. */
+	double frame_rate;          /*< Frames per second to pace to, 0 to uncap. */
+};
+typedef struct _ApplicationSettings ApplicationSettings;
 
 /******************************************************************************
  * @name  _Application
@@ -11,16 +29,22 @@
 struct _Application
 {
 	Window *window;
+	FrameLimiter frame_limiter;
+
+	World *world;
+	MeshPipeline *mesh_pipeline;
+	uint64_t start_ns; /*< When the application started, for the camera. */
 };
 typedef struct _Application Application;
 
 /******************************************************************************
- * @name   application_initialise()
- * @brief  Setup the application to be run.
- * @return ENGINE_ERROR value to indicate the success or communicate why the
- *         the function failed.
+ * @name      application_initialise()
+ * @brief     Setup the application to be run.
+ * @param[in] settings The settings to run the application with.
+ * @return    ENGINE_ERROR value to indicate the success or communicate why the
+ *            the function failed.
 ******************************************************************************/
-ENGINE_ERROR application_initialise();
+ENGINE_ERROR application_initialise(const ApplicationSettings *settings);
 
 /******************************************************************************
  * @name   application_destroy()
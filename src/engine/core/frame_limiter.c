@@ -0,0 +1,58 @@
+#include "frame_limiter.h"
+
+#include "timer.h"
+
+/* Bounds on the time spun before each deadline. It grows to cover the worst
+ * recent oversleep and slowly shrinks back while sleeps are accurate. */
+#define FRAME_LIMITER_MIN_SPIN_NS 200000ull
+#define FRAME_LIMITER_MAX_SPIN_NS 4000000ull
+
+void frame_limiter_init(FrameLimiter *limiter, double frame_rate)
+{
+	limiter->period_ns = frame_rate > 0.0 ? (uint64_t)(1000000000.0 / frame_rate) : 0;
+	limiter->deadline_ns = 0;
+	limiter->spin_ns = FRAME_LIMITER_MIN_SPIN_NS;
+}
+
+void frame_limiter_wait(FrameLimiter *limiter)
+{
+	uint64_t now;
+
+	if (limiter->period_ns == 0)
+	{
+		return;
+	}
+
+	now = timer_now_ns();
+
+	if (limiter->deadline_ns == 0
+	    || now >= limiter->deadline_ns + limiter->period_ns)
+	{
+		limiter->deadline_ns = now + limiter->period_ns;
+		return;
+	}
+
+	if (now + limiter->spin_ns < limiter->deadline_ns)
+	{
+		uint64_t wake = limiter->deadline_ns - limiter->spin_ns;
+		uint64_t oversleep;
+
+		timer_sleep_until_ns(wake);
+		now = timer_now_ns();
+		oversleep = now > wake ? now - wake : 0;
+
+		if (oversleep * 2 > limiter->spin_ns)
+		{
+			limiter->spin_ns = oversleep * 2 < FRAME_LIMITER_MAX_SPIN_NS
+			                   ? oversleep * 2
+			                   : FRAME_LIMITER_MAX_SPIN_NS;
+		}
+		else if (limiter->spin_ns > FRAME_LIMITER_MIN_SPIN_NS)
+		{
+			limiter->spin_ns -= limiter->spin_ns / 64;
+		}
+	}
+
+	timer_spin_until_ns(limiter->deadline_ns);
+	limiter->deadline_ns += limiter->period_ns;
+}
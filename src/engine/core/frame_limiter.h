@@ -0,0 +1,40 @@
+#ifndef _FRAME_LIMITER_H_
+#define _FRAME_LIMITER_H_
+
+#include <stdint.h>
+
+/******************************************************************************
+ * @name  _FrameLimiter
+ * @brief Paces a loop to a target frame rate. Most of each wait is spent
+ *        asleep, the last moments are spun so frames start on time even when
+ *        the scheduler wakes the thread late.
+******************************************************************************/
+struct _FrameLimiter
+{
+	uint64_t period_ns;   /*< The target frame time, 0 when uncapped. */
+	uint64_t deadline_ns; /*< When the next frame may start, 0 before the first. */
+	uint64_t spin_ns;     /*< How long before the deadline to stop sleeping. */
+};
+typedef struct _FrameLimiter FrameLimiter;
+
+/******************************************************************************
+ * @name       frame_limiter_init()
+ * @brief      Sets up a frame limiter.
+ * @param[out] limiter    The limiter to set up.
+ * @param      frame_rate The target frames per second, 0 or less to uncap.
+ * @return     void
+******************************************************************************/
+void frame_limiter_init(FrameLimiter *limiter, double frame_rate);
+
+/******************************************************************************
+ * @name         frame_limiter_wait()
+ * @brief        Waits until the next frame is due. Call once per frame just
+ *               before reading input so it is as fresh as possible when the
+ *               frame is drawn. A frame that ran more than a whole period late
+ *               restarts the pacing rather than rushing to catch up.
+ * @param[inout] limiter The limiter to wait on.
+ * @return       void
+******************************************************************************/
+void frame_limiter_wait(FrameLimiter *limiter);
+
+#endif /* _FRAME_LIMITER_H_ */
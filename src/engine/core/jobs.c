@@ -0,0 +1,871 @@
+#include "jobs.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "profiler.h"
+
+#define JOB_SPIN_COUNT    64
+#define JOB_IDLE_WAIT_NS  10000000
+
+/******************************************************************************
+ * @name  JobSlot
+ * @brief A queued job. Fields are atomic because a thief may read a slot the
+ *        owner is overwriting, the thief's claim then fails and the read is
+ *        discarded.
+******************************************************************************/
+struct JobSlot
+{
+	_Atomic(JobFunction) function;
+	_Atomic(void*) data;
+	_Atomic(JobCounter*) counter;
+};
+
+/******************************************************************************
+ * @name  JobQueue
+ * @brief A Chase-Lev work stealing deque. The owning thread pushes and takes
+ *        at the bottom, other threads steal from the top.
+******************************************************************************/
+struct JobQueue
+{
+	/* On separate cache lines so thieves do not slow down the owner. */
+	_Alignas(64) atomic_llong top;
+	_Alignas(64) atomic_llong bottom;
+	_Alignas(64) struct JobSlot slots[JOB_QUEUE_SIZE];
+};
+
+/******************************************************************************
+ * @name  QueuedJob
+ * @brief A job read out of a queue.
+******************************************************************************/
+struct QueuedJob
+{
+	JobFunction function;
+	void *data;
+	JobCounter *counter;
+};
+
+/******************************************************************************
+ * @name  JobContinuation
+ * @brief Jobs waiting on a counter to reach zero.
+******************************************************************************/
+struct JobContinuation
+{
+	struct JobContinuation *next;
+	JobCounter *counter;
+	uint32_t count;
+	Job jobs[];
+};
+
+/******************************************************************************
+ * @name  ParallelFor
+ * @brief Shared by the jobs of a parallel for. Each job claims batches until
+ *        the range is exhausted and the last to finish frees it.
+******************************************************************************/
+struct ParallelFor
+{
+	ParallelForFunction function;
+	void *data;
+	uint32_t count;
+	uint32_t batch_size;
+	atomic_uint next;
+	atomic_uint references;
+};
+
+struct JobSystem
+{
+	struct JobQueue *queues; /*< One per thread, index 0 is the main thread. */
+	pthread_t *workers;
+	uint32_t thread_count;
+
+	/* Jobs that must run on the main thread. */
+	pthread_mutex_t main_lock;
+	Job *main_jobs;
+	JobCounter **main_counters;
+	uint32_t main_count;
+	uint32_t main_capacity;
+
+	/* Jobs only workers run, oldest first from background_head. */
+	pthread_mutex_t background_lock;
+	Job *background_jobs;
+	JobCounter **background_counters;
+	uint32_t background_head;
+	uint32_t background_count;
+	uint32_t background_capacity;
+	atomic_uint background_pending; /*< Read without the lock. */
+
+	atomic_int running;
+	atomic_int sleeping;
+	pthread_mutex_t sleep_lock;
+	pthread_cond_t wake;
+};
+
+static struct JobSystem job_system;
+static _Thread_local int32_t thread_index = -1;
+static _Thread_local uint32_t steal_seed;
+
+static void run_job(JobFunction function, void *data, JobCounter *counter);
+
+static void queue_push(struct JobQueue *queue,
+                       JobFunction function,
+                       void *data,
+                       JobCounter *counter)
+{
+	long long bottom = atomic_load_explicit(&queue->bottom, memory_order_relaxed);
+	long long top = atomic_load_explicit(&queue->top, memory_order_acquire);
+	struct JobSlot *slot;
+
+	/* Full, running the job now is slower but never loses it. */
+	if (bottom - top >= JOB_QUEUE_SIZE)
+	{
+		run_job(function, data, counter);
+		return;
+	}
+
+	slot = &queue->slots[bottom & (JOB_QUEUE_SIZE - 1)];
+	atomic_store_explicit(&slot->function, function, memory_order_relaxed);
+	atomic_store_explicit(&slot->data, data, memory_order_relaxed);
+	atomic_store_explicit(&slot->counter, counter, memory_order_relaxed);
+
+	atomic_store_explicit(&queue->bottom, bottom + 1, memory_order_release);
+}
+
+static uint8_t queue_take(struct JobQueue *queue, struct QueuedJob *job)
+{
+	long long bottom = atomic_load_explicit(&queue->bottom, memory_order_relaxed) - 1;
+	long long top;
+	uint8_t taken = 1;
+	struct JobSlot *slot;
+
+	atomic_store_explicit(&queue->bottom, bottom, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	top = atomic_load_explicit(&queue->top, memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		atomic_store_explicit(&queue->bottom, bottom + 1, memory_order_relaxed);
+		return 0;
+	}
+
+	slot = &queue->slots[bottom & (JOB_QUEUE_SIZE - 1)];
+	job->function = atomic_load_explicit(&slot->function, memory_order_relaxed);
+	job->data = atomic_load_explicit(&slot->data, memory_order_relaxed);
+	job->counter = atomic_load_explicit(&slot->counter, memory_order_relaxed);
+
+	/* The last job, race thieves for it. */
+	if (top == bottom)
+	{
+		taken = atomic_compare_exchange_strong_explicit(&queue->top,
+		                                                &top,
+		                                                top + 1,
+		                                                memory_order_seq_cst,
+		                                                memory_order_relaxed);
+		atomic_store_explicit(&queue->bottom, bottom + 1, memory_order_relaxed);
+	}
+
+	return taken;
+}
+
+static uint8_t queue_steal(struct JobQueue *queue, struct QueuedJob *job)
+{
+	long long top = atomic_load_explicit(&queue->top, memory_order_acquire);
+	long long bottom;
+	struct JobSlot *slot;
+
+	atomic_thread_fence(memory_order_seq_cst);
+	bottom = atomic_load_explicit(&queue->bottom, memory_order_acquire);
+
+	if (top >= bottom)
+	{
+		return 0;
+	}
+
+	slot = &queue->slots[top & (JOB_QUEUE_SIZE - 1)];
+	job->function = atomic_load_explicit(&slot->function, memory_order_relaxed);
+	job->data = atomic_load_explicit(&slot->data, memory_order_relaxed);
+	job->counter = atomic_load_explicit(&slot->counter, memory_order_relaxed);
+
+	return atomic_compare_exchange_strong_explicit(&queue->top,
+	                                               &top,
+	                                               top + 1,
+	                                               memory_order_seq_cst,
+	                                               memory_order_relaxed);
+}
+
+static void counter_lock(JobCounter *counter)
+{
+	while (atomic_exchange_explicit(&counter->lock, 1, memory_order_acquire))
+	{
+		while (atomic_load_explicit(&counter->lock, memory_order_relaxed))
+		{
+			sched_yield();
+		}
+	}
+}
+
+static void counter_unlock(JobCounter *counter)
+{
+	atomic_store_explicit(&counter->lock, 0, memory_order_release);
+}
+
+static void wake_workers()
+{
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&job_system.sleeping, memory_order_relaxed) > 0)
+	{
+		pthread_mutex_lock(&job_system.sleep_lock);
+		pthread_cond_broadcast(&job_system.wake);
+		pthread_mutex_unlock(&job_system.sleep_lock);
+	}
+}
+
+static void submit(const Job *jobs, uint32_t count, JobCounter *counter)
+{
+	struct JobQueue *queue;
+
+	ENGINE_ASSERT(thread_index >= 0);
+	queue = &job_system.queues[thread_index];
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		queue_push(queue, jobs[i].function, jobs[i].data, counter);
+	}
+
+	wake_workers();
+}
+
+/******************************************************************************
+ * @name      counter_decrement()
+ * @brief     Marks one job counted by a counter as finished. The last
+ *            decrement holds the lock while the counter reaches zero, so a
+ *            waiter that has seen zero and then the lock released knows the
+ *            counter is no longer touched and can free it.
+ * @param[in] counter The counter to decrement.
+ * @return    void
+******************************************************************************/
+static void counter_decrement(JobCounter *counter)
+{
+	unsigned int value = atomic_load_explicit(&counter->value, memory_order_relaxed);
+	struct JobContinuation *continuations = NULL;
+
+	while (value > 1)
+	{
+		if (atomic_compare_exchange_weak_explicit(&counter->value,
+		                                          &value,
+		                                          value - 1,
+		                                          memory_order_acq_rel,
+		                                          memory_order_relaxed))
+		{
+			return;
+		}
+	}
+
+	counter_lock(counter);
+	if (atomic_fetch_sub_explicit(&counter->value, 1, memory_order_acq_rel) == 1)
+	{
+		continuations = counter->continuations;
+		counter->continuations = NULL;
+	}
+	counter_unlock(counter);
+
+	while (continuations != NULL)
+	{
+		struct JobContinuation *next = continuations->next;
+
+		submit(continuations->jobs, continuations->count, continuations->counter);
+		free(continuations);
+		continuations = next;
+	}
+}
+
+static void run_job(JobFunction function, void *data, JobCounter *counter)
+{
+	function(data);
+
+	if (counter != NULL)
+	{
+		counter_decrement(counter);
+	}
+}
+
+static uint8_t run_main_job()
+{
+	Job job;
+	JobCounter *counter;
+
+	pthread_mutex_lock(&job_system.main_lock);
+	if (job_system.main_count == 0)
+	{
+		pthread_mutex_unlock(&job_system.main_lock);
+		return 0;
+	}
+
+	/* Oldest first, main thread work is usually ordered. */
+	job = job_system.main_jobs[0];
+	counter = job_system.main_counters[0];
+	job_system.main_count--;
+	memmove(job_system.main_jobs,
+	        job_system.main_jobs + 1,
+	        job_system.main_count * sizeof(Job));
+	memmove(job_system.main_counters,
+	        job_system.main_counters + 1,
+	        job_system.main_count * sizeof(JobCounter*));
+	pthread_mutex_unlock(&job_system.main_lock);
+
+	run_job(job.function, job.data, counter);
+	return 1;
+}
+
+static uint8_t run_background_job()
+{
+	Job job;
+	JobCounter *counter;
+	uint32_t head;
+
+	if (atomic_load_explicit(&job_system.background_pending, memory_order_relaxed) == 0)
+	{
+		return 0;
+	}
+
+	pthread_mutex_lock(&job_system.background_lock);
+	if (job_system.background_count == 0)
+	{
+		pthread_mutex_unlock(&job_system.background_lock);
+		return 0;
+	}
+
+	head = job_system.background_head;
+	job = job_system.background_jobs[head];
+	counter = job_system.background_counters[head];
+	job_system.background_head = (head + 1) % job_system.background_capacity;
+	job_system.background_count--;
+	atomic_fetch_sub_explicit(&job_system.background_pending, 1, memory_order_relaxed);
+	pthread_mutex_unlock(&job_system.background_lock);
+
+	run_job(job.function, job.data, counter);
+	return 1;
+}
+
+/******************************************************************************
+ * @name   run_one()
+ * @brief  Runs a single job from the calling thread's queue, or stolen from
+ *         another thread. The main thread also runs its own jobs.
+ * @return 1 if a job was run, else 0.
+******************************************************************************/
+static uint8_t run_one()
+{
+	struct QueuedJob job;
+	uint32_t victim;
+
+	if (queue_take(&job_system.queues[thread_index], &job))
+	{
+		run_job(job.function, job.data, job.counter);
+		return 1;
+	}
+
+	if (thread_index == 0 && run_main_job())
+	{
+		return 1;
+	}
+
+	/* xorshift, so thieves do not all pick on the same victim. */
+	steal_seed ^= steal_seed << 13;
+	steal_seed ^= steal_seed >> 17;
+	steal_seed ^= steal_seed << 5;
+	victim = steal_seed % job_system.thread_count;
+
+	for (uint32_t i = 0; i < job_system.thread_count; i++)
+	{
+		uint32_t index = (victim + i) % job_system.thread_count;
+
+		if (index != (uint32_t)thread_index
+		    && queue_steal(&job_system.queues[index], &job))
+		{
+			run_job(job.function, job.data, job.counter);
+			return 1;
+		}
+	}
+
+	/* Background work only fills time workers would otherwise sleep. */
+	return thread_index != 0 && run_background_job();
+}
+
+static uint8_t work_available()
+{
+	if (atomic_load(&job_system.background_pending) > 0)
+	{
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < job_system.thread_count; i++)
+	{
+		struct JobQueue *queue = &job_system.queues[i];
+
+		if (atomic_load(&queue->bottom) > atomic_load(&queue->top))
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void *worker_main(void *argument)
+{
+	thread_index = (int32_t)(intptr_t)argument;
+	steal_seed = 2463534242u * (uint32_t)thread_index;
+
+	PROFILE_THREAD_NAME("Job worker");
+
+	while (atomic_load(&job_system.running))
+	{
+		uint8_t found = 0;
+
+		for (uint32_t i = 0; i < JOB_SPIN_COUNT && !found; i++)
+		{
+			found = run_one();
+		}
+
+		if (found)
+		{
+			continue;
+		}
+
+		pthread_mutex_lock(&job_system.sleep_lock);
+		atomic_fetch_add(&job_system.sleeping, 1);
+
+		/* Pairs with the fence in wake_workers(). */
+		if (atomic_load(&job_system.running) && !work_available())
+		{
+			struct timespec timeout;
+
+			clock_gettime(CLOCK_REALTIME, &timeout);
+			timeout.tv_nsec += JOB_IDLE_WAIT_NS;
+			if (timeout.tv_nsec >= 1000000000)
+			{
+				timeout.tv_sec++;
+				timeout.tv_nsec -= 1000000000;
+			}
+
+			pthread_cond_timedwait(&job_system.wake,
+			                       &job_system.sleep_lock,
+			                       &timeout);
+		}
+
+		atomic_fetch_sub(&job_system.sleeping, 1);
+		pthread_mutex_unlock(&job_system.sleep_lock);
+	}
+
+	/* Jobs queued by jobs that were running at shutdown. */
+	while (run_one())
+	{
+	}
+
+	return NULL;
+}
+
+ENGINE_ERROR job_system_create(uint32_t worker_count)
+{
+	ENGINE_ERROR error = ENGINE_OK;
+	uint32_t started = 0;
+
+	PROFILE_THREAD_NAME("Main");
+
+	if (worker_count == 0)
+	{
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		worker_count = cores > 1 ? (uint32_t)cores - 1 : 1;
+	}
+
+	job_system.thread_count = worker_count + 1;
+	job_system.queues = aligned_alloc(64,
+		job_system.thread_count * sizeof(struct JobQueue));
+	job_system.workers = malloc(worker_count * sizeof(pthread_t));
+
+	if (job_system.queues == NULL || job_system.workers == NULL)
+	{
+		error = ENGINE_ERROR_OUT_OF_MEMORY;
+		ENGINE_LOG_GOTO_IF_ERROR(error,
+		                         "Failed to allocate job queues",
+		                         alloc_fail);
+	}
+
+	for (uint32_t i = 0; i < job_system.thread_count; i++)
+	{
+		atomic_init(&job_system.queues[i].top, 0);
+		atomic_init(&job_system.queues[i].bottom, 0);
+	}
+
+	job_system.main_jobs = NULL;
+	job_system.main_counters = NULL;
+	job_system.main_count = 0;
+	job_system.main_capacity = 0;
+	pthread_mutex_init(&job_system.main_lock, NULL);
+
+	job_system.background_jobs = NULL;
+	job_system.background_counters = NULL;
+	job_system.background_head = 0;
+	job_system.background_count = 0;
+	job_system.background_capacity = 0;
+	atomic_init(&job_system.background_pending, 0);
+	pthread_mutex_init(&job_system.background_lock, NULL);
+
+	atomic_init(&job_system.running, 1);
+	atomic_init(&job_system.sleeping, 0);
+	pthread_mutex_init(&job_system.sleep_lock, NULL);
+	pthread_cond_init(&job_system.wake, NULL);
+
+	thread_index = 0;
+	steal_seed = 2463534242u;
+
+	for (; started < worker_count; started++)
+	{
+		if (pthread_create(&job_system.workers[started],
+		                   NULL,
+		                   worker_main,
+		                   (void*)(intptr_t)(started + 1)) != 0)
+		{
+			error = ENGINE_ERROR_INIT_FAILED;
+			ENGINE_LOG_GOTO_IF_ERROR(error,
+			                         "Failed to start job worker thread",
+			                         thread_fail);
+		}
+	}
+
+	LOG_INFO("Job system started with %u worker threads", worker_count);
+
+	return ENGINE_OK;
+
+thread_fail:
+	atomic_store(&job_system.running, 0);
+	wake_workers();
+	for (uint32_t i = 0; i < started; i++)
+	{
+		pthread_join(job_system.workers[i], NULL);
+	}
+	pthread_cond_destroy(&job_system.wake);
+	pthread_mutex_destroy(&job_system.sleep_lock);
+	pthread_mutex_destroy(&job_system.background_lock);
+	pthread_mutex_destroy(&job_system.main_lock);
+	thread_index = -1;
+alloc_fail:
+	free(job_system.workers);
+	free(job_system.queues);
+	job_system.workers = NULL;
+	job_system.queues = NULL;
+	return error;
+}
+
+void job_system_destroy()
+{
+	/* Finish everything still queued, including main thread jobs. */
+	while (run_one() || work_available())
+	{
+	}
+
+	atomic_store(&job_system.running, 0);
+	pthread_mutex_lock(&job_system.sleep_lock);
+	pthread_cond_broadcast(&job_system.wake);
+	pthread_mutex_unlock(&job_system.sleep_lock);
+
+	for (uint32_t i = 0; i < job_system.thread_count - 1; i++)
+	{
+		pthread_join(job_system.workers[i], NULL);
+	}
+
+	pthread_cond_destroy(&job_system.wake);
+	pthread_mutex_destroy(&job_system.sleep_lock);
+	pthread_mutex_destroy(&job_system.background_lock);
+	pthread_mutex_destroy(&job_system.main_lock);
+
+	free(job_system.main_jobs);
+	free(job_system.main_counters);
+	free(job_system.background_jobs);
+	free(job_system.background_counters);
+	free(job_system.workers);
+	free(job_system.queues);
+	memset(&job_system, 0, sizeof(job_system));
+
+	thread_index = -1;
+}
+
+uint32_t job_thread_count()
+{
+	return job_system.thread_count;
+}
+
+uint32_t job_thread_index()
+{
+	return (uint32_t)thread_index;
+}
+
+void job_run(const Job *restrict jobs,
+             uint32_t count,
+             JobCounter *restrict counter)
+{
+	if (counter != NULL)
+	{
+		atomic_fetch_add_explicit(&counter->value, count, memory_order_relaxed);
+	}
+
+	submit(jobs, count, counter);
+}
+
+void job_run_after(JobCounter *dependency,
+                   const Job *jobs,
+                   uint32_t count,
+                   JobCounter *counter)
+{
+	struct JobContinuation *continuation;
+
+	if (counter != NULL)
+	{
+		atomic_fetch_add_explicit(&counter->value, count, memory_order_relaxed);
+	}
+
+	counter_lock(dependency);
+	if (atomic_load_explicit(&dependency->value, memory_order_acquire) == 0)
+	{
+		counter_unlock(dependency);
+		submit(jobs, count, counter);
+		return;
+	}
+
+	continuation = malloc(sizeof(struct JobContinuation) + count * sizeof(Job));
+	ENGINE_ASSERT(continuation != NULL);
+
+	continuation->counter = counter;
+	continuation->count = count;
+	memcpy(continuation->jobs, jobs, count * sizeof(Job));
+
+	continuation->next = dependency->continuations;
+	dependency->continuations = continuation;
+	counter_unlock(dependency);
+}
+
+void job_run_main(const Job *restrict jobs,
+                  uint32_t count,
+                  JobCounter *restrict counter)
+{
+	if (counter != NULL)
+	{
+		atomic_fetch_add_explicit(&counter->value, count, memory_order_relaxed);
+	}
+
+	pthread_mutex_lock(&job_system.main_lock);
+
+	if (job_system.main_count + count > job_system.main_capacity)
+	{
+		uint32_t capacity = job_system.main_capacity ? job_system.main_capacity : 64;
+
+		while (capacity < job_system.main_count + count)
+		{
+			capacity *= 2;
+		}
+
+		job_system.main_jobs = realloc(job_system.main_jobs,
+		                               capacity * sizeof(Job));
+		job_system.main_counters = realloc(job_system.main_counters,
+		                                   capacity * sizeof(JobCounter*));
+		ENGINE_ASSERT(job_system.main_jobs != NULL
+		              && job_system.main_counters != NULL);
+		job_system.main_capacity = capacity;
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		job_system.main_jobs[job_system.main_count] = jobs[i];
+		job_system.main_counters[job_system.main_count] = counter;
+		job_system.main_count++;
+	}
+
+	pthread_mutex_unlock(&job_system.main_lock);
+}
+
+void job_run_background(const Job *restrict jobs,
+                        uint32_t count,
+                        JobCounter *restrict counter)
+{
+	if (counter != NULL)
+	{
+		atomic_fetch_add_explicit(&counter->value, count, memory_order_relaxed);
+	}
+
+	pthread_mutex_lock(&job_system.background_lock);
+
+	if (job_system.background_count + count > job_system.background_capacity)
+	{
+		uint32_t capacity = job_system.background_capacity
+		                    ? job_system.background_capacity
+		                    : 64;
+		Job *background_jobs;
+		JobCounter **background_counters;
+
+		while (capacity < job_system.background_count + count)
+		{
+			capacity *= 2;
+		}
+
+		/* Unwrap the ring so the queued jobs start at the front. */
+		background_jobs = malloc(capacity * sizeof(Job));
+		background_counters = malloc(capacity * sizeof(JobCounter*));
+		ENGINE_ASSERT(background_jobs != NULL && background_counters != NULL);
+
+		for (uint32_t i = 0; i < job_system.background_count; i++)
+		{
+			uint32_t index = (job_system.background_head + i)
+			                 % job_system.background_capacity;
+
+			background_jobs[i] = job_system.background_jobs[index];
+			background_counters[i] = job_system.background_counters[index];
+		}
+
+		free(job_system.background_jobs);
+		free(job_system.background_counters);
+		job_system.background_jobs = background_jobs;
+		job_system.background_counters = background_counters;
+		job_system.background_head = 0;
+		job_system.background_capacity = capacity;
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t index = (job_system.background_head + job_system.background_count)
+		                 % job_system.background_capacity;
+
+		job_system.background_jobs[index] = jobs[i];
+		job_system.background_counters[index] = counter;
+		job_system.background_count++;
+	}
+
+	atomic_fetch_add_explicit(&job_system.background_pending, count, memory_order_relaxed);
+	pthread_mutex_unlock(&job_system.background_lock);
+
+	wake_workers();
+}
+
+void job_process_main()
+{
+	ENGINE_ASSERT(thread_index == 0);
+
+	while (run_main_job())
+	{
+	}
+}
+
+static void parallel_for_job(void *data)
+{
+	struct ParallelFor *parallel_for = data;
+
+	for (;;)
+	{
+		uint32_t start = atomic_fetch_add_explicit(&parallel_for->next,
+		                                           parallel_for->batch_size,
+		                                           memory_order_relaxed);
+		uint32_t end;
+
+		if (start >= parallel_for->count)
+		{
+			break;
+		}
+
+		end = start + parallel_for->batch_size;
+		if (end > parallel_for->count)
+		{
+			end = parallel_for->count;
+		}
+
+		parallel_for->function(parallel_for->data, start, end);
+	}
+
+	if (atomic_fetch_sub_explicit(&parallel_for->references,
+	                              1,
+	                              memory_order_acq_rel) == 1)
+	{
+		free(parallel_for);
+	}
+}
+
+void job_parallel_for(uint32_t count,
+                      uint32_t batch_size,
+                      ParallelForFunction function,
+                      void *data,
+                      JobCounter *counter)
+{
+	struct ParallelFor *parallel_for;
+	uint32_t batch_count;
+	uint32_t job_count;
+	Job job;
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (batch_size == 0)
+	{
+		batch_size = 1;
+	}
+
+	batch_count = (count + batch_size - 1) / batch_size;
+
+	/* A single batch is not worth the overhead of a job. */
+	if (batch_count == 1)
+	{
+		function(data, 0, count);
+		return;
+	}
+
+	job_count = batch_count < job_system.thread_count
+	            ? batch_count
+	            : job_system.thread_count;
+
+	parallel_for = malloc(sizeof(struct ParallelFor));
+	ENGINE_ASSERT(parallel_for != NULL);
+
+	parallel_for->function = function;
+	parallel_for->data = data;
+	parallel_for->count = count;
+	parallel_for->batch_size = batch_size;
+	atomic_init(&parallel_for->next, 0);
+	atomic_init(&parallel_for->references, job_count);
+
+	job.function = parallel_for_job;
+	job.data = parallel_for;
+
+	if (counter != NULL)
+	{
+		atomic_fetch_add_explicit(&counter->value, job_count, memory_order_relaxed);
+	}
+
+	for (uint32_t i = 0; i < job_count; i++)
+	{
+		submit(&job, 1, counter);
+	}
+}
+
+void job_wait(JobCounter *counter)
+{
+	uint32_t idle = 0;
+
+	while (atomic_load_explicit(&counter->value, memory_order_acquire) != 0)
+	{
+		if (run_one())
+		{
+			idle = 0;
+		}
+		else if (++idle > JOB_SPIN_COUNT)
+		{
+			sched_yield();
+		}
+	}
+
+	/* The last decrement may still hold the lock. */
+	counter_lock(counter);
+	counter_unlock(counter);
+}
@@ -0,0 +1,183 @@
+#ifndef _JOBS_H_
+#define _JOBS_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "debug.h"
+
+#define JOB_QUEUE_SIZE 4096 /* Per worker, must be a power of two. */
+
+/******************************************************************************
+ * @name  JobFunction
+ * @brief The work a job does.
+ * @param data The data given when the job was submitted.
+******************************************************************************/
+typedef void (*JobFunction)(void *data);
+
+/******************************************************************************
+ * @name  ParallelForFunction
+ * @brief The work a parallel for does on one batch of its range.
+ * @param data  The data given to job_parallel_for().
+ * @param start The first index of the batch.
+ * @param end   One past the last index of the batch.
+******************************************************************************/
+typedef void (*ParallelForFunction)(void *data, uint32_t start, uint32_t end);
+
+/******************************************************************************
+ * @name  _JobCounter
+ * @brief Counts jobs that have been submitted but not finished. Zero
+ *        initialise before first use. A counter can be waited on, or used as a
+ *        dependency of jobs that should only start once it reaches zero.
+******************************************************************************/
+struct _JobCounter
+{
+	atomic_uint value;
+	atomic_int lock;                   /*< Guards continuations. */
+	struct JobContinuation *continuations; /*< Jobs waiting for zero. */
+};
+typedef struct _JobCounter JobCounter;
+
+/******************************************************************************
+ * @name  _Job
+ * @brief A function to run on any thread and the data to run it with.
+******************************************************************************/
+struct _Job
+{
+	JobFunction function;
+	void *data;
+};
+typedef struct _Job Job;
+
+/******************************************************************************
+ * @name   job_system_create()
+ * @brief  Starts the worker threads. Must be called from the main thread,
+ *         which also runs jobs while it waits on a counter.
+ * @param  worker_count The number of worker threads, 0 to use one per core
+ *                      not taken by the main thread.
+ * @return An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR job_system_create(uint32_t worker_count);
+
+/******************************************************************************
+ * @name   job_system_destroy()
+ * @brief  Finishes every queued job then stops the worker threads.
+ * @return void
+******************************************************************************/
+void job_system_destroy();
+
+/******************************************************************************
+ * @name   job_thread_count()
+ * @brief  The number of threads that run jobs, including the main thread.
+ * @return The thread count.
+******************************************************************************/
+uint32_t job_thread_count();
+
+/******************************************************************************
+ * @name   job_thread_index()
+ * @brief  Identifies the calling thread. The main thread is 0 and workers are
+ *         numbered from 1, so the index can select per thread data.
+ * @return The index of the calling thread.
+******************************************************************************/
+uint32_t job_thread_index();
+
+/******************************************************************************
+ * @name      job_run()
+ * @brief     Queues jobs to be run by any thread. Must be called from the main
+ *            thread or a job.
+ * @param[in] jobs    The jobs to run.
+ * @param     count   The number of jobs.
+ * @param[in] counter Incremented by count and decremented as each job
+ *                    finishes. May be NULL.
+ * @return    void
+******************************************************************************/
+void job_run(const Job *restrict jobs,
+             uint32_t count,
+             JobCounter *restrict counter);
+
+/******************************************************************************
+ * @name      job_run_after()
+ * @brief     Queues jobs once a dependency reaches zero. The jobs are counted
+ *            by counter straight away, so waiting on counter also waits for
+ *            the dependency.
+ * @param[in] dependency The counter that must reach zero first.
+ * @param[in] jobs       The jobs to run.
+ * @param     count      The number of jobs.
+ * @param[in] counter    Incremented by count and decremented as each job
+ *                       finishes. May be NULL.
+ * @return    void
+******************************************************************************/
+void job_run_after(JobCounter *dependency,
+                   const Job *jobs,
+                   uint32_t count,
+                   JobCounter *counter);
+
+/******************************************************************************
+ * @name      job_run_main()
+ * @brief     Queues jobs that must run on the main thread, such as those that
+ *            use the window or the graphics queue. They are run by
+ *            job_process_main() or while the main thread waits on a counter.
+ *            Can be called from any job.
+ * @param[in] jobs    The jobs to run.
+ * @param     count   The number of jobs.
+ * @param[in] counter Incremented by count and decremented as each job
+ *                    finishes. May be NULL.
+ * @return    void
+******************************************************************************/
+void job_run_main(const Job *restrict jobs,
+                  uint32_t count,
+                  JobCounter *restrict counter);
+
+/******************************************************************************
+ * @name      job_run_background()
+ * @brief     Queues jobs that only worker threads run, once they have nothing
+ *            else to do, such as streaming or meshing. The main thread never
+ *            runs them, so waiting on a frame's work never waits on them.
+ *            Jobs run in the order they were queued. Can be called from any
+ *            thread.
+ * @param[in] jobs    The jobs to run.
+ * @param     count   The number of jobs.
+ * @param[in] counter Incremented by count and decremented as each job
+ *                    finishes. May be NULL.
+ * @return    void
+******************************************************************************/
+void job_run_background(const Job *restrict jobs,
+                        uint32_t count,
+                        JobCounter *restrict counter);
+
+/******************************************************************************
+ * @name   job_process_main()
+ * @brief  Runs the jobs queued for the main thread. Called by the main thread
+ *         once per frame.
+ * @return void
+******************************************************************************/
+void job_process_main();
+
+/******************************************************************************
+ * @name      job_parallel_for()
+ * @brief     Splits [0, count) into batches run across all threads. Batches
+ *            are handed out as threads become free so uneven work balances.
+ * @param     count      The size of the range.
+ * @param     batch_size The number of indices given to the function at once.
+ * @param     function   The function to run on each batch.
+ * @param[in] data       Given to every call of function.
+ * @param[in] counter    Reaches zero once every batch has finished. May be
+ *                       NULL.
+ * @return    void
+******************************************************************************/
+void job_parallel_for(uint32_t count,
+                      uint32_t batch_size,
+                      ParallelForFunction function,
+                      void *data,
+                      JobCounter *counter);
+
+/******************************************************************************
+ * @name      job_wait()
+ * @brief     Runs queued jobs until a counter reaches zero. Once it returns
+ *            the counter is no longer used by the job system.
+ * @param[in] counter The counter to wait on.
+ * @return    void
+******************************************************************************/
+void job_wait(JobCounter *counter);
+
+#endif /* _JOBS_H_ */
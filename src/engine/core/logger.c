@@ -5,10 +5,75 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include <time.h>
 
 #define ARRAY_SIZE(arr) sizeof(arr) / sizeof(arr[0])
 
+#define LOG_FILE_PATH     "./logs/engine.log"
+#define LOG_MESSAGE_SIZE  256
+#define LOG_RING_SIZE     1024 /* Must be a power of two. */
+#define LOG_IDLE_WAIT_NS  100000000
+
+/******************************************************************************
+ * @name  LogEntry
+ * @brief A formatted message waiting to be written. The sequence number says
+ *        whether the slot is free for a producer or ready for the writer.
+******************************************************************************/
+struct LogEntry
+{
+	atomic_size_t sequence;
+	enum Verbosity verbosity;
+	struct timespec time;
+	char message[LOG_MESSAGE_SIZE];
+};
+
+/******************************************************************************
+ * @name  Logger
+ * @brief A bounded multi producer, single consumer ring of log entries and the
+ *        thread that writes them out. Producers never block, a message is
+ *        dropped and counted when the ring is full.
+******************************************************************************/
+struct Logger
+{
+	struct LogEntry ring[LOG_RING_SIZE];
+	atomic_size_t enqueue_position;
+	atomic_size_t dequeue_position; /*< Only written by the writer thread. */
+	atomic_size_t dropped;
+
+	FILE *file; /*< Kept open for the lifetime of the process. */
+
+	pthread_t writer;
+	atomic_int running;
+	atomic_int sleeping;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;    /*< Signalled when there is work for the writer. */
+	pthread_cond_t drained; /*< Broadcast when the writer empties the ring. */
+};
+
+static struct Logger logger;
+static pthread_once_t logger_once = PTHREAD_ONCE_INIT;
+
+static const char *const verbosity_colours[] = {
+	"\e[0;34m",   /* DEBUG - Blue */
+	"\e[0;37m",   /* INFO - White */
+	"\e[0;33m",   /* WARNING - Yellow */
+	"\e[0;31m",   /* ERROR - Red */
+	"\e[1;31m",   /* FATAL - Red */
+	"\e[0;0m",    /* Reset */
+};
+
+static const char *const verbosity_strings[] = {
+	"Debug",
+	"Info",
+	"Warning",
+	"Error",
+	"Fatal"
+};
+
+static const uint8_t log_to_stdout_mask = 0xFF; /* Verbosities included in this mask will be logged to stdout. */
+
 /******************************************************************************
  * @name   get_verbosity_index()
  * @brief  Transforms a verbosity into a index for an array.
@@ -20,100 +85,348 @@ static int get_verbosity_index(enum Verbosity verbosity, size_t max_index)
 {
 	uint8_t verbosity_index = (uint8_t)verbosity;
 
-	for (int i = 0; i < max_index; i++)
+	for (uint32_t i = 0; i < max_index; i++)
 	{
 		verbosity_index >>= 1;
 		if (verbosity_index == 0)
 		{
-			return i;
+			return (int)i;
 		}
 	}
 
 	return -1;
 }
 
+/******************************************************************************
+ * @name      write_entry()
+ * @brief     Writes a message to stdout and the log file. Output is buffered
+ *            until the caller flushes.
+ * @param     verbosity The verbosity of the message.
+ * @param[in] time      When the message was logged.
+ * @param[in] message   The formatted message.
+ * @return    void
+******************************************************************************/
+static void write_entry(enum Verbosity verbosity,
+                        const struct timespec *time,
+                        const char *message)
+{
+	const int verbosity_index =
+		get_verbosity_index(verbosity, ARRAY_SIZE(verbosity_colours) - 1);
+
+	if (verbosity_index < 0)
+	{
+		return;
+	}
+
+	if (verbosity & log_to_stdout_mask)
+	{
+		fprintf(stdout,
+		        "%s%s: %s%s\n",
+		        verbosity_colours[verbosity_index],
+		        verbosity_strings[verbosity_index],
+		        message,
+		        verbosity_colours[ARRAY_SIZE(verbosity_colours) - 1]);
+	}
+
+	if (logger.file != NULL)
+	{
+		struct tm local_time;
+		char str_time[32];
+
+		localtime_r(&time->tv_sec, &local_time);
+		strftime(str_time, sizeof(str_time), "%X", &local_time);
+
+		fprintf(logger.file,
+		        "[%s.%03ld] %s: %s\n",
+		        str_time,
+		        time->tv_nsec / 1000000,
+		        verbosity_strings[verbosity_index],
+		        message);
+	}
+}
+
+/******************************************************************************
+ * @name   drain()
+ * @brief  Writes every entry that is ready, in order, then flushes the output.
+ *         Only called by the writer thread, or once it has stopped.
+ * @return The number of entries written.
+******************************************************************************/
+static size_t drain()
+{
+	size_t position = atomic_load_explicit(&logger.dequeue_position,
+	                                       memory_order_relaxed);
+	size_t dropped = atomic_exchange(&logger.dropped, 0);
+	size_t written = 0;
+
+	if (dropped > 0)
+	{
+		struct timespec now;
+		char message[64];
+
+		clock_gettime(CLOCK_REALTIME, &now);
+		snprintf(message, sizeof(message), "%zu log messages were dropped", dropped);
+		write_entry(VERB_WARNING, &now, message);
+	}
+
+	for (;;)
+	{
+		struct LogEntry *entry = &logger.ring[position & (LOG_RING_SIZE - 1)];
+		size_t sequence = atomic_load_explicit(&entry->sequence,
+		                                       memory_order_acquire);
+
+		/* Empty, or the next producer has not finished writing its entry. */
+		if (sequence != position + 1)
+		{
+			break;
+		}
+
+		write_entry(entry->verbosity, &entry->time, entry->message);
+
+		atomic_store_explicit(&entry->sequence,
+		                      position + LOG_RING_SIZE,
+		                      memory_order_release);
+		position++;
+		written++;
+	}
+
+	if (written > 0 || dropped > 0)
+	{
+		fflush(stdout);
+		if (logger.file != NULL)
+		{
+			fflush(logger.file);
+		}
+	}
+
+	atomic_store_explicit(&logger.dequeue_position, position, memory_order_release);
+	return written;
+}
+
+static void *writer_main(void *argument)
+{
+	(void)argument;
+
+	while (atomic_load(&logger.running))
+	{
+		if (drain() > 0)
+		{
+			continue;
+		}
+
+		pthread_mutex_lock(&logger.lock);
+		pthread_cond_broadcast(&logger.drained);
+
+		atomic_store(&logger.sleeping, 1);
+
+		/* Pairs with the fence in log_message(), an entry published before
+		 * sleeping was read as 0 is seen here. */
+		if (atomic_load(&logger.running)
+		    && atomic_load(&logger.enqueue_position)
+		       == atomic_load(&logger.dequeue_position))
+		{
+			struct timespec timeout;
+
+			clock_gettime(CLOCK_REALTIME, &timeout);
+			timeout.tv_nsec += LOG_IDLE_WAIT_NS;
+			if (timeout.tv_nsec >= 1000000000)
+			{
+				timeout.tv_sec++;
+				timeout.tv_nsec -= 1000000000;
+			}
+
+			pthread_cond_timedwait(&logger.wake, &logger.lock, &timeout);
+		}
+
+		atomic_store(&logger.sleeping, 0);
+		pthread_mutex_unlock(&logger.lock);
+	}
+
+	drain();
+
+	pthread_mutex_lock(&logger.lock);
+	pthread_cond_broadcast(&logger.drained);
+	pthread_mutex_unlock(&logger.lock);
+
+	return NULL;
+}
+
+static void wake_writer()
+{
+	pthread_mutex_lock(&logger.lock);
+	pthread_cond_signal(&logger.wake);
+	pthread_mutex_unlock(&logger.lock);
+}
+
+/******************************************************************************
+ * @name  logger_shutdown()
+ * @brief Stops the writer thread once everything logged has been written.
+ *        Registered with atexit().
+******************************************************************************/
+static void logger_shutdown()
+{
+	if (atomic_exchange(&logger.running, 0))
+	{
+		wake_writer();
+		pthread_join(logger.writer, NULL);
+	}
+
+	if (logger.file != NULL)
+	{
+		fclose(logger.file);
+		logger.file = NULL;
+	}
+}
+
+static void logger_init()
+{
+	for (size_t i = 0; i < LOG_RING_SIZE; i++)
+	{
+		atomic_init(&logger.ring[i].sequence, i);
+	}
+
+	atomic_init(&logger.enqueue_position, 0);
+	atomic_init(&logger.dequeue_position, 0);
+	atomic_init(&logger.dropped, 0);
+	atomic_init(&logger.sleeping, 0);
+	atomic_init(&logger.running, 1);
+
+	pthread_mutex_init(&logger.lock, NULL);
+	pthread_cond_init(&logger.wake, NULL);
+	pthread_cond_init(&logger.drained, NULL);
+
+	logger.file = fopen(LOG_FILE_PATH, "a");
+
+	/* Without a writer thread messages are written by the caller instead. */
+	if (pthread_create(&logger.writer, NULL, writer_main, NULL) != 0)
+	{
+		atomic_store(&logger.running, 0);
+	}
+
+	atexit(logger_shutdown);
+}
+
+void log_flush()
+{
+	size_t target;
+
+	pthread_once(&logger_once, logger_init);
+
+	if (!atomic_load(&logger.running))
+	{
+		return;
+	}
+
+	target = atomic_load(&logger.enqueue_position);
+
+	pthread_mutex_lock(&logger.lock);
+	while (atomic_load(&logger.running)
+	       && atomic_load(&logger.dequeue_position) < target)
+	{
+		pthread_cond_signal(&logger.wake);
+		pthread_cond_wait(&logger.drained, &logger.lock);
+	}
+	pthread_mutex_unlock(&logger.lock);
+}
+
 void log_message(enum Verbosity verbosity,
                  const char *restrict format,
                  const char *restrict file,
                  const unsigned int line,
                  ...)
 {
-	static const char *const verbosity_colours[] = {
-		"\e[0;34m",   /* DEBUG - Blue */
-		"\e[0;37m",   /* INFO - White */
-		"\e[0;33m",   /* WARNING - Yellow */
-		"\e[0;31m",   /* ERROR - Red */
-		"\e[1;31m",   /* FATAL - Red */
-		"\e[0;0m",    /* Reset */
-	};
-
-	static const char *const verbosity_strings[] = {
-		"Debug",
-		"Info",
-		"Warning",
-		"Error",
-		"Fatal"
-	};
-
-	static const uint8_t log_to_stdout_mask = 0xFF; /* Verbosities included in this mask will be logged to stdout. */
-	
-	const int verbosity_index = 
-		get_verbosity_index(verbosity, ARRAY_SIZE(verbosity_colours) - 1);
-	char message[256];
-	char log_message[512];
-	FILE *log_file = fopen("./logs/engine.log", "a");
+	struct LogEntry *entry;
+	size_t position;
 	va_list args;
-	int success = 0;
 
-	va_start(args, line);
-	
+	/* The source location is not part of the output, line only anchors va_start. */
+	(void)file;
+
 	if (!(verbosity & log_to_stdout_mask))
 	{
 		return;
 	}
 
-	if (strncpy(message, format, ARRAY_SIZE(message)) == NULL)
-	{
-		printf("Failed to copy log message\n");
-		return;
-	}
+	pthread_once(&logger_once, logger_init);
 
-	success = vsnprintf(message, ARRAY_SIZE(message), format, args);
-	if (success > ARRAY_SIZE(message) && success < 0)
+	if (!atomic_load_explicit(&logger.running, memory_order_relaxed))
 	{
-		printf("Failed to create log message\n");
+		struct timespec now;
+		char message[LOG_MESSAGE_SIZE];
+
+		clock_gettime(CLOCK_REALTIME, &now);
+		va_start(args, line);
+		vsnprintf(message, sizeof(message), format, args);
+		va_end(args);
+
+		write_entry(verbosity, &now, message);
+		fflush(stdout);
 		return;
 	}
 
-	if (verbosity & log_to_stdout_mask)
+	position = atomic_load_explicit(&logger.enqueue_position, memory_order_relaxed);
+
+	for (;;)
 	{
-		snprintf(log_message,
-		         sizeof(log_message),
-		         "%s%s: %s%s\n",
-		         verbosity_colours[verbosity_index],
-		         verbosity_strings[verbosity_index],
-		         message,
-		         verbosity_colours[ARRAY_SIZE(verbosity_colours) - 1]);
-		printf(log_message);
+		size_t sequence;
+		intptr_t difference;
+
+		entry = &logger.ring[position & (LOG_RING_SIZE - 1)];
+		sequence = atomic_load_explicit(&entry->sequence, memory_order_acquire);
+		difference = (intptr_t)sequence - (intptr_t)position;
+
+		if (difference == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit(&logger.enqueue_position,
+			                                          &position,
+			                                          position + 1,
+			                                          memory_order_relaxed,
+			                                          memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (difference < 0)
+		{
+			/* Full, drop rather than block the caller. Fatal messages are
+			 * never dropped, they wait for the writer to make room. */
+			if (verbosity != VERB_FATAL)
+			{
+				atomic_fetch_add_explicit(&logger.dropped, 1, memory_order_relaxed);
+				return;
+			}
+
+			log_flush();
+			position = atomic_load_explicit(&logger.enqueue_position,
+			                                memory_order_relaxed);
+		}
+		else
+		{
+			position = atomic_load_explicit(&logger.enqueue_position,
+			                                memory_order_relaxed);
+		}
 	}
 
-	if (log_file != NULL)
+	entry->verbosity = verbosity;
+	clock_gettime(CLOCK_REALTIME, &entry->time);
+
+	va_start(args, line);
+	if (vsnprintf(entry->message, sizeof(entry->message), format, args) < 0)
 	{
-		time_t raw_time;
-		char str_time[32];
+		strncpy(entry->message, "Failed to create log message", sizeof(entry->message));
+	}
+	va_end(args);
 
-		time(&raw_time);
-		strftime(str_time, sizeof(str_time), "%X", localtime(&raw_time));
+	atomic_store_explicit(&entry->sequence, position + 1, memory_order_release);
 
-		snprintf(log_message,
-		         sizeof(log_message),
-		         "[%s] %s: %s\n",
-		         str_time,
-		         verbosity_strings[verbosity_index],
-		         message);
-		fprintf(log_file, log_message);
-		fclose(log_file);
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&logger.sleeping, memory_order_relaxed))
+	{
+		wake_writer();
 	}
 
-	va_end(args);
-}
\ No newline at end of file
+	/* The process is likely about to abort, make sure the message lands. */
+	if (verbosity == VERB_FATAL)
+	{
+		log_flush();
+	}
+}
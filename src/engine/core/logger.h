@@ -17,7 +17,10 @@ enum Verbosity
 /******************************************************************************
  * @name   log_message()
  * @brief  Used to log a message to stdout or a specified file at a certain log
- *         verbosity.
+ *         verbosity. The message is formatted on the calling thread and
+ *         written later by a background thread. Messages are dropped, and the
+ *         number dropped is logged, if the writer falls too far behind. Fatal
+ *         messages are flushed before returning.
  * @param  verbosity  The verbosity level of the log message.
  * @param  format     The format of the message to be logged.
  * @param  file       The file in which the call to log was made.
@@ -30,6 +33,12 @@ void log_message(enum Verbosity verbosity,
                  const unsigned int line,
                  ...);
 
+/******************************************************************************
+ * @name   log_flush()
+ * @brief  Blocks until every message logged before the call has been written.
+ * @return void
+******************************************************************************/
+void log_flush();
 
 /******************************************************************************
  * Easy to use macros to be used to log.
@@ -0,0 +1,133 @@
+#ifndef _MATHS_H_
+#define _MATHS_H_
+
+#include <math.h>
+
+/******************************************************************************
+ * @name  _Vec3
+ * @brief A point or direction in 3D space.
+******************************************************************************/
+struct _Vec3
+{
+	float x, y, z;
+};
+typedef struct _Vec3 Vec3;
+
+/******************************************************************************
+ * @name  _Mat4
+ * @brief A 4x4 matrix stored column major, the layout GLSL expects.
+******************************************************************************/
+struct _Mat4
+{
+	float m[16]; /*< Element (row r, column c) is m[c * 4 + r]. */
+};
+typedef struct _Mat4 Mat4;
+
+static inline Vec3 vec3_sub(Vec3 a, Vec3 b)
+{
+	return (Vec3){a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+static inline float vec3_dot(Vec3 a, Vec3 b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static inline Vec3 vec3_cross(Vec3 a, Vec3 b)
+{
+	return (Vec3){a.y * b.z - a.z * b.y,
+	              a.z * b.x - a.x * b.z,
+	              a.x * b.y - a.y * b.x};
+}
+
+static inline Vec3 vec3_normalise(Vec3 v)
+{
+	float length = sqrtf(vec3_dot(v, v));
+
+	return length > 0.0f ? (Vec3){v.x / length, v.y / length, v.z / length} : v;
+}
+
+static inline Mat4 mat4_identity()
+{
+	return (Mat4){{1.0f, 0.0f, 0.0f, 0.0f,
+	               0.0f, 1.0f, 0.0f, 0.0f,
+	               0.0f, 0.0f, 1.0f, 0.0f,
+	               0.0f, 0.0f, 0.0f, 1.0f}};
+}
+
+/******************************************************************************
+ * @name   mat4_multiply()
+ * @brief  Multiplies two matrices, a vector is transformed by b and then a.
+ * @param  a The left hand matrix.
+ * @param  b The right hand matrix.
+ * @return a * b.
+******************************************************************************/
+static inline Mat4 mat4_multiply(const Mat4 *a, const Mat4 *b)
+{
+	Mat4 result;
+
+	for (int column = 0; column < 4; column++)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			float sum = 0.0f;
+
+			for (int k = 0; k < 4; k++)
+			{
+				sum += a->m[k * 4 + row] * b->m[column * 4 + k];
+			}
+
+			result.m[column * 4 + row] = sum;
+		}
+	}
+
+	return result;
+}
+
+/******************************************************************************
+ * @name   mat4_look_at()
+ * @brief  Creates a right handed view matrix, the camera looks down -z with
+ *         +y up.
+ * @param  eye    Where the camera is.
+ * @param  target The point the camera looks at.
+ * @param  up     The world's up direction.
+ * @return The view matrix.
+******************************************************************************/
+static inline Mat4 mat4_look_at(Vec3 eye, Vec3 target, Vec3 up)
+{
+	Vec3 forward = vec3_normalise(vec3_sub(target, eye));
+	Vec3 right = vec3_normalise(vec3_cross(forward, up));
+	Vec3 camera_up = vec3_cross(right, forward);
+
+	return (Mat4){{right.x, camera_up.x, -forward.x, 0.0f,
+	               right.y, camera_up.y, -forward.y, 0.0f,
+	               right.z, camera_up.z, -forward.z, 0.0f,
+	               -vec3_dot(right, eye),
+	               -vec3_dot(camera_up, eye),
+	               vec3_dot(forward, eye),
+	               1.0f}};
+}
+
+/******************************************************************************
+ * @name   mat4_perspective_reverse_z()
+ * @brief  Creates a Vulkan perspective projection with reversed depth and no
+ *         far plane. The near plane maps to depth 1 and infinity to 0, which
+ *         spreads float depth precision evenly over distance. Depth tests
+ *         must use VK_COMPARE_OP_GREATER and clear depth to 0. Clip space y
+ *         points down, so +y is up on screen.
+ * @param  fov_y  The vertical field of view in radians.
+ * @param  aspect The width of the view divided by its height.
+ * @param  near   The distance to the near plane, greater than 0.
+ * @return The projection matrix.
+******************************************************************************/
+static inline Mat4 mat4_perspective_reverse_z(float fov_y, float aspect, float near)
+{
+	float f = 1.0f / tanf(fov_y * 0.5f);
+
+	return (Mat4){{f / aspect, 0.0f, 0.0f,  0.0f,
+	               0.0f,       -f,   0.0f,  0.0f,
+	               0.0f,       0.0f, 0.0f, -1.0f,
+	               0.0f,       0.0f, near,  0.0f}};
+}
+
+#endif /* _MATHS_H_ */
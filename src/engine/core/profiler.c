@@ -0,0 +1,350 @@
+#include "profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "logger.h"
+#include "timer.h"
+
+#if ENGINE_PROFILE
+
+/* Events this close to being overwritten are not exported, the owning thread
+ * may be writing over them while they are read. */
+#define PROFILE_EXPORT_SLACK 1024
+#define PROFILE_MAX_DEPTH    256
+
+enum ProfileEventType
+{
+	PROFILE_EVENT_BEGIN,
+	PROFILE_EVENT_END,
+	PROFILE_EVENT_COUNTER,
+	PROFILE_EVENT_FRAME
+};
+
+/******************************************************************************
+ * @name  ProfileEvent
+ * @brief A single recorded event. Fields are atomic only so an export racing
+ *        the owning thread is well defined, they are written relaxed.
+******************************************************************************/
+struct ProfileEvent
+{
+	atomic_ullong time;
+	_Atomic(const char*) name;
+	_Atomic double value;
+	atomic_uint type;
+};
+
+/******************************************************************************
+ * @name  ProfileThread
+ * @brief The events of one thread. Only the owning thread writes, exports
+ *        read up to count. Buffers are never freed so a thread's events
+ *        outlive it.
+******************************************************************************/
+struct ProfileThread
+{
+	struct ProfileEvent events[PROFILE_EVENTS_PER_THREAD];
+	atomic_ullong count;
+	_Atomic(const char*) name;
+	uint32_t id;
+	struct ProfileThread *next;
+};
+
+static _Atomic(struct ProfileThread*) profile_threads = NULL;
+static atomic_uint profile_thread_count = 0;
+static _Thread_local struct ProfileThread *current_thread = NULL;
+
+/******************************************************************************
+ * @name   get_thread()
+ * @brief  Gets the calling thread's buffer, creating and publishing it on the
+ *         thread's first event.
+ * @return The buffer, or NULL if it could not be allocated.
+******************************************************************************/
+static struct ProfileThread *get_thread()
+{
+	struct ProfileThread *thread = current_thread;
+
+	if (thread != NULL)
+	{
+		return thread;
+	}
+
+	thread = calloc(1, sizeof(struct ProfileThread));
+	if (thread == NULL)
+	{
+		return NULL;
+	}
+
+	thread->id = atomic_fetch_add(&profile_thread_count, 1);
+	thread->next = atomic_load(&profile_threads);
+	while (!atomic_compare_exchange_weak(&profile_threads, &thread->next, thread))
+	{
+	}
+
+	current_thread = thread;
+	return thread;
+}
+
+static inline void record(enum ProfileEventType type, const char *name, double value)
+{
+	struct ProfileThread *thread = get_thread();
+	struct ProfileEvent *event;
+	unsigned long long count;
+
+	if (thread == NULL)
+	{
+		return;
+	}
+
+	count = atomic_load_explicit(&thread->count, memory_order_relaxed);
+	event = &thread->events[count & (PROFILE_EVENTS_PER_THREAD - 1)];
+
+	atomic_store_explicit(&event->time, timer_now_ns(), memory_order_relaxed);
+	atomic_store_explicit(&event->name, name, memory_order_relaxed);
+	atomic_store_explicit(&event->value, value, memory_order_relaxed);
+	atomic_store_explicit(&event->type, type, memory_order_relaxed);
+
+	atomic_store_explicit(&thread->count, count + 1, memory_order_release);
+}
+
+uint8_t profile_zone_begin(const char *name)
+{
+	record(PROFILE_EVENT_BEGIN, name, 0.0);
+	return 0;
+}
+
+void profile_zone_end(uint8_t *unused)
+{
+	(void)unused;
+
+	record(PROFILE_EVENT_END, NULL, 0.0);
+}
+
+void profile_counter(const char *name, double value)
+{
+	record(PROFILE_EVENT_COUNTER, name, value);
+}
+
+void profile_frame()
+{
+	record(PROFILE_EVENT_FRAME, "Frame", 0.0);
+}
+
+void profile_thread_name(const char *name)
+{
+	struct ProfileThread *thread = get_thread();
+
+	if (thread != NULL)
+	{
+		atomic_store(&thread->name, name);
+	}
+}
+
+/******************************************************************************
+ * @name      write_string()
+ * @brief     Writes a JSON string, escaping quotes and backslashes.
+ * @param[in] file   The file to write to.
+ * @param[in] string The string to write.
+ * @return    void
+******************************************************************************/
+static void write_string(FILE *file, const char *string)
+{
+	fputc('"', file);
+	for (; *string != '\0'; string++)
+	{
+		if (*string == '"' || *string == '\\')
+		{
+			fputc('\\', file);
+		}
+		fputc(*string, file);
+	}
+	fputc('"', file);
+}
+
+/******************************************************************************
+ * @name      write_zone()
+ * @brief     Writes a complete event for a zone.
+ * @param[in] file  The file to write to.
+ * @param     id    The id of the thread the zone ran on.
+ * @param[in] name  The zone's name.
+ * @param     start When the zone started.
+ * @param     end   When the zone ended.
+ * @return    void
+******************************************************************************/
+static void write_zone(FILE *file,
+                       uint32_t id,
+                       const char *name,
+                       uint64_t start,
+                       uint64_t end)
+{
+	fprintf(file, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":", id);
+	write_string(file, name);
+	fprintf(file,
+	        ",\"ts\":%.3f,\"dur\":%.3f}",
+	        start / 1000.0,
+	        (end - start) / 1000.0);
+}
+
+/******************************************************************************
+ * @name      write_thread()
+ * @brief     Writes a thread's events. Zones are paired into complete events,
+ *            an end whose start was overwritten is dropped and zones still
+ *            open are closed at the time of the export.
+ * @param[in] file   The file to write to.
+ * @param[in] thread The thread to write.
+ * @param     now    When the export started.
+ * @return    void
+******************************************************************************/
+static void write_thread(FILE *file, struct ProfileThread *thread, uint64_t now)
+{
+	const char *stack_names[PROFILE_MAX_DEPTH];
+	uint64_t stack_times[PROFILE_MAX_DEPTH];
+	uint32_t depth = 0;
+	const char *name = atomic_load(&thread->name);
+	unsigned long long count = atomic_load_explicit(&thread->count, memory_order_acquire);
+	unsigned long long start = 0;
+
+	if (count > PROFILE_EVENTS_PER_THREAD - PROFILE_EXPORT_SLACK)
+	{
+		start = count - (PROFILE_EVENTS_PER_THREAD - PROFILE_EXPORT_SLACK);
+	}
+
+	if (name != NULL)
+	{
+		fprintf(file,
+		        ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":",
+		        thread->id);
+		write_string(file, name);
+		fprintf(file, "}}");
+	}
+
+	for (unsigned long long i = start; i < count; i++)
+	{
+		struct ProfileEvent *event = &thread->events[i & (PROFILE_EVENTS_PER_THREAD - 1)];
+		uint64_t time = atomic_load_explicit(&event->time, memory_order_relaxed);
+		const char *event_name = atomic_load_explicit(&event->name, memory_order_relaxed);
+
+		switch (atomic_load_explicit(&event->type, memory_order_relaxed))
+		{
+			case PROFILE_EVENT_BEGIN:
+				if (depth < PROFILE_MAX_DEPTH)
+				{
+					stack_names[depth] = event_name;
+					stack_times[depth] = time;
+				}
+				depth++;
+				break;
+
+			case PROFILE_EVENT_END:
+				if (depth > 0)
+				{
+					depth--;
+					if (depth < PROFILE_MAX_DEPTH)
+					{
+						write_zone(file,
+						           thread->id,
+						           stack_names[depth],
+						           stack_times[depth],
+						           time);
+					}
+				}
+				break;
+
+			case PROFILE_EVENT_COUNTER:
+				fprintf(file, ",\n{\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"name\":", thread->id);
+				write_string(file, event_name);
+				fprintf(file,
+				        ",\"ts\":%.3f,\"args\":{\"value\":%g}}",
+				        time / 1000.0,
+				        atomic_load_explicit(&event->value, memory_order_relaxed));
+				break;
+
+			case PROFILE_EVENT_FRAME:
+				fprintf(file,
+				        ",\n{\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":%u,\"name\":\"Frame\",\"ts\":%.3f}",
+				        thread->id,
+				        time / 1000.0);
+				break;
+		}
+	}
+
+	while (depth > 0)
+	{
+		depth--;
+		if (depth < PROFILE_MAX_DEPTH)
+		{
+			write_zone(file, thread->id, stack_names[depth], stack_times[depth], now);
+		}
+	}
+}
+
+ENGINE_ERROR profiler_export(const char *path)
+{
+	uint64_t now = timer_now_ns();
+	FILE *file = fopen(path, "w");
+
+	if (file == NULL)
+	{
+		LOG_WARNING("Unable to write profile to %s", path);
+		return ENGINE_ERROR_INIT_FAILED;
+	}
+
+	/* The metadata event lets every other event start with a comma. */
+	fprintf(file,
+	        "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+	        "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"Cube Realms\"}}");
+
+	for (struct ProfileThread *thread = atomic_load(&profile_threads);
+	     thread != NULL;
+	     thread = thread->next)
+	{
+		write_thread(file, thread, now);
+	}
+
+	fprintf(file, "\n]}\n");
+
+	if (fclose(file) != 0)
+	{
+		LOG_WARNING("Unable to write profile to %s", path);
+		return ENGINE_ERROR_INIT_FAILED;
+	}
+
+	LOG_INFO("Wrote profile to %s", path);
+	return ENGINE_OK;
+}
+
+#else
+
+uint8_t profile_zone_begin(const char *name)
+{
+	(void)name;
+	return 0;
+}
+
+void profile_zone_end(uint8_t *unused)
+{
+	(void)unused;
+}
+
+void profile_counter(const char *name, double value)
+{
+	(void)name;
+	(void)value;
+}
+
+void profile_frame()
+{
+}
+
+void profile_thread_name(const char *name)
+{
+	(void)name;
+}
+
+ENGINE_ERROR profiler_export(const char *path)
+{
+	LOG_WARNING("Profiling is disabled, build with -Dprofile=true to export %s", path);
+	return ENGINE_OK;
+}
+
+#endif /* ENGINE_PROFILE */
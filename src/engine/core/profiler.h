@@ -0,0 +1,107 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <stdint.h>
+
+#include "debug.h"
+
+/******************************************************************************
+ * CPU profiling. Build with -Dprofile=true to define ENGINE_PROFILE, without
+ * it every macro below expands to nothing and costs nothing.
+ *
+ * Events are written to a buffer owned by the calling thread without locks,
+ * each buffer keeps the most recent PROFILE_EVENTS_PER_THREAD events. Names
+ * must be string literals or otherwise outlive the process.
+******************************************************************************/
+
+#define PROFILE_EVENTS_PER_THREAD (1u << 14) /* Must be a power of two. */
+
+#if ENGINE_PROFILE
+
+/* Times the rest of the enclosing scope. */
+#define PROFILE_ZONE(name) \
+	PROFILE_ZONE_NAMED(PROFILE_CONCAT(_profile_zone_, __LINE__), name)
+
+#define PROFILE_ZONE_NAMED(variable, name) \
+	__attribute__((cleanup(profile_zone_end))) uint8_t variable = \
+		profile_zone_begin(name)
+
+/* Times from PROFILE_BEGIN() to the matching PROFILE_END() on one thread. */
+#define PROFILE_BEGIN(name) profile_zone_begin(name)
+#define PROFILE_END() profile_zone_end(NULL)
+
+/* Records a named value over time. */
+#define PROFILE_COUNTER(name, value) profile_counter(name, (double)(value))
+
+/* Marks the start of a new frame. */
+#define PROFILE_FRAME() profile_frame()
+
+/* Names the calling thread in exported traces. */
+#define PROFILE_THREAD_NAME(name) profile_thread_name(name)
+
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_CONCAT_INNER(a, b) a##b
+
+#else
+
+#define PROFILE_ZONE(name)
+#define PROFILE_BEGIN(name) ((void)0)
+#define PROFILE_END() ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+
+#endif /* ENGINE_PROFILE */
+
+/******************************************************************************
+ * @name      profile_zone_begin()
+ * @brief     Records the start of a zone. Use the PROFILE_ macros instead.
+ * @param[in] name The zone's name.
+ * @return    A dummy value for PROFILE_ZONE() to attach its cleanup to.
+******************************************************************************/
+uint8_t profile_zone_begin(const char *name);
+
+/******************************************************************************
+ * @name      profile_zone_end()
+ * @brief     Records the end of the most recently started zone.
+ * @param[in] unused Allows use as a cleanup function.
+ * @return    void
+******************************************************************************/
+void profile_zone_end(uint8_t *unused);
+
+/******************************************************************************
+ * @name      profile_counter()
+ * @brief     Records the value of a counter.
+ * @param[in] name  The counter's name.
+ * @param     value The counter's value.
+ * @return    void
+******************************************************************************/
+void profile_counter(const char *name, double value);
+
+/******************************************************************************
+ * @name   profile_frame()
+ * @brief  Records a frame marker.
+ * @return void
+******************************************************************************/
+void profile_frame();
+
+/******************************************************************************
+ * @name      profile_thread_name()
+ * @brief     Names the calling thread.
+ * @param[in] name The thread's name.
+ * @return    void
+******************************************************************************/
+void profile_thread_name(const char *name);
+
+/******************************************************************************
+ * @name      profiler_export()
+ * @brief     Writes the recorded events of every thread as a Chrome trace
+ *            that chrome://tracing and Perfetto can open. Events keep being
+ *            recorded while exporting. Does nothing unless built with
+ *            ENGINE_PROFILE.
+ * @param[in] path The file to write.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR profiler_export(const char *path);
+
+#endif /* _PROFILER_H_ */
@@ -0,0 +1,35 @@
+#include "timer.h"
+
+#include <time.h>
+#include <errno.h>
+
+uint64_t timer_now_ns()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+void timer_sleep_until_ns(uint64_t time)
+{
+	struct timespec wake = {
+		.tv_sec = time / 1000000000ull,
+		.tv_nsec = time % 1000000000ull
+	};
+
+	/* An absolute wake time is not pushed back by signals interrupting. */
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR)
+	{
+	}
+}
+
+void timer_spin_until_ns(uint64_t time)
+{
+	while (timer_now_ns() < time)
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
+	}
+}
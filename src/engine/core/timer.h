@@ -0,0 +1,42 @@
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include <stdint.h>
+
+/******************************************************************************
+ * @name   timer_now_ns()
+ * @brief  Reads a monotonic high resolution clock.
+ * @return The current time in nanoseconds from an arbitrary fixed point.
+******************************************************************************/
+uint64_t timer_now_ns();
+
+/******************************************************************************
+ * @name   timer_sleep_until_ns()
+ * @brief  Sleeps until timer_now_ns() reaches a time. The scheduler may wake
+ *         the thread late, by up to a millisecond or more.
+ * @param  time The time to wake at, from timer_now_ns().
+ * @return void
+******************************************************************************/
+void timer_sleep_until_ns(uint64_t time);
+
+/******************************************************************************
+ * @name   timer_spin_until_ns()
+ * @brief  Busy waits until timer_now_ns() reaches a time. Precise but keeps a
+ *         core busy, use for the last moments of a wait only.
+ * @param  time The time to return at, from timer_now_ns().
+ * @return void
+******************************************************************************/
+void timer_spin_until_ns(uint64_t time);
+
+/******************************************************************************
+ * @name   timer_ns_to_ms()
+ * @brief  Converts a duration in nanoseconds to milliseconds.
+ * @param  nanoseconds The duration to convert.
+ * @return The duration in milliseconds.
+******************************************************************************/
+static inline double timer_ns_to_ms(uint64_t nanoseconds)
+{
+	return (double)nanoseconds / 1000000.0;
+}
+
+#endif /* _TIMER_H_ */
@@ -4,27 +4,38 @@
 #include <stdlib.h>
 
 #include "logger.h"
+#include "profiler.h"
 
 static void error_callback(int error, const char *description)
 {
 	LOG_ERROR("%d - %s", error, description);
 }
 
+static void framebuffer_size_callback(GLFWwindow *handle, int width, int height)
+{
+	Window *window = glfwGetWindowUserPointer(handle);
+
+	window->resized = 1;
+}
+
 ENGINE_ERROR window_create(Window **window)
 {
 	*window = malloc(sizeof(Window));
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); /* Only necessary now because Vulkan renderer not setup for resizing */
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 	(*window)->handle = glfwCreateWindow(800, 600, "Cube Realms", NULL, NULL);
+	(*window)->resized = 0;
 
 	if ((*window)->handle == NULL)
 	{
-		free(window);
+		free(*window);
 		return ENGINE_ERROR_INIT_FAILED;
 	}
 
 	glfwSetErrorCallback(&error_callback);
+	glfwSetWindowUserPointer((*window)->handle, *window);
+	glfwSetFramebufferSizeCallback((*window)->handle, &framebuffer_size_callback);
 
 	return ENGINE_OK;
 }
@@ -37,5 +48,16 @@ void window_destroy(Window *restrict window)
 
 void window_update(Window *restrict window)
 {
+	int width, height;
+
+	PROFILE_ZONE("window_update");
+
 	glfwPollEvents();
+
+	glfwGetFramebufferSize(window->handle, &width, &height);
+	while ((width == 0 || height == 0) && !glfwWindowShouldClose(window->handle))
+	{
+		glfwWaitEvents();
+		glfwGetFramebufferSize(window->handle, &width, &height);
+	}
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef _WINDOW_H_
 #define _WINDOW_H_
 
+#include <stdint.h>
+
 #include <GLFW/glfw3.h>
 
 #include "debug.h"
@@ -12,6 +14,8 @@
 struct _Window
 {
 	GLFWwindow *handle; /*< The GLFWwindow instance that this Window handles */
+	uint8_t resized;    /*< Set when the framebuffer changes size, cleared by
+	                        whoever resizes what is drawn to it. */
 };
 typedef struct _Window Window;
 
@@ -36,7 +40,8 @@ void window_destroy(Window *restrict window);
 /******************************************************************************
  * @name      window_update()
  * @brief     A function to update the state of a window updates a specified
- *            window.
+ *            window. While the window is minimised this blocks until an event
+ *            arrives as there is nothing to draw.
  * @param[in] window A pointer to a window to be updated.
  * @return    void
 ******************************************************************************/
@@ -58,38 +58,25 @@ void vertex_data_destroy(VertexData *data)
 	free(data);
 }
 
-static uint8_t find_memory_type(Device *device,
-                                 uint32_t filter_type,
-                                 VkMemoryPropertyFlags properties,
-                                 uint32_t *suitable_type_index)
+VertexBuffer *buffer_create(Device *device,
+                            size_t size,
+                            VkBufferUsageFlags usage,
+                            VkMemoryPropertyFlags properties)
 {
-	VkPhysicalDeviceMemoryProperties memory_properties;
-	vkGetPhysicalDeviceMemoryProperties(device->physical_device, &memory_properties);
+	VertexBuffer *buffer = malloc(sizeof(VertexBuffer));
+	ENGINE_ERROR error;
+	VkResult success;
 
-	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+	if (buffer == NULL)
 	{
-		if ((filter_type & (1 << i))
-		    && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties)
-		{
-			*suitable_type_index = i;
-			return 1;
-		}
+		LOG_ERROR("Failed to allocate buffer");
+		return NULL;
 	}
 
-	LOG_ERROR("Failed to find valid memory filter");
-	return 0;
-}
-
-VertexBuffer *vertex_buffer_create(Device *device, size_t verticies_size)
-{
-	VertexBuffer *buffer = malloc(sizeof(VertexBuffer));
-	uint32_t suitable_type_index;
-	VkResult success;
-
 	VkBufferCreateInfo buffer_info = {
 		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-		.size = verticies_size,
-		.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		.size = size,
+		.usage = usage,
 		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
 	};
 
@@ -100,64 +87,41 @@ VertexBuffer *vertex_buffer_create(Device *device, size_t verticies_size)
 
 	if (success != VK_SUCCESS)
 	{
-		LOG_ERROR("Failed to create vertex buffer");
+		LOG_ERROR("Failed to create buffer");
 		free(buffer);
 		return NULL;
 	}
 
-	VkMemoryRequirements memory_requirements;
-	vkGetBufferMemoryRequirements(device->logical_device,
-	                              buffer->handle,
-	                              &memory_requirements);
-
-	uint8_t found = find_memory_type(device,
-	                                 memory_requirements.memoryTypeBits,
-	                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-	                                 | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-	                                 &suitable_type_index);
-
-	if (!found)
+	error = memory_allocate_buffer(device->allocator,
+	                               buffer->handle,
+	                               properties,
+	                               &buffer->allocation);
+	if (error != ENGINE_OK)
 	{
+		LOG_ERROR("Failed to allocate memory for buffer");
 		vkDestroyBuffer(device->logical_device, buffer->handle, NULL);
 		free(buffer);
 		return NULL;
 	}
 
-	VkMemoryAllocateInfo alloc_info = {
-		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.allocationSize = memory_requirements.size,
-		.memoryTypeIndex = suitable_type_index,
-	};
-
-	success = vkAllocateMemory(device->logical_device,
-	                           &alloc_info,
-	                           NULL,
-	                           &buffer->buffer_memory);
-
-	if (success != VK_SUCCESS)
-	{
-		LOG_ERROR("Failed to allocate memory for vertex buffer");
-		vkDestroyBuffer(device->logical_device, buffer->handle, NULL);
-		free(buffer);
-		return NULL;
-	}
-
-	success = vkBindBufferMemory(device->logical_device,
-	                             buffer->handle,
-	                             buffer->buffer_memory,
-	                             0);
-
-	if (success != VK_SUCCESS)
-	{
-		LOG_WARNING("Unable to bind vertex buffer to memory");
-	}
-
 	return buffer;
 }
 
+VertexBuffer *vertex_buffer_create(Device *device,
+                                   size_t verticies_size,
+                                   VkMemoryPropertyFlags properties)
+{
+	return buffer_create(device,
+	                     verticies_size,
+	                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+	                     | VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+	                     | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+	                     properties);
+}
+
 void vertex_buffer_destroy(VertexBuffer *buffer, Device *device)
 {
 	vkDestroyBuffer(device->logical_device, buffer->handle, NULL);
-	vkFreeMemory(device->logical_device, buffer->buffer_memory, NULL);
+	memory_free(device->allocator, &buffer->allocation);
 	free(buffer);
 }
\ No newline at end of file
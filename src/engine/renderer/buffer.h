@@ -7,6 +7,7 @@
 #include <GLFW/glfw3.h>
 
 #include "devices.h"
+#include "memory.h"
 
 /* TODO: Have a types header. */
 typedef struct _Vector { float x, y; } Vector;
@@ -35,7 +36,7 @@ typedef struct _VertexData VertexData;
 struct _VertexBuffer
 {
 	VkBuffer handle;
-	VkDeviceMemory buffer_memory;
+	MemoryAllocation allocation; /*< Mapped if host visible. */
 };
 typedef struct _VertexBuffer VertexBuffer;
 
@@ -58,14 +59,35 @@ VertexData *vertex_data_create(float *verticies, uint32_t vertex_count);
 ******************************************************************************/
 void vertex_data_destroy(VertexData *data);
 
+/******************************************************************************
+ * @name      buffer_create()
+ * @brief     Creates a buffer of any usage and allocates memory for it from
+ *            the device's allocator.
+ * @param[in] device     The device the buffer is allocated on.
+ * @param     size       The size of the buffer in bytes.
+ * @param     usage      How the buffer is used.
+ * @param     properties The properties of the memory to allocate from.
+ * @return    A pointer to the buffer, or NULL if it could not be created.
+******************************************************************************/
+VertexBuffer *buffer_create(Device *device,
+                            size_t size,
+                            VkBufferUsageFlags usage,
+                            VkMemoryPropertyFlags properties);
+
 /******************************************************************************
  * @name      vertex_buffer_create()
- * @brief     Creates a VertexBuffer and allocates memory for it.
+ * @brief     Creates a VertexBuffer and allocates memory for it from the
+ *            device's allocator. The buffer can be a transfer destination so
+ *            it may live in memory the host cannot write, and may hold indices
+ *            after the vertices so a mesh needs only one buffer.
  * @param[in] device        The device the buffer is allocated on.
  * @param     vertices_size The size of the buffer to be allocated.
+ * @param     properties    The properties of the memory to allocate from.
  * @return    A pointer to a vertex buffer.
 ******************************************************************************/
-VertexBuffer *vertex_buffer_create(Device *device, size_t verticies_size);
+VertexBuffer *vertex_buffer_create(Device *device,
+                                   size_t verticies_size,
+                                   VkMemoryPropertyFlags properties);
 
 /******************************************************************************
  * @name      vertex_buffer_destroy()
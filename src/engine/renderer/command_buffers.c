@@ -2,8 +2,16 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdatomic.h>
 
 #include "core/logger.h"
+#include "core/jobs.h"
+#include "core/timer.h"
+#include "core/profiler.h"
+
+#define ARRAY_SIZE(arr) sizeof(arr) / sizeof(arr[0])
 
 ENGINE_ERROR command_pool_create(CommandPool **command_pool, Device *device)
 {
@@ -48,115 +56,638 @@ void command_pool_destroy(CommandPool *pool, Device *device)
 	free(pool);
 }
 
-ENGINE_ERROR command_buffer_create(CommandBuffer **command_buffer,
-                                   const CommandPool *restrict pool,
-                                   const Device *restrict device,
-                                   const GraphicsPipeline *restrict pipeline,
-                                   SwapChain *restrict swap_chain,
-                                   Framebuffer **framebuffer_array,
-                                   VertexBuffer *restrict vertex_buffer,
-                                   size_t verticies_size)
+/******************************************************************************
+ * @name  RecordContext
+ * @brief Shared by the jobs recording a frame's draws.
+******************************************************************************/
+struct RecordContext
 {
-	*command_buffer = malloc(sizeof(CommandBuffer));
-	ENGINE_ERROR error;
-	VkResult success;
+	struct ThreadCommands *threads; /*< The frame's commands for each thread. */
+	const GraphicsPipeline *pipeline;
+	const VkCommandBufferInheritanceInfo *inheritance;
+	const DrawCommand *draws;
+	GpuProfiler *profiler;
+	uint32_t frame;
+	uint32_t pass_scope;
+	const GraphicsPushConstants *constants;
+	PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count;
+	VkViewport viewport; /*< Covers the whole target. */
+	VkRect2D scissor;
+	atomic_ullong cpu_ns; /*< Time spent recording across all threads. */
+	atomic_int failed;
+};
 
-	(*command_buffer)->buffer_count = swap_chain->image_count;
-	(*command_buffer)->buffers = calloc((*command_buffer)->buffer_count, sizeof(VkCommandBuffer*));
+static ENGINE_ERROR allocate_buffer(const Device *device,
+                                    VkCommandPool pool,
+                                    VkCommandBufferLevel level,
+                                    VkCommandBuffer *buffer)
+{
+	VkResult success;
 
 	VkCommandBufferAllocateInfo alloc_info = {
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-		.commandPool = pool->handle,
-		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-		.commandBufferCount = swap_chain->image_count
+		.commandPool = pool,
+		.level = level,
+		.commandBufferCount = 1
+	};
+
+	success = vkAllocateCommandBuffers(device->logical_device, &alloc_info, buffer);
+	if (success != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate frame command buffer");
+	}
+
+	return ENGINE_OK;
+}
+
+static ENGINE_ERROR create_pool(const Device *device,
+                                VkCommandPool *pool,
+                                VkCommandBufferLevel level,
+                                VkCommandBuffer *buffer)
+{
+	VkResult success;
+
+	VkCommandPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.queueFamilyIndex = device->queue_family_indicies.graphics_family,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
 	};
 
-	success = vkAllocateCommandBuffers(device->logical_device,
-	                                   &alloc_info,
-	                                   (*command_buffer)->buffers);
+	success = vkCreateCommandPool(device->logical_device, &pool_info, NULL, pool);
 	if (success != VK_SUCCESS)
+	{
+		*pool = VK_NULL_HANDLE;
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to create frame command pool");
+	}
+
+	if (allocate_buffer(device, *pool, level, buffer) != ENGINE_OK)
+	{
+		vkDestroyCommandPool(device->logical_device, *pool, NULL);
+		*pool = VK_NULL_HANDLE;
+		return ENGINE_ERROR_OUT_OF_MEMORY;
+	}
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR frame_commands_create(FrameCommands **commands,
+                                   const Device *restrict device,
+                                   uint32_t frame_count,
+                                   uint32_t thread_count,
+                                   uint64_t budget_ns,
+                                   uint8_t depth_prepass)
+{
+	ENGINE_ERROR error = ENGINE_OK;
+	FrameCommands *frame_commands;
+
+	if (device->queue_family_indicies.graphics_family == -1)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_INIT_FAILED,
+		                           "Graphics queue family is invalid.");
+	}
+
+	frame_commands = calloc(1, sizeof(FrameCommands));
+	*commands = frame_commands;
+	if (frame_commands == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate frame commands");
+	}
+
+	frame_commands->frame_count = frame_count;
+	frame_commands->thread_count = thread_count;
+	frame_commands->budget_ns = budget_ns;
+	frame_commands->depth_prepass = depth_prepass;
+	frame_commands->draw_cost_ns = 0.0;
+	frame_commands->batch_size = FRAME_COMMANDS_MIN_BATCH_SIZE;
+	frame_commands->pools = calloc(frame_count, sizeof(VkCommandPool));
+	frame_commands->primaries = calloc(frame_count, sizeof(VkCommandBuffer));
+	frame_commands->threads = aligned_alloc(_Alignof(struct ThreadCommands),
+		frame_count * thread_count * sizeof(struct ThreadCommands));
+
+	if (frame_commands->threads != NULL)
+	{
+		memset(frame_commands->threads,
+		       0,
+		       frame_count * thread_count * sizeof(struct ThreadCommands));
+	}
+
+	if (frame_commands->pools == NULL
+	    || frame_commands->primaries == NULL
+	    || frame_commands->threads == NULL)
 	{
 		error = ENGINE_ERROR_OUT_OF_MEMORY;
 		ENGINE_LOG_GOTO_IF_ERROR(error,
-		                         "Failed to allocate command buffer memory",
-		                         buffer_allocation_fail);
+		                         "Failed to allocate frame commands",
+		                         create_fail);
 	}
 
-	for (uint32_t i = 0; i < swap_chain->image_count; i++)
+	for (uint32_t i = 0; i < frame_count; i++)
 	{
-		VkCommandBufferBeginInfo buffer_begin_info = {
-			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-			.flags = 0,
-			.pInheritanceInfo = NULL
-		};
+		error = create_pool(device,
+		                    &frame_commands->pools[i],
+		                    VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		                    &frame_commands->primaries[i]);
+		ENGINE_GOTO_IF_ERROR(error, create_fail);
 
-		success = vkBeginCommandBuffer((*command_buffer)->buffers[i], &buffer_begin_info);
-		if (success != VK_SUCCESS)
+		for (uint32_t j = 0; j < thread_count; j++)
 		{
-			error = ENGINE_ERROR_OUT_OF_MEMORY;
-			ENGINE_LOG_GOTO_IF_ERROR(error,
-			                         "Failed to begin command buffer, insufficient memory",
-			                         command_buffer_record_fail);
+			struct ThreadCommands *thread =
+				&frame_commands->threads[i * thread_count + j];
+
+			error = create_pool(device,
+			                    &thread->pool,
+			                    VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+			                    &thread->secondary);
+			ENGINE_GOTO_IF_ERROR(error, create_fail);
+
+			if (depth_prepass)
+			{
+				error = allocate_buffer(device,
+				                        thread->pool,
+				                        VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+				                        &thread->prepass);
+				ENGINE_GOTO_IF_ERROR(error, create_fail);
+			}
 		}
+	}
+
+	return ENGINE_OK;
 
-		VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+create_fail:
+	frame_commands_destroy(frame_commands, device);
+	*commands = NULL;
+	return error;
+}
 
-		VkRenderPassBeginInfo render_pass_info = {
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-			.renderPass = pipeline->render_pass,
-			.framebuffer = framebuffer_array[i]->handle,
-			.renderArea.offset = {0, 0},
-			.renderArea.extent = swap_chain->extent,
-			.clearValueCount = 1,
-			.pClearValues = &clear_color
-		};
+void frame_commands_destroy(FrameCommands *commands, const Device *device)
+{
+	/* Command buffers are freed with their pools. */
+	for (uint32_t i = 0; commands->pools != NULL && i < commands->frame_count; i++)
+	{
+		vkDestroyCommandPool(device->logical_device, commands->pools[i], NULL);
+	}
 
-		vkCmdBeginRenderPass((*command_buffer)->buffers[i],
-		                     &render_pass_info,
-		                     VK_SUBPASS_CONTENTS_INLINE);
+	for (uint32_t i = 0;
+	     commands->threads != NULL && i < commands->frame_count * commands->thread_count;
+	     i++)
+	{
+		vkDestroyCommandPool(device->logical_device, commands->threads[i].pool, NULL);
+	}
 
-		vkCmdBindPipeline((*command_buffer)->buffers[i],
-		                  VK_PIPELINE_BIND_POINT_GRAPHICS,
-		                  pipeline->handle);
+	free(commands->pools);
+	free(commands->primaries);
+	free(commands->threads);
+	free(commands);
+}
 
-		VkDeviceSize offset = 0;
-		vkCmdBindVertexBuffers((*command_buffer)->buffers[i], 0, 1, (VkBuffer*)vertex_buffer, &offset);
+/******************************************************************************
+ * @name      begin_secondary()
+ * @brief     Begins a secondary command buffer inside the frame's render pass
+ *            and sets the state every draw shares.
+ * @param[in] context  The frame's RecordContext.
+ * @param     buffer   The secondary command buffer to begin.
+ * @param[in] name     The name the buffer's draws are timed under.
+ * @return    The GPU profiler scope timing the buffer, or GPU_PROFILER_NO_SCOPE
+ *            if the buffer could not be begun.
+******************************************************************************/
+static uint32_t begin_secondary(struct RecordContext *context,
+                                VkCommandBuffer buffer,
+                                const char *name)
+{
+	uint32_t scope;
 
-		vkCmdDraw((*command_buffer)->buffers[i], verticies_size / sizeof(float), 1, 0, 0);
-		vkCmdEndRenderPass((*command_buffer)->buffers[i]);
+	VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+		         | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+		.pInheritanceInfo = context->inheritance
+	};
 
-		if (vkEndCommandBuffer((*command_buffer)->buffers[i]) != VK_SUCCESS)
+	if (vkBeginCommandBuffer(buffer, &begin_info) != VK_SUCCESS)
+	{
+		atomic_store(&context->failed, 1);
+		return GPU_PROFILER_NO_SCOPE;
+	}
+
+	scope = gpu_profiler_add_scope(context->profiler,
+	                               context->frame,
+	                               name,
+	                               context->pass_scope);
+	gpu_profiler_write(context->profiler, buffer, context->frame, scope, 0);
+
+	/* Dynamic state and push constants are not inherited, every secondary
+	 * sets its own. Pipelines are bound by the draws, they all share a layout
+	 * so the constants survive switching between them. */
+	vkCmdSetViewport(buffer, 0, 1, &context->viewport);
+	vkCmdSetScissor(buffer, 0, 1, &context->scissor);
+	vkCmdPushConstants(buffer,
+	                   context->pipeline->layout,
+	                   VK_SHADER_STAGE_VERTEX_BIT,
+	                   0,
+	                   sizeof(GraphicsPushConstants),
+	                   context->constants);
+
+	return scope;
+}
+
+/******************************************************************************
+ * @name      record_draws()
+ * @brief     Records a batch of draws into the calling thread's secondary
+ *            command buffers, beginning them on the thread's first batch.
+ *            With a depth pre-pass each draw is recorded twice, depth only
+ *            and then shaded.
+ * @param[in] data  The frame's RecordContext.
+ * @param     start The first draw of the batch.
+ * @param     end   One past the last draw of the batch.
+ * @return    void
+******************************************************************************/
+static void record_draws(void *data, uint32_t start, uint32_t end)
+{
+	struct RecordContext *context = data;
+	struct ThreadCommands *thread = &context->threads[job_thread_index()];
+	VkCommandBuffer buffers[2];
+	uint32_t buffer_count = 0;
+	uint64_t batch_start = timer_now_ns();
+
+	PROFILE_ZONE("record_draws");
+
+	if (!thread->recording)
+	{
+		thread->recording = 1;
+		thread->scope = begin_secondary(context, thread->secondary, "Draws");
+
+		if (thread->prepass != VK_NULL_HANDLE)
 		{
-			error = ENGINE_ERROR_OUT_OF_MEMORY;
-			ENGINE_LOG_GOTO_IF_ERROR(error,
-			                         "Failed to record command buffer, insufficient memory",
-									 command_buffer_record_fail);
+			thread->prepass_scope = begin_secondary(context,
+			                                        thread->prepass,
+			                                        "Depth pre-pass");
+		}
+
+		if (atomic_load(&context->failed))
+		{
+			return;
 		}
 	}
 
-	return ENGINE_OK;
+	if (thread->prepass != VK_NULL_HANDLE)
+	{
+		buffers[buffer_count++] = thread->prepass;
+	}
+	buffers[buffer_count++] = thread->secondary;
 
-command_buffer_record_fail:
-	vkFreeCommandBuffers(device->logical_device,
-	                     pool->handle,
-	                     (*command_buffer)->buffer_count,
-	                     (*command_buffer)->buffers);
+	for (uint32_t b = 0; b < buffer_count; b++)
+	{
+		uint8_t prepass = buffers[b] == thread->prepass;
+		const GraphicsPipeline *bound_pipeline = NULL;
+		VkBuffer bound = VK_NULL_HANDLE;
+		VkDeviceSize bound_offset = 0;
+		VkBuffer bound_instances = VK_NULL_HANDLE;
+		VkBuffer bound_indices = VK_NULL_HANDLE;
+		float origin[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+		uint8_t origin_pushed = 0;
 
-buffer_allocation_fail:
-	free((*command_buffer)->buffers);
-	free((*command_buffer));
-	*command_buffer = NULL;
-	return error;
+		for (uint32_t i = start; i < end; i++)
+		{
+			const DrawCommand *draw = &context->draws[i];
+			const VkDeviceSize instance_offset = 0;
+
+			if (draw->pipeline != bound_pipeline)
+			{
+				vkCmdBindPipeline(buffers[b],
+				                  VK_PIPELINE_BIND_POINT_GRAPHICS,
+				                  prepass ? draw->pipeline->prepass
+				                          : draw->pipeline->handle);
+				bound_pipeline = draw->pipeline;
+			}
+
+			if (!origin_pushed
+			    || draw->origin.x != origin[0]
+			    || draw->origin.y != origin[1]
+			    || draw->origin.z != origin[2])
+			{
+				origin[0] = draw->origin.x;
+				origin[1] = draw->origin.y;
+				origin[2] = draw->origin.z;
+				origin_pushed = 1;
+				vkCmdPushConstants(buffers[b],
+				                   context->pipeline->layout,
+				                   VK_SHADER_STAGE_VERTEX_BIT,
+				                   offsetof(GraphicsPushConstants, origin),
+				                   sizeof(origin),
+				                   origin);
+			}
+
+			if (draw->vertex_buffer != bound || draw->offset != bound_offset)
+			{
+				vkCmdBindVertexBuffers(buffers[b],
+				                       0,
+				                       1,
+				                       &draw->vertex_buffer,
+				                       &draw->offset);
+				bound = draw->vertex_buffer;
+				bound_offset = draw->offset;
+			}
+
+			if (draw->instance_buffer != VK_NULL_HANDLE
+			    && draw->instance_buffer != bound_instances)
+			{
+				vkCmdBindVertexBuffers(buffers[b],
+				                       1,
+				                       1,
+				                       &draw->instance_buffer,
+				                       &instance_offset);
+				bound_instances = draw->instance_buffer;
+			}
+
+			if (draw->index_buffer == VK_NULL_HANDLE)
+			{
+				vkCmdDraw(buffers[b], draw->vertex_count, 1, 0, draw->first_instance);
+				continue;
+			}
+
+			if (draw->index_buffer != bound_indices)
+			{
+				vkCmdBindIndexBuffer(buffers[b],
+				                     draw->index_buffer,
+				                     0,
+				                     VK_INDEX_TYPE_UINT32);
+				bound_indices = draw->index_buffer;
+			}
+
+			if (draw->indirect_buffer == VK_NULL_HANDLE)
+			{
+				vkCmdDrawIndexed(buffers[b],
+				                 draw->index_count,
+				                 1,
+				                 draw->first_index,
+				                 draw->vertex_offset,
+				                 draw->first_instance);
+			}
+			else if (draw->count_buffer != VK_NULL_HANDLE)
+			{
+				context->draw_indexed_indirect_count(buffers[b],
+				                                     draw->indirect_buffer,
+				                                     0,
+				                                     draw->count_buffer,
+				                                     0,
+				                                     draw->max_draw_count,
+				                                     sizeof(VkDrawIndexedIndirectCommand));
+			}
+			else
+			{
+				vkCmdDrawIndexedIndirect(buffers[b],
+				                         draw->indirect_buffer,
+				                         0,
+				                         draw->max_draw_count,
+				                         sizeof(VkDrawIndexedIndirectCommand));
+			}
+		}
+	}
+
+	atomic_fetch_add_explicit(&context->cpu_ns,
+	                          timer_now_ns() - batch_start,
+	                          memory_order_relaxed);
 }
 
-void command_buffer_destroy(CommandBuffer *buffer,
-                            CommandPool *pool,
-                            Device *device)
+/******************************************************************************
+ * @name      update_draw_cost()
+ * @brief     Folds a frame's measured recording time into the per draw cost
+ *            and picks the batch size of the next frame from it.
+ * @param[in] commands   The commands that were recorded.
+ * @param     cpu_ns     Time spent recording draws across all threads.
+ * @param     draw_count The number of draws recorded.
+ * @return    void
+******************************************************************************/
+static void update_draw_cost(FrameCommands *commands,
+                             uint64_t cpu_ns,
+                             uint32_t draw_count)
 {
-	vkFreeCommandBuffers(device->logical_device,
-	                     pool->handle,
-	                     buffer->buffer_count,
-	                     buffer->buffers);
-	free(buffer->buffers);
-	free(buffer);
-}
\ No newline at end of file
+	double sample;
+	double batch_size;
+
+	if (draw_count == 0)
+	{
+		return;
+	}
+
+	sample = (double)cpu_ns / draw_count;
+	commands->draw_cost_ns = commands->draw_cost_ns == 0.0
+	                         ? sample
+	                         : commands->draw_cost_ns * 0.9 + sample * 0.1;
+
+	batch_size = FRAME_COMMANDS_BATCH_NS / commands->draw_cost_ns;
+	if (batch_size < FRAME_COMMANDS_MIN_BATCH_SIZE)
+	{
+		batch_size = FRAME_COMMANDS_MIN_BATCH_SIZE;
+	}
+	else if (batch_size > FRAME_COMMANDS_MAX_BATCH_SIZE)
+	{
+		batch_size = FRAME_COMMANDS_MAX_BATCH_SIZE;
+	}
+
+	commands->batch_size = (uint32_t)batch_size;
+}
+
+ENGINE_ERROR frame_commands_record(FrameCommands *restrict commands,
+                                   const Device *restrict device,
+                                   uint32_t frame,
+                                   const GraphicsPipeline *restrict pipeline,
+                                   const RenderTarget *restrict target,
+                                   const Framebuffer *restrict framebuffer,
+                                   const DrawCommand *restrict draws,
+                                   uint32_t draw_count,
+                                   const GraphicsPushConstants *restrict constants,
+                                   const FramePrologue *restrict prologue,
+                                   GpuProfiler *restrict profiler,
+                                   VkCommandBuffer *primary)
+{
+	struct ThreadCommands *threads = &commands->threads[frame * commands->thread_count];
+	/* Every pre-pass buffer is executed before any colour buffer, so the
+	 * depth buffer is complete before shading starts. */
+	VkCommandBuffer prepasses[commands->thread_count];
+	VkCommandBuffer secondaries[2 * commands->thread_count];
+	uint32_t prepass_count = 0;
+	uint32_t secondary_count = 0;
+	JobCounter counter = {0};
+	uint64_t record_start = timer_now_ns();
+	uint32_t frame_scope = gpu_profiler_add_scope(profiler,
+	                                              frame,
+	                                              "Frame",
+	                                              GPU_PROFILER_NO_SCOPE);
+	uint32_t prologue_scope = prologue != NULL
+	                          ? gpu_profiler_add_scope(profiler,
+	                                                   frame,
+	                                                   prologue->name,
+	                                                   frame_scope)
+	                          : GPU_PROFILER_NO_SCOPE;
+	uint32_t pass_scope = gpu_profiler_add_scope(profiler,
+	                                             frame,
+	                                             "Main pass",
+	                                             frame_scope);
+
+	struct RecordContext context = {
+		.threads = threads,
+		.pipeline = pipeline,
+		.draws = draws,
+		.profiler = profiler,
+		.frame = frame,
+		.pass_scope = pass_scope,
+		.constants = constants,
+		.draw_indexed_indirect_count = device->draw_indexed_indirect_count,
+		.viewport = {
+			.x = 0.0f,
+			.y = 0.0f,
+			.width = (float)target->extent.width,
+			.height = (float)target->extent.height,
+			.minDepth = 0.0f,
+			.maxDepth = 1.0f
+		},
+		.scissor = {
+			.offset = {0, 0},
+			.extent = target->extent
+		}
+	};
+	atomic_init(&context.cpu_ns, 0);
+	atomic_init(&context.failed, 0);
+
+	VkCommandBufferInheritanceInfo inheritance = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.renderPass = pipeline->render_pass,
+		.subpass = 0,
+		.framebuffer = framebuffer->handle
+	};
+	context.inheritance = &inheritance;
+
+	*primary = commands->primaries[frame];
+
+	/* The frame's previous submission has finished, its buffers can be
+	 * recycled without freeing them. */
+	vkResetCommandPool(device->logical_device, commands->pools[frame], 0);
+	for (uint32_t i = 0; i < commands->thread_count; i++)
+	{
+		vkResetCommandPool(device->logical_device, threads[i].pool, 0);
+		threads[i].recording = 0;
+	}
+
+	job_parallel_for(draw_count,
+	                 commands->batch_size,
+	                 record_draws,
+	                 &context,
+	                 &counter);
+	job_wait(&counter);
+
+	update_draw_cost(commands, atomic_load(&context.cpu_ns), draw_count);
+
+	if (atomic_load(&context.failed))
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to begin secondary command buffers");
+	}
+
+	for (uint32_t i = 0; i < commands->thread_count; i++)
+	{
+		if (!threads[i].recording)
+		{
+			continue;
+		}
+
+		if (threads[i].prepass != VK_NULL_HANDLE)
+		{
+			gpu_profiler_write(profiler,
+			                   threads[i].prepass,
+			                   frame,
+			                   threads[i].prepass_scope,
+			                   1);
+
+			if (vkEndCommandBuffer(threads[i].prepass) != VK_SUCCESS)
+			{
+				atomic_store(&context.failed, 1);
+			}
+			prepasses[prepass_count++] = threads[i].prepass;
+		}
+
+		gpu_profiler_write(profiler, threads[i].secondary, frame, threads[i].scope, 1);
+
+		if (vkEndCommandBuffer(threads[i].secondary) != VK_SUCCESS)
+		{
+			atomic_store(&context.failed, 1);
+		}
+		secondaries[prepass_count + secondary_count++] = threads[i].secondary;
+	}
+
+	memcpy(secondaries, prepasses, prepass_count * sizeof(VkCommandBuffer));
+	secondary_count += prepass_count;
+
+	if (atomic_load(&context.failed))
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to record secondary command buffers");
+	}
+
+	VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+
+	if (vkBeginCommandBuffer(*primary, &begin_info) != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to begin command buffer, insufficient memory");
+	}
+
+	gpu_profiler_reset(profiler, *primary, frame);
+	gpu_profiler_write(profiler, *primary, frame, frame_scope, 0);
+
+	if (prologue != NULL)
+	{
+		gpu_profiler_write(profiler, *primary, frame, prologue_scope, 0);
+		prologue->record(*primary, prologue->data);
+		gpu_profiler_write(profiler, *primary, frame, prologue_scope, 1);
+	}
+
+	gpu_profiler_write(profiler, *primary, frame, pass_scope, 0);
+
+	/* Depth is reversed, the far plane is 0. */
+	VkClearValue clear_values[] = {
+		{.color = {{0.0f, 0.0f, 0.0f, 1.0f}}},
+		{.depthStencil = {0.0f, 0}}
+	};
+
+	VkRenderPassBeginInfo render_pass_info = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+		.renderPass = pipeline->render_pass,
+		.framebuffer = framebuffer->handle,
+		.renderArea.offset = {0, 0},
+		.renderArea.extent = target->extent,
+		.clearValueCount = ARRAY_SIZE(clear_values),
+		.pClearValues = clear_values
+	};
+
+	vkCmdBeginRenderPass(*primary,
+	                     &render_pass_info,
+	                     VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+	if (secondary_count > 0)
+	{
+		vkCmdExecuteCommands(*primary, secondary_count, secondaries);
+	}
+
+	vkCmdEndRenderPass(*primary);
+
+	gpu_profiler_write(profiler, *primary, frame, pass_scope, 1);
+	gpu_profiler_write(profiler, *primary, frame, frame_scope, 1);
+
+	if (vkEndCommandBuffer(*primary) != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to record command buffer, insufficient memory");
+	}
+
+	commands->record_ns = timer_now_ns() - record_start;
+	commands->over_budget = commands->record_ns > commands->budget_ns;
+
+	return ENGINE_OK;
+}
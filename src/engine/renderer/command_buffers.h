@@ -8,9 +8,14 @@
 
 #include "devices.h"
 #include "graphics_pipeline.h"
-#include "swap_chain.h"
+#include "render_target.h"
 #include "framebuffer.h"
 #include "buffer.h"
+#include "gpu_profiler.h"
+
+#define FRAME_COMMANDS_BATCH_NS        50000 /* Time a thread should spend on a batch. */
+#define FRAME_COMMANDS_MIN_BATCH_SIZE  16
+#define FRAME_COMMANDS_MAX_BATCH_SIZE  4096
 
 /******************************************************************************
  * @name _CommandPool
@@ -23,15 +28,95 @@ struct _CommandPool
 typedef struct _CommandPool CommandPool;
 
 /******************************************************************************
- * @name  _CommandBuffer
- * @brief A struct where an array of VkCommandBuffers is stored.
+ * @name  _DrawCommand
+ * @brief A draw from a vertex buffer, indexed if it has indices, or a batch of
+ *        indexed draws whose commands the device wrote to a buffer. Draws
+ *        using the same pipeline should be kept together, the pipeline is
+ *        only bound when it changes.
+******************************************************************************/
+struct _DrawCommand
+{
+	const GraphicsPipeline *pipeline;
+	VkBuffer vertex_buffer;
+	VkDeviceSize offset;
+	uint32_t vertex_count;
+	VkBuffer instance_buffer; /*< Bound to binding 1, VK_NULL_HANDLE if the
+	                              pipeline has no per instance data. */
+	VkBuffer index_buffer;    /*< 32 bit indices, VK_NULL_HANDLE for a
+	                              non-indexed draw. */
+	uint32_t index_count;
+	uint32_t first_index;
+	int32_t vertex_offset;    /*< Added to each index. */
+	uint32_t first_instance;
+	Vec3 origin;              /*< Added to the draw's vertex positions. */
+
+	/* Set to draw VkDrawIndexedIndirectCommands from a buffer instead. */
+	VkBuffer indirect_buffer;
+	VkBuffer count_buffer;    /*< Holds how many commands to draw, up to
+	                              max_draw_count. VK_NULL_HANDLE to draw all
+	                              max_draw_count. */
+	uint32_t max_draw_count;
+};
+typedef struct _DrawCommand DrawCommand;
+
+/******************************************************************************
+ * @name  _FramePrologue
+ * @brief Work recorded into a frame's primary command buffer before its
+ *        render pass begins, such as generating the pass's indirect draws.
+******************************************************************************/
+struct _FramePrologue
+{
+	const char *name; /*< The name the work is timed under on the GPU. */
+	void (*record)(VkCommandBuffer buffer, void *data);
+	void *data;
+};
+typedef struct _FramePrologue FramePrologue;
+
+/******************************************************************************
+ * @name  ThreadCommands
+ * @brief The pool a thread records its secondary command buffers for a frame
+ *        from. Aligned so threads never share a cache line.
 ******************************************************************************/
-struct _CommandBuffer
+struct ThreadCommands
 {
-	VkCommandBuffer *buffers;
-	uint32_t buffer_count;
+	_Alignas(64) VkCommandPool pool;
+	VkCommandBuffer secondary;
+	VkCommandBuffer prepass; /*< The same draws depth only, NULL without a
+	                             depth pre-pass. */
+	uint8_t recording;       /*< Set once the secondaries have been begun this
+	                             frame. */
+	uint32_t scope;          /*< Times the secondary's draws on the GPU. */
+	uint32_t prepass_scope;  /*< Times the pre-pass draws on the GPU. */
 };
-typedef struct _CommandBuffer CommandBuffer;
+
+/******************************************************************************
+ * @name  _FrameCommands
+ * @brief The command buffers of each frame in flight. A frame's draws are
+ *        split across the job system's threads, each recording a secondary
+ *        command buffer from its own pool, which a primary buffer then
+ *        executes. A frame's pools are transient and reset, not freed, once
+ *        the frame's previous submission has finished.
+ *
+ *        The CPU cost of recording a draw is measured every frame and sets how
+ *        many draws make up a batch, so small frames are recorded by one
+ *        thread without job overhead and large ones spread over every thread.
+******************************************************************************/
+struct _FrameCommands
+{
+	VkCommandPool *pools;           /*< One per frame, for the primary buffer. */
+	VkCommandBuffer *primaries;     /*< One per frame. */
+	struct ThreadCommands *threads; /*< thread_count per frame. */
+	uint32_t frame_count;
+	uint32_t thread_count;
+	uint8_t depth_prepass; /*< Every thread's pre-pass runs before any colour. */
+
+	uint64_t budget_ns;  /*< Time recording a frame should take. */
+	double draw_cost_ns; /*< Moving average of the CPU time per draw. */
+	uint32_t batch_size; /*< Draws per batch, derived from draw_cost_ns. */
+	uint64_t record_ns;  /*< Time taken to record the last frame. */
+	uint8_t over_budget; /*< Set if the last frame took longer than budget_ns. */
+};
+typedef struct _FrameCommands FrameCommands;
 
 /******************************************************************************
  * @name       command_pool_create()
@@ -54,39 +139,68 @@ ENGINE_ERROR command_pool_create(CommandPool **command_pool, Device *device);
 void command_pool_destroy(CommandPool *pool, Device *device);
 
 /******************************************************************************
- * @name       command_buffer_create()
- * @brief      Creates a set of command buffers for a set of image views for a
- *             given swap chain.
- * @param[out] command_buffer    A pointer to a pointer set to the created command buffer.
- * @param[in]  pool              The pool from which to allocate command buffers.
- * @param[in]  device            The device the pool belongs to.
- * @param[in]  pipeline          The graphics pipeline to use.
- * @param[in]  swap_chain        The swap chain to create command buffers for.
- * @param[in]  framebuffer_array An array of framebuffer pointers.
- * @param[in]  vertex_buffer     The vertex buffer the vertex is stored in.
- * @param      verticies_size    The size of the vertex data to be drawn.
- * @return     A ENGINE_ERROR value is returned. If a command buffer was successfully
- *             created ENGINE_OK.
+ * @name       frame_commands_create()
+ * @brief      Creates command pools and buffers for each frame in flight and
+ *             each thread that may record.
+ * @param[out] commands      A pointer to a pointer set to the created commands.
+ * @param[in]  device        The device the pools belong to.
+ * @param      frame_count   The number of frames in flight.
+ * @param      thread_count  The number of threads that may record.
+ * @param      budget_ns     The time recording a frame should take.
+ * @param      depth_prepass If set draws are also recorded depth only, with
+ *                           the pipeline's pre-pass pipeline.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
 ******************************************************************************/
-ENGINE_ERROR command_buffer_create(CommandBuffer **command_buffer,
-                                   const CommandPool *restrict pool,
+ENGINE_ERROR frame_commands_create(FrameCommands **commands,
                                    const Device *restrict device,
-                                   const GraphicsPipeline *restrict pipeline,
-                                   SwapChain *restrict swap_chain,
-                                   Framebuffer **framebuffer_array,
-                                   VertexBuffer *restrict vertex_buffer,
-                                   size_t verticies_size);
+                                   uint32_t frame_count,
+                                   uint32_t thread_count,
+                                   uint64_t budget_ns,
+                                   uint8_t depth_prepass);
 
 /******************************************************************************
- * @name      command_buffer_destroy()
- * @brief     Destroys a specified command buffer.
- * @param[in] buffer The command buffer to destroy.
- * @param[in] pool   The pool from which the command buffer was allocated.
- * @param[in] device The device the pool belongs to.
+ * @name      frame_commands_destroy()
+ * @brief     Destroys the pools of every frame. The device must be idle.
+ * @param[in] commands The commands to destroy.
+ * @param[in] device   The device the pools belong to.
  * @return    void
 ******************************************************************************/
-void command_buffer_destroy(CommandBuffer *buffer,
-                            CommandPool *pool,
-                            Device *device);
+void frame_commands_destroy(FrameCommands *commands, const Device *device);
+
+/******************************************************************************
+ * @name       frame_commands_record()
+ * @brief      Resets a frame's pools and records its draws in parallel on the
+ *             job system, then records a primary buffer that runs the render
+ *             pass and executes the secondary buffers. Must be called from the
+ *             main thread once the frame's previous submission has finished.
+ * @param[in]  commands    The commands to record into.
+ * @param[in]  device      The device the pools belong to.
+ * @param      frame       The frame in flight to record.
+ * @param[in]  pipeline    A pipeline with the render pass and layout every
+ *                         draw's pipeline shares.
+ * @param[in]  target      The render target being drawn to.
+ * @param[in]  framebuffer The framebuffer of the image being drawn to.
+ * @param[in]  draws       The draws to record.
+ * @param      draw_count  The number of draws.
+ * @param[in]  constants   The push constants every draw uses, the origin
+ *                         is replaced by each draw's.
+ * @param[in]  prologue    Recorded before the render pass, may be NULL.
+ * @param[in]  profiler    Times the frame, the render pass and each thread's
+ *                         draws.
+ * @param[out] primary     Set to the recorded primary command buffer.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR frame_commands_record(FrameCommands *restrict commands,
+                                   const Device *restrict device,
+                                   uint32_t frame,
+                                   const GraphicsPipeline *restrict pipeline,
+                                   const RenderTarget *restrict target,
+                                   const Framebuffer *restrict framebuffer,
+                                   const DrawCommand *restrict draws,
+                                   uint32_t draw_count,
+                                   const GraphicsPushConstants *restrict constants,
+                                   const FramePrologue *restrict prologue,
+                                   GpuProfiler *restrict profiler,
+                                   VkCommandBuffer *primary);
 
 #endif /* _COMMAND_BUFFER_H_ */
\ No newline at end of file
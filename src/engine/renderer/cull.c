@@ -0,0 +1,339 @@
+#include "cull.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/logger.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CULL_X86 1
+#include <immintrin.h>
+#endif
+
+#define ARRAY_SIZE(arr) sizeof(arr) / sizeof(arr[0])
+
+void frustum_from_matrix(Frustum *restrict frustum, const Mat4 *restrict view_projection)
+{
+	/* A clip space point is inside if -w <= x <= w, -w <= y <= w and z <= w,
+	 * each is a row of the matrix added to or taken from the w row. Reversed
+	 * depth puts the far plane, z >= 0, at infinity. */
+	static const struct
+	{
+		uint32_t row;
+		float sign;
+	} planes[FRUSTUM_PLANE_COUNT] = {
+		{0,  1.0f},
+		{0, -1.0f},
+		{1,  1.0f},
+		{1, -1.0f},
+		{2, -1.0f}
+	};
+	const float *m = view_projection->m;
+
+	for (uint32_t p = 0; p < ARRAY_SIZE(planes); p++)
+	{
+		for (uint32_t k = 0; k < 4; k++)
+		{
+			frustum->planes[p][k] = m[k * 4 + 3] + planes[p].sign * m[k * 4 + planes[p].row];
+		}
+	}
+}
+
+/******************************************************************************
+ * @name      reallocate()
+ * @brief     Moves the bounds into one aligned block of six arrays.
+ * @param[in] bounds   The bounds to move.
+ * @param     capacity The boxes each array has room for, a multiple of
+ *                     CULL_BOUNDS_LANES.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK, otherwise the
+ *            bounds are unchanged.
+******************************************************************************/
+static ENGINE_ERROR reallocate(CullBounds *bounds, uint32_t capacity)
+{
+	size_t size = 6 * (size_t)capacity * sizeof(float);
+	float *storage = aligned_alloc(CULL_BOUNDS_ALIGNMENT, size);
+
+	if (storage == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate culling bounds");
+	}
+
+	/* The padding after the last box is read, but never reported visible. */
+	memset(storage, 0, size);
+
+	for (uint32_t axis = 0; bounds->min[0] != NULL && axis < 3; axis++)
+	{
+		memcpy(storage + axis * capacity, bounds->min[axis], bounds->count * sizeof(float));
+		memcpy(storage + (3 + axis) * capacity, bounds->max[axis], bounds->count * sizeof(float));
+	}
+
+	/* The block starts with the first array. */
+	free(bounds->min[0]);
+
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		bounds->min[axis] = storage + axis * capacity;
+		bounds->max[axis] = storage + (3 + axis) * capacity;
+	}
+	bounds->capacity = capacity;
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR cull_bounds_init(CullBounds *bounds)
+{
+	memset(bounds, 0, sizeof(CullBounds));
+	return reallocate(bounds, CULL_BOUNDS_INITIAL_CAPACITY);
+}
+
+void cull_bounds_deinit(CullBounds *bounds)
+{
+	free(bounds->min[0]);
+	memset(bounds, 0, sizeof(CullBounds));
+}
+
+ENGINE_ERROR cull_bounds_reserve(CullBounds *bounds, uint32_t count)
+{
+	uint32_t capacity = bounds->capacity;
+
+	if (count <= capacity)
+	{
+		return ENGINE_OK;
+	}
+
+	while (capacity < count)
+	{
+		capacity *= 2;
+	}
+
+	return reallocate(bounds, capacity);
+}
+
+/******************************************************************************
+ * @name       select_corners()
+ * @brief      Picks, for each plane, the arrays holding the corner of each box
+ *             furthest along the plane's normal. A box is outside the frustum
+ *             if that corner is outside any plane.
+ * @param[in]  bounds  The boxes to test.
+ * @param[in]  frustum The planes to test against.
+ * @param[out] corners The x, y and z arrays of each plane's corners.
+ * @return     void
+******************************************************************************/
+static void select_corners(const CullBounds *restrict bounds,
+                           const Frustum *restrict frustum,
+                           const float *corners[FRUSTUM_PLANE_COUNT][3])
+{
+	for (uint32_t p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+	{
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			corners[p][axis] = frustum->planes[p][axis] >= 0.0f
+			                   ? bounds->max[axis]
+			                   : bounds->min[axis];
+		}
+	}
+}
+
+static uint32_t cull_scalar(const CullBounds *restrict bounds,
+                            const Frustum *restrict frustum,
+                            uint32_t *restrict visible)
+{
+	const float *corners[FRUSTUM_PLANE_COUNT][3];
+	uint32_t count = 0;
+
+	select_corners(bounds, frustum, corners);
+
+	for (uint32_t i = 0; i < bounds->count; i++)
+	{
+		uint8_t inside = 1;
+
+		for (uint32_t p = 0; inside && p < FRUSTUM_PLANE_COUNT; p++)
+		{
+			const float *plane = frustum->planes[p];
+
+			inside = plane[0] * corners[p][0][i]
+			         + plane[1] * corners[p][1][i]
+			         + plane[2] * corners[p][2][i]
+			         + plane[3] >= 0.0f;
+		}
+
+		visible[count] = i;
+		count += inside;
+	}
+
+	return count;
+}
+
+#ifdef CULL_X86
+
+/******************************************************************************
+ * @name         append_visible()
+ * @brief        Appends the index of each box whose bit is set in a mask of
+ *               boxes tested together.
+ * @param        mask    Bit n is set if box first + n is visible.
+ * @param        first   The first box tested.
+ * @param        count   The boxes that exist from first on, later bits are
+ *                       padding and ignored.
+ * @param[out]   visible Where the indices are appended.
+ * @param[inout] written The number of indices in visible.
+ * @return       void
+******************************************************************************/
+static inline void append_visible(uint32_t mask,
+                                  uint32_t first,
+                                  uint32_t count,
+                                  uint32_t *restrict visible,
+                                  uint32_t *restrict written)
+{
+	if (count < 32)
+	{
+		mask &= (1u << count) - 1;
+	}
+
+	while (mask != 0)
+	{
+		visible[(*written)++] = first + (uint32_t)__builtin_ctz(mask);
+		mask &= mask - 1;
+	}
+}
+
+__attribute__((target("sse2")))
+static uint32_t cull_sse2(const CullBounds *restrict bounds,
+                          const Frustum *restrict frustum,
+                          uint32_t *restrict visible)
+{
+	const float *corners[FRUSTUM_PLANE_COUNT][3];
+	__m128 planes[FRUSTUM_PLANE_COUNT][4];
+	const __m128 zero = _mm_setzero_ps();
+	uint32_t count = 0;
+
+	select_corners(bounds, frustum, corners);
+	for (uint32_t p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+	{
+		for (uint32_t k = 0; k < 4; k++)
+		{
+			planes[p][k] = _mm_set1_ps(frustum->planes[p][k]);
+		}
+	}
+
+	for (uint32_t i = 0; i < bounds->count; i += 4)
+	{
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (uint32_t p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_mul_ps(planes[p][0], _mm_load_ps(corners[p][0] + i)),
+			                             _mm_mul_ps(planes[p][1], _mm_load_ps(corners[p][1] + i)));
+
+			distance = _mm_add_ps(distance,
+			                      _mm_add_ps(_mm_mul_ps(planes[p][2], _mm_load_ps(corners[p][2] + i)),
+			                                 planes[p][3]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+
+			/* Neighbouring boxes are usually culled by the same plane. */
+			if (_mm_movemask_ps(inside) == 0)
+			{
+				break;
+			}
+		}
+
+		append_visible((uint32_t)_mm_movemask_ps(inside),
+		               i,
+		               bounds->count - i,
+		               visible,
+		               &count);
+	}
+
+	return count;
+}
+
+__attribute__((target("avx")))
+static uint32_t cull_avx(const CullBounds *restrict bounds,
+                         const Frustum *restrict frustum,
+                         uint32_t *restrict visible)
+{
+	const float *corners[FRUSTUM_PLANE_COUNT][3];
+	__m256 planes[FRUSTUM_PLANE_COUNT][4];
+	const __m256 zero = _mm256_setzero_ps();
+	uint32_t count = 0;
+
+	select_corners(bounds, frustum, corners);
+	for (uint32_t p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+	{
+		for (uint32_t k = 0; k < 4; k++)
+		{
+			planes[p][k] = _mm256_set1_ps(frustum->planes[p][k]);
+		}
+	}
+
+	for (uint32_t i = 0; i < bounds->count; i += 8)
+	{
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for (uint32_t p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_mul_ps(planes[p][0], _mm256_load_ps(corners[p][0] + i)),
+			                                _mm256_mul_ps(planes[p][1], _mm256_load_ps(corners[p][1] + i)));
+
+			distance = _mm256_add_ps(distance,
+			                         _mm256_add_ps(_mm256_mul_ps(planes[p][2], _mm256_load_ps(corners[p][2] + i)),
+			                                       planes[p][3]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+
+			if (_mm256_movemask_ps(inside) == 0)
+			{
+				break;
+			}
+		}
+
+		append_visible((uint32_t)_mm256_movemask_ps(inside),
+		               i,
+		               bounds->count - i,
+		               visible,
+		               &count);
+	}
+
+	return count;
+}
+
+#endif /* CULL_X86 */
+
+static const CullKernels kernels[CULL_SIMD_COUNT] = {
+	{CULL_SIMD_SCALAR, "scalar", cull_scalar},
+#ifdef CULL_X86
+	{CULL_SIMD_SSE2, "sse2", cull_sse2},
+	{CULL_SIMD_AVX, "avx", cull_avx}
+#endif
+};
+
+const CullKernels *cull_kernels_get(CullSimd simd)
+{
+	switch (simd)
+	{
+		case CULL_SIMD_SCALAR:
+			return &kernels[CULL_SIMD_SCALAR];
+#ifdef CULL_X86
+		case CULL_SIMD_SSE2:
+			return __builtin_cpu_supports("sse2") ? &kernels[CULL_SIMD_SSE2] : NULL;
+		case CULL_SIMD_AVX:
+			return __builtin_cpu_supports("avx") ? &kernels[CULL_SIMD_AVX] : NULL;
+#endif
+		default:
+			return NULL;
+	}
+}
+
+const CullKernels *cull_kernels_best()
+{
+	for (int simd = CULL_SIMD_COUNT - 1; simd > CULL_SIMD_SCALAR; simd--)
+	{
+		const CullKernels *best = cull_kernels_get(simd);
+
+		if (best != NULL)
+		{
+			return best;
+		}
+	}
+
+	return &kernels[CULL_SIMD_SCALAR];
+}
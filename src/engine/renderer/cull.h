@@ -0,0 +1,165 @@
+#ifndef _CULL_H_
+#define _CULL_H_
+
+#include <stdint.h>
+
+#include "core/debug.h"
+#include "core/maths.h"
+
+#define FRUSTUM_PLANE_COUNT 5 /* Left, right, bottom, top and near, there is
+                                 no far plane. */
+
+#define CULL_BOUNDS_LANES            8 /* Boxes tested at once by the widest kernel. */
+#define CULL_BOUNDS_ALIGNMENT        32
+#define CULL_BOUNDS_INITIAL_CAPACITY 256
+
+/******************************************************************************
+ * @name  _Frustum
+ * @brief The planes bounding what the camera sees. A point p is inside a
+ *        plane if a * p.x + b * p.y + c * p.z + d >= 0, the planes are not
+ *        normalised as only the sign matters.
+******************************************************************************/
+struct _Frustum
+{
+	float planes[FRUSTUM_PLANE_COUNT][4]; /*< a, b, c and d of each plane. */
+};
+typedef struct _Frustum Frustum;
+
+/******************************************************************************
+ * @name  _CullBounds
+ * @brief Axis aligned bounding boxes stored as separate arrays of each
+ *        coordinate, so the culling kernels load the same coordinate of
+ *        several boxes at once. The arrays are aligned and padded to a whole
+ *        number of CULL_BOUNDS_LANES.
+******************************************************************************/
+struct _CullBounds
+{
+	float *min[3]; /*< x, y and z of each box's minimum corner. */
+	float *max[3]; /*< x, y and z of each box's maximum corner. */
+	uint32_t count;
+	uint32_t capacity;
+};
+typedef struct _CullBounds CullBounds;
+
+/******************************************************************************
+ * @name  _CullSimd
+ * @brief The instruction sets the culling kernels are written for.
+******************************************************************************/
+enum _CullSimd
+{
+	CULL_SIMD_SCALAR,
+	CULL_SIMD_SSE2,
+	CULL_SIMD_AVX,
+	CULL_SIMD_COUNT
+};
+typedef enum _CullSimd CullSimd;
+
+/******************************************************************************
+ * @name  _CullKernels
+ * @brief Frustum culling for one instruction set.
+******************************************************************************/
+struct _CullKernels
+{
+	CullSimd simd;
+	const char *name;
+
+	/* Writes the index of each box at least partly inside the frustum to
+	 * visible, in order, and returns how many there are. visible must have
+	 * room for every box. */
+	uint32_t (*cull)(const CullBounds *restrict bounds,
+	                 const Frustum *restrict frustum,
+	                 uint32_t *restrict visible);
+};
+typedef struct _CullKernels CullKernels;
+
+/******************************************************************************
+ * @name       frustum_from_matrix()
+ * @brief      Extracts the frustum's planes from a view projection matrix made
+ *             with mat4_perspective_reverse_z().
+ * @param[out] frustum         Set to the planes.
+ * @param[in]  view_projection The camera's view projection matrix.
+ * @return     void
+******************************************************************************/
+void frustum_from_matrix(Frustum *restrict frustum, const Mat4 *restrict view_projection);
+
+/******************************************************************************
+ * @name       cull_bounds_init()
+ * @brief      Allocates storage for CULL_BOUNDS_INITIAL_CAPACITY boxes.
+ * @param[out] bounds The bounds to initalise.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR cull_bounds_init(CullBounds *bounds);
+
+/******************************************************************************
+ * @name      cull_bounds_deinit()
+ * @brief     Frees the bounds' storage.
+ * @param[in] bounds The bounds to deinitalise.
+ * @return    void
+******************************************************************************/
+void cull_bounds_deinit(CullBounds *bounds);
+
+/******************************************************************************
+ * @name      cull_bounds_reserve()
+ * @brief     Makes room for a number of boxes.
+ * @param[in] bounds The bounds to grow.
+ * @param     count  The number of boxes to make room for.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK, otherwise the
+ *            bounds are unchanged.
+******************************************************************************/
+ENGINE_ERROR cull_bounds_reserve(CullBounds *bounds, uint32_t count);
+
+/******************************************************************************
+ * @name      cull_bounds_push()
+ * @brief     Adds a box after the others. There must be room reserved for it.
+ * @param[in] bounds The bounds to add to.
+ * @param     min    The box's minimum corner.
+ * @param     max    The box's maximum corner.
+ * @return    void
+******************************************************************************/
+static inline void cull_bounds_push(CullBounds *bounds, Vec3 min, Vec3 max)
+{
+	uint32_t i = bounds->count++;
+
+	bounds->min[0][i] = min.x;
+	bounds->min[1][i] = min.y;
+	bounds->min[2][i] = min.z;
+	bounds->max[0][i] = max.x;
+	bounds->max[1][i] = max.y;
+	bounds->max[2][i] = max.z;
+}
+
+/******************************************************************************
+ * @name      cull_bounds_remove()
+ * @brief     Removes a box by moving the last box into its place.
+ * @param[in] bounds The bounds to remove from.
+ * @param     index  The box to remove.
+ * @return    void
+******************************************************************************/
+static inline void cull_bounds_remove(CullBounds *bounds, uint32_t index)
+{
+	uint32_t last = --bounds->count;
+
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		bounds->min[axis][index] = bounds->min[axis][last];
+		bounds->max[axis][index] = bounds->max[axis][last];
+	}
+}
+
+/******************************************************************************
+ * @name   cull_kernels_get()
+ * @brief  Gets the kernels for an instruction set.
+ * @param  simd The instruction set.
+ * @return The kernels, or NULL if the build or the CPU lacks the instruction
+ *         set.
+******************************************************************************/
+const CullKernels *cull_kernels_get(CullSimd simd);
+
+/******************************************************************************
+ * @name   cull_kernels_best()
+ * @brief  Gets the kernels for the widest instruction set the CPU supports.
+ * @return The kernels, never NULL.
+******************************************************************************/
+const CullKernels *cull_kernels_best();
+
+#endif /* _CULL_H_ */
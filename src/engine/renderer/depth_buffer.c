@@ -0,0 +1,125 @@
+#include "depth_buffer.h"
+
+#include <stdlib.h>
+
+#include "core/logger.h"
+
+#define ARRAY_SIZE(arr) sizeof(arr) / sizeof(arr[0])
+
+/* In order of preference. D16 is always supported as a depth attachment. */
+static const VkFormat depth_formats[] = {
+	VK_FORMAT_D32_SFLOAT,
+	VK_FORMAT_D32_SFLOAT_S8_UINT,
+	VK_FORMAT_X8_D24_UNORM_PACK32,
+	VK_FORMAT_D24_UNORM_S8_UINT,
+	VK_FORMAT_D16_UNORM
+};
+
+ENGINE_ERROR depth_buffer_select_format(const Device *restrict device,
+                                        VkFormat *restrict format)
+{
+	for (uint32_t i = 0; i < ARRAY_SIZE(depth_formats); i++)
+	{
+		VkFormatProperties properties;
+
+		vkGetPhysicalDeviceFormatProperties(device->physical_device,
+		                                    depth_formats[i],
+		                                    &properties);
+
+		if (properties.optimalTilingFeatures
+		    & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+		{
+			*format = depth_formats[i];
+			return ENGINE_OK;
+		}
+	}
+
+	LOG_ERROR("Device supports no depth attachment format");
+	return ENGINE_ERROR_INVALID_DEVICE;
+}
+
+ENGINE_ERROR depth_buffer_create(DepthBuffer **depth,
+                                 const Device *restrict device,
+                                 VkFormat format,
+                                 VkExtent2D extent)
+{
+	ENGINE_ERROR error;
+	VkResult success;
+
+	*depth = calloc(1, sizeof(DepthBuffer));
+	if (*depth == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate depth buffer");
+	}
+
+	(*depth)->format = format;
+	(*depth)->extent = extent;
+
+	/* The contents are cleared at the start of every frame and never read
+	 * afterwards, so tilers can keep them in on chip memory. */
+	VkImageCreateInfo image_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = format,
+		.extent = {extent.width, extent.height, 1},
+		.mipLevels = 1,
+		.arrayLayers = 1,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+	};
+
+	success = vkCreateImage(device->logical_device, &image_info, NULL, &(*depth)->image);
+	if (success != VK_SUCCESS)
+	{
+		error = ENGINE_ERROR_OUT_OF_MEMORY;
+		ENGINE_LOG_GOTO_IF_ERROR(error, "Failed to create depth image", create_fail);
+	}
+
+	error = memory_allocate_image(device->allocator,
+	                              (*depth)->image,
+	                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	                              &(*depth)->memory);
+	ENGINE_LOG_GOTO_IF_ERROR(error,
+	                         "Failed to allocate memory for depth image",
+	                         create_fail);
+
+	VkImageViewCreateInfo view_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+		.image = (*depth)->image,
+		.viewType = VK_IMAGE_VIEW_TYPE_2D,
+		.format = format,
+		.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+		.subresourceRange.baseMipLevel = 0,
+		.subresourceRange.levelCount = 1,
+		.subresourceRange.baseArrayLayer = 0,
+		.subresourceRange.layerCount = 1
+	};
+
+	success = vkCreateImageView(device->logical_device, &view_info, NULL, &(*depth)->view);
+	if (success != VK_SUCCESS)
+	{
+		error = ENGINE_ERROR_INIT_FAILED;
+		ENGINE_LOG_GOTO_IF_ERROR(error, "Failed to create depth image view", create_fail);
+	}
+
+	return ENGINE_OK;
+
+create_fail:
+	depth_buffer_destroy(*depth, device);
+	*depth = NULL;
+	return error;
+}
+
+void depth_buffer_destroy(DepthBuffer *depth, const Device *device)
+{
+	vkDestroyImageView(device->logical_device, depth->view, NULL);
+	vkDestroyImage(device->logical_device, depth->image, NULL);
+
+	memory_free(device->allocator, &depth->memory);
+
+	free(depth);
+}
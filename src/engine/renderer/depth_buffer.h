@@ -0,0 +1,62 @@
+#ifndef _DEPTH_BUFFER_H_
+#define _DEPTH_BUFFER_H_
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "core/debug.h"
+
+#include "devices.h"
+#include "memory.h"
+
+/******************************************************************************
+ * @name  _DepthBuffer
+ * @brief A depth image shared by every frame. Frames that overlap on the GPU
+ *        are ordered by the render pass's external dependency.
+******************************************************************************/
+struct _DepthBuffer
+{
+	VkImage image;
+	MemoryAllocation memory;
+	VkImageView view;
+
+	VkFormat format;
+	VkExtent2D extent;
+};
+typedef struct _DepthBuffer DepthBuffer;
+
+/******************************************************************************
+ * @name       depth_buffer_select_format()
+ * @brief      Picks the most precise depth format the device can render to.
+ *             Float formats come first as reversed depth relies on them.
+ * @param[in]  device The device to query.
+ * @param[out] format Set to the chosen format.
+ * @return     An ENGINE_ERROR value. If a format was found ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR depth_buffer_select_format(const Device *restrict device,
+                                        VkFormat *restrict format);
+
+/******************************************************************************
+ * @name       depth_buffer_create()
+ * @brief      Creates a depth image in device local memory.
+ * @param[out] depth  A pointer to a pointer set to the created depth buffer.
+ * @param[in]  device The device the image belongs to.
+ * @param      format The format from depth_buffer_select_format().
+ * @param      extent The size of the image, matching the colour images.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR depth_buffer_create(DepthBuffer **depth,
+                                 const Device *restrict device,
+                                 VkFormat format,
+                                 VkExtent2D extent);
+
+/******************************************************************************
+ * @name      depth_buffer_destroy()
+ * @brief     Destroys a depth buffer. The GPU must have finished using it.
+ * @param[in] depth  The depth buffer to destroy.
+ * @param[in] device The device the image belongs to.
+ * @return    void
+******************************************************************************/
+void depth_buffer_destroy(DepthBuffer *depth, const Device *device);
+
+#endif /* _DEPTH_BUFFER_H_ */
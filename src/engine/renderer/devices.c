@@ -5,6 +5,8 @@
 
 #include "core/logger.h"
 
+#define ARRAY_SIZE(arr) sizeof(arr) / sizeof(arr[0])
+
 static const char *device_extensions[] = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
@@ -54,6 +56,38 @@ static int check_device_extension_support(VkPhysicalDevice *device)
 	return 0;
 }
 
+/******************************************************************************
+ * @name      device_extension_available()
+ * @brief     Checks whether a physical device supports an optional extension.
+ * @param     device The physical device to query.
+ * @param[in] name   The name of the extension.
+ * @return    1 if the extension is supported, else 0.
+******************************************************************************/
+static uint8_t device_extension_available(VkPhysicalDevice device, const char *name)
+{
+	VkExtensionProperties *extensions;
+	uint32_t extension_count = 0;
+	uint8_t available = 0;
+
+	vkEnumerateDeviceExtensionProperties(device, NULL, &extension_count, NULL);
+
+	extensions = malloc(sizeof(VkExtensionProperties) * extension_count);
+	if (extensions == NULL)
+	{
+		return 0;
+	}
+
+	vkEnumerateDeviceExtensionProperties(device, NULL, &extension_count, extensions);
+
+	for (uint32_t i = 0; !available && i < extension_count; i++)
+	{
+		available = strcmp(extensions[i].extensionName, name) == 0;
+	}
+
+	free(extensions);
+	return available;
+}
+
 /******************************************************************************
  * @name      device_query_swap_chain_support_details()
  * @brief     Queries a physical device for swap chain support details including
@@ -123,8 +157,10 @@ static struct DeviceSwapChainSupportDetails
  * @name        find_queue_family()
  * @brief       Finds valid queue families and sets each families index into
  *              indicies.
- * @param[in]   device   The device to find the queue families in.
- * @param[in]   indicies The struct to store the indicies of each queue family.
+ * @param[in]   device         The device to find the queue families in.
+ * @param[in]   indicies       The struct to store the indicies of each queue family.
+ * @param[in]   render_surface The surface to check present support against, or
+ *                             NULL if the device will not present.
  * @return      void
 ******************************************************************************/
 static void find_queue_family(VkPhysicalDevice *device,
@@ -135,6 +171,7 @@ static void find_queue_family(VkPhysicalDevice *device,
 	VkBool32 present_support;
 	uint32_t queue_family_count;
 	uint32_t i;
+	uint8_t transfer_has_compute = 1;
 
 	vkGetPhysicalDeviceQueueFamilyProperties(*device, &queue_family_count, NULL);
 
@@ -146,19 +183,31 @@ static void find_queue_family(VkPhysicalDevice *device,
 
 	for (i = 0; i < queue_family_count; i++)
 	{
-		vkGetPhysicalDeviceSurfaceSupportKHR(*device,
-		                                     i,
-		                                     *render_surface,
-		                                     &present_support);
-		if (present_support)
+		if (render_surface != NULL)
 		{
-			indicies->present_family = i;
+			vkGetPhysicalDeviceSurfaceSupportKHR(*device,
+			                                     i,
+			                                     *render_surface,
+			                                     &present_support);
+			if (present_support)
+			{
+				indicies->present_family = i;
+			}
 		}
 
 		if (queue_family_properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
 		{
 			indicies->graphics_family = i;
 		}
+		/* Transfer only families map to the DMA engines, prefer them over
+		 * async compute families. */
+		else if (queue_family_properties[i].queueFlags & VK_QUEUE_TRANSFER_BIT
+		         && transfer_has_compute)
+		{
+			indicies->transfer_family = i;
+			transfer_has_compute =
+				(queue_family_properties[i].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+		}
 	}
 
 	free(queue_family_properties);
@@ -177,12 +226,25 @@ static ENGINE_ERROR suitable_device_found(VkPhysicalDevice *device,
                                           struct DeviceSwapChainSupportDetails *details)
 {
 	VkPhysicalDeviceProperties device_properties;
-	struct QueueFamilyIndicies indicies = {-1, -1};
+	struct QueueFamilyIndicies indicies = {-1, -1, -1};
 
 	vkGetPhysicalDeviceProperties(*device, &device_properties);
 
 	find_queue_family(device, &indicies, render_surface);
 
+	/* Headless devices never present so only need a graphics queue. */
+	if (render_surface == NULL)
+	{
+		if (indicies.graphics_family == -1)
+		{
+			return ENGINE_ERROR_INVALID_DEVICE;
+		}
+
+		indicies.present_family = indicies.graphics_family;
+		*queue_family_indicies = indicies;
+		return ENGINE_OK;
+	}
+
 	if (!check_device_extension_support(device))
 	{
 		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_INVALID_DEVICE,
@@ -233,7 +295,12 @@ static ENGINE_ERROR select_physical_device(Device *restrict device,
 
 	for (i = 0; i < device_count; i++)
 	{
-		struct DeviceSwapChainSupportDetails swap_chain_support;
+		struct DeviceSwapChainSupportDetails swap_chain_support = {
+			.formats = NULL,
+			.formats_count = 0,
+			.present_modes = NULL,
+			.present_modes_count = 0
+		};
 		error = suitable_device_found(&devices[i],
 		                                &device->queue_family_indicies,
 		                                render_surface,
@@ -241,6 +308,7 @@ static ENGINE_ERROR select_physical_device(Device *restrict device,
 		if (error == ENGINE_OK)
 		{
 			device->physical_device = devices[i];
+			vkGetPhysicalDeviceProperties(devices[i], &device->properties);
 			device->swap_chain_details = swap_chain_support;
 			free(devices);
 			return ENGINE_OK;
@@ -261,6 +329,10 @@ ENGINE_ERROR device_create(Device **restrict device,
 	*device = malloc(sizeof(Device));
 	(*device)->queue_family_indicies.graphics_family = -1;
 	(*device)->queue_family_indicies.present_family = -1;
+	(*device)->queue_family_indicies.transfer_family = -1;
+	(*device)->swap_chain_details.formats = NULL;
+	(*device)->swap_chain_details.present_modes = NULL;
+	(*device)->pipeline_cache = VK_NULL_HANDLE;
 
 	error = select_physical_device(*device, instance, render_surface);
 	if (error != ENGINE_OK)
@@ -284,18 +356,65 @@ ENGINE_ERROR device_create(Device **restrict device,
 		.pQueuePriorities = &queue_priority
 	};
 
+	VkDeviceQueueCreateInfo transfer_queue_info = {
+		.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+		.queueFamilyIndex = (uint32_t)(*device)->queue_family_indicies.transfer_family,
+		.queueCount = 1,
+		.pQueuePriorities = &queue_priority
+	};
+
+	VkPhysicalDeviceFeatures supported_features;
 	VkPhysicalDeviceFeatures physical_device_features = {};
+	const char *enabled_extensions[ARRAY_SIZE(device_extensions) + 1];
+	uint32_t enabled_extension_count = 0;
+	uint8_t draw_indirect_count;
+
+	/* Indirect draws generated on the device are optional, chunks are drawn
+	 * one call at a time without them. */
+	vkGetPhysicalDeviceFeatures((*device)->physical_device, &supported_features);
+	(*device)->multi_draw_indirect = supported_features.multiDrawIndirect
+	                                 && supported_features.drawIndirectFirstInstance;
+	physical_device_features.multiDrawIndirect = (*device)->multi_draw_indirect;
+	physical_device_features.drawIndirectFirstInstance = (*device)->multi_draw_indirect;
+
+	if (render_surface != NULL)
+	{
+		for (uint32_t i = 0; i < ARRAY_SIZE(device_extensions); i++)
+		{
+			enabled_extensions[enabled_extension_count++] = device_extensions[i];
+		}
+	}
+
+	draw_indirect_count = (*device)->multi_draw_indirect
+	                      && device_extension_available((*device)->physical_device,
+	                                                    VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	if (draw_indirect_count)
+	{
+		enabled_extensions[enabled_extension_count++] = VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME;
+	}
+
+	VkDeviceQueueCreateInfo queue_create_infos[3] = {graphics_queue_info};
+	uint32_t queue_create_info_count = 1;
+
+	/* A queue family may only be requested once. */
+	if (present_queue_info.queueFamilyIndex != graphics_queue_info.queueFamilyIndex)
+	{
+		queue_create_infos[queue_create_info_count++] = present_queue_info;
+	}
 
-	VkDeviceQueueCreateInfo queue_create_infos[] = {graphics_queue_info,
-	                                                present_queue_info};
+	if ((*device)->queue_family_indicies.transfer_family != -1
+	    && transfer_queue_info.queueFamilyIndex != present_queue_info.queueFamilyIndex)
+	{
+		queue_create_infos[queue_create_info_count++] = transfer_queue_info;
+	}
 
 	VkDeviceCreateInfo device_info = {
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
 		.pQueueCreateInfos = queue_create_infos,
-		.queueCreateInfoCount = 2,
+		.queueCreateInfoCount = queue_create_info_count,
 		.pEnabledFeatures = &physical_device_features,
-		.enabledExtensionCount = 1,
-		.ppEnabledExtensionNames = device_extensions,
+		.enabledExtensionCount = enabled_extension_count,
+		.ppEnabledExtensionNames = enabled_extensions,
 		.enabledLayerCount = 0
 	};
 
@@ -343,13 +462,68 @@ ENGINE_ERROR device_create(Device **restrict device,
 	                 0,
 	                 &(*device)->present_queue);
 
+	(*device)->draw_indexed_indirect_count = NULL;
+	if (draw_indirect_count)
+	{
+		(*device)->draw_indexed_indirect_count = (PFN_vkCmdDrawIndexedIndirectCountKHR)
+			vkGetDeviceProcAddr((*device)->logical_device,
+			                    "vkCmdDrawIndexedIndirectCountKHR");
+	}
+
+	/* Without a dedicated family transfers share the graphics queue. */
+	if ((*device)->queue_family_indicies.transfer_family != -1)
+	{
+		vkGetDeviceQueue((*device)->logical_device,
+		                 (*device)->queue_family_indicies.transfer_family,
+		                 0,
+		                 &(*device)->transfer_queue);
+	}
+	else
+	{
+		(*device)->transfer_queue = (*device)->graphics_queue;
+	}
+
+	error = memory_allocator_create(&(*device)->allocator,
+	                                (*device)->physical_device,
+	                                (*device)->logical_device);
+	if (error != ENGINE_OK)
+	{
+		vkDestroyDevice((*device)->logical_device, NULL);
+		free(*device);
+		*device = NULL;
+		ENGINE_LOG_RETURN_IF_ERROR(error, "Failed to create memory allocator");
+	}
+
 	return ENGINE_OK;
 }
 
 void device_destroy(Device *device)
 {
+	memory_allocator_destroy(device->allocator);
 	vkDestroyDevice(device->logical_device, NULL);
 	free(device->swap_chain_details.formats);
 	free(device->swap_chain_details.present_modes);
 	free(device);
+}
+
+uint8_t device_find_memory_type(const Device *device,
+                                uint32_t filter_type,
+                                VkMemoryPropertyFlags properties,
+                                uint32_t *suitable_type_index)
+{
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(device->physical_device, &memory_properties);
+
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+	{
+		if ((filter_type & (1 << i))
+		    && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			*suitable_type_index = i;
+			return 1;
+		}
+	}
+
+	LOG_ERROR("Failed to find valid memory filter");
+	return 0;
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "core/debug.h"
 
 #include "instance.h"
+#include "memory.h"
 
 /******************************************************************************
  * @name  DeviceSwapChainSupportDetails
@@ -32,6 +33,7 @@ struct QueueFamilyIndicies
 {
 	int64_t graphics_family;
 	int64_t present_family;
+	int64_t transfer_family; /*< A family without graphics support, or -1. */
 };
 
 /******************************************************************************
@@ -42,12 +44,24 @@ struct _Device
 {
 	VkDevice logical_device;
 	VkPhysicalDevice physical_device;
+	VkPhysicalDeviceProperties properties;
 
 	struct DeviceSwapChainSupportDetails swap_chain_details;
 	struct QueueFamilyIndicies queue_family_indicies;
 
 	VkQueue graphics_queue;
 	VkQueue present_queue;
+	VkQueue transfer_queue; /*< The graphics queue if there is no transfer family. */
+
+	MemoryAllocator *allocator; /*< Every buffer and image is allocated from here. */
+	VkPipelineCache pipeline_cache; /*< Shared by every pipeline created on the device. */
+
+	/* Set if one indirect call can draw many commands, each with its own
+	 * first instance, so draws can be generated on the device. */
+	uint8_t multi_draw_indirect;
+	/* Draws a count of indirect commands read from a buffer, NULL without
+	 * VK_KHR_draw_indirect_count. */
+	PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count;
 };
 typedef struct _Device Device;
 
@@ -58,7 +72,8 @@ typedef struct _Device Device;
  * @param[out] device         A pointer to a pointer which is set to store the address of
  *                            the created device struct.
  * @param[in]  instance       The vulkan instance.
- * @param[in]  render_surface The surface that will be used to draw to.
+ * @param[in]  render_surface The surface that will be used to draw to, or NULL
+ *                            to create a headless device that never presents.
  * @return     An ENGINE_ERROR value to describe the success of the device struct
  *             creation and initalisation.
 ******************************************************************************/
@@ -74,5 +89,20 @@ ENGINE_ERROR device_create(Device **restrict device,
 ******************************************************************************/
 void device_destroy(Device *device);
 
+/******************************************************************************
+ * @name       device_find_memory_type()
+ * @brief      Finds a memory type on a device that satisfies a filter and a set
+ *             of memory properties.
+ * @param[in]  device              The device to query.
+ * @param      filter_type         A bitmask of acceptable memory type indicies.
+ * @param      properties          The properties the memory type must have.
+ * @param[out] suitable_type_index The index of the memory type that was found.
+ * @return     1 if a suitable memory type was found, else 0.
+******************************************************************************/
+uint8_t device_find_memory_type(const Device *device,
+                                uint32_t filter_type,
+                                VkMemoryPropertyFlags properties,
+                                uint32_t *suitable_type_index);
+
 
 #endif /* _DEVICES_H_ */
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "draw_list.h"
+
+#include <stdlib.h>
+
+#include "core/logger.h"
+
+ENGINE_ERROR draw_list_init(DrawList *list)
+{
+	list->count = 0;
+	list->capacity = DRAW_LIST_INITIAL_CAPACITY;
+	list->draws = malloc(sizeof(DrawCommand) * list->capacity);
+
+	if (list->draws == NULL)
+	{
+		list->capacity = 0;
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate draw list");
+	}
+
+	return ENGINE_OK;
+}
+
+void draw_list_deinit(DrawList *list)
+{
+	free(list->draws);
+	list->draws = NULL;
+	list->count = 0;
+	list->capacity = 0;
+}
+
+ENGINE_ERROR draw_list_push(DrawList *restrict list,
+                            const DrawCommand *restrict draw)
+{
+	if (list->count == list->capacity)
+	{
+		uint32_t capacity = list->capacity ? list->capacity * 2 : DRAW_LIST_INITIAL_CAPACITY;
+		DrawCommand *draws = realloc(list->draws, sizeof(DrawCommand) * capacity);
+
+		if (draws == NULL)
+		{
+			ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+			                           "Failed to grow draw list");
+		}
+
+		list->draws = draws;
+		list->capacity = capacity;
+	}
+
+	list->draws[list->count++] = *draw;
+	return ENGINE_OK;
+}
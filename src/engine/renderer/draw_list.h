@@ -0,0 +1,65 @@
+#ifndef _DRAW_LIST_H_
+#define _DRAW_LIST_H_
+
+#include <stdint.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "core/debug.h"
+
+#include "command_buffers.h"
+
+#define DRAW_LIST_INITIAL_CAPACITY 256
+
+/******************************************************************************
+ * @name  _DrawList
+ * @brief The draws visible this frame. Cleared and refilled every frame, the
+ *        storage only ever grows so a steady scene allocates nothing.
+******************************************************************************/
+struct _DrawList
+{
+	DrawCommand *draws;
+	uint32_t count;
+	uint32_t capacity;
+};
+typedef struct _DrawList DrawList;
+
+/******************************************************************************
+ * @name       draw_list_init()
+ * @brief      Allocates a draw list's initial storage.
+ * @param[out] list The list to initalise.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR draw_list_init(DrawList *list);
+
+/******************************************************************************
+ * @name      draw_list_deinit()
+ * @brief     Frees a draw list's storage.
+ * @param[in] list The list to deinitalise.
+ * @return    void
+******************************************************************************/
+void draw_list_deinit(DrawList *list);
+
+/******************************************************************************
+ * @name      draw_list_clear()
+ * @brief     Empties a list, keeping its storage.
+ * @param[in] list The list to clear.
+ * @return    void
+******************************************************************************/
+static inline void draw_list_clear(DrawList *list)
+{
+	list->count = 0;
+}
+
+/******************************************************************************
+ * @name      draw_list_push()
+ * @brief     Adds a draw to a list, growing the storage if needed.
+ * @param[in] list The list to add to.
+ * @param[in] draw The draw to add.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR draw_list_push(DrawList *restrict list,
+                            const DrawCommand *restrict draw);
+
+#endif /* _DRAW_LIST_H_ */
@@ -0,0 +1,131 @@
+#include "frame_sync.h"
+
+#include <stdlib.h>
+
+#include "core/logger.h"
+
+ENGINE_ERROR frame_sync_create(FrameSync **sync,
+                               const Device *restrict device,
+                               uint32_t frame_count,
+                               uint32_t image_count)
+{
+	uint32_t i;
+	VkResult success = VK_SUCCESS;
+
+	ENGINE_ASSERT(frame_count > 0);
+
+	*sync = malloc(sizeof(FrameSync));
+	if (*sync == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate frame synchronisation");
+	}
+
+	(*sync)->image_available = calloc(frame_count, sizeof(VkSemaphore));
+	(*sync)->render_finished = calloc(frame_count, sizeof(VkSemaphore));
+	(*sync)->in_flight = calloc(frame_count, sizeof(VkFence));
+	(*sync)->frame_count = frame_count;
+	(*sync)->images_in_flight = calloc(image_count, sizeof(VkFence));
+	(*sync)->image_count = image_count;
+	(*sync)->current_frame = 0;
+
+	if ((*sync)->image_available == NULL
+	    || (*sync)->render_finished == NULL
+	    || (*sync)->in_flight == NULL
+	    || (*sync)->images_in_flight == NULL)
+	{
+		/* Nothing has been created yet, only the arrays need freeing. */
+		(*sync)->frame_count = 0;
+		frame_sync_destroy(*sync, device);
+		*sync = NULL;
+
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate frame synchronisation");
+	}
+
+	VkSemaphoreCreateInfo semaphore_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+	};
+
+	/* Fences start signalled so the first wait on each frame returns. */
+	VkFenceCreateInfo fence_info = {
+		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+		.flags = VK_FENCE_CREATE_SIGNALED_BIT
+	};
+
+	for (i = 0; i < frame_count; i++)
+	{
+		success = vkCreateSemaphore(device->logical_device,
+		                            &semaphore_info,
+		                            NULL,
+		                            &(*sync)->image_available[i]);
+		if (success != VK_SUCCESS)
+		{
+			break;
+		}
+
+		success = vkCreateSemaphore(device->logical_device,
+		                            &semaphore_info,
+		                            NULL,
+		                            &(*sync)->render_finished[i]);
+		if (success != VK_SUCCESS)
+		{
+			break;
+		}
+
+		success = vkCreateFence(device->logical_device,
+		                        &fence_info,
+		                        NULL,
+		                        &(*sync)->in_flight[i]);
+		if (success != VK_SUCCESS)
+		{
+			break;
+		}
+	}
+
+	if (success != VK_SUCCESS)
+	{
+		/* Handles that were never created are still zeroed by calloc. */
+		frame_sync_destroy(*sync, device);
+		*sync = NULL;
+
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to initalise frame synchronisation,"
+		                           " insufficient host/device memory");
+	}
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR frame_sync_set_image_count(FrameSync *sync, uint32_t image_count)
+{
+	VkFence *images_in_flight = calloc(image_count, sizeof(VkFence));
+
+	if (images_in_flight == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to track swap chain images");
+	}
+
+	free(sync->images_in_flight);
+	sync->images_in_flight = images_in_flight;
+	sync->image_count = image_count;
+
+	return ENGINE_OK;
+}
+
+void frame_sync_destroy(FrameSync *sync, const Device *device)
+{
+	for (uint32_t i = 0; i < sync->frame_count; i++)
+	{
+		vkDestroySemaphore(device->logical_device, sync->image_available[i], NULL);
+		vkDestroySemaphore(device->logical_device, sync->render_finished[i], NULL);
+		vkDestroyFence(device->logical_device, sync->in_flight[i], NULL);
+	}
+
+	free(sync->image_available);
+	free(sync->render_finished);
+	free(sync->in_flight);
+	free(sync->images_in_flight);
+	free(sync);
+}
@@ -0,0 +1,69 @@
+#ifndef _FRAME_SYNC_H_
+#define _FRAME_SYNC_H_
+
+#include <stdint.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "core/debug.h"
+
+#include "devices.h"
+
+/******************************************************************************
+ * @name  _FrameSync
+ * @brief Synchronisation objects for a set of frames in flight. Each frame
+ *        owns an acquire semaphore, a render semaphore and a fence. Each swap
+ *        chain image remembers the fence of the frame that last rendered to it
+ *        so an image is never recorded into while the GPU still uses it.
+******************************************************************************/
+struct _FrameSync
+{
+	VkSemaphore *image_available;
+	VkSemaphore *render_finished;
+	VkFence *in_flight;
+	uint32_t frame_count;
+
+	VkFence *images_in_flight; /*< Borrowed from in_flight, not owned. */
+	uint32_t image_count;
+
+	uint32_t current_frame;
+};
+typedef struct _FrameSync FrameSync;
+
+/******************************************************************************
+ * @name       frame_sync_create()
+ * @brief      Creates the semaphores and fences for a number of frames in
+ *             flight.
+ * @param[out] sync        A pointer to a pointer that is set to the created
+ *                         FrameSync struct.
+ * @param[in]  device      The device the synchronisation objects belong to.
+ * @param      frame_count The number of frames that may be in flight at once.
+ * @param      image_count The number of swap chain images to track.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR frame_sync_create(FrameSync **sync,
+                               const Device *restrict device,
+                               uint32_t frame_count,
+                               uint32_t image_count);
+
+/******************************************************************************
+ * @name      frame_sync_set_image_count()
+ * @brief     Tracks a new set of swap chain images after the swap chain was
+ *            recreated, forgetting which frames used the old ones.
+ * @param[in] sync        The FrameSync to update.
+ * @param     image_count The number of swap chain images to track.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR frame_sync_set_image_count(FrameSync *sync, uint32_t image_count);
+
+/******************************************************************************
+ * @name      frame_sync_destroy()
+ * @brief     Destroys a FrameSync struct. The device must be idle.
+ * @param[in] sync   The FrameSync to destroy.
+ * @param[in] device The device the synchronisation objects belong to.
+ * @return    void
+******************************************************************************/
+void frame_sync_destroy(FrameSync *sync, const Device *device);
+
+#endif /* _FRAME_SYNC_H_ */
@@ -7,16 +7,18 @@
 Framebuffer *framebuffer_create(const Device *restrict device,
                                 const GraphicsPipeline *restrict pipeline,
                                 const VkImageView *restrict image_view,
+                                VkImageView depth_view,
                                 const VkExtent2D *restrict extent)
 {
 	Framebuffer *framebuffer = malloc(sizeof(Framebuffer));
+	VkImageView attachments[] = {*image_view, depth_view};
 	VkResult success;
-	
+
 	VkFramebufferCreateInfo framebuffer_info = {
 		.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
 		.renderPass = pipeline->render_pass,
-		.attachmentCount = 1,
-		.pAttachments = image_view,
+		.attachmentCount = 2,
+		.pAttachments = attachments,
 		.width = extent->width,
 		.height = extent->height,
 		.layers = 1
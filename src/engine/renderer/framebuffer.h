@@ -23,12 +23,14 @@ typedef struct _Framebuffer Framebuffer;
  * @param[in] device     The device that the framebuffer belongs to.
  * @param[in] pipeline   The pipeline that will be used with the framebuffer.
  * @param[in] image_view The image view that the framebuffer will display.
+ * @param     depth_view The depth image view to test against.
  * @param[in] extent     The extent of the framebuffer.
  * @return    A pointer to a framebuffer.
 ******************************************************************************/
 Framebuffer *framebuffer_create(const Device *restrict device,
                                 const GraphicsPipeline *restrict pipeline,
                                 const VkImageView *restrict image_view,
+                                VkImageView depth_view,
                                 const VkExtent2D *restrict extent);
 
 /******************************************************************************
@@ -0,0 +1,614 @@
+#include "gpu_cull.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/logger.h"
+
+#include "shader_library.h"
+
+#define ARRAY_SIZE(arr) sizeof(arr) / sizeof(arr[0])
+
+/******************************************************************************
+ * @name      write_descriptors()
+ * @brief     Points a frame's descriptor set at its buffers.
+ * @param[in] device The device the set was allocated on.
+ * @param[in] frame  The frame whose set to write.
+ * @return    void
+******************************************************************************/
+static void write_descriptors(const Device *restrict device,
+                              const struct GpuCullFrame *restrict frame)
+{
+	VkDescriptorBufferInfo buffers[] = {
+		{frame->records->handle, 0, VK_WHOLE_SIZE},
+		{frame->commands->handle, 0, VK_WHOLE_SIZE},
+		{frame->count->handle, 0, VK_WHOLE_SIZE}
+	};
+	VkWriteDescriptorSet writes[ARRAY_SIZE(buffers)];
+
+	for (uint32_t i = 0; i < ARRAY_SIZE(buffers); i++)
+	{
+		writes[i] = (VkWriteDescriptorSet){
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = frame->descriptors,
+			.dstBinding = i,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &buffers[i]
+		};
+	}
+
+	vkUpdateDescriptorSets(device->logical_device, ARRAY_SIZE(writes), writes, 0, NULL);
+}
+
+/******************************************************************************
+ * @name      resize_frame()
+ * @brief     Replaces a frame's record and command buffers with ones that
+ *            have room for more records. The frame must not be in flight.
+ * @param[in] cull     The culling the frame belongs to.
+ * @param[in] device   The device to allocate on.
+ * @param[in] frame    The frame to resize.
+ * @param     capacity The records the new buffers have room for.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK, otherwise the
+ *            frame is unchanged.
+******************************************************************************/
+static ENGINE_ERROR resize_frame(const GpuCull *restrict cull,
+                                 Device *restrict device,
+                                 struct GpuCullFrame *restrict frame,
+                                 uint32_t capacity)
+{
+	VertexBuffer *records;
+	VertexBuffer *commands = NULL;
+
+	records = buffer_create(device,
+	                        capacity * sizeof(ChunkDrawRecord),
+	                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+	                        | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+	                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+	                        | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	if (records == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to create draw record buffer");
+	}
+
+	if (cull->enabled)
+	{
+		commands = buffer_create(device,
+		                         capacity * sizeof(VkDrawIndexedIndirectCommand),
+		                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+		                         | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (commands == NULL)
+		{
+			vertex_buffer_destroy(records, device);
+			ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+			                           "Failed to create indirect draw buffer");
+		}
+	}
+
+	if (frame->records != NULL)
+	{
+		vertex_buffer_destroy(frame->records, device);
+	}
+	if (frame->commands != NULL)
+	{
+		vertex_buffer_destroy(frame->commands, device);
+	}
+
+	frame->records = records;
+	frame->commands = commands;
+	frame->capacity = capacity;
+	frame->stale = 1;
+
+	if (cull->enabled)
+	{
+		write_descriptors(device, frame);
+	}
+
+	return ENGINE_OK;
+}
+
+/******************************************************************************
+ * @name      create_pipeline()
+ * @brief     Creates the compute pipeline, its layout and a descriptor set
+ *            for each frame in flight.
+ * @param[in] cull   The culling to create the pipeline of.
+ * @param[in] device The device to create it on.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR create_pipeline(GpuCull *restrict cull,
+                                    const Device *restrict device)
+{
+	const ShaderBinary *shader = shader_library_find("chunk_cull.comp");
+	VkDescriptorSetLayout set_layouts[cull->frame_count];
+	VkDescriptorSet sets[cull->frame_count];
+	VkShaderModule module;
+	VkResult success;
+
+	/* Records, commands and the count, in that order. */
+	VkDescriptorSetLayoutBinding bindings[3];
+	for (uint32_t i = 0; i < ARRAY_SIZE(bindings); i++)
+	{
+		bindings[i] = (VkDescriptorSetLayoutBinding){
+			.binding = i,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+		};
+	}
+
+	VkDescriptorSetLayoutCreateInfo set_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = ARRAY_SIZE(bindings),
+		.pBindings = bindings
+	};
+
+	success = vkCreateDescriptorSetLayout(device->logical_device,
+	                                      &set_layout_info,
+	                                      NULL,
+	                                      &cull->set_layout);
+	if (success != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to create culling descriptor set layout");
+	}
+
+	VkDescriptorPoolSize pool_size = {
+		.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.descriptorCount = ARRAY_SIZE(bindings) * cull->frame_count
+	};
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = cull->frame_count,
+		.poolSizeCount = 1,
+		.pPoolSizes = &pool_size
+	};
+
+	success = vkCreateDescriptorPool(device->logical_device,
+	                                 &pool_info,
+	                                 NULL,
+	                                 &cull->descriptor_pool);
+	if (success != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to create culling descriptor pool");
+	}
+
+	for (uint32_t i = 0; i < cull->frame_count; i++)
+	{
+		set_layouts[i] = cull->set_layout;
+	}
+
+	VkDescriptorSetAllocateInfo set_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = cull->descriptor_pool,
+		.descriptorSetCount = cull->frame_count,
+		.pSetLayouts = set_layouts
+	};
+
+	success = vkAllocateDescriptorSets(device->logical_device, &set_info, sets);
+	if (success != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate culling descriptor sets");
+	}
+
+	for (uint32_t i = 0; i < cull->frame_count; i++)
+	{
+		cull->frames[i].descriptors = sets[i];
+	}
+
+	VkPushConstantRange push_constants = {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(GpuCullPushConstants)
+	};
+
+	VkPipelineLayoutCreateInfo layout_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &cull->set_layout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_constants
+	};
+
+	success = vkCreatePipelineLayout(device->logical_device,
+	                                 &layout_info,
+	                                 NULL,
+	                                 &cull->layout);
+	if (success != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to create culling pipeline layout");
+	}
+
+	if (shader == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_INIT_FAILED,
+		                           "No shader named chunk_cull.comp was built "
+		                           "into the engine");
+	}
+
+	VkShaderModuleCreateInfo module_info = {
+		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		.codeSize = shader->size,
+		.pCode = shader->code
+	};
+
+	success = vkCreateShaderModule(device->logical_device, &module_info, NULL, &module);
+	if (success != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_INIT_FAILED,
+		                           "Failed to create culling shader module");
+	}
+
+	VkComputePipelineCreateInfo pipeline_info = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = module,
+			.pName = "main"
+		},
+		.layout = cull->layout
+	};
+
+	success = vkCreateComputePipelines(device->logical_device,
+	                                   device->pipeline_cache,
+	                                   1,
+	                                   &pipeline_info,
+	                                   NULL,
+	                                   &cull->pipeline);
+
+	/* The pipeline keeps what it needs of the module. */
+	vkDestroyShaderModule(device->logical_device, module, NULL);
+
+	if (success != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_INIT_FAILED,
+		                           "Failed to create culling pipeline");
+	}
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR gpu_cull_create(GpuCull **cull,
+                             Device *device,
+                             uint32_t frame_count,
+                             uint8_t enable)
+{
+	ENGINE_ERROR error;
+
+	*cull = calloc(1, sizeof(GpuCull));
+	if (*cull == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate culling");
+	}
+
+	(*cull)->frame_count = frame_count;
+	(*cull)->enabled = enable && device->multi_draw_indirect;
+	(*cull)->draw_count = device->draw_indexed_indirect_count != NULL;
+	(*cull)->max_draw_count = device->properties.limits.maxDrawIndirectCount;
+	(*cull)->records = malloc(GPU_CULL_MIN_CAPACITY * sizeof(ChunkDrawRecord));
+	(*cull)->record_capacity = GPU_CULL_MIN_CAPACITY;
+	(*cull)->frames = calloc(frame_count, sizeof(struct GpuCullFrame));
+
+	if ((*cull)->records == NULL || (*cull)->frames == NULL)
+	{
+		error = ENGINE_ERROR_OUT_OF_MEMORY;
+		ENGINE_LOG_GOTO_IF_ERROR(error, "Failed to allocate draw records", create_fail);
+	}
+
+	if ((*cull)->enabled)
+	{
+		error = create_pipeline(*cull, device);
+		ENGINE_GOTO_IF_ERROR(error, create_fail);
+	}
+
+	for (uint32_t i = 0; i < frame_count; i++)
+	{
+		struct GpuCullFrame *frame = &(*cull)->frames[i];
+
+		if ((*cull)->enabled)
+		{
+			frame->count = buffer_create(device,
+			                             sizeof(uint32_t),
+			                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+			                             | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+			                             | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			if (frame->count == NULL)
+			{
+				error = ENGINE_ERROR_OUT_OF_MEMORY;
+				ENGINE_LOG_GOTO_IF_ERROR(error,
+				                         "Failed to create draw count buffer",
+				                         create_fail);
+			}
+		}
+
+		error = resize_frame(*cull, device, frame, GPU_CULL_MIN_CAPACITY);
+		ENGINE_GOTO_IF_ERROR(error, create_fail);
+	}
+
+	LOG_INFO("Culling chunks on the %s%s",
+	         (*cull)->enabled ? "device" : "CPU",
+	         (*cull)->enabled && (*cull)->draw_count ? " with draw counts" : "");
+
+	return ENGINE_OK;
+
+create_fail:
+	gpu_cull_destroy(*cull, device);
+	*cull = NULL;
+	return error;
+}
+
+void gpu_cull_destroy(GpuCull *cull, Device *device)
+{
+	for (uint32_t i = 0; cull->frames != NULL && i < cull->frame_count; i++)
+	{
+		struct GpuCullFrame *frame = &cull->frames[i];
+
+		if (frame->records != NULL)
+		{
+			vertex_buffer_destroy(frame->records, device);
+		}
+		if (frame->commands != NULL)
+		{
+			vertex_buffer_destroy(frame->commands, device);
+		}
+		if (frame->count != NULL)
+		{
+			vertex_buffer_destroy(frame->count, device);
+		}
+		free(frame->changed);
+	}
+
+	/* Descriptor sets are freed with their pool. */
+	vkDestroyPipeline(device->logical_device, cull->pipeline, NULL);
+	vkDestroyPipelineLayout(device->logical_device, cull->layout, NULL);
+	vkDestroyDescriptorPool(device->logical_device, cull->descriptor_pool, NULL);
+	vkDestroyDescriptorSetLayout(device->logical_device, cull->set_layout, NULL);
+
+	free(cull->frames);
+	free(cull->records);
+	free(cull);
+}
+
+/******************************************************************************
+ * @name      mark_changed()
+ * @brief     Notes that a record must be copied to every frame's buffer. A
+ *            frame that would copy as many records as there are copies them
+ *            all instead.
+ * @param[in] cull  The culling the record belongs to.
+ * @param     index The record that changed.
+ * @return    void
+******************************************************************************/
+static void mark_changed(GpuCull *cull, uint32_t index)
+{
+	for (uint32_t i = 0; i < cull->frame_count; i++)
+	{
+		struct GpuCullFrame *frame = &cull->frames[i];
+
+		if (frame->stale)
+		{
+			continue;
+		}
+
+		if (frame->changed_count >= cull->record_count)
+		{
+			frame->stale = 1;
+			continue;
+		}
+
+		if (frame->changed_count == frame->changed_capacity)
+		{
+			uint32_t capacity = frame->changed_capacity > 0
+			                    ? frame->changed_capacity * 2
+			                    : GPU_CULL_MIN_CAPACITY;
+			uint32_t *changed = realloc(frame->changed, capacity * sizeof(uint32_t));
+
+			if (changed == NULL)
+			{
+				frame->stale = 1;
+				continue;
+			}
+
+			frame->changed = changed;
+			frame->changed_capacity = capacity;
+		}
+
+		frame->changed[frame->changed_count++] = index;
+	}
+}
+
+ENGINE_ERROR gpu_cull_push(GpuCull *restrict cull,
+                           const ChunkDrawRecord *restrict record)
+{
+	if (cull->record_count == cull->record_capacity)
+	{
+		uint32_t capacity = cull->record_capacity * 2;
+		ChunkDrawRecord *records = realloc(cull->records,
+		                                   capacity * sizeof(ChunkDrawRecord));
+
+		if (records == NULL)
+		{
+			ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+			                           "Failed to grow draw records");
+		}
+
+		cull->records = records;
+		cull->record_capacity = capacity;
+	}
+
+	cull->records[cull->record_count++] = *record;
+	mark_changed(cull, cull->record_count - 1);
+
+	return ENGINE_OK;
+}
+
+void gpu_cull_remove(GpuCull *cull, uint32_t index)
+{
+	uint32_t last = --cull->record_count;
+
+	if (index != last)
+	{
+		cull->records[index] = cull->records[last];
+		mark_changed(cull, index);
+	}
+}
+
+void gpu_cull_set_hidden(GpuCull *cull, uint32_t index, uint8_t hidden)
+{
+	uint32_t index_count = cull->records[index].index_count;
+
+	index_count = hidden ? index_count | GPU_CULL_HIDDEN : index_count & ~GPU_CULL_HIDDEN;
+	if (index_count != cull->records[index].index_count)
+	{
+		cull->records[index].index_count = index_count;
+		mark_changed(cull, index);
+	}
+}
+
+ENGINE_ERROR gpu_cull_update(GpuCull *restrict cull,
+                             Device *restrict device,
+                             uint32_t frame_index)
+{
+	struct GpuCullFrame *frame = &cull->frames[frame_index];
+	ChunkDrawRecord *mapped;
+	ENGINE_ERROR error;
+
+	if (cull->record_count > frame->capacity)
+	{
+		uint32_t capacity = frame->capacity;
+
+		while (capacity < cull->record_count)
+		{
+			capacity *= 2;
+		}
+
+		error = resize_frame(cull, device, frame, capacity);
+		ENGINE_RETURN_IF_ERROR(error);
+	}
+
+	mapped = frame->records->allocation.mapped;
+
+	if (frame->stale)
+	{
+		memcpy(mapped, cull->records, cull->record_count * sizeof(ChunkDrawRecord));
+	}
+	else
+	{
+		/* Records past the end were removed after they changed. */
+		for (uint32_t i = 0; i < frame->changed_count; i++)
+		{
+			uint32_t index = frame->changed[i];
+
+			if (index < cull->record_count)
+			{
+				mapped[index] = cull->records[index];
+			}
+		}
+	}
+
+	frame->changed_count = 0;
+	frame->stale = 0;
+
+	return ENGINE_OK;
+}
+
+/******************************************************************************
+ * @name      record_culling()
+ * @brief     Records the culling prepared by gpu_cull_prologue(). The count is
+ *            cleared, then each workgroup culls GPU_CULL_GROUP_SIZE records
+ *            and the draws are made visible to indirect reads.
+ * @param     buffer The primary command buffer, outside the render pass.
+ * @param[in] data   The GpuCull.
+ * @return    void
+******************************************************************************/
+static void record_culling(VkCommandBuffer buffer, void *data)
+{
+	GpuCull *cull = data;
+	struct GpuCullFrame *frame = &cull->frames[cull->frame];
+
+	VkMemoryBarrier cleared = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+	};
+
+	VkMemoryBarrier written = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+	};
+
+	vkCmdFillBuffer(buffer, frame->count->handle, 0, sizeof(uint32_t), 0);
+	vkCmdPipelineBarrier(buffer,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+	                     0,
+	                     1,
+	                     &cleared,
+	                     0,
+	                     NULL,
+	                     0,
+	                     NULL);
+
+	vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull->pipeline);
+	vkCmdBindDescriptorSets(buffer,
+	                        VK_PIPELINE_BIND_POINT_COMPUTE,
+	                        cull->layout,
+	                        0,
+	                        1,
+	                        &frame->descriptors,
+	                        0,
+	                        NULL);
+	vkCmdPushConstants(buffer,
+	                   cull->layout,
+	                   VK_SHADER_STAGE_COMPUTE_BIT,
+	                   0,
+	                   sizeof(GpuCullPushConstants),
+	                   &cull->constants);
+	vkCmdDispatch(buffer,
+	              (cull->constants.record_count + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE,
+	              1,
+	              1);
+
+	vkCmdPipelineBarrier(buffer,
+	                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+	                     VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+	                     0,
+	                     1,
+	                     &written,
+	                     0,
+	                     NULL,
+	                     0,
+	                     NULL);
+}
+
+void gpu_cull_prologue(GpuCull *restrict cull,
+                       uint32_t frame,
+                       const Frustum *restrict frustum,
+                       FramePrologue *restrict prologue,
+                       DrawCommand *restrict draw)
+{
+	const struct GpuCullFrame *culled = &cull->frames[frame];
+
+	cull->frame = frame;
+	memcpy(cull->constants.planes, frustum->planes, sizeof(cull->constants.planes));
+	cull->constants.record_count = cull->record_count;
+	cull->constants.compact = cull->draw_count;
+
+	prologue->name = "Chunk culling";
+	prologue->record = record_culling;
+	prologue->data = cull;
+
+	draw->instance_buffer = culled->records->handle;
+	draw->indirect_buffer = culled->commands->handle;
+	draw->count_buffer = cull->draw_count ? culled->count->handle : VK_NULL_HANDLE;
+	draw->max_draw_count = cull->record_count;
+}
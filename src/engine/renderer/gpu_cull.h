@@ -0,0 +1,210 @@
+#ifndef _GPU_CULL_H_
+#define _GPU_CULL_H_
+
+#include <stdint.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "core/debug.h"
+
+#include "devices.h"
+#include "buffer.h"
+#include "cull.h"
+#include "command_buffers.h"
+
+#define GPU_CULL_GROUP_SIZE   64  /* Records culled by each workgroup, must
+                                     match chunk_cull.comp. */
+#define GPU_CULL_MIN_CAPACITY 256
+#define GPU_CULL_HIDDEN       (1u << 31) /* Set in a record's index count while
+                                            it is not drawn at all. */
+
+/******************************************************************************
+ * @name  _ChunkDrawRecord
+ * @brief How to draw a chunk mesh from the mesh arena and where it is. Must
+ *        match DrawRecord in chunk_cull.comp, chunk.vert reads the origin as
+ *        a per instance attribute.
+******************************************************************************/
+struct _ChunkDrawRecord
+{
+	float min[3];          /*< The mesh's bounds in the world. */
+	uint32_t index_count;  /*< Along with GPU_CULL_HIDDEN. */
+	float max[3];
+	uint32_t first_index;  /*< Where the indices start in the arena, in
+	                           indices. */
+	float origin[3];       /*< Where the mesh's chunk starts in the world. */
+	int32_t vertex_offset; /*< Where the vertices start in the arena, in
+	                           vertices. */
+};
+typedef struct _ChunkDrawRecord ChunkDrawRecord;
+
+/******************************************************************************
+ * @name  _GpuCullPushConstants
+ * @brief Values pushed to chunk_cull.comp, must match its push constant block.
+******************************************************************************/
+struct _GpuCullPushConstants
+{
+	float planes[FRUSTUM_PLANE_COUNT][4];
+	uint32_t record_count;
+	uint32_t compact; /*< Set to pack the visible draws together and count
+	                      them, otherwise culled draws have no instances. */
+};
+typedef struct _GpuCullPushConstants GpuCullPushConstants;
+
+/******************************************************************************
+ * @name  GpuCullFrame
+ * @brief The buffers a frame in flight culls with. The records are a host
+ *        visible copy of the CPU's, brought up to date by copying only those
+ *        that changed since the frame was last drawn.
+******************************************************************************/
+struct GpuCullFrame
+{
+	VertexBuffer *records;  /*< Mapped, read by culling and as instance data. */
+	VertexBuffer *commands; /*< A VkDrawIndexedIndirectCommand per record. */
+	VertexBuffer *count;    /*< The number of visible draws when compacting. */
+	uint32_t capacity;      /*< Records the buffers have room for. */
+	VkDescriptorSet descriptors;
+
+	uint32_t *changed;      /*< Records changed since the last update. */
+	uint32_t changed_count;
+	uint32_t changed_capacity;
+	uint8_t stale;          /*< Set if every record must be copied. */
+};
+
+/******************************************************************************
+ * @name  _GpuCull
+ * @brief Keeps a record of how to draw each chunk mesh and, on devices that
+ *        can draw indirectly, culls them against the frustum with a compute
+ *        shader that writes the indirect draws. The CPU's work per frame is
+ *        then the same however many chunks are loaded.
+ *
+ *        Records are stored in the order of the renderer's meshes, so a
+ *        mesh's slot is its record's index and its draw's first instance.
+******************************************************************************/
+struct _GpuCull
+{
+	ChunkDrawRecord *records;
+	uint32_t record_count;
+	uint32_t record_capacity;
+
+	struct GpuCullFrame *frames; /*< One per frame in flight. */
+	uint32_t frame_count;
+
+	uint8_t enabled;         /*< Set if draws are generated on the device,
+	                             otherwise only the records are kept. */
+	uint8_t draw_count;      /*< Set if the device can read the number of
+	                             draws from a buffer. */
+	uint32_t max_draw_count; /*< The most draws one indirect call can make. */
+
+	VkDescriptorSetLayout set_layout;
+	VkDescriptorPool descriptor_pool;
+	VkPipelineLayout layout;
+	VkPipeline pipeline;
+
+	/* What the next prologue records. */
+	uint32_t frame;
+	GpuCullPushConstants constants;
+};
+typedef struct _GpuCull GpuCull;
+
+/******************************************************************************
+ * @name       gpu_cull_create()
+ * @brief      Creates the records and the buffers of each frame in flight.
+ * @param[out] cull        A pointer to a pointer set to the created culling.
+ * @param[in]  device      The device to cull on.
+ * @param      frame_count The number of frames in flight.
+ * @param      enable      If set, and the device supports multiple indirect
+ *                         draws in one call, the compute pipeline is created.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR gpu_cull_create(GpuCull **cull,
+                             Device *device,
+                             uint32_t frame_count,
+                             uint8_t enable);
+
+/******************************************************************************
+ * @name      gpu_cull_destroy()
+ * @brief     Destroys the culling. The device must be idle.
+ * @param[in] cull   The culling to destroy.
+ * @param[in] device The device it was created on.
+ * @return    void
+******************************************************************************/
+void gpu_cull_destroy(GpuCull *cull, Device *device);
+
+/******************************************************************************
+ * @name      gpu_cull_push()
+ * @brief     Adds a record after the others.
+ * @param[in] cull   The culling to add to.
+ * @param[in] record The record to copy.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR gpu_cull_push(GpuCull *restrict cull,
+                           const ChunkDrawRecord *restrict record);
+
+/******************************************************************************
+ * @name      gpu_cull_remove()
+ * @brief     Removes a record by moving the last record into its place.
+ * @param[in] cull  The culling to remove from.
+ * @param     index The record to remove.
+ * @return    void
+******************************************************************************/
+void gpu_cull_remove(GpuCull *cull, uint32_t index);
+
+/******************************************************************************
+ * @name      gpu_cull_set_hidden()
+ * @brief     Hides a record, so it is culled whatever the frustum, or shows
+ *            it again.
+ * @param[in] cull   The culling the record belongs to.
+ * @param     index  The record to change.
+ * @param     hidden Set to hide the record.
+ * @return    void
+******************************************************************************/
+void gpu_cull_set_hidden(GpuCull *cull, uint32_t index, uint8_t hidden);
+
+/******************************************************************************
+ * @name      gpu_cull_update()
+ * @brief     Brings a frame's records up to date, growing its buffers if the
+ *            records no longer fit. Must be called once the frame's previous
+ *            submission has finished.
+ * @param[in] cull   The culling to update.
+ * @param[in] device The device it was created on.
+ * @param     frame  The frame in flight.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR gpu_cull_update(GpuCull *restrict cull,
+                             Device *restrict device,
+                             uint32_t frame);
+
+/******************************************************************************
+ * @name   gpu_cull_can_draw()
+ * @brief  Checks whether this frame's chunks can be culled and drawn on the
+ *         device.
+ * @param  cull The culling to check.
+ * @return 1 if they can, else 0.
+******************************************************************************/
+static inline uint8_t gpu_cull_can_draw(const GpuCull *cull)
+{
+	return cull->enabled && cull->record_count <= cull->max_draw_count;
+}
+
+/******************************************************************************
+ * @name       gpu_cull_prologue()
+ * @brief      Prepares the culling of a frame's records, to be recorded
+ *             before its render pass, and the indexed indirect draw of what
+ *             is visible. gpu_cull_can_draw() must be set.
+ * @param[in]  cull     The culling to prepare.
+ * @param      frame    The frame in flight.
+ * @param[in]  frustum  The frustum to cull against.
+ * @param[out] prologue Set to record the culling.
+ * @param[out] draw     Its instance and indirect buffers are set. The rest
+ *                      of the draw, the pipeline and the arena's buffer, is
+ *                      left alone.
+ * @return     void
+******************************************************************************/
+void gpu_cull_prologue(GpuCull *restrict cull,
+                       uint32_t frame,
+                       const Frustum *restrict frustum,
+                       FramePrologue *restrict prologue,
+                       DrawCommand *restrict draw);
+
+#endif /* _GPU_CULL_H_ */
@@ -0,0 +1,254 @@
+#include "gpu_profiler.h"
+
+#include <stdlib.h>
+
+#include "core/logger.h"
+
+#define QUERIES_PER_FRAME (GPU_PROFILER_MAX_SCOPES * 2)
+
+ENGINE_ERROR gpu_profiler_create(GpuProfiler **profiler,
+                                 const Device *restrict device,
+                                 uint32_t frame_count)
+{
+	VkQueueFamilyProperties *queue_family_properties;
+	uint32_t queue_family_count;
+	uint32_t valid_bits;
+	ENGINE_ERROR error = ENGINE_OK;
+	VkResult success;
+
+	*profiler = malloc(sizeof(GpuProfiler));
+	if (*profiler == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate GPU profiler");
+	}
+
+	(*profiler)->frames = calloc(frame_count, sizeof(struct GpuProfilerFrame));
+	(*profiler)->frame_count = frame_count;
+	(*profiler)->query_pool = VK_NULL_HANDLE;
+	(*profiler)->timestamp_period = device->properties.limits.timestampPeriod;
+	(*profiler)->result_count = 0;
+	(*profiler)->frame_ms = -1.0;
+
+	if ((*profiler)->frames == NULL)
+	{
+		error = ENGINE_ERROR_OUT_OF_MEMORY;
+		ENGINE_LOG_GOTO_IF_ERROR(error,
+		                         "Failed to allocate GPU profiler",
+		                         query_pool_create_fail);
+	}
+
+	for (uint32_t i = 0; i < frame_count; i++)
+	{
+		atomic_init(&(*profiler)->frames[i].scope_count, 0);
+	}
+
+	vkGetPhysicalDeviceQueueFamilyProperties(device->physical_device,
+	                                         &queue_family_count,
+	                                         NULL);
+	queue_family_properties =
+		malloc(sizeof(VkQueueFamilyProperties) * queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(device->physical_device,
+	                                         &queue_family_count,
+	                                         queue_family_properties);
+
+	valid_bits = queue_family_properties[
+		device->queue_family_indicies.graphics_family].timestampValidBits;
+	free(queue_family_properties);
+
+	/* Some queues cannot write timestamps, GPU time is then never reported. */
+	(*profiler)->supported = valid_bits != 0;
+	(*profiler)->timestamp_mask = valid_bits >= 64 ? UINT64_MAX
+	                                               : (1ull << valid_bits) - 1;
+
+	if (!(*profiler)->supported)
+	{
+		LOG_WARNING("Graphics queue does not support timestamps");
+		return ENGINE_OK;
+	}
+
+	VkQueryPoolCreateInfo query_pool_info = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = frame_count * QUERIES_PER_FRAME
+	};
+
+	success = vkCreateQueryPool(device->logical_device,
+	                            &query_pool_info,
+	                            NULL,
+	                            &(*profiler)->query_pool);
+	if (success != VK_SUCCESS)
+	{
+		error = ENGINE_ERROR_OUT_OF_MEMORY;
+		ENGINE_LOG_GOTO_IF_ERROR(error,
+		                         "Failed to create timestamp query pool",
+		                         query_pool_create_fail);
+	}
+
+	return ENGINE_OK;
+
+query_pool_create_fail:
+	free((*profiler)->frames);
+	free(*profiler);
+	*profiler = NULL;
+	return error;
+}
+
+void gpu_profiler_destroy(GpuProfiler *profiler, const Device *device)
+{
+	vkDestroyQueryPool(device->logical_device, profiler->query_pool, NULL);
+	free(profiler->frames);
+	free(profiler);
+}
+
+/******************************************************************************
+ * @name      scope_depth()
+ * @brief     Counts the scopes enclosing a scope.
+ * @param[in] frame The frame the scope belongs to.
+ * @param     scope The scope to find the depth of.
+ * @return    0 for a scope without a parent.
+******************************************************************************/
+static uint32_t scope_depth(const struct GpuProfilerFrame *frame, uint32_t scope)
+{
+	uint32_t depth = 0;
+
+	while (frame->scopes[scope].parent != GPU_PROFILER_NO_SCOPE)
+	{
+		scope = frame->scopes[scope].parent;
+		depth++;
+	}
+
+	return depth;
+}
+
+uint8_t gpu_profiler_collect(GpuProfiler *restrict profiler,
+                             const Device *restrict device,
+                             uint32_t frame)
+{
+	struct GpuProfilerFrame *profiler_frame = &profiler->frames[frame];
+	uint32_t scope_count = atomic_load(&profiler_frame->scope_count);
+	uint64_t timestamps[QUERIES_PER_FRAME];
+	uint64_t starts[GPU_PROFILER_MAX_SCOPES];
+	uint8_t submitted = profiler_frame->submitted;
+	VkResult success;
+
+	profiler_frame->submitted = 0;
+	atomic_store(&profiler_frame->scope_count, 0);
+
+	if (!profiler->supported || !submitted || scope_count == 0)
+	{
+		return 0;
+	}
+
+	/* The fence has signalled so the results should be ready, if they are
+	 * not the frame is skipped rather than waited for. */
+	success = vkGetQueryPoolResults(device->logical_device,
+	                                profiler->query_pool,
+	                                frame * QUERIES_PER_FRAME,
+	                                scope_count * 2,
+	                                scope_count * 2 * sizeof(uint64_t),
+	                                timestamps,
+	                                sizeof(uint64_t),
+	                                VK_QUERY_RESULT_64_BIT);
+	if (success != VK_SUCCESS)
+	{
+		return 0;
+	}
+
+	/* Ordered by start time, parents start before their children. */
+	profiler->result_count = 0;
+	for (uint32_t i = 0; i < scope_count; i++)
+	{
+		uint64_t start = timestamps[i * 2] & profiler->timestamp_mask;
+		uint64_t end = timestamps[i * 2 + 1] & profiler->timestamp_mask;
+		uint32_t position = profiler->result_count;
+
+		while (position > 0 && starts[position - 1] > start)
+		{
+			starts[position] = starts[position - 1];
+			profiler->results[position] = profiler->results[position - 1];
+			position--;
+		}
+
+		starts[position] = start;
+		profiler->results[position].name = profiler_frame->scopes[i].name;
+		profiler->results[position].depth = scope_depth(profiler_frame, i);
+		profiler->results[position].ms = (double)((end - start) & profiler->timestamp_mask)
+		                                 * profiler->timestamp_period / 1000000.0;
+		profiler->result_count++;
+
+		if (i == 0)
+		{
+			profiler->frame_ms = profiler->results[position].ms;
+		}
+	}
+
+	return 1;
+}
+
+uint32_t gpu_profiler_add_scope(GpuProfiler *restrict profiler,
+                                uint32_t frame,
+                                const char *restrict name,
+                                uint32_t parent)
+{
+	struct GpuProfilerFrame *profiler_frame = &profiler->frames[frame];
+	uint32_t scope;
+
+	if (!profiler->supported)
+	{
+		return GPU_PROFILER_NO_SCOPE;
+	}
+
+	scope = atomic_fetch_add_explicit(&profiler_frame->scope_count,
+	                                  1,
+	                                  memory_order_relaxed);
+	if (scope >= GPU_PROFILER_MAX_SCOPES)
+	{
+		atomic_fetch_sub_explicit(&profiler_frame->scope_count,
+		                          1,
+		                          memory_order_relaxed);
+		return GPU_PROFILER_NO_SCOPE;
+	}
+
+	profiler_frame->scopes[scope].name = name;
+	profiler_frame->scopes[scope].parent = parent;
+	return scope;
+}
+
+void gpu_profiler_reset(const GpuProfiler *profiler,
+                        VkCommandBuffer commands,
+                        uint32_t frame)
+{
+	if (!profiler->supported)
+	{
+		return;
+	}
+
+	vkCmdResetQueryPool(commands,
+	                    profiler->query_pool,
+	                    frame * QUERIES_PER_FRAME,
+	                    QUERIES_PER_FRAME);
+}
+
+void gpu_profiler_write(const GpuProfiler *profiler,
+                        VkCommandBuffer commands,
+                        uint32_t frame,
+                        uint32_t scope,
+                        uint8_t end)
+{
+	if (scope == GPU_PROFILER_NO_SCOPE)
+	{
+		return;
+	}
+
+	vkCmdWriteTimestamp(commands,
+	                    end ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+	                        : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+	                    profiler->query_pool,
+	                    frame * QUERIES_PER_FRAME + scope * 2 + end);
+}
+
+void gpu_profiler_submitted(GpuProfiler *profiler, uint32_t frame)
+{
+	profiler->frames[frame].submitted = 1;
+}
@@ -0,0 +1,155 @@
+#ifndef _GPU_PROFILER_H_
+#define _GPU_PROFILER_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "core/debug.h"
+
+#include "devices.h"
+#include "renderer.h"
+
+#define GPU_PROFILER_MAX_SCOPES 128
+#define GPU_PROFILER_NO_SCOPE   UINT32_MAX
+
+/******************************************************************************
+ * @name  GpuProfilerScope
+ * @brief A section of a frame timed by a pair of timestamp queries. The
+ *        scope's index selects its queries.
+******************************************************************************/
+struct GpuProfilerScope
+{
+	const char *name;
+	uint32_t parent;
+};
+
+/******************************************************************************
+ * @name  GpuProfilerFrame
+ * @brief The scopes recorded into a frame in flight.
+******************************************************************************/
+struct GpuProfilerFrame
+{
+	struct GpuProfilerScope scopes[GPU_PROFILER_MAX_SCOPES];
+	atomic_uint scope_count;
+	uint8_t submitted;
+};
+
+/******************************************************************************
+ * @name  _GpuProfiler
+ * @brief Times named, nested sections of each frame on the GPU. Each frame in
+ *        flight owns a range of a timestamp query pool. Results are read once
+ *        the frame's fence has signalled, frame_count frames after they were
+ *        recorded, so reading them never stalls.
+******************************************************************************/
+struct _GpuProfiler
+{
+	VkQueryPool query_pool;
+	struct GpuProfilerFrame *frames;
+	uint32_t frame_count;
+
+	uint8_t supported;
+	uint64_t timestamp_mask;
+	double timestamp_period; /*< Nanoseconds per timestamp tick. */
+
+	/* The most recently read frame. */
+	GpuScopeTiming results[GPU_PROFILER_MAX_SCOPES];
+	uint32_t result_count;
+	double frame_ms; /*< The duration of the frame's first scope. */
+};
+typedef struct _GpuProfiler GpuProfiler;
+
+/******************************************************************************
+ * @name       gpu_profiler_create()
+ * @brief      Creates a timestamp query pool for a number of frames in flight.
+ * @param[out] profiler    A pointer to a pointer set to the created profiler.
+ * @param[in]  device      The device the queries run on.
+ * @param      frame_count The number of frames in flight.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR gpu_profiler_create(GpuProfiler **profiler,
+                                 const Device *restrict device,
+                                 uint32_t frame_count);
+
+/******************************************************************************
+ * @name      gpu_profiler_destroy()
+ * @brief     Destroys a profiler. The device must be idle.
+ * @param[in] profiler The profiler to destroy.
+ * @param[in] device   The device the queries run on.
+ * @return    void
+******************************************************************************/
+void gpu_profiler_destroy(GpuProfiler *profiler, const Device *device);
+
+/******************************************************************************
+ * @name      gpu_profiler_collect()
+ * @brief     Reads the results of a frame's previous submission without
+ *            waiting and readies the frame for new scopes. Called once the
+ *            frame's fence has signalled, before it is recorded again.
+ * @param[in] profiler The profiler to collect.
+ * @param[in] device   The device the queries run on.
+ * @param     frame    The frame in flight to collect.
+ * @return    1 if new results were read, else 0.
+******************************************************************************/
+uint8_t gpu_profiler_collect(GpuProfiler *restrict profiler,
+                             const Device *restrict device,
+                             uint32_t frame);
+
+/******************************************************************************
+ * @name      gpu_profiler_add_scope()
+ * @brief     Adds a scope to a frame. Its timestamps must then both be written
+ *            with gpu_profiler_write(). Can be called from any thread.
+ * @param[in] profiler The profiler to add to.
+ * @param     frame    The frame in flight being recorded.
+ * @param[in] name     A name that outlives the profiler.
+ * @param     parent   The enclosing scope, or GPU_PROFILER_NO_SCOPE.
+ * @return    The scope, or GPU_PROFILER_NO_SCOPE if timestamps are not
+ *            supported or the frame has no scopes left.
+******************************************************************************/
+uint32_t gpu_profiler_add_scope(GpuProfiler *restrict profiler,
+                                uint32_t frame,
+                                const char *restrict name,
+                                uint32_t parent);
+
+/******************************************************************************
+ * @name      gpu_profiler_reset()
+ * @brief     Records the reset of a frame's queries. Must be recorded outside
+ *            a render pass and execute before any of the frame's timestamps.
+ * @param[in] profiler The profiler that owns the queries.
+ * @param     commands The command buffer to record into.
+ * @param     frame    The frame in flight being recorded.
+ * @return    void
+******************************************************************************/
+void gpu_profiler_reset(const GpuProfiler *profiler,
+                        VkCommandBuffer commands,
+                        uint32_t frame);
+
+/******************************************************************************
+ * @name      gpu_profiler_write()
+ * @brief     Records the start or end timestamp of a scope. Does nothing for
+ *            GPU_PROFILER_NO_SCOPE.
+ * @param[in] profiler The profiler that owns the queries.
+ * @param     commands The command buffer to record into.
+ * @param     frame    The frame in flight being recorded.
+ * @param     scope    The scope to time.
+ * @param     end      0 for the start of the scope, 1 for the end.
+ * @return    void
+******************************************************************************/
+void gpu_profiler_write(const GpuProfiler *profiler,
+                        VkCommandBuffer commands,
+                        uint32_t frame,
+                        uint32_t scope,
+                        uint8_t end);
+
+/******************************************************************************
+ * @name      gpu_profiler_submitted()
+ * @brief     Marks a frame's queries as submitted so they are read when the
+ *            frame is next collected.
+ * @param[in] profiler The profiler that owns the queries.
+ * @param     frame    The frame in flight that was submitted.
+ * @return    void
+******************************************************************************/
+void gpu_profiler_submitted(GpuProfiler *profiler, uint32_t frame);
+
+#endif /* _GPU_PROFILER_H_ */
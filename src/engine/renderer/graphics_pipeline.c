@@ -1,98 +1,102 @@
 #include "graphics_pipeline.h"
 
-#include <stdio.h>
 #include <stdlib.h>
 
 #include "core/logger.h"
 
-/******************************************************************************
- * @name       read_shader_binary()
- * @brief      Copies the contents of a shader binary and outputs it.
- * @param[in]  file The file path of the binary.
- * @param[out] length The length of the outputted buffer.
- * @return     A pointer to a heap allocated buffer.
-******************************************************************************/
-static char* read_shader_binary(const char *file, size_t *length)
-{
-	FILE *fp = fopen(file, "rb");
-	char *buffer = NULL;
-
-	if (fp != NULL)
-	{
-		fseek(fp, 0, SEEK_END);
-		*length = ftell(fp);
-		fseek(fp, 0, SEEK_SET);
-
-		if (length != 0)
-		{
-			buffer = malloc(sizeof(char) * (*length));
-			fread(buffer, sizeof(char), *length, fp);
-		}
-
-		fclose(fp);
-	}
-	else
-	{
-		LOG_ERROR("Path to binary does not exist");
-	}
-
-	return buffer;
-}
+#include "shader_library.h"
 
 /******************************************************************************
  * @name      create_render_pass()
  * @brief     Creates a render pass for a pipeline.
  * @param[in] pipeline The pipeline the pass belongs to.
  * @param[in] device The device the pipeline belongs to.
- * @param[in] swap_chain The swap_chain that provides images to the pipeline.
+ * @param[in] target The render target that provides images to the pipeline.
  * @return    An ENGINE_ERROR value that describes the success of creating the
  *            render pass. If successful ENGINE_OK is returned.
 ******************************************************************************/
 static ENGINE_ERROR create_render_pass(GraphicsPipeline *pipeline,
                                        const Device *device,
-                                       const SwapChain *swap_chain)
+                                       const RenderTarget *target)
 {
 	VkResult success;
 
 	VkAttachmentDescription color_attachment = {
-		.format = swap_chain->format,
+		.format = target->format,
 		.samples = VK_SAMPLE_COUNT_1_BIT,
 		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
 		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
 		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+		.finalLayout = target->final_layout
 	};
 
+	/* Depth is cleared every frame and never read afterwards. */
+	VkAttachmentDescription depth_attachment = {
+		.format = target->depth_format,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+		.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+	};
+
+	VkAttachmentDescription attachments[] = {color_attachment, depth_attachment};
+
 	VkAttachmentReference color_attachment_ref = {
 		.attachment = 0,
 		.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
 	};
 
+	VkAttachmentReference depth_attachment_ref = {
+		.attachment = 1,
+		.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+	};
+
 	VkSubpassDescription subpass = {
 		.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
 		.colorAttachmentCount = 1,
-		.pColorAttachments = &color_attachment_ref
+		.pColorAttachments = &color_attachment_ref,
+		.pDepthStencilAttachment = &depth_attachment_ref
 	};
 
-	VkSubpassDependency dependency = {
-		.srcSubpass = VK_SUBPASS_EXTERNAL,
-		.dstSubpass = 0,
-		.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-		.srcAccessMask = 0,
-		.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-		.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+	VkSubpassDependency dependencies[] = {
+		{
+			/* The depth image is shared between frames, the previous frame
+			 * must finish its depth tests before this one clears it. */
+			.srcSubpass = VK_SUBPASS_EXTERNAL,
+			.dstSubpass = 0,
+			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+			                | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+			                | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+			                 | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+		},
+		{
+			/* Only used when the images are copied out after rendering. */
+			.srcSubpass = 0,
+			.dstSubpass = VK_SUBPASS_EXTERNAL,
+			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+			.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT
+		}
 	};
 
 	VkRenderPassCreateInfo render_pass_info = {
 		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-		.attachmentCount = 1,
-		.pAttachments = &color_attachment,
+		.attachmentCount = 2,
+		.pAttachments = attachments,
 		.subpassCount = 1,
 		.pSubpasses = &subpass,
-		.dependencyCount = 1,
-		.pDependencies = &dependency
+		.dependencyCount =
+			target->final_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ? 2 : 1,
+		.pDependencies = dependencies
 	};
 
 	success = vkCreateRenderPass(device->logical_device,
@@ -111,9 +115,11 @@ static ENGINE_ERROR create_render_pass(GraphicsPipeline *pipeline,
 
 ENGINE_ERROR graphics_pipeline_create(GraphicsPipeline **pipeline,
                                       const Device *restrict device,
-                                      const SwapChain *restrict swap_chain,
-                                      const VertexData *restrict vertex_data)
+                                      const RenderTarget *restrict target,
+                                      const GraphicsPipelineInfo *restrict info)
 {
+	uint8_t depth_prepass = info->depth_prepass;
+	VkPipeline handles[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
 	*pipeline = malloc(sizeof(GraphicsPipeline));
 	VkShaderModule vertex_module = NULL;
 	VkShaderModule fragment_module = NULL;
@@ -127,7 +133,7 @@ ENGINE_ERROR graphics_pipeline_create(GraphicsPipeline **pipeline,
 
 	error = set_graphics_pipeline_shader(*pipeline,
 	                                     device,
-	                                     "./assets/vert.spv",
+	                                     info->vertex_shader,
 	                                     VK_SHADER_STAGE_VERTEX_BIT,
 	                                     &vertex_module);
 
@@ -135,7 +141,7 @@ ENGINE_ERROR graphics_pipeline_create(GraphicsPipeline **pipeline,
 
 	error = set_graphics_pipeline_shader(*pipeline,
 	                                     device,
-	                                     "./assets/frag.spv",
+	                                     info->fragment_shader,
 	                                     VK_SHADER_STAGE_FRAGMENT_BIT,
 	                                     &fragment_module);
 
@@ -143,10 +149,10 @@ ENGINE_ERROR graphics_pipeline_create(GraphicsPipeline **pipeline,
 
 	VkPipelineVertexInputStateCreateInfo vertex_input_info = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-		.vertexBindingDescriptionCount = 1,
-		.pVertexBindingDescriptions = &vertex_data->binding_description,
-		.vertexAttributeDescriptionCount = 2,
-		.pVertexAttributeDescriptions = vertex_data->attribute_description
+		.vertexBindingDescriptionCount = info->binding_count,
+		.pVertexBindingDescriptions = info->bindings,
+		.vertexAttributeDescriptionCount = info->attribute_count,
+		.pVertexAttributeDescriptions = info->attributes
 	};
 
 	VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {
@@ -155,26 +161,24 @@ ENGINE_ERROR graphics_pipeline_create(GraphicsPipeline **pipeline,
 		.primitiveRestartEnable = VK_FALSE
 	};
 
-	VkViewport viewport = {
-		.x = 0.0f,
-		.y = 0.0f,
-		.width = swap_chain->extent.width,
-		.height = swap_chain->extent.height,
-		.minDepth = 0.0f,
-		.maxDepth = 1.0f
-	};
-
-	VkRect2D scissor = {
-		.offset = {0, 0},
-		.extent = swap_chain->extent
-	};
-
+	/* Set while recording so the pipeline outlives swap chain resizes. */
 	VkPipelineViewportStateCreateInfo viewport_state = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
 		.viewportCount = 1,
-		.pViewports = &viewport,
+		.pViewports = NULL,
 		.scissorCount = 1,
-		.pScissors = &scissor
+		.pScissors = NULL
+	};
+
+	VkDynamicState dynamic_states[] = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamic_state = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+		.dynamicStateCount = sizeof(dynamic_states) / sizeof(dynamic_states[0]),
+		.pDynamicStates = dynamic_states
 	};
 
 	VkPipelineRasterizationStateCreateInfo rastertizer = {
@@ -222,12 +226,50 @@ ENGINE_ERROR graphics_pipeline_create(GraphicsPipeline **pipeline,
 		.blendConstants = {0.0f, 0.0f, 0.0f, 0.0f}
 	};
 
+	/* Reversed depth, nearer fragments have greater depth. After a depth
+	 * pre-pass only the nearest fragment of each pixel is left to shade. */
+	VkPipelineDepthStencilStateCreateInfo depth_stencil = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+		.depthTestEnable = VK_TRUE,
+		.depthWriteEnable = depth_prepass ? VK_FALSE : VK_TRUE,
+		.depthCompareOp = depth_prepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_GREATER,
+		.depthBoundsTestEnable = VK_FALSE,
+		.stencilTestEnable = VK_FALSE
+	};
+
+	VkPipelineDepthStencilStateCreateInfo prepass_depth_stencil = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+		.depthTestEnable = VK_TRUE,
+		.depthWriteEnable = VK_TRUE,
+		.depthCompareOp = VK_COMPARE_OP_GREATER,
+		.depthBoundsTestEnable = VK_FALSE,
+		.stencilTestEnable = VK_FALSE
+	};
+
+	VkPipelineColorBlendAttachmentState prepass_blend_attachment = {
+		.colorWriteMask = 0,
+		.blendEnable = VK_FALSE
+	};
+
+	VkPipelineColorBlendStateCreateInfo prepass_color_blend = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+		.logicOpEnable = VK_FALSE,
+		.attachmentCount = 1,
+		.pAttachments = &prepass_blend_attachment
+	};
+
+	VkPushConstantRange push_constants = {
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		.offset = 0,
+		.size = sizeof(GraphicsPushConstants)
+	};
+
 	VkPipelineLayoutCreateInfo layout = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
 		.setLayoutCount = 0,
 		.pSetLayouts = NULL,
-		.pushConstantRangeCount = 0,
-		.pPushConstantRanges = NULL
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_constants
 	};
 
 	success = vkCreatePipelineLayout(device->logical_device,
@@ -245,34 +287,65 @@ ENGINE_ERROR graphics_pipeline_create(GraphicsPipeline **pipeline,
 	}
 
 
-	error = create_render_pass(*pipeline, device, swap_chain);
-	ENGINE_GOTO_IF_ERROR(error, render_pass_init_fail);
-
-	VkGraphicsPipelineCreateInfo pipeline_info = {
-		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-		.stageCount = 2,
-		.pStages = (*pipeline)->shader_stages,
-		.pVertexInputState = &vertex_input_info,
-		.pInputAssemblyState = &input_assembly_info,
-		.pViewportState = &viewport_state,
-		.pRasterizationState = &rastertizer,
-		.pMultisampleState = &multisample,
-		.pDepthStencilState = NULL,
-		.pColorBlendState = &color_blend,
-		.pDynamicState = NULL,
-		.layout = (*pipeline)->layout,
-		.renderPass = (*pipeline)->render_pass,
-		.subpass = 0,
-		.basePipelineHandle = VK_NULL_HANDLE,
-		.basePipelineIndex = -1
+	(*pipeline)->owns_render_pass = info->render_pass == VK_NULL_HANDLE;
+	if ((*pipeline)->owns_render_pass)
+	{
+		error = create_render_pass(*pipeline, device, target);
+		ENGINE_GOTO_IF_ERROR(error, render_pass_init_fail);
+	}
+	else
+	{
+		(*pipeline)->render_pass = info->render_pass;
+	}
+
+	VkGraphicsPipelineCreateInfo pipeline_infos[2] = {
+		{
+			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+			.stageCount = 2,
+			.pStages = (*pipeline)->shader_stages,
+			.pVertexInputState = &vertex_input_info,
+			.pInputAssemblyState = &input_assembly_info,
+			.pViewportState = &viewport_state,
+			.pRasterizationState = &rastertizer,
+			.pMultisampleState = &multisample,
+			.pDepthStencilState = &depth_stencil,
+			.pColorBlendState = &color_blend,
+			.pDynamicState = &dynamic_state,
+			.layout = (*pipeline)->layout,
+			.renderPass = (*pipeline)->render_pass,
+			.subpass = 0,
+			.basePipelineHandle = VK_NULL_HANDLE,
+			.basePipelineIndex = -1
+		},
+		{
+			/* Depth only, the vertex stage alone is enough. */
+			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+			.stageCount = 1,
+			.pStages = (*pipeline)->shader_stages,
+			.pVertexInputState = &vertex_input_info,
+			.pInputAssemblyState = &input_assembly_info,
+			.pViewportState = &viewport_state,
+			.pRasterizationState = &rastertizer,
+			.pMultisampleState = &multisample,
+			.pDepthStencilState = &prepass_depth_stencil,
+			.pColorBlendState = &prepass_color_blend,
+			.pDynamicState = &dynamic_state,
+			.layout = (*pipeline)->layout,
+			.renderPass = (*pipeline)->render_pass,
+			.subpass = 0,
+			.basePipelineHandle = VK_NULL_HANDLE,
+			.basePipelineIndex = -1
+		}
 	};
 
 	success = vkCreateGraphicsPipelines(device->logical_device,
-	                                    VK_NULL_HANDLE,
-	                                    1,
-	                                    &pipeline_info,
+	                                    device->pipeline_cache,
+	                                    depth_prepass ? 2 : 1,
+	                                    pipeline_infos,
 	                                    NULL,
-	                                    &(*pipeline)->handle);
+	                                    handles);
+	(*pipeline)->handle = handles[0];
+	(*pipeline)->prepass = handles[1];
 
 	if (success != VK_SUCCESS)
 	{
@@ -287,7 +360,7 @@ ENGINE_ERROR graphics_pipeline_create(GraphicsPipeline **pipeline,
 			ENGINE_LOG_GOTO_IF_ERROR(error,
 									"Failed to create pipeline layout, insufficient"
 									"host/device memory",
-									render_pass_init_fail);
+									pipeline_create_fail);
 		}
 	}
 
@@ -296,6 +369,14 @@ ENGINE_ERROR graphics_pipeline_create(GraphicsPipeline **pipeline,
 
 	return ENGINE_OK;
 
+pipeline_create_fail:
+	vkDestroyPipeline(device->logical_device, handles[0], NULL);
+	vkDestroyPipeline(device->logical_device, handles[1], NULL);
+	if ((*pipeline)->owns_render_pass)
+	{
+		vkDestroyRenderPass(device->logical_device, (*pipeline)->render_pass, NULL);
+	}
+
 render_pass_init_fail:
 	vkDestroyPipelineLayout(device->logical_device, (*pipeline)->layout, NULL);
 
@@ -314,33 +395,35 @@ void graphics_pipeline_destroy(GraphicsPipeline *restrict pipeline,
                                const Device *restrict device)
 {
 	vkDestroyPipeline(device->logical_device, pipeline->handle, NULL);
+	vkDestroyPipeline(device->logical_device, pipeline->prepass, NULL);
 	vkDestroyPipelineLayout(device->logical_device, pipeline->layout, NULL);
-	vkDestroyRenderPass(device->logical_device, pipeline->render_pass, NULL);
+	if (pipeline->owns_render_pass)
+	{
+		vkDestroyRenderPass(device->logical_device, pipeline->render_pass, NULL);
+	}
 	free(pipeline->shader_stages);
 	free(pipeline);
 }
 
 ENGINE_ERROR set_graphics_pipeline_shader(GraphicsPipeline *restrict pipeline,
                                           const Device *restrict device,
-                                          const char *restrict shader_path,
+                                          const char *restrict shader_name,
                                           VkShaderStageFlagBits shader_stage,
                                           VkShaderModule *restrict module)
 {
-	size_t shader_length = 0;
-	uint32_t *shader_binary = (uint32_t*)read_shader_binary(shader_path,
-	                                                        &shader_length);
+	const ShaderBinary *shader = shader_library_find(shader_name);
 	VkResult success;
 
-	if (shader_binary == NULL)
+	if (shader == NULL)
 	{
-		free(shader_binary);
+		LOG_ERROR("No shader named %s was built into the engine", shader_name);
 		return ENGINE_ERROR_INIT_FAILED;
 	}
 
 	VkShaderModuleCreateInfo module_info = {
 		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-		.codeSize = shader_length,
-		.pCode = shader_binary
+		.codeSize = shader->size,
+		.pCode = shader->code
 	};
 
 	success = vkCreateShaderModule(device->logical_device,
@@ -349,8 +432,6 @@ ENGINE_ERROR set_graphics_pipeline_shader(GraphicsPipeline *restrict pipeline,
 	                               module);
 	if (success != VK_SUCCESS)
 	{
-		free(shader_binary);
-
 		if (success == VK_ERROR_OUT_OF_HOST_MEMORY
 		    || success == VK_ERROR_OUT_OF_DEVICE_MEMORY)
 		{
@@ -365,8 +446,6 @@ ENGINE_ERROR set_graphics_pipeline_shader(GraphicsPipeline *restrict pipeline,
 		}
 	}
 
-	free(shader_binary);
-
 	VkPipelineShaderStageCreateInfo stage_info = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
 		.stage = shader_stage,
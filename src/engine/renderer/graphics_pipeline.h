@@ -7,20 +7,60 @@
 #include <GLFW/glfw3.h>
 
 #include "core/debug.h"
+#include "core/maths.h"
 
 #include "devices.h"
-#include "swap_chain.h"
+#include "render_target.h"
 #include "buffer.h"
 
+/******************************************************************************
+ * @name  _GraphicsPushConstants
+ * @brief Values pushed to the vertex shader, must match its push constant
+ *        block.
+******************************************************************************/
+struct _GraphicsPushConstants
+{
+	Mat4 view_projection;
+	float origin[4]; /*< Added to each vertex position, set per draw. */
+};
+typedef struct _GraphicsPushConstants GraphicsPushConstants;
+
+/******************************************************************************
+ * @name  _GraphicsPipelineInfo
+ * @brief What a graphics pipeline draws with. Every pipeline shares the same
+ *        layout of GraphicsPushConstants, so they can be switched between
+ *        without pushing the constants again.
+******************************************************************************/
+struct _GraphicsPipelineInfo
+{
+	const char *vertex_shader;   /*< The file name of the GLSL source. */
+	const char *fragment_shader; /*< The file name of the GLSL source. */
+
+	const VkVertexInputBindingDescription *bindings;
+	uint32_t binding_count;
+	const VkVertexInputAttributeDescription *attributes;
+	uint32_t attribute_count;
+
+	VkRenderPass render_pass; /*< A render pass to share, VK_NULL_HANDLE to
+	                              create one for the render target. */
+	uint8_t depth_prepass;    /*< If set a depth only pipeline is also created
+	                              and the main pipeline only shades fragments
+	                              whose depth equals what the pre-pass wrote. */
+};
+typedef struct _GraphicsPipelineInfo GraphicsPipelineInfo;
+
 struct _GraphicsPipeline
 {
 	VkPipeline handle;
+	VkPipeline prepass; /*< Writes depth only, VK_NULL_HANDLE unless created
+	                        with a depth pre-pass. */
 	VkPipelineShaderStageCreateInfo *shader_stages;
 	uint32_t stage_count;
 	uint32_t last_stage;
 
 	VkPipelineLayout layout;
 	VkRenderPass render_pass;
+	uint8_t owns_render_pass; /*< Not set if the render pass is shared. */
 };
 typedef struct _GraphicsPipeline GraphicsPipeline;
 
@@ -29,15 +69,15 @@ typedef struct _GraphicsPipeline GraphicsPipeline;
  * @brief      Creates an instance of the GraphicsPipeline struct.
  * @param[out] pipeline A pointer to a pointer that stores the initalised pipeline.
  * @param[in]  device The device the pipeline will belong to.
- * @param[in]  swap_chain The swap_chain that the pipeline recieves images from.
- * @param[in]  vertex_data Vertex data to be processed.
+ * @param[in]  target The render target that the pipeline renders images to.
+ * @param[in]  info   The shaders, vertex layout and render pass to use.
  * @return     An ENGINE_ERROR value, if creation of the graphics pipeline was 
  *             successful ENGINE_OK is returned.
 ******************************************************************************/
 ENGINE_ERROR graphics_pipeline_create(GraphicsPipeline **pipeline,
                                       const Device *restrict device,
-                                      const SwapChain *restrict swap_chain,
-                                      const VertexData *restrict vertex_data);
+                                      const RenderTarget *restrict target,
+                                      const GraphicsPipelineInfo *restrict info);
 
 /******************************************************************************
  * @name      graphics_pipeline_destroy()
@@ -51,10 +91,10 @@ void graphics_pipeline_destroy(GraphicsPipeline *restrict pipeline,
 
 /******************************************************************************
  * @name       set_graphics_pipeline_shader()
- * @brief      Creates a shader stage for a given shader binary.
+ * @brief      Creates a shader stage from a shader embedded in the engine.
  * @param[in]  pipeline     The pipeline the stage will belong to.
  * @param[in]  device       The device the pipeline belongs to.
- * @param[in]  shader_path  A path to the shader binary.
+ * @param[in]  shader_name  The file name of the shader's GLSL source.
  * @param      shader_stage The shaders stage flag.
  * @param[out] module       A pointer to a shader module to be cleaned up after
  *                          the graphics pipeline has been created.
@@ -63,7 +103,7 @@ void graphics_pipeline_destroy(GraphicsPipeline *restrict pipeline,
 ******************************************************************************/
 ENGINE_ERROR set_graphics_pipeline_shader(GraphicsPipeline *restrict pipeline,
                                           const Device *restrict device,
-                                          const char *restrict shader_path,
+                                          const char *restrict shader_name,
                                           VkShaderStageFlagBits shader_stage,
                                           VkShaderModule *restrict module);
 
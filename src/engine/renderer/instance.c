@@ -93,7 +93,7 @@ static int validate_validation_layers()
 }
 #endif
 
-ENGINE_ERROR instance_create(Instance **instance)
+ENGINE_ERROR instance_create(Instance **instance, uint8_t headless)
 {
 	const char **extensions;
 	uint32_t extension_count;
@@ -113,10 +113,20 @@ ENGINE_ERROR instance_create(Instance **instance)
 		.pApplicationInfo = &app_info,
 	};
 
-	extensions = get_required_extensions(&extension_count);
-	if (extensions == NULL)
+	/* Surface extensions come from GLFW which may not be initalised when
+	 * running headless. */
+	if (headless)
+	{
+		extensions = NULL;
+		extension_count = 0;
+	}
+	else
 	{
-		LOG_WARNING("No required extensions found");
+		extensions = get_required_extensions(&extension_count);
+		if (extensions == NULL)
+		{
+			LOG_WARNING("No required extensions found");
+		}
 	}
 
 	instance_info.ppEnabledExtensionNames = extensions;
@@ -1,6 +1,8 @@
 #ifndef _INSTANCE_H_
 #define _INSTANCE_H_
 
+#include <stdint.h>
+
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
@@ -21,9 +23,10 @@ typedef struct _Instance Instance;
  * @brief     Creates an Instance struct that will handle VkInstance operations.
  * @param[out] instance A pointer to a pointer which will store the address of
  *                      of the created instance.
+ * @param      headless If set no surface extensions are enabled.
  * @return    A value of ENGINE_ERROR if successful ENGINE_OK.
 ******************************************************************************/
-ENGINE_ERROR instance_create(Instance **instance);
+ENGINE_ERROR instance_create(Instance **instance, uint8_t headless);
 
 /******************************************************************************
  * @name      instance_destroy()
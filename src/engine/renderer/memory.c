@@ -0,0 +1,908 @@
+#include "memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/logger.h"
+
+#define MEMORY_SIZE_CLASSES 64 /* One free list per power of two. */
+
+/******************************************************************************
+ * @name  _MemoryRange
+ * @brief A used or free part of a block. The ranges of a block are kept in
+ *        address order and together cover the whole block. Free ranges are
+ *        also linked into the block's free list for their size class and
+ *        never sit next to one another, they are merged as soon as they
+ *        touch.
+******************************************************************************/
+struct _MemoryRange
+{
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	uint8_t free;
+	uint8_t linear;
+
+	struct _MemoryRange *prev;
+	struct _MemoryRange *next;
+	struct _MemoryRange *free_prev;
+	struct _MemoryRange *free_next;
+};
+
+/******************************************************************************
+ * @name  _MemoryBlock
+ * @brief A single VkDeviceMemory object that ranges are handed out from.
+******************************************************************************/
+struct _MemoryBlock
+{
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	void *mapped;
+	uint32_t memory_type;
+	uint32_t allocation_count;
+
+	struct _MemoryRange *ranges;
+	struct _MemoryRange *free_ranges[MEMORY_SIZE_CLASSES]; /*< Indexed by
+	                                                           size_class(). */
+	uint64_t free_classes; /*< Bit n set if free_ranges[n] is not empty. */
+
+	struct _MemoryBlock *next;
+};
+
+static inline VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/******************************************************************************
+ * @name   on_same_page()
+ * @brief  Checks if the last byte of one resource and the first byte of the
+ *         resource after it share a bufferImageGranularity page.
+ * @param  end_of_first   The offset of the last byte of the first resource.
+ * @param  start_of_second The offset of the first byte of the second resource.
+ * @param  page_size      The bufferImageGranularity of the device.
+ * @return 1 if they share a page, else 0.
+******************************************************************************/
+static inline uint8_t on_same_page(VkDeviceSize end_of_first,
+                                   VkDeviceSize start_of_second,
+                                   VkDeviceSize page_size)
+{
+	return (end_of_first & ~(page_size - 1))
+	       == (start_of_second & ~(page_size - 1));
+}
+
+/******************************************************************************
+ * @name   size_class()
+ * @brief  Gets the free list a range belongs in, ranges of at least 2^n and
+ *         less than 2^(n + 1) bytes share list n.
+ * @param  size The size of the range, more than 0.
+ * @return The size class.
+******************************************************************************/
+static inline uint32_t size_class(VkDeviceSize size)
+{
+	return 63 - (uint32_t)__builtin_clzll(size);
+}
+
+/* Must be called before a free range's size changes and again after. */
+static void free_list_insert(struct _MemoryBlock *block,
+                             struct _MemoryRange *range)
+{
+	uint32_t class = size_class(range->size);
+
+	range->free_prev = NULL;
+	range->free_next = block->free_ranges[class];
+
+	if (block->free_ranges[class] != NULL)
+	{
+		block->free_ranges[class]->free_prev = range;
+	}
+
+	block->free_ranges[class] = range;
+	block->free_classes |= 1ull << class;
+}
+
+static void free_list_remove(struct _MemoryBlock *block,
+                             struct _MemoryRange *range)
+{
+	uint32_t class = size_class(range->size);
+
+	if (range->free_prev != NULL)
+	{
+		range->free_prev->free_next = range->free_next;
+	}
+	else
+	{
+		block->free_ranges[class] = range->free_next;
+		if (range->free_next == NULL)
+		{
+			block->free_classes &= ~(1ull << class);
+		}
+	}
+
+	if (range->free_next != NULL)
+	{
+		range->free_next->free_prev = range->free_prev;
+	}
+
+	range->free_prev = NULL;
+	range->free_next = NULL;
+}
+
+/******************************************************************************
+ * @name      split_range()
+ * @brief     Makes a free range covering part of an existing range and links
+ *            it in before or after it.
+ * @param[in] block  The block the range belongs to.
+ * @param[in] range  The range being split.
+ * @param[in] split  Unused storage for the new range.
+ * @param     offset The offset of the new range.
+ * @param     size   The size of the new range.
+ * @param     after  1 to link the new range after range, 0 for before.
+ * @return    void
+******************************************************************************/
+static void split_range(struct _MemoryBlock *block,
+                        struct _MemoryRange *range,
+                        struct _MemoryRange *split,
+                        VkDeviceSize offset,
+                        VkDeviceSize size,
+                        uint8_t after)
+{
+	split->offset = offset;
+	split->size = size;
+	split->free = 1;
+	split->linear = 0;
+
+	if (after)
+	{
+		split->prev = range;
+		split->next = range->next;
+		if (range->next != NULL)
+		{
+			range->next->prev = split;
+		}
+		range->next = split;
+	}
+	else
+	{
+		split->prev = range->prev;
+		split->next = range;
+		if (range->prev != NULL)
+		{
+			range->prev->next = split;
+		}
+		else
+		{
+			block->ranges = split;
+		}
+		range->prev = split;
+	}
+
+	free_list_insert(block, split);
+}
+
+static void unlink_range(struct _MemoryBlock *block, struct _MemoryRange *range)
+{
+	if (range->prev != NULL)
+	{
+		range->prev->next = range->next;
+	}
+	else
+	{
+		block->ranges = range->next;
+	}
+
+	if (range->next != NULL)
+	{
+		range->next->prev = range->prev;
+	}
+
+	free(range);
+}
+
+/******************************************************************************
+ * @name       fit_range()
+ * @brief      Finds where an allocation would start within a free range,
+ *             keeping linear and optimal resources on different
+ *             bufferImageGranularity pages.
+ * @param[in]  allocator The allocator, for the device granularity.
+ * @param[in]  range     The free range to test.
+ * @param      size      The size of the allocation.
+ * @param      alignment The alignment of the allocation.
+ * @param      linear    Whether the allocation is for a linear resource.
+ * @param[out] offset    Set to the offset the allocation would start at.
+ * @return     1 if the allocation fits, else 0.
+******************************************************************************/
+static uint8_t fit_range(const MemoryAllocator *allocator,
+                         const struct _MemoryRange *range,
+                         VkDeviceSize size,
+                         VkDeviceSize alignment,
+                         uint8_t linear,
+                         VkDeviceSize *offset)
+{
+	VkDeviceSize page_size = allocator->buffer_image_granularity;
+	const struct _MemoryRange *prev = range->prev;
+	const struct _MemoryRange *next = range->next;
+	VkDeviceSize start = align_up(range->offset, alignment);
+
+	if (prev != NULL
+	    && prev->linear != linear
+	    && on_same_page(prev->offset + prev->size - 1, start, page_size))
+	{
+		start = align_up(start, page_size);
+	}
+
+	if (start + size > range->offset + range->size)
+	{
+		return 0;
+	}
+
+	if (next != NULL
+	    && next->linear != linear
+	    && on_same_page(start + size - 1, next->offset, page_size))
+	{
+		return 0;
+	}
+
+	*offset = start;
+	return 1;
+}
+
+/******************************************************************************
+ * @name       find_range()
+ * @brief      Finds a free range of a block an allocation fits in. Ranges of
+ *             the allocation's own size class are searched for the best fit,
+ *             failing that the first range that fits from the next class up
+ *             with any free ranges is taken.
+ * @param[in]  allocator The allocator, for the device granularity.
+ * @param[in]  block     The block to search.
+ * @param      size      The size of the allocation.
+ * @param      alignment The alignment of the allocation.
+ * @param      linear    Whether the allocation is for a linear resource.
+ * @param[out] offset    Set to the offset the allocation would start at.
+ * @return     The free range, or NULL if the allocation fits in none.
+******************************************************************************/
+static struct _MemoryRange *find_range(const MemoryAllocator *allocator,
+                                       const struct _MemoryBlock *block,
+                                       VkDeviceSize size,
+                                       VkDeviceSize alignment,
+                                       uint8_t linear,
+                                       VkDeviceSize *offset)
+{
+	uint32_t first = size_class(size);
+	uint64_t classes = block->free_classes & (~0ull << first);
+
+	while (classes != 0)
+	{
+		uint32_t class = (uint32_t)__builtin_ctzll(classes);
+		struct _MemoryRange *best = NULL;
+		VkDeviceSize start;
+
+		for (struct _MemoryRange *range = block->free_ranges[class];
+		     range != NULL;
+		     range = range->free_next)
+		{
+			if (best != NULL && range->size >= best->size)
+			{
+				continue;
+			}
+
+			if (fit_range(allocator, range, size, alignment, linear, &start))
+			{
+				best = range;
+				*offset = start;
+
+				/* Every range above the allocation's class is larger than
+				 * it, any of them does. */
+				if (class != first)
+				{
+					return best;
+				}
+			}
+		}
+
+		if (best != NULL)
+		{
+			return best;
+		}
+
+		classes &= classes - 1;
+	}
+
+	return NULL;
+}
+
+/******************************************************************************
+ * @name   at_allocation_limit()
+ * @brief  Checks whether another VkDeviceMemory object would exceed the
+ *         device's maxMemoryAllocationCount.
+ * @param  allocator The allocator to check.
+ * @return 1 if no more may be allocated, else 0.
+******************************************************************************/
+static uint8_t at_allocation_limit(const MemoryAllocator *allocator)
+{
+	if (allocator->stats.block_count + allocator->stats.dedicated_count
+	    >= allocator->max_allocation_count)
+	{
+		LOG_WARNING("Reached the device limit of %u memory allocations",
+		            allocator->max_allocation_count);
+		return 1;
+	}
+
+	return 0;
+}
+
+/******************************************************************************
+ * @name      take_range()
+ * @brief     Marks part of a free range as used, splitting any space left
+ *            before or after it into new free ranges. Nothing changes if the
+ *            new ranges cannot be allocated.
+ * @param[in] block  The block the range belongs to.
+ * @param[in] range  The free range to take from.
+ * @param     offset The offset returned by fit_range().
+ * @param     size   The size of the allocation.
+ * @param     linear Whether the allocation is for a linear resource.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR take_range(struct _MemoryBlock *block,
+                               struct _MemoryRange *range,
+                               VkDeviceSize offset,
+                               VkDeviceSize size,
+                               uint8_t linear)
+{
+	VkDeviceSize range_end = range->offset + range->size;
+	struct _MemoryRange *before = NULL;
+	struct _MemoryRange *after = NULL;
+
+	if (offset > range->offset)
+	{
+		before = malloc(sizeof(struct _MemoryRange));
+		if (before == NULL)
+		{
+			return ENGINE_ERROR_OUT_OF_MEMORY;
+		}
+	}
+
+	if (offset + size < range_end)
+	{
+		after = malloc(sizeof(struct _MemoryRange));
+		if (after == NULL)
+		{
+			free(before);
+			return ENGINE_ERROR_OUT_OF_MEMORY;
+		}
+	}
+
+	free_list_remove(block, range);
+
+	if (before != NULL)
+	{
+		split_range(block, range, before, range->offset, offset - range->offset, 0);
+	}
+
+	if (after != NULL)
+	{
+		split_range(block, range, after, offset + size, range_end - offset - size, 1);
+	}
+
+	range->offset = offset;
+	range->size = size;
+	range->free = 0;
+	range->linear = linear;
+
+	return ENGINE_OK;
+}
+
+/******************************************************************************
+ * @name      release_range()
+ * @brief     Marks a range as free and merges it with free neighbours.
+ * @param[in] block The block the range belongs to.
+ * @param[in] range The range to release.
+ * @return    void
+******************************************************************************/
+static void release_range(struct _MemoryBlock *block, struct _MemoryRange *range)
+{
+	struct _MemoryRange *next = range->next;
+	struct _MemoryRange *prev = range->prev;
+
+	range->free = 1;
+
+	if (next != NULL && next->free)
+	{
+		free_list_remove(block, next);
+		range->size += next->size;
+		unlink_range(block, next);
+	}
+
+	if (prev != NULL && prev->free)
+	{
+		free_list_remove(block, prev);
+		prev->size += range->size;
+		free_list_insert(block, prev);
+		unlink_range(block, range);
+		return;
+	}
+
+	free_list_insert(block, range);
+}
+
+static ENGINE_ERROR block_create(MemoryAllocator *allocator,
+                                 uint32_t memory_type,
+                                 VkDeviceSize size,
+                                 struct _MemoryBlock **block)
+{
+	VkMemoryPropertyFlags flags =
+		allocator->memory_properties.memoryTypes[memory_type].propertyFlags;
+	struct _MemoryRange *range;
+	VkResult success;
+
+	*block = calloc(1, sizeof(struct _MemoryBlock));
+	range = malloc(sizeof(struct _MemoryRange));
+	if (*block == NULL || range == NULL)
+	{
+		free(*block);
+		free(range);
+		*block = NULL;
+		return ENGINE_ERROR_OUT_OF_MEMORY;
+	}
+
+	(*block)->size = size;
+	(*block)->mapped = NULL;
+	(*block)->memory_type = memory_type;
+	(*block)->allocation_count = 0;
+
+	VkMemoryAllocateInfo alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = size,
+		.memoryTypeIndex = memory_type
+	};
+
+	success = vkAllocateMemory(allocator->device,
+	                           &alloc_info,
+	                           NULL,
+	                           &(*block)->memory);
+	if (success != VK_SUCCESS)
+	{
+		free(*block);
+		free(range);
+		*block = NULL;
+		return ENGINE_ERROR_OUT_OF_MEMORY;
+	}
+
+	/* Host visible blocks stay mapped for their whole lifetime. */
+	if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		success = vkMapMemory(allocator->device,
+		                      (*block)->memory,
+		                      0,
+		                      VK_WHOLE_SIZE,
+		                      0,
+		                      &(*block)->mapped);
+		if (success != VK_SUCCESS)
+		{
+			vkFreeMemory(allocator->device, (*block)->memory, NULL);
+			free(*block);
+			free(range);
+			*block = NULL;
+			return ENGINE_ERROR_OUT_OF_MEMORY;
+		}
+	}
+
+	range->offset = 0;
+	range->size = size;
+	range->free = 1;
+	range->linear = 0;
+	range->prev = NULL;
+	range->next = NULL;
+
+	(*block)->ranges = range;
+	free_list_insert(*block, range);
+
+	(*block)->next = allocator->blocks[memory_type];
+	allocator->blocks[memory_type] = *block;
+
+	allocator->stats.block_count++;
+	allocator->stats.reserved_bytes += size;
+
+	return ENGINE_OK;
+}
+
+static void block_destroy(MemoryAllocator *allocator, struct _MemoryBlock *block)
+{
+	struct _MemoryRange *range = block->ranges;
+
+	while (range != NULL)
+	{
+		struct _MemoryRange *next = range->next;
+		free(range);
+		range = next;
+	}
+
+	if (block->mapped != NULL)
+	{
+		vkUnmapMemory(allocator->device, block->memory);
+	}
+
+	vkFreeMemory(allocator->device, block->memory, NULL);
+
+	allocator->stats.block_count--;
+	allocator->stats.reserved_bytes -= block->size;
+
+	free(block);
+}
+
+static ENGINE_ERROR allocate_dedicated(MemoryAllocator *allocator,
+                                       uint32_t memory_type,
+                                       VkDeviceSize size,
+                                       MemoryAllocation *allocation)
+{
+	VkMemoryPropertyFlags flags =
+		allocator->memory_properties.memoryTypes[memory_type].propertyFlags;
+	VkResult success;
+
+	VkMemoryAllocateInfo alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = size,
+		.memoryTypeIndex = memory_type
+	};
+
+	success = vkAllocateMemory(allocator->device,
+	                           &alloc_info,
+	                           NULL,
+	                           &allocation->memory);
+	if (success != VK_SUCCESS)
+	{
+		return ENGINE_ERROR_OUT_OF_MEMORY;
+	}
+
+	allocation->offset = 0;
+	allocation->size = size;
+	allocation->mapped = NULL;
+	allocation->block = NULL;
+	allocation->range = NULL;
+
+	if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		success = vkMapMemory(allocator->device,
+		                      allocation->memory,
+		                      0,
+		                      VK_WHOLE_SIZE,
+		                      0,
+		                      &allocation->mapped);
+		if (success != VK_SUCCESS)
+		{
+			vkFreeMemory(allocator->device, allocation->memory, NULL);
+			memset(allocation, 0, sizeof(MemoryAllocation));
+			return ENGINE_ERROR_OUT_OF_MEMORY;
+		}
+	}
+
+	allocator->stats.dedicated_count++;
+	allocator->stats.reserved_bytes += size;
+
+	return ENGINE_OK;
+}
+
+/******************************************************************************
+ * @name       allocate_from_type()
+ * @brief      Allocates from the smallest free range found by find_range()
+ *             in a memory type's blocks, creating a new block if none fit.
+ * @param[in]  allocator    The allocator to allocate from.
+ * @param      memory_type  The memory type to allocate from.
+ * @param[in]  requirements The size and alignment of the allocation.
+ * @param      linear       Whether the allocation is for a linear resource.
+ * @param[out] allocation   Set to the allocated range.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR allocate_from_type(MemoryAllocator *allocator,
+                                       uint32_t memory_type,
+                                       const VkMemoryRequirements *requirements,
+                                       uint8_t linear,
+                                       MemoryAllocation *allocation)
+{
+	struct _MemoryBlock *best_block = NULL;
+	struct _MemoryRange *best_range = NULL;
+	VkDeviceSize best_offset = 0;
+	VkDeviceSize offset;
+	uint8_t created = 0;
+	ENGINE_ERROR error;
+
+	/* Large allocations would leave most of a block unusable. */
+	if (requirements->size > allocator->block_sizes[memory_type] / 2)
+	{
+		if (at_allocation_limit(allocator))
+		{
+			return ENGINE_ERROR_OUT_OF_MEMORY;
+		}
+
+		return allocate_dedicated(allocator,
+		                          memory_type,
+		                          requirements->size,
+		                          allocation);
+	}
+
+	for (struct _MemoryBlock *block = allocator->blocks[memory_type];
+	     block != NULL;
+	     block = block->next)
+	{
+		struct _MemoryRange *range = find_range(allocator,
+		                                        block,
+		                                        requirements->size,
+		                                        requirements->alignment,
+		                                        linear,
+		                                        &offset);
+
+		if (range != NULL && (best_range == NULL || range->size < best_range->size))
+		{
+			best_block = block;
+			best_range = range;
+			best_offset = offset;
+		}
+	}
+
+	if (best_range == NULL)
+	{
+		if (at_allocation_limit(allocator))
+		{
+			return ENGINE_ERROR_OUT_OF_MEMORY;
+		}
+
+		error = block_create(allocator,
+		                     memory_type,
+		                     allocator->block_sizes[memory_type],
+		                     &best_block);
+		ENGINE_RETURN_IF_ERROR(error);
+
+		best_range = best_block->ranges;
+		best_offset = 0;
+		created = 1;
+	}
+
+	error = take_range(best_block, best_range, best_offset, requirements->size, linear);
+	if (error != ENGINE_OK)
+	{
+		if (created)
+		{
+			allocator->blocks[memory_type] = best_block->next;
+			block_destroy(allocator, best_block);
+		}
+		return error;
+	}
+	best_block->allocation_count++;
+
+	allocation->memory = best_block->memory;
+	allocation->offset = best_offset;
+	allocation->size = requirements->size;
+	allocation->mapped = best_block->mapped != NULL
+	                     ? (char*)best_block->mapped + best_offset
+	                     : NULL;
+	allocation->block = best_block;
+	allocation->range = best_range;
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR memory_allocator_create(MemoryAllocator **allocator,
+                                     VkPhysicalDevice physical_device,
+                                     VkDevice device)
+{
+	VkPhysicalDeviceProperties properties;
+
+	*allocator = malloc(sizeof(MemoryAllocator));
+	if (*allocator == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate memory allocator");
+	}
+	memset(*allocator, 0, sizeof(MemoryAllocator));
+
+	(*allocator)->device = device;
+	vkGetPhysicalDeviceMemoryProperties(physical_device,
+	                                    &(*allocator)->memory_properties);
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+	(*allocator)->buffer_image_granularity =
+		properties.limits.bufferImageGranularity;
+	(*allocator)->max_allocation_count =
+		properties.limits.maxMemoryAllocationCount;
+
+	for (uint32_t i = 0; i < (*allocator)->memory_properties.memoryTypeCount; i++)
+	{
+		uint32_t heap = (*allocator)->memory_properties.memoryTypes[i].heapIndex;
+		VkDeviceSize heap_size =
+			(*allocator)->memory_properties.memoryHeaps[heap].size;
+
+		(*allocator)->block_sizes[i] = heap_size <= MEMORY_SMALL_HEAP_SIZE
+		                               ? align_up(heap_size / 8, 4096)
+		                               : MEMORY_BLOCK_SIZE;
+	}
+
+	if (pthread_mutex_init(&(*allocator)->lock, NULL) != 0)
+	{
+		free(*allocator);
+		*allocator = NULL;
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_INIT_FAILED,
+		                           "Failed to create allocator lock");
+	}
+
+	return ENGINE_OK;
+}
+
+void memory_allocator_destroy(MemoryAllocator *allocator)
+{
+	if (allocator->stats.allocation_count > 0)
+	{
+		LOG_WARNING("%u device memory allocations were never freed",
+		            allocator->stats.allocation_count);
+	}
+
+	for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++)
+	{
+		struct _MemoryBlock *block = allocator->blocks[i];
+
+		while (block != NULL)
+		{
+			struct _MemoryBlock *next = block->next;
+			block_destroy(allocator, block);
+			block = next;
+		}
+	}
+
+	pthread_mutex_destroy(&allocator->lock);
+	free(allocator);
+}
+
+ENGINE_ERROR memory_allocate(MemoryAllocator *restrict allocator,
+                             const VkMemoryRequirements *restrict requirements,
+                             VkMemoryPropertyFlags properties,
+                             uint8_t linear,
+                             MemoryAllocation *restrict allocation)
+{
+	const VkPhysicalDeviceMemoryProperties *memory_properties =
+		&allocator->memory_properties;
+	ENGINE_ERROR error = ENGINE_ERROR_OUT_OF_MEMORY;
+
+	memset(allocation, 0, sizeof(MemoryAllocation));
+
+	pthread_mutex_lock(&allocator->lock);
+
+	/* Fall back to the next suitable type if a heap is exhausted. */
+	for (uint32_t i = 0; i < memory_properties->memoryTypeCount; i++)
+	{
+		if (!(requirements->memoryTypeBits & (1 << i))
+		    || (memory_properties->memoryTypes[i].propertyFlags & properties)
+		       != properties)
+		{
+			continue;
+		}
+
+		error = allocate_from_type(allocator, i, requirements, linear, allocation);
+		if (error == ENGINE_OK)
+		{
+			allocator->stats.allocation_count++;
+			allocator->stats.used_bytes += allocation->size;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&allocator->lock);
+
+	ENGINE_LOG_RETURN_IF_ERROR(error, "Failed to allocate device memory");
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR memory_allocate_buffer(MemoryAllocator *restrict allocator,
+                                    VkBuffer buffer,
+                                    VkMemoryPropertyFlags properties,
+                                    MemoryAllocation *restrict allocation)
+{
+	VkMemoryRequirements requirements;
+	ENGINE_ERROR error;
+
+	vkGetBufferMemoryRequirements(allocator->device, buffer, &requirements);
+
+	error = memory_allocate(allocator, &requirements, properties, 1, allocation);
+	ENGINE_RETURN_IF_ERROR(error);
+
+	if (vkBindBufferMemory(allocator->device,
+	                       buffer,
+	                       allocation->memory,
+	                       allocation->offset) != VK_SUCCESS)
+	{
+		memory_free(allocator, allocation);
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to bind buffer memory");
+	}
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR memory_allocate_image(MemoryAllocator *restrict allocator,
+                                   VkImage image,
+                                   VkMemoryPropertyFlags properties,
+                                   MemoryAllocation *restrict allocation)
+{
+	VkMemoryRequirements requirements;
+	ENGINE_ERROR error;
+
+	vkGetImageMemoryRequirements(allocator->device, image, &requirements);
+
+	error = memory_allocate(allocator, &requirements, properties, 0, allocation);
+	ENGINE_RETURN_IF_ERROR(error);
+
+	if (vkBindImageMemory(allocator->device,
+	                      image,
+	                      allocation->memory,
+	                      allocation->offset) != VK_SUCCESS)
+	{
+		memory_free(allocator, allocation);
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to bind image memory");
+	}
+
+	return ENGINE_OK;
+}
+
+void memory_free(MemoryAllocator *restrict allocator,
+                 MemoryAllocation *restrict allocation)
+{
+	struct _MemoryBlock *block = allocation->block;
+	uint8_t keep_block = 1;
+
+	if (allocation->memory == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&allocator->lock);
+
+	allocator->stats.allocation_count--;
+	allocator->stats.used_bytes -= allocation->size;
+
+	if (block == NULL)
+	{
+		vkFreeMemory(allocator->device, allocation->memory, NULL);
+		allocator->stats.dedicated_count--;
+		allocator->stats.reserved_bytes -= allocation->size;
+	}
+	else
+	{
+		release_range(block, allocation->range);
+		block->allocation_count--;
+
+		/* Keep one empty block per type around to avoid churn. */
+		if (block->allocation_count == 0)
+		{
+			struct _MemoryBlock **link = &allocator->blocks[block->memory_type];
+
+			for (struct _MemoryBlock *other = *link; other != NULL; other = other->next)
+			{
+				if (other != block && other->allocation_count == 0)
+				{
+					keep_block = 0;
+				}
+			}
+
+			if (!keep_block)
+			{
+				while (*link != block)
+				{
+					link = &(*link)->next;
+				}
+				*link = block->next;
+
+				block_destroy(allocator, block);
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&allocator->lock);
+
+	memset(allocation, 0, sizeof(MemoryAllocation));
+}
+
+void memory_allocator_get_stats(MemoryAllocator *restrict allocator,
+                                MemoryStats *restrict stats)
+{
+	pthread_mutex_lock(&allocator->lock);
+	*stats = allocator->stats;
+	pthread_mutex_unlock(&allocator->lock);
+}
@@ -0,0 +1,159 @@
+#ifndef _MEMORY_H_
+#define _MEMORY_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "core/debug.h"
+
+/* Heaps larger than this are split into blocks of MEMORY_BLOCK_SIZE. */
+#define MEMORY_SMALL_HEAP_SIZE (1024ull * 1024 * 1024)
+#define MEMORY_BLOCK_SIZE      (64ull * 1024 * 1024)
+
+struct _MemoryBlock;
+struct _MemoryRange;
+
+/******************************************************************************
+ * @name  _MemoryAllocation
+ * @brief A sub-range of a memory block handed out by a MemoryAllocator. A
+ *        zeroed allocation holds no memory and may be freed safely.
+******************************************************************************/
+struct _MemoryAllocation
+{
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	void *mapped; /*< Host address of offset, NULL unless host visible. */
+
+	struct _MemoryBlock *block; /*< NULL for dedicated allocations. */
+	struct _MemoryRange *range;
+};
+typedef struct _MemoryAllocation MemoryAllocation;
+
+/******************************************************************************
+ * @name  _MemoryStats
+ * @brief Totals across every memory type of an allocator.
+******************************************************************************/
+struct _MemoryStats
+{
+	uint32_t block_count;
+	uint32_t dedicated_count;
+	uint32_t allocation_count;
+	VkDeviceSize reserved_bytes; /*< Bytes held in VkDeviceMemory objects. */
+	VkDeviceSize used_bytes;     /*< Bytes handed out to allocations. */
+};
+typedef struct _MemoryStats MemoryStats;
+
+/******************************************************************************
+ * @name  _MemoryAllocator
+ * @brief Sub-allocates buffers and images from large blocks of device memory,
+ *        one list of blocks per memory type, so the number of live
+ *        vkAllocateMemory calls stays small. Allocations too large to share a
+ *        block get dedicated memory.
+******************************************************************************/
+struct _MemoryAllocator
+{
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	VkDeviceSize buffer_image_granularity;
+	uint32_t max_allocation_count;
+
+	VkDeviceSize block_sizes[VK_MAX_MEMORY_TYPES];
+	struct _MemoryBlock *blocks[VK_MAX_MEMORY_TYPES];
+
+	MemoryStats stats;
+	pthread_mutex_t lock;
+};
+typedef struct _MemoryAllocator MemoryAllocator;
+
+/******************************************************************************
+ * @name       memory_allocator_create()
+ * @brief      Creates an allocator for a logical device. No memory is
+ *             allocated until the first request.
+ * @param[out] allocator       A pointer to a pointer set to the created allocator.
+ * @param      physical_device The physical device to query memory types from.
+ * @param      device          The logical device memory is allocated on.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR memory_allocator_create(MemoryAllocator **allocator,
+                                     VkPhysicalDevice physical_device,
+                                     VkDevice device);
+
+/******************************************************************************
+ * @name      memory_allocator_destroy()
+ * @brief     Frees every block owned by the allocator. Allocations still alive
+ *            are reported as leaks.
+ * @param[in] allocator The allocator to destroy.
+ * @return    void
+******************************************************************************/
+void memory_allocator_destroy(MemoryAllocator *allocator);
+
+/******************************************************************************
+ * @name       memory_allocate()
+ * @brief      Allocates memory satisfying a set of requirements.
+ * @param[in]  allocator    The allocator to allocate from.
+ * @param[in]  requirements The size, alignment and memory types allowed.
+ * @param      properties   The properties the memory type must have.
+ * @param      linear       1 for buffers and linear images, 0 for optimal
+ *                          images. Used to respect bufferImageGranularity.
+ * @param[out] allocation   Set to the allocated range.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR memory_allocate(MemoryAllocator *restrict allocator,
+                             const VkMemoryRequirements *restrict requirements,
+                             VkMemoryPropertyFlags properties,
+                             uint8_t linear,
+                             MemoryAllocation *restrict allocation);
+
+/******************************************************************************
+ * @name       memory_allocate_buffer()
+ * @brief      Allocates memory for a buffer and binds it.
+ * @param[in]  allocator  The allocator to allocate from.
+ * @param      buffer     The buffer to bind.
+ * @param      properties The properties the memory type must have.
+ * @param[out] allocation Set to the allocated range.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR memory_allocate_buffer(MemoryAllocator *restrict allocator,
+                                    VkBuffer buffer,
+                                    VkMemoryPropertyFlags properties,
+                                    MemoryAllocation *restrict allocation);
+
+/******************************************************************************
+ * @name       memory_allocate_image()
+ * @brief      Allocates memory for an optimally tiled image and binds it.
+ * @param[in]  allocator  The allocator to allocate from.
+ * @param      image      The image to bind.
+ * @param      properties The properties the memory type must have.
+ * @param[out] allocation Set to the allocated range.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR memory_allocate_image(MemoryAllocator *restrict allocator,
+                                   VkImage image,
+                                   VkMemoryPropertyFlags properties,
+                                   MemoryAllocation *restrict allocation);
+
+/******************************************************************************
+ * @name         memory_free()
+ * @brief        Returns an allocation to its block and zeroes it.
+ * @param[in]    allocator  The allocator the allocation came from.
+ * @param[inout] allocation The allocation to free.
+ * @return       void
+******************************************************************************/
+void memory_free(MemoryAllocator *restrict allocator,
+                 MemoryAllocation *restrict allocation);
+
+/******************************************************************************
+ * @name       memory_allocator_get_stats()
+ * @brief      Reads the current totals of an allocator.
+ * @param[in]  allocator The allocator to query.
+ * @param[out] stats     Set to the allocator's totals.
+ * @return     void
+******************************************************************************/
+void memory_allocator_get_stats(MemoryAllocator *restrict allocator,
+                                MemoryStats *restrict stats);
+
+#endif /* _MEMORY_H_ */
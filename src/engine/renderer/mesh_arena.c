@@ -0,0 +1,178 @@
+#include "mesh_arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/logger.h"
+
+ENGINE_ERROR mesh_arena_create(MeshArena **arena,
+                               Device *device,
+                               VkDeviceSize size,
+                               VkMemoryPropertyFlags properties)
+{
+	*arena = calloc(1, sizeof(MeshArena));
+	if (*arena == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate mesh arena");
+	}
+
+	(*arena)->free_ranges = malloc(MESH_ARENA_MIN_CAPACITY * sizeof(MeshArenaRange));
+	if ((*arena)->free_ranges == NULL)
+	{
+		free(*arena);
+		*arena = NULL;
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate mesh arena ranges");
+	}
+
+	(*arena)->buffer = vertex_buffer_create(device, size, properties);
+	if ((*arena)->buffer == NULL)
+	{
+		free((*arena)->free_ranges);
+		free(*arena);
+		*arena = NULL;
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to create mesh arena buffer");
+	}
+
+	(*arena)->size = size;
+	(*arena)->free_capacity = MESH_ARENA_MIN_CAPACITY;
+	(*arena)->free_ranges[0] = (MeshArenaRange){0, size};
+	(*arena)->free_count = 1;
+
+	return ENGINE_OK;
+}
+
+void mesh_arena_destroy(MeshArena *arena, Device *device)
+{
+	if (arena->allocation_count > 0)
+	{
+		LOG_WARNING("Destroying mesh arena with %u ranges in use",
+		            arena->allocation_count);
+	}
+
+	vertex_buffer_destroy(arena->buffer, device);
+	free(arena->free_ranges);
+	free(arena);
+}
+
+ENGINE_ERROR mesh_arena_allocate(MeshArena *restrict arena,
+                                 VkDeviceSize size,
+                                 MeshArenaRange *restrict range)
+{
+	size = (size + MESH_ARENA_ALIGNMENT - 1) & ~(VkDeviceSize)(MESH_ARENA_ALIGNMENT - 1);
+
+	/* Every allocation can leave a free range either side of it. */
+	if (arena->allocation_count + 2 > arena->free_capacity)
+	{
+		uint32_t capacity = arena->free_capacity * 2;
+		MeshArenaRange *ranges = realloc(arena->free_ranges,
+		                                 capacity * sizeof(MeshArenaRange));
+
+		if (ranges == NULL)
+		{
+			ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+			                           "Failed to grow mesh arena ranges");
+		}
+
+		arena->free_ranges = ranges;
+		arena->free_capacity = capacity;
+	}
+
+	for (uint32_t i = 0; i < arena->free_count; i++)
+	{
+		MeshArenaRange *free_range = &arena->free_ranges[i];
+
+		if (free_range->size < size)
+		{
+			continue;
+		}
+
+		range->offset = free_range->offset;
+		range->size = size;
+
+		free_range->offset += size;
+		free_range->size -= size;
+		if (free_range->size == 0)
+		{
+			memmove(free_range,
+			        free_range + 1,
+			        (arena->free_count - i - 1) * sizeof(MeshArenaRange));
+			arena->free_count--;
+		}
+
+		arena->used += size;
+		arena->allocation_count++;
+		return ENGINE_OK;
+	}
+
+	return ENGINE_ERROR_OUT_OF_MEMORY;
+}
+
+void mesh_arena_free(MeshArena *restrict arena, const MeshArenaRange *restrict range)
+{
+	uint32_t low = 0;
+	uint32_t high = arena->free_count;
+	uint8_t merged = 0;
+
+	/* Find the first free range after the one being freed. */
+	while (low < high)
+	{
+		uint32_t middle = (low + high) / 2;
+
+		if (arena->free_ranges[middle].offset < range->offset)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	arena->used -= range->size;
+	arena->allocation_count--;
+
+	if (low > 0)
+	{
+		MeshArenaRange *previous = &arena->free_ranges[low - 1];
+
+		if (previous->offset + previous->size == range->offset)
+		{
+			previous->size += range->size;
+			merged = 1;
+		}
+	}
+
+	if (low < arena->free_count
+	    && range->offset + range->size == arena->free_ranges[low].offset)
+	{
+		if (merged)
+		{
+			/* The range joined its neighbours into one. */
+			arena->free_ranges[low - 1].size += arena->free_ranges[low].size;
+			memmove(&arena->free_ranges[low],
+			        &arena->free_ranges[low + 1],
+			        (arena->free_count - low - 1) * sizeof(MeshArenaRange));
+			arena->free_count--;
+		}
+		else
+		{
+			arena->free_ranges[low].offset = range->offset;
+			arena->free_ranges[low].size += range->size;
+		}
+		return;
+	}
+
+	if (merged)
+	{
+		return;
+	}
+
+	memmove(&arena->free_ranges[low + 1],
+	        &arena->free_ranges[low],
+	        (arena->free_count - low) * sizeof(MeshArenaRange));
+	arena->free_ranges[low] = *range;
+	arena->free_count++;
+}
@@ -0,0 +1,99 @@
+#ifndef _MESH_ARENA_H_
+#define _MESH_ARENA_H_
+
+#include <stdint.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "core/debug.h"
+
+#include "devices.h"
+#include "buffer.h"
+
+#define MESH_ARENA_ALIGNMENT    16 /* Of every range, a multiple of the vertex
+                                      and index sizes. */
+#define MESH_ARENA_MIN_CAPACITY 64
+
+/******************************************************************************
+ * @name  _MeshArenaRange
+ * @brief A range of bytes in a mesh arena's buffer.
+******************************************************************************/
+struct _MeshArenaRange
+{
+	VkDeviceSize offset;
+	VkDeviceSize size;
+};
+typedef struct _MeshArenaRange MeshArenaRange;
+
+/******************************************************************************
+ * @name  _MeshArena
+ * @brief One buffer every chunk mesh's vertices and indices are allocated
+ *        from, so all of them can be drawn without binding another buffer
+ *        and by a single indirect call. Ranges are handed out first fit from
+ *        a list of free ranges, which are merged with their neighbours when
+ *        freed.
+******************************************************************************/
+struct _MeshArena
+{
+	VertexBuffer *buffer;
+	VkDeviceSize size;
+	VkDeviceSize used; /*< Bytes handed out. */
+
+	MeshArenaRange *free_ranges; /*< Sorted by offset, never touching. */
+	uint32_t free_count;
+	uint32_t free_capacity;      /*< Always more than allocation_count, so
+	                                 freeing never has to grow the list. */
+	uint32_t allocation_count;
+};
+typedef struct _MeshArena MeshArena;
+
+/******************************************************************************
+ * @name       mesh_arena_create()
+ * @brief      Creates an arena and its buffer.
+ * @param[out] arena      A pointer to a pointer set to the created arena.
+ * @param[in]  device     The device the buffer is allocated on.
+ * @param      size       The size of the buffer in bytes.
+ * @param      properties The properties of the buffer's memory.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR mesh_arena_create(MeshArena **arena,
+                               Device *device,
+                               VkDeviceSize size,
+                               VkMemoryPropertyFlags properties);
+
+/******************************************************************************
+ * @name      mesh_arena_destroy()
+ * @brief     Destroys an arena and its buffer. The device must no longer be
+ *            reading from it.
+ * @param[in] arena  The arena to destroy.
+ * @param[in] device The device the buffer was allocated on.
+ * @return    void
+******************************************************************************/
+void mesh_arena_destroy(MeshArena *arena, Device *device);
+
+/******************************************************************************
+ * @name       mesh_arena_allocate()
+ * @brief      Allocates a range of the arena's buffer.
+ * @param[in]  arena The arena to allocate from.
+ * @param      size  The number of bytes needed.
+ * @param[out] range Set to the allocated range, its size rounded up to
+ *                   MESH_ARENA_ALIGNMENT.
+ * @return     An ENGINE_ERROR value. ENGINE_ERROR_OUT_OF_MEMORY if no free
+ *             range is large enough.
+******************************************************************************/
+ENGINE_ERROR mesh_arena_allocate(MeshArena *restrict arena,
+                                 VkDeviceSize size,
+                                 MeshArenaRange *restrict range);
+
+/******************************************************************************
+ * @name      mesh_arena_free()
+ * @brief     Returns a range to the arena. The device must no longer be
+ *            reading from it.
+ * @param[in] arena The arena the range was allocated from.
+ * @param[in] range The range to free.
+ * @return    void
+******************************************************************************/
+void mesh_arena_free(MeshArena *restrict arena, const MeshArenaRange *restrict range);
+
+#endif /* _MESH_ARENA_H_ */
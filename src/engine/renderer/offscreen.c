@@ -0,0 +1,307 @@
+#include "offscreen.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/logger.h"
+
+/******************************************************************************
+ * @name       create_image()
+ * @brief      Creates an image usable as a colour attachment and binds it to
+ *             device local memory.
+ * @param[in]  device The device the image belongs to.
+ * @param[in]  target The target describing the image format and extent.
+ * @param      index  The index of the image within the target.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR create_image(const Device *restrict device,
+                                 OffscreenTarget *restrict target,
+                                 uint32_t index)
+{
+	ENGINE_ERROR error;
+	VkResult success;
+
+	VkImageCreateInfo image_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = target->format,
+		.extent = {target->extent.width, target->extent.height, 1},
+		.mipLevels = 1,
+		.arrayLayers = 1,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+		         | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+	};
+
+	success = vkCreateImage(device->logical_device,
+	                        &image_info,
+	                        NULL,
+	                        &target->images[index]);
+	if (success != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to create offscreen image");
+	}
+
+	error = memory_allocate_image(device->allocator,
+	                              target->images[index],
+	                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	                              &target->image_memory[index]);
+	ENGINE_LOG_RETURN_IF_ERROR(error, "Failed to allocate memory for offscreen image");
+
+	VkImageViewCreateInfo image_view_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+		.image = target->images[index],
+		.viewType = VK_IMAGE_VIEW_TYPE_2D,
+		.format = target->format,
+		.components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+		.components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
+		.components.b = VK_COMPONENT_SWIZZLE_IDENTITY,
+		.components.a = VK_COMPONENT_SWIZZLE_IDENTITY,
+		.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+		.subresourceRange.baseMipLevel = 0,
+		.subresourceRange.levelCount = 1,
+		.subresourceRange.baseArrayLayer = 0,
+		.subresourceRange.layerCount = 1
+	};
+
+	success = vkCreateImageView(device->logical_device,
+	                            &image_view_info,
+	                            NULL,
+	                            &target->image_views[index]);
+	if (success != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_INIT_FAILED,
+		                           "Failed to create an offscreen image view");
+	}
+
+	return ENGINE_OK;
+}
+
+/******************************************************************************
+ * @name       create_readback_buffer()
+ * @brief      Creates a host visible buffer large enough to hold one image.
+ * @param[in]  device The device the buffer belongs to.
+ * @param[in]  target The target the buffer is created for.
+ * @param      index  The index of the image the buffer will hold.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR create_readback_buffer(const Device *restrict device,
+                                           OffscreenTarget *restrict target,
+                                           uint32_t index)
+{
+	ENGINE_ERROR error;
+	VkResult success;
+
+	VkBufferCreateInfo buffer_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = target->readback_size,
+		.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+	};
+
+	success = vkCreateBuffer(device->logical_device,
+	                         &buffer_info,
+	                         NULL,
+	                         &target->readback_buffers[index]);
+	if (success != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to create readback buffer");
+	}
+
+	error = memory_allocate_buffer(device->allocator,
+	                               target->readback_buffers[index],
+	                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+	                               | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	                               &target->readback_memory[index]);
+	ENGINE_LOG_RETURN_IF_ERROR(error, "Failed to allocate memory for readback buffer");
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR offscreen_target_create(OffscreenTarget **target,
+                                     const Device *restrict device,
+                                     VkExtent2D extent,
+                                     uint32_t image_count,
+                                     uint8_t readback)
+{
+	ENGINE_ERROR error = ENGINE_OK;
+
+	*target = malloc(sizeof(OffscreenTarget));
+	(*target)->images = calloc(image_count, sizeof(VkImage));
+	(*target)->image_memory = calloc(image_count, sizeof(MemoryAllocation));
+	(*target)->image_views = calloc(image_count, sizeof(VkImageView));
+	(*target)->image_count = image_count;
+	(*target)->format = OFFSCREEN_FORMAT;
+	(*target)->extent = extent;
+	(*target)->readback_buffers = NULL;
+	(*target)->readback_memory = NULL;
+	(*target)->readback_commands = NULL;
+	(*target)->readback_size = (VkDeviceSize)extent.width * extent.height * 4;
+
+	if (readback)
+	{
+		(*target)->readback_buffers = calloc(image_count, sizeof(VkBuffer));
+		(*target)->readback_memory = calloc(image_count, sizeof(MemoryAllocation));
+	}
+
+	for (uint32_t i = 0; i < image_count && error == ENGINE_OK; i++)
+	{
+		error = create_image(device, *target, i);
+
+		if (error == ENGINE_OK && readback)
+		{
+			error = create_readback_buffer(device, *target, i);
+		}
+	}
+
+	if (error != ENGINE_OK)
+	{
+		/* Anything that was not created is still a zeroed handle. */
+		offscreen_target_destroy(*target, device);
+		*target = NULL;
+		return error;
+	}
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR offscreen_target_record_readback(OffscreenTarget *restrict target,
+                                              const Device *restrict device,
+                                              const CommandPool *restrict pool)
+{
+	VkResult success;
+
+	if (target->readback_buffers == NULL)
+	{
+		return ENGINE_OK;
+	}
+
+	target->readback_commands = calloc(target->image_count, sizeof(VkCommandBuffer));
+
+	VkCommandBufferAllocateInfo alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = pool->handle,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = target->image_count
+	};
+
+	success = vkAllocateCommandBuffers(device->logical_device,
+	                                   &alloc_info,
+	                                   target->readback_commands);
+	if (success != VK_SUCCESS)
+	{
+		free(target->readback_commands);
+		target->readback_commands = NULL;
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate readback command buffers");
+	}
+
+	for (uint32_t i = 0; i < target->image_count; i++)
+	{
+		VkCommandBuffer commands = target->readback_commands[i];
+
+		VkCommandBufferBeginInfo begin_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = 0,
+			.pInheritanceInfo = NULL
+		};
+
+		vkBeginCommandBuffer(commands, &begin_info);
+
+		/* The render pass leaves the image in TRANSFER_SRC_OPTIMAL and its
+		 * external dependency already orders the copy after rendering. */
+		VkBufferImageCopy region = {
+			.bufferOffset = 0,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.imageSubresource.mipLevel = 0,
+			.imageSubresource.baseArrayLayer = 0,
+			.imageSubresource.layerCount = 1,
+			.imageOffset = {0, 0, 0},
+			.imageExtent = {target->extent.width, target->extent.height, 1}
+		};
+
+		vkCmdCopyImageToBuffer(commands,
+		                       target->images[i],
+		                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		                       target->readback_buffers[i],
+		                       1,
+		                       &region);
+
+		VkBufferMemoryBarrier host_barrier = {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.buffer = target->readback_buffers[i],
+			.offset = 0,
+			.size = VK_WHOLE_SIZE
+		};
+
+		vkCmdPipelineBarrier(commands,
+		                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+		                     VK_PIPELINE_STAGE_HOST_BIT,
+		                     0,
+		                     0, NULL,
+		                     1, &host_barrier,
+		                     0, NULL);
+
+		success = vkEndCommandBuffer(commands);
+		if (success != VK_SUCCESS)
+		{
+			ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+			                           "Failed to record readback command buffer");
+		}
+	}
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR offscreen_target_read(const OffscreenTarget *restrict target,
+                                   const Device *restrict device,
+                                   uint32_t image_index,
+                                   void *restrict pixels)
+{
+	if (target->readback_buffers == NULL || image_index >= target->image_count)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_INIT_FAILED,
+		                           "Offscreen target has no readback for image");
+	}
+
+	memcpy(pixels,
+	       target->readback_memory[image_index].mapped,
+	       target->readback_size);
+
+	return ENGINE_OK;
+}
+
+void offscreen_target_destroy(OffscreenTarget *target, const Device *device)
+{
+	for (uint32_t i = 0; i < target->image_count; i++)
+	{
+		vkDestroyImageView(device->logical_device, target->image_views[i], NULL);
+		vkDestroyImage(device->logical_device, target->images[i], NULL);
+		memory_free(device->allocator, &target->image_memory[i]);
+
+		if (target->readback_buffers != NULL)
+		{
+			vkDestroyBuffer(device->logical_device, target->readback_buffers[i], NULL);
+			memory_free(device->allocator, &target->readback_memory[i]);
+		}
+	}
+
+	free(target->readback_commands);
+	free(target->readback_buffers);
+	free(target->readback_memory);
+	free(target->image_views);
+	free(target->image_memory);
+	free(target->images);
+	free(target);
+}
@@ -0,0 +1,95 @@
+#ifndef _OFFSCREEN_H_
+#define _OFFSCREEN_H_
+
+#include <stdint.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "core/debug.h"
+
+#include "devices.h"
+#include "memory.h"
+#include "command_buffers.h"
+
+#define OFFSCREEN_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+
+/******************************************************************************
+ * @name  _OffscreenTarget
+ * @brief A set of device images rendered to in place of a swap chain when the
+ *        renderer runs without a window. Optionally each image has a host
+ *        visible buffer it is copied into after rendering so it can be read.
+******************************************************************************/
+struct _OffscreenTarget
+{
+	VkImage *images;
+	MemoryAllocation *image_memory;
+	VkImageView *image_views;
+	uint32_t image_count;
+
+	VkFormat format;
+	VkExtent2D extent;
+
+	/* Only set when readback is enabled. */
+	VkBuffer *readback_buffers;
+	MemoryAllocation *readback_memory;
+	VkCommandBuffer *readback_commands;
+	VkDeviceSize readback_size;
+};
+typedef struct _OffscreenTarget OffscreenTarget;
+
+/******************************************************************************
+ * @name       offscreen_target_create()
+ * @brief      Creates a set of offscreen colour images.
+ * @param[out] target      A pointer to a pointer set to the created target.
+ * @param[in]  device      The device the images are allocated on.
+ * @param      extent      The size of each image.
+ * @param      image_count The number of images to rotate between.
+ * @param      readback    If set a host visible buffer is created per image.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR offscreen_target_create(OffscreenTarget **target,
+                                     const Device *restrict device,
+                                     VkExtent2D extent,
+                                     uint32_t image_count,
+                                     uint8_t readback);
+
+/******************************************************************************
+ * @name      offscreen_target_record_readback()
+ * @brief     Records a command buffer per image that copies the image into its
+ *            readback buffer. Does nothing if readback is disabled.
+ * @param[in] target The target to record the copies for.
+ * @param[in] device The device the target belongs to.
+ * @param[in] pool   The pool to allocate the command buffers from.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR offscreen_target_record_readback(OffscreenTarget *restrict target,
+                                              const Device *restrict device,
+                                              const CommandPool *restrict pool);
+
+/******************************************************************************
+ * @name       offscreen_target_read()
+ * @brief      Copies the contents of an image's readback buffer. The caller
+ *             must make sure the frame that rendered the image has finished.
+ * @param[in]  target      The target to read from.
+ * @param[in]  device      The device the target belongs to.
+ * @param      image_index The image to read.
+ * @param[out] pixels      Memory of at least readback_size bytes.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR offscreen_target_read(const OffscreenTarget *restrict target,
+                                   const Device *restrict device,
+                                   uint32_t image_index,
+                                   void *restrict pixels);
+
+/******************************************************************************
+ * @name      offscreen_target_destroy()
+ * @brief     Destroys an offscreen target. The readback command buffers are
+ *            freed along with the pool they were allocated from.
+ * @param[in] target The target to destroy.
+ * @param[in] device The device the target belongs to.
+ * @return    void
+******************************************************************************/
+void offscreen_target_destroy(OffscreenTarget *target, const Device *device);
+
+#endif /* _OFFSCREEN_H_ */
@@ -0,0 +1,210 @@
+#include "pipeline_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/logger.h"
+
+#define PIPELINE_CACHE_MAGIC 0x43505243 /* "CRPC" */
+
+/******************************************************************************
+ * @name  PipelineCacheFileHeader
+ * @brief Written before the cache data. The driver version is not part of the
+ *        Vulkan cache header, and the size catches truncated files.
+******************************************************************************/
+struct PipelineCacheFileHeader
+{
+	uint32_t magic;
+	uint32_t driver_version;
+	uint64_t data_size;
+};
+
+/* The header every VkPipelineCache blob starts with. */
+#define VULKAN_CACHE_HEADER_SIZE (16 + VK_UUID_SIZE)
+
+/******************************************************************************
+ * @name      cache_data_valid()
+ * @brief     Checks cache data was produced by the same device and driver.
+ * @param[in] device The device the cache will be used on.
+ * @param[in] header The engine header read from the file.
+ * @param[in] data   The Vulkan cache data that followed the header.
+ * @return    1 if the data can be given to the driver, else 0.
+******************************************************************************/
+static uint8_t cache_data_valid(const Device *device,
+                                const struct PipelineCacheFileHeader *header,
+                                const uint8_t *data)
+{
+	uint32_t header_size, header_version, vendor_id, device_id;
+
+	if (header->magic != PIPELINE_CACHE_MAGIC
+	    || header->driver_version != device->properties.driverVersion
+	    || header->data_size < VULKAN_CACHE_HEADER_SIZE)
+	{
+		return 0;
+	}
+
+	memcpy(&header_size, data, sizeof(uint32_t));
+	memcpy(&header_version, data + 4, sizeof(uint32_t));
+	memcpy(&vendor_id, data + 8, sizeof(uint32_t));
+	memcpy(&device_id, data + 12, sizeof(uint32_t));
+
+	return header_size >= VULKAN_CACHE_HEADER_SIZE
+	       && header_size <= header->data_size
+	       && header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+	       && vendor_id == device->properties.vendorID
+	       && device_id == device->properties.deviceID
+	       && memcmp(data + 16,
+	                 device->properties.pipelineCacheUUID,
+	                 VK_UUID_SIZE) == 0;
+}
+
+/******************************************************************************
+ * @name       read_cache_file()
+ * @brief      Reads the cache data from a file if it is valid for a device.
+ * @param[in]  device The device the cache will be used on.
+ * @param[in]  path   The file to read.
+ * @param[out] size   Set to the size of the returned data.
+ * @return     A heap allocated copy of the data, or NULL.
+******************************************************************************/
+static uint8_t *read_cache_file(const Device *device, const char *path, size_t *size)
+{
+	struct PipelineCacheFileHeader header;
+	uint8_t *data = NULL;
+	FILE *fp = fopen(path, "rb");
+
+	*size = 0;
+
+	if (fp == NULL)
+	{
+		return NULL;
+	}
+
+	if (fread(&header, sizeof(header), 1, fp) == 1
+	    && header.magic == PIPELINE_CACHE_MAGIC
+	    && header.data_size >= VULKAN_CACHE_HEADER_SIZE)
+	{
+		data = malloc(header.data_size);
+
+		if (data == NULL
+		    || fread(data, 1, header.data_size, fp) != header.data_size
+		    || !cache_data_valid(device, &header, data))
+		{
+			free(data);
+			data = NULL;
+		}
+		else
+		{
+			*size = header.data_size;
+		}
+	}
+
+	fclose(fp);
+
+	if (data == NULL)
+	{
+		LOG_INFO("Discarding pipeline cache %s, it does not match this device", path);
+	}
+
+	return data;
+}
+
+ENGINE_ERROR pipeline_cache_load(Device *restrict device,
+                                 const char *restrict path)
+{
+	size_t size;
+	uint8_t *data = read_cache_file(device, path, &size);
+	VkResult success;
+
+	VkPipelineCacheCreateInfo cache_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.initialDataSize = size,
+		.pInitialData = data
+	};
+
+	success = vkCreatePipelineCache(device->logical_device,
+	                                &cache_info,
+	                                NULL,
+	                                &device->pipeline_cache);
+	free(data);
+
+	if (success != VK_SUCCESS)
+	{
+		device->pipeline_cache = VK_NULL_HANDLE;
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to create pipeline cache");
+	}
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR pipeline_cache_save(const Device *restrict device,
+                                 const char *restrict path)
+{
+	struct PipelineCacheFileHeader header = {
+		.magic = PIPELINE_CACHE_MAGIC,
+		.driver_version = device->properties.driverVersion
+	};
+	char temporary_path[FILENAME_MAX];
+	size_t size = 0;
+	uint8_t *data;
+	uint8_t written;
+	FILE *fp;
+
+	if (device->pipeline_cache == VK_NULL_HANDLE)
+	{
+		return ENGINE_OK;
+	}
+
+	vkGetPipelineCacheData(device->logical_device,
+	                       device->pipeline_cache,
+	                       &size,
+	                       NULL);
+	data = malloc(size);
+	if (data == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate pipeline cache data");
+	}
+
+	if (vkGetPipelineCacheData(device->logical_device,
+	                           device->pipeline_cache,
+	                           &size,
+	                           data) != VK_SUCCESS)
+	{
+		free(data);
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to read pipeline cache data");
+	}
+
+	header.data_size = size;
+
+	snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", path);
+	fp = fopen(temporary_path, "wb");
+	if (fp == NULL)
+	{
+		free(data);
+		LOG_WARNING("Unable to write pipeline cache to %s", temporary_path);
+		return ENGINE_ERROR_INIT_FAILED;
+	}
+
+	written = fwrite(&header, sizeof(header), 1, fp) == 1
+	          && fwrite(data, 1, size, fp) == size;
+	written = (fclose(fp) == 0) && written;
+	free(data);
+
+	if (!written || rename(temporary_path, path) != 0)
+	{
+		remove(temporary_path);
+		LOG_WARNING("Unable to write pipeline cache to %s", path);
+		return ENGINE_ERROR_INIT_FAILED;
+	}
+
+	return ENGINE_OK;
+}
+
+void pipeline_cache_destroy(Device *device)
+{
+	vkDestroyPipelineCache(device->logical_device, device->pipeline_cache, NULL);
+	device->pipeline_cache = VK_NULL_HANDLE;
+}
@@ -0,0 +1,45 @@
+#ifndef _PIPELINE_CACHE_H_
+#define _PIPELINE_CACHE_H_
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "core/debug.h"
+
+#include "devices.h"
+
+#define PIPELINE_CACHE_DEFAULT_PATH "./pipeline_cache.bin"
+
+/******************************************************************************
+ * @name       pipeline_cache_load()
+ * @brief      Creates the device's pipeline cache, seeded from a file saved by
+ *             an earlier run. The file is ignored if it is missing, truncated
+ *             or was written by a different device or driver.
+ * @param[in]  device The device to create the cache for.
+ * @param[in]  path   The file the cache was saved to.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR pipeline_cache_load(Device *restrict device,
+                                 const char *restrict path);
+
+/******************************************************************************
+ * @name      pipeline_cache_save()
+ * @brief     Writes the contents of the device's pipeline cache to a file.
+ *            The file is replaced atomically so a crash never leaves a partial
+ *            cache behind.
+ * @param[in] device The device whose cache is saved.
+ * @param[in] path   The file to save to.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR pipeline_cache_save(const Device *restrict device,
+                                 const char *restrict path);
+
+/******************************************************************************
+ * @name      pipeline_cache_destroy()
+ * @brief     Destroys the device's pipeline cache.
+ * @param[in] device The device whose cache is destroyed.
+ * @return    void
+******************************************************************************/
+void pipeline_cache_destroy(Device *device);
+
+#endif /* _PIPELINE_CACHE_H_ */
@@ -0,0 +1,29 @@
+#ifndef _RENDER_TARGET_H_
+#define _RENDER_TARGET_H_
+
+#include <stdint.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+/******************************************************************************
+ * @name  _RenderTarget
+ * @brief Describes the set of images a frame is rendered into. It is filled
+ *        from either a swap chain or an offscreen target so the pipeline,
+ *        framebuffers and command buffers do not depend on which one is used.
+******************************************************************************/
+struct _RenderTarget
+{
+	VkImageView *image_views; /*< Borrowed from the owning swap chain/target. */
+	uint32_t image_count;
+
+	VkFormat format;
+	VkExtent2D extent;
+	VkImageLayout final_layout; /*< Layout images are left in after rendering. */
+
+	VkFormat depth_format;
+	VkImageView depth_view; /*< Shared by every image, borrowed. */
+};
+typedef struct _RenderTarget RenderTarget;
+
+#endif /* _RENDER_TARGET_H_ */
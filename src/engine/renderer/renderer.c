@@ -1,9 +1,13 @@
 #include "renderer.h"
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 
 #include "core/logger.h"
+#include "core/timer.h"
+#include "core/jobs.h"
+#include "core/profiler.h"
 
 #include "instance.h"
 #include "devices.h"
@@ -12,6 +16,48 @@
 #include "framebuffer.h"
 #include "command_buffers.h"
 #include "buffer.h"
+#include "frame_sync.h"
+#include "render_target.h"
+#include "offscreen.h"
+#include "gpu_profiler.h"
+#include "upload.h"
+#include "pipeline_cache.h"
+#include "draw_list.h"
+#include "depth_buffer.h"
+#include "cull.h"
+#include "gpu_cull.h"
+#include "mesh_arena.h"
+
+#define ARRAY_SIZE(arr) sizeof(arr) / sizeof(arr[0])
+
+#define RENDERER_DEFAULT_FOV_Y 1.2217305f /* 70 degrees. */
+#define RENDERER_DEFAULT_NEAR  0.1f
+
+#define RENDERER_MIN_MESH_CAPACITY 64
+
+/******************************************************************************
+ * @name  _RendererMesh
+ * @brief A chunk mesh's vertices followed by its indices in the mesh arena.
+******************************************************************************/
+struct _RendererMesh
+{
+	MeshArenaRange range;
+	uint32_t slot; /*< Position in the renderer's list of meshes, and of its
+	                   bounds and draw record. */
+};
+
+/******************************************************************************
+ * @name  RetiredRanges
+ * @brief Mesh arena ranges no longer drawn that a frame's last submission, or
+ *        the uploads flushed just before it, may still use. Freed once the
+ *        frame's fence has signalled.
+******************************************************************************/
+struct RetiredRanges
+{
+	MeshArenaRange *ranges;
+	uint32_t count;
+	uint32_t capacity;
+};
 
 /******************************************************************************
  * @name Renderer
@@ -23,87 +69,138 @@ struct Renderer
 	Device *device;
 	VkSurfaceKHR render_surface;
 	SwapChain *swap_chain;
+	const Window *window;
+	uint8_t swap_chain_stale; /*< Recreated before the next frame is drawn. */
 	GraphicsPipeline *graphics_pipeline;
+	GraphicsPipeline *chunk_pipeline; /*< Shares graphics_pipeline's render
+	                                      pass. */
+
+	/* Set instead of the surface and swap chain when running headless. */
+	uint8_t headless;
+	OffscreenTarget *offscreen;
+	uint32_t offscreen_image;
+	uint32_t last_image;
+
+	RenderTarget target;
+	DepthBuffer *depth_buffer; /*< Matches the target's size. */
 
 	Framebuffer **framebuffers;
 	uint32_t framebuffer_count;
 
 	CommandPool *command_pool;
-	CommandBuffer *command_buffer;
+	FrameCommands *frame_commands;
+
+	DrawList draw_list; /*< Rebuilt every frame from what is visible. */
 
 	VertexBuffer *vbuffer;
-};
+	uint32_t vertex_count;
+	UploadContext *upload;
 
-static struct Renderer renderer;
+	MeshArena *mesh_arena; /*< Holds every mesh, so they share one buffer. */
+	RendererMesh **meshes; /*< Every live mesh, drawn each frame it is visible. */
+	uint32_t mesh_count;
+	uint32_t mesh_capacity;
+	CullBounds mesh_bounds; /*< Of each mesh, in the same order. */
+	uint32_t *visible;      /*< Meshes visible this frame, mesh_capacity. */
+	const CullKernels *cull;
+	GpuCull *gpu_cull;      /*< Each mesh's draw record, in the same order,
+	                            culled on the device if it can. */
+	FramePrologue culling;  /*< Records the device's culling of a frame. */
+	struct RetiredRanges *retired; /*< One per frame in flight. */
+	struct RetiredRanges retiring; /*< Retired since the last submission,
+	                                   handed to the next frame. */
 
-/* TODO: Move these somewhere else. These should not be here! */
-static VkSemaphore image_available;
-static VkSemaphore render_finished;
+	const char *pipeline_cache_path;
 
-static ENGINE_ERROR semaphore_create()
-{
-	VkResult success;
-	VkSemaphoreCreateInfo semaphore_info = {
-		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
-	};
+	RendererCamera camera;
 
-	success = vkCreateSemaphore(renderer.device->logical_device,
-	                            &semaphore_info,
-	                            NULL,
-	                            &image_available);
+	FrameSync *frame_sync;
 
-	if (success != VK_SUCCESS)
-	{
-		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
-		                           "Failed to initalise semaphore insufficient"
-		                           "host/device memory");
-	}
+	GpuProfiler *gpu_profiler;
+	RendererFrameStats stats;
+};
 
-	success = vkCreateSemaphore(renderer.device->logical_device,
-	                            &semaphore_info,
-	                            NULL,
-	                            &render_finished);
-	if (success != VK_SUCCESS)
+static struct Renderer renderer;
+
+static const struct
+{
+	const char *name;
+	RendererPresentMode mode;
+	VkPresentModeKHR vk_mode;
+} present_modes[] = {
+	{ "mailbox",      RENDERER_PRESENT_MODE_MAILBOX,      VK_PRESENT_MODE_MAILBOX_KHR },
+	{ "immediate",    RENDERER_PRESENT_MODE_IMMEDIATE,    VK_PRESENT_MODE_IMMEDIATE_KHR },
+	{ "fifo",         RENDERER_PRESENT_MODE_FIFO,         VK_PRESENT_MODE_FIFO_KHR },
+	{ "fifo_relaxed", RENDERER_PRESENT_MODE_FIFO_RELAXED, VK_PRESENT_MODE_FIFO_RELAXED_KHR }
+};
+
+/******************************************************************************
+ * @name   destroy_framebuffers()
+ * @brief  Destroys the framebuffer of each render target image.
+ * @return void
+******************************************************************************/
+static void destroy_framebuffers()
+{
+	for (uint32_t i = 0; i < renderer.framebuffer_count; i++)
 	{
-		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
-		                           "Failed to initalise semaphore insufficient"
-		                           "host/device memory");
+		framebuffer_destroy(renderer.framebuffers[i], renderer.device);
 	}
 
-	return ENGINE_OK;
+	free(renderer.framebuffers);
+	renderer.framebuffers = NULL;
+	renderer.framebuffer_count = 0;
 }
 
-static ENGINE_ERROR create_framebuffers(Framebuffer **framebuffer_array,
-                                        uint32_t image_count)
+/******************************************************************************
+ * @name   create_framebuffers()
+ * @brief  Creates a framebuffer for each render target image.
+ * @return An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR create_framebuffers()
 {
-	for (uint32_t i = 0; i < image_count; i++)
+	renderer.framebuffers = calloc(renderer.target.image_count, sizeof(Framebuffer*));
+	renderer.framebuffer_count = 0;
+
+	if (renderer.framebuffers == NULL)
 	{
-		framebuffer_array[i] = framebuffer_create(renderer.device,
-		                                          renderer.graphics_pipeline,
-		                                          &renderer.swap_chain->image_views[i],
-		                                          &renderer.swap_chain->extent);
+		return ENGINE_ERROR_OUT_OF_MEMORY;
+	}
 
-		if (framebuffer_array[i] == NULL)
-		{
-			for (uint32_t j = 0; framebuffer_array[j] != NULL; j++)
-			{
-				framebuffer_destroy(framebuffer_array[j], renderer.device);
-			}
+	for (uint32_t i = 0; i < renderer.target.image_count; i++)
+	{
+		renderer.framebuffers[i] = framebuffer_create(renderer.device,
+		                                              renderer.graphics_pipeline,
+		                                              &renderer.target.image_views[i],
+		                                              renderer.target.depth_view,
+		                                              &renderer.target.extent);
 
+		if (renderer.framebuffers[i] == NULL)
+		{
+			destroy_framebuffers();
 			return ENGINE_ERROR_INIT_FAILED;
 		}
+
+		renderer.framebuffer_count++;
 	}
+
 	return ENGINE_OK;
 }
 
-ENGINE_ERROR renderer_init(const Window *window)
+/******************************************************************************
+ * @name      create_presentation_target()
+ * @brief     Creates the window surface and the swap chain images are
+ *            presented with.
+ * @param[in] window   The window to present to.
+ * @param[in] settings The settings describing how to present.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR create_presentation_target(const Window *window,
+                                               const RendererSettings *settings)
 {
-	ENGINE_ERROR error = ENGINE_OK;
+	VkPresentModeKHR present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+	ENGINE_ERROR error;
 	VkResult surface_status = 0;
 
-	error = instance_create(&renderer.instance);
-	ENGINE_LOG_RETURN_IF_ERROR(error, "Vulkan instance failed to initalise");
-
 	/* Should we be doing this here? Maybe not. */
 	surface_status = glfwCreateWindowSurface(renderer.instance->handle,
 	                                         window->handle,
@@ -111,7 +208,6 @@ ENGINE_ERROR renderer_init(const Window *window)
 	                                         &renderer.render_surface);
 	if (surface_status != VK_SUCCESS)
 	{
-		instance_destroy(renderer.instance);
 		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_INIT_FAILED,
 		                           "Failed to create Vulkan surface for Window");
 	}
@@ -119,52 +215,520 @@ ENGINE_ERROR renderer_init(const Window *window)
 	error = device_create(&renderer.device,
 	                      renderer.instance,
 	                      &renderer.render_surface);
-
 	ENGINE_GOTO_IF_ERROR(error, device_init_fail);
 
+	for (uint32_t i = 0; i < ARRAY_SIZE(present_modes); i++)
+	{
+		if (present_modes[i].mode == settings->present_mode)
+		{
+			present_mode = present_modes[i].vk_mode;
+		}
+	}
+
 	error = swap_chain_create(&renderer.swap_chain,
 	                          window,
 	                          renderer.device,
-	                          &renderer.render_surface);
-
+	                          &renderer.render_surface,
+	                          present_mode,
+	                          settings->swap_chain_images);
 	ENGINE_GOTO_IF_ERROR(error, swap_chain_init_fail);
 
+	LOG_INFO("Presenting with mode %d from %u swap chain images",
+	         renderer.swap_chain->present_mode,
+	         renderer.swap_chain->image_count);
+
+	renderer.target.image_views = renderer.swap_chain->image_views;
+	renderer.target.image_count = renderer.swap_chain->image_count;
+	renderer.target.format = renderer.swap_chain->format;
+	renderer.target.extent = renderer.swap_chain->extent;
+	renderer.target.final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	return ENGINE_OK;
+
+swap_chain_init_fail:
+	device_destroy(renderer.device);
+
+device_init_fail:
+	vkDestroySurfaceKHR(renderer.instance->handle,
+	                    renderer.render_surface,
+	                    NULL);
+	return error;
+}
+
+/******************************************************************************
+ * @name      create_headless_target()
+ * @brief     Creates a device without present support and the offscreen
+ *            images rendered to in place of a swap chain.
+ * @param[in] settings The settings describing the offscreen images.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR create_headless_target(const RendererSettings *settings)
+{
+	ENGINE_ERROR error;
+	VkExtent2D extent = {settings->headless_width, settings->headless_height};
+
+	renderer.render_surface = VK_NULL_HANDLE;
+	renderer.swap_chain = NULL;
+
+	error = device_create(&renderer.device, renderer.instance, NULL);
+	ENGINE_RETURN_IF_ERROR(error);
+
+	error = offscreen_target_create(&renderer.offscreen,
+	                                renderer.device,
+	                                extent,
+	                                settings->frames_in_flight,
+	                                settings->headless_readback);
+	if (error != ENGINE_OK)
+	{
+		device_destroy(renderer.device);
+		ENGINE_LOG_RETURN_IF_ERROR(error, "Failed to create offscreen target");
+	}
+
+	renderer.target.image_views = renderer.offscreen->image_views;
+	renderer.target.image_count = renderer.offscreen->image_count;
+	renderer.target.format = renderer.offscreen->format;
+	renderer.target.extent = renderer.offscreen->extent;
+	renderer.target.final_layout = settings->headless_readback
+	                               ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+	                               : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	return ENGINE_OK;
+}
+
+/******************************************************************************
+ * @name      destroy_target()
+ * @brief     Destroys whichever target the renderer was initalised with along
+ *            with the device.
+ * @return    void
+******************************************************************************/
+static void destroy_target()
+{
+	if (renderer.headless)
+	{
+		offscreen_target_destroy(renderer.offscreen, renderer.device);
+		device_destroy(renderer.device);
+		return;
+	}
+
+	swap_chain_destroy(renderer.swap_chain, renderer.device);
+	device_destroy(renderer.device);
+	vkDestroySurfaceKHR(renderer.instance->handle,
+	                    renderer.render_surface,
+	                    NULL);
+}
+
+/******************************************************************************
+ * @name   create_depth_buffer()
+ * @brief  Creates a depth buffer the size of the render target and adds it to
+ *         the target. The format is only chosen the first time, so the render
+ *         pass stays compatible when the depth buffer is recreated.
+ * @return An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR create_depth_buffer()
+{
+	ENGINE_ERROR error;
+
+	if (renderer.target.depth_format == VK_FORMAT_UNDEFINED)
+	{
+		error = depth_buffer_select_format(renderer.device,
+		                                   &renderer.target.depth_format);
+		ENGINE_LOG_RETURN_IF_ERROR(error, "No supported depth format");
+	}
+
+	error = depth_buffer_create(&renderer.depth_buffer,
+	                            renderer.device,
+	                            renderer.target.depth_format,
+	                            renderer.target.extent);
+	ENGINE_LOG_RETURN_IF_ERROR(error, "Failed to create depth buffer");
+
+	renderer.target.depth_view = renderer.depth_buffer->view;
+
+	return ENGINE_OK;
+}
+
+/******************************************************************************
+ * @name   recreate_swap_chain()
+ * @brief  Recreates the swap chain at the window's current size along with
+ *         the framebuffers that use its images. The render pass and pipelines
+ *         do not depend on the size and are kept.
+ * @return An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR recreate_swap_chain()
+{
+	uint64_t start = timer_now_ns();
+	int width, height;
+	ENGINE_ERROR error;
+
+	PROFILE_ZONE("recreate_swap_chain");
+
+	/* Nothing can be presented to a minimised window, try again next frame. */
+	glfwGetFramebufferSize(renderer.window->handle, &width, &height);
+	if (width == 0 || height == 0)
+	{
+		return ENGINE_ERROR_INIT_FAILED;
+	}
+
+	/* Frames in flight may still be rendering to the old images. */
+	vkDeviceWaitIdle(renderer.device->logical_device);
+
+	destroy_framebuffers();
+
+	error = swap_chain_recreate(renderer.swap_chain,
+	                            renderer.window,
+	                            renderer.device,
+	                            &renderer.render_surface);
+	ENGINE_RETURN_IF_ERROR(error);
+
+	renderer.target.image_views = renderer.swap_chain->image_views;
+	renderer.target.image_count = renderer.swap_chain->image_count;
+	renderer.target.extent = renderer.swap_chain->extent;
+
+	depth_buffer_destroy(renderer.depth_buffer, renderer.device);
+	renderer.depth_buffer = NULL;
+
+	error = create_depth_buffer();
+	ENGINE_RETURN_IF_ERROR(error);
+
+	error = create_framebuffers();
+	ENGINE_LOG_RETURN_IF_ERROR(error, "Failed to recreate framebuffers");
+
+	error = frame_sync_set_image_count(renderer.frame_sync,
+	                                   renderer.target.image_count);
+	ENGINE_RETURN_IF_ERROR(error);
+
+	renderer.swap_chain_stale = 0;
+
+	LOG_DEBUG("Recreated swap chain at %ux%u in %.2f ms",
+	          renderer.target.extent.width,
+	          renderer.target.extent.height,
+	          timer_ns_to_ms(timer_now_ns() - start));
+	return ENGINE_OK;
+}
+
+/******************************************************************************
+ * @name   create_chunk_pipeline()
+ * @brief  Creates the pipeline chunk meshes are drawn with, in the graphics
+ *         pipeline's render pass.
+ * @param  depth_prepass If set a depth only pipeline is also created.
+ * @return An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR create_chunk_pipeline(uint8_t depth_prepass)
+{
+	/* Each draw's first instance is its mesh's slot, which picks the mesh's
+	 * origin out of the draw records. */
+	VkVertexInputBindingDescription bindings[] = {
+		{
+			.binding = 0,
+			.stride = sizeof(ChunkVertex),
+			.inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+		},
+		{
+			.binding = 1,
+			.stride = sizeof(ChunkDrawRecord),
+			.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE
+		}
+	};
+	VkVertexInputAttributeDescription attributes[] = {
+		{
+			.location = 0,
+			.binding = 0,
+			.format = VK_FORMAT_R32_UINT,
+			.offset = offsetof(ChunkVertex, position)
+		},
+		{
+			.location = 1,
+			.binding = 0,
+			.format = VK_FORMAT_R32_UINT,
+			.offset = offsetof(ChunkVertex, block)
+		},
+		{
+			.location = 2,
+			.binding = 1,
+			.format = VK_FORMAT_R32G32B32_SFLOAT,
+			.offset = offsetof(ChunkDrawRecord, origin)
+		}
+	};
+	GraphicsPipelineInfo info = {
+		.vertex_shader = "chunk.vert",
+		.fragment_shader = "fragment.frag",
+		.bindings = bindings,
+		.binding_count = ARRAY_SIZE(bindings),
+		.attributes = attributes,
+		.attribute_count = ARRAY_SIZE(attributes),
+		.render_pass = renderer.graphics_pipeline->render_pass,
+		.depth_prepass = depth_prepass
+	};
+
+	return graphics_pipeline_create(&renderer.chunk_pipeline,
+	                                renderer.device,
+	                                &renderer.target,
+	                                &info);
+}
+
+/******************************************************************************
+ * @name      retire_range()
+ * @brief     Frees a mesh arena range once the next frame submitted has
+ *            finished. Copies into the range may still be waiting in the
+ *            upload context, they are flushed to the graphics queue just
+ *            before that frame, so its fence covers them and every earlier
+ *            frame.
+ * @param[in] range The range to free.
+ * @return    void
+******************************************************************************/
+static void retire_range(const MeshArenaRange *range)
+{
+	struct RetiredRanges *retired = &renderer.retiring;
+
+	if (retired->count == retired->capacity)
+	{
+		uint32_t capacity = retired->capacity > 0
+		                    ? retired->capacity * 2
+		                    : RENDERER_MIN_MESH_CAPACITY;
+		MeshArenaRange *ranges = realloc(retired->ranges,
+		                                 capacity * sizeof(MeshArenaRange));
+
+		/* Better to stall than to leak or reuse memory the GPU is reading.
+		 * Pending copies into it are submitted first so the wait covers them,
+		 * a failed flush has logged why. */
+		if (ranges == NULL)
+		{
+			LOG_WARNING("Waiting for the device to free a mesh");
+			upload_flush(renderer.upload, renderer.device);
+			vkDeviceWaitIdle(renderer.device->logical_device);
+			mesh_arena_free(renderer.mesh_arena, range);
+			return;
+		}
+
+		retired->ranges = ranges;
+		retired->capacity = capacity;
+	}
+
+	retired->ranges[retired->count++] = *range;
+}
+
+/******************************************************************************
+ * @name      free_retired_ranges()
+ * @brief     Frees the ranges retired to a frame whose fence has signalled.
+ * @param[in] retired The frame's retired ranges.
+ * @return    void
+******************************************************************************/
+static void free_retired_ranges(struct RetiredRanges *retired)
+{
+	for (uint32_t i = 0; i < retired->count; i++)
+	{
+		mesh_arena_free(renderer.mesh_arena, &retired->ranges[i]);
+	}
+
+	retired->count = 0;
+}
+
+/******************************************************************************
+ * @name       build_draw_list()
+ * @brief      Fills the draw list with what is visible this frame, or the
+ *             triangle while there are no meshes. If the device culls the
+ *             chunk meshes they are one indirect draw, whose commands the
+ *             frame's prologue generates, otherwise they are culled here
+ *             and each visible mesh is drawn on its own.
+ * @param[in]  view_projection The camera's view projection matrix.
+ * @param      frame           The frame in flight.
+ * @param[out] prologue        Set to the culling to record before the render
+ *                             pass, or NULL if there is none.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR build_draw_list(const Mat4 *view_projection,
+                                    uint32_t frame,
+                                    const FramePrologue **prologue)
+{
+	uint64_t cull_start = timer_now_ns();
+	uint32_t visible_count;
+	Frustum frustum;
+	ENGINE_ERROR error;
+
+	PROFILE_ZONE("build_draw_list");
+
+	draw_list_clear(&renderer.draw_list);
+	*prologue = NULL;
+
+	if (renderer.mesh_count == 0)
+	{
+		DrawCommand draw = {
+			.pipeline = renderer.graphics_pipeline,
+			.vertex_buffer = renderer.vbuffer->handle,
+			.offset = 0,
+			.vertex_count = renderer.vertex_count
+		};
+
+		renderer.stats.cull_ms = 0.0;
+		renderer.stats.gpu_culled = 0;
+		return draw_list_push(&renderer.draw_list, &draw);
+	}
+
+	frustum_from_matrix(&frustum, view_projection);
+
+	if (gpu_cull_can_draw(renderer.gpu_cull))
+	{
+		DrawCommand draw = {
+			.pipeline = renderer.chunk_pipeline,
+			.vertex_buffer = renderer.mesh_arena->buffer->handle,
+			.offset = 0,
+			.index_buffer = renderer.mesh_arena->buffer->handle
+		};
+
+		gpu_cull_prologue(renderer.gpu_cull, frame, &frustum, &renderer.culling, &draw);
+		*prologue = &renderer.culling;
+
+		renderer.stats.cull_ms = 0.0;
+		renderer.stats.gpu_culled = 1;
+		return draw_list_push(&renderer.draw_list, &draw);
+	}
+
+	PROFILE_BEGIN("cull");
+	visible_count = renderer.cull->cull(&renderer.mesh_bounds, &frustum, renderer.visible);
+	PROFILE_END();
+
+	renderer.stats.cull_ms = timer_ns_to_ms(timer_now_ns() - cull_start);
+	renderer.stats.gpu_culled = 0;
+	PROFILE_COUNTER("Visible meshes", visible_count);
+
+	for (uint32_t i = 0; i < visible_count; i++)
+	{
+		uint32_t slot = renderer.visible[i];
+		const ChunkDrawRecord *record = &renderer.gpu_cull->records[slot];
+
+		if (record->index_count & GPU_CULL_HIDDEN)
+		{
+			continue;
+		}
+
+		DrawCommand draw = {
+			.pipeline = renderer.chunk_pipeline,
+			.vertex_buffer = renderer.mesh_arena->buffer->handle,
+			.offset = 0,
+			.instance_buffer = renderer.gpu_cull->frames[frame].records->handle,
+			.index_buffer = renderer.mesh_arena->buffer->handle,
+			.index_count = record->index_count,
+			.first_index = record->first_index,
+			.vertex_offset = record->vertex_offset,
+			.first_instance = slot
+		};
+
+		error = draw_list_push(&renderer.draw_list, &draw);
+		ENGINE_RETURN_IF_ERROR(error);
+	}
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR renderer_init(const Window *window,
+                           const RendererSettings *settings)
+{
+	ENGINE_ERROR error = ENGINE_OK;
+	double record_budget_ms = settings->record_budget_ms > 0.0
+	                          ? settings->record_budget_ms
+	                          : RENDERER_DEFAULT_RECORD_BUDGET_MS;
+
+	renderer.headless = settings->headless;
+	renderer.window = window;
+	renderer.swap_chain_stale = 0;
+	renderer.offscreen = NULL;
+	renderer.offscreen_image = 0;
+	renderer.last_image = 0;
+	renderer.depth_buffer = NULL;
+	renderer.target.depth_format = VK_FORMAT_UNDEFINED;
+	renderer.camera = (RendererCamera){
+		.position = {0.0f, 0.0f, 1.5f},
+		.target = {0.0f, 0.0f, 0.0f},
+		.fov_y = RENDERER_DEFAULT_FOV_Y,
+		.near = RENDERER_DEFAULT_NEAR
+	};
+
+	error = instance_create(&renderer.instance, renderer.headless);
+	ENGINE_LOG_RETURN_IF_ERROR(error, "Vulkan instance failed to initalise");
+
+	if (renderer.headless)
+	{
+		error = create_headless_target(settings);
+	}
+	else
+	{
+		error = create_presentation_target(window, settings);
+	}
+	ENGINE_GOTO_IF_ERROR(error, target_init_fail);
+
+	error = create_depth_buffer();
+	ENGINE_GOTO_IF_ERROR(error, depth_buffer_init_fail);
+
+	renderer.pipeline_cache_path = settings->pipeline_cache_path != NULL
+	                               ? settings->pipeline_cache_path
+	                               : PIPELINE_CACHE_DEFAULT_PATH;
+
+	/* Pipelines can still be created without a cache, only slower. */
+	if (pipeline_cache_load(renderer.device, renderer.pipeline_cache_path) != ENGINE_OK)
+	{
+		LOG_WARNING("Continuing without a pipeline cache");
+	}
+
+	error = upload_context_create(&renderer.upload, renderer.device);
+	ENGINE_GOTO_IF_ERROR(error, upload_init_fail);
+
 	/* Won't be here in the future */
 	float verticies[] = {
-		 0.0f, -0.5f, 1.0f, 0.0f, 0.0f,
-		 0.5f,  0.5f, 0.0f, 1.0f, 0.0f,
-		-0.5f,  0.5f, 0.0f, 0.0f, 1.0f
+		 0.0f,  0.5f, 1.0f, 0.0f, 0.0f,
+		 0.5f, -0.5f, 0.0f, 1.0f, 0.0f,
+		-0.5f, -0.5f, 0.0f, 0.0f, 1.0f
 	};
 
 	VertexData *vertex_data =
 		vertex_data_create(verticies, sizeof(verticies) / sizeof(float));
 
 	renderer.vbuffer = vertex_buffer_create(renderer.device,
-	                                        sizeof(verticies));
-
-	void *data;
-	vkMapMemory(renderer.device->logical_device,
-	            renderer.vbuffer->buffer_memory,
-	            0,
-	            sizeof(verticies),
-	            0,
-	            &data);
-	memcpy(data, verticies, sizeof(verticies));
-	vkUnmapMemory(renderer.device->logical_device,
-	              renderer.vbuffer->buffer_memory);
+	                                        sizeof(verticies),
+	                                        renderer.upload->buffer_properties);
+	if (renderer.vbuffer == NULL)
+	{
+		error = ENGINE_ERROR_OUT_OF_MEMORY;
+		ENGINE_LOG_GOTO_IF_ERROR(error,
+		                         "Failed to create vertex buffer",
+		                         vertex_buffer_init_fail);
+	}
+
+	error = upload_buffer(renderer.upload,
+	                      renderer.device,
+	                      renderer.vbuffer->handle,
+	                      &renderer.vbuffer->allocation,
+	                      0,
+	                      verticies,
+	                      sizeof(verticies));
+	if (error == ENGINE_OK)
+	{
+		error = upload_flush(renderer.upload, renderer.device);
+	}
+	ENGINE_LOG_GOTO_IF_ERROR(error,
+	                         "Failed to upload vertex data",
+	                         graphics_pipeline_init_fail);
+
+	GraphicsPipelineInfo pipeline_info = {
+		.vertex_shader = "vertex.vert",
+		.fragment_shader = "fragment.frag",
+		.bindings = &vertex_data->binding_description,
+		.binding_count = 1,
+		.attributes = vertex_data->attribute_description,
+		.attribute_count = ARRAY_SIZE(vertex_data->attribute_description),
+		.render_pass = VK_NULL_HANDLE,
+		.depth_prepass = settings->depth_prepass
+	};
 
 	error = graphics_pipeline_create(&renderer.graphics_pipeline,
 	                                 renderer.device,
-	                                 renderer.swap_chain,
-	                                 vertex_data);
+	                                 &renderer.target,
+	                                 &pipeline_info);
 
 	ENGINE_GOTO_IF_ERROR(error, graphics_pipeline_init_fail);
 
-	renderer.framebuffers =
-		malloc(sizeof(Framebuffer*) * renderer.swap_chain->image_count);
+	error = create_chunk_pipeline(settings->depth_prepass);
+	ENGINE_GOTO_IF_ERROR(error, chunk_pipeline_init_fail);
 
-	error = create_framebuffers(renderer.framebuffers,
-	                            renderer.swap_chain->image_count);
+	error = create_framebuffers();
 	ENGINE_LOG_GOTO_IF_ERROR(error,
 	                         "Failed to intialise all framebuffers",
 	                         framebuffer_init_fail);
@@ -172,131 +736,564 @@ ENGINE_ERROR renderer_init(const Window *window)
 	error = command_pool_create(&renderer.command_pool, renderer.device);
 	ENGINE_GOTO_IF_ERROR(error, command_pool_init_fail);
 
-	error = command_buffer_create(&renderer.command_buffer,
-	                              renderer.command_pool,
+	error = frame_commands_create(&renderer.frame_commands,
 	                              renderer.device,
-	                              renderer.graphics_pipeline,
-	                              renderer.swap_chain,
-	                              renderer.framebuffers,
-	                              renderer.vbuffer,
-	                              sizeof(verticies));
-
-	vertex_data_destroy(vertex_data);
-
+	                              settings->frames_in_flight,
+	                              job_thread_count(),
+	                              (uint64_t)(record_budget_ms * 1000000.0),
+	                              settings->depth_prepass);
 	ENGINE_LOG_GOTO_IF_ERROR(error,
-	                         "Failed to initalise command buffer",
+	                         "Failed to initalise frame command buffers",
 	                         command_buffer_init_fail);
 
-	error = semaphore_create();
-	ENGINE_GOTO_IF_ERROR(error, semaphore_init_fail);
+	renderer.vertex_count = sizeof(verticies) / (5 * sizeof(float));
+
+	error = draw_list_init(&renderer.draw_list);
+	ENGINE_GOTO_IF_ERROR(error, draw_list_init_fail);
+
+	if (renderer.headless)
+	{
+		error = offscreen_target_record_readback(renderer.offscreen,
+		                                         renderer.device,
+		                                         renderer.command_pool);
+		ENGINE_GOTO_IF_ERROR(error, gpu_profiler_init_fail);
+	}
+
+	error = gpu_profiler_create(&renderer.gpu_profiler,
+	                            renderer.device,
+	                            settings->frames_in_flight);
+	ENGINE_GOTO_IF_ERROR(error, gpu_profiler_init_fail);
+
+	error = frame_sync_create(&renderer.frame_sync,
+	                          renderer.device,
+	                          settings->frames_in_flight,
+	                          renderer.target.image_count);
+	ENGINE_GOTO_IF_ERROR(error, frame_sync_init_fail);
+
+	renderer.meshes = NULL;
+	renderer.mesh_count = 0;
+	renderer.mesh_capacity = 0;
+	renderer.visible = NULL;
+	renderer.retiring = (struct RetiredRanges){0};
+	renderer.retired = calloc(settings->frames_in_flight, sizeof(struct RetiredRanges));
+	if (renderer.retired == NULL)
+	{
+		error = ENGINE_ERROR_OUT_OF_MEMORY;
+		goto retired_init_fail;
+	}
+
+	error = cull_bounds_init(&renderer.mesh_bounds);
+	ENGINE_GOTO_IF_ERROR(error, mesh_bounds_init_fail);
+
+	error = mesh_arena_create(&renderer.mesh_arena,
+	                          renderer.device,
+	                          settings->mesh_memory > 0 ? settings->mesh_memory
+	                                                    : RENDERER_DEFAULT_MESH_MEMORY,
+	                          renderer.upload->buffer_properties);
+	ENGINE_GOTO_IF_ERROR(error, mesh_arena_init_fail);
+
+	error = gpu_cull_create(&renderer.gpu_cull,
+	                        renderer.device,
+	                        settings->frames_in_flight,
+	                        !settings->cpu_culling);
+	ENGINE_GOTO_IF_ERROR(error, gpu_cull_init_fail);
+
+	renderer.cull = cull_kernels_best();
+	LOG_INFO("Culling with %s kernels", renderer.cull->name);
+
+	memset(&renderer.stats, 0, sizeof(renderer.stats));
+	renderer.stats.gpu_ms = -1.0;
+
+	vertex_data_destroy(vertex_data);
 
 	return ENGINE_OK;
 
-semaphore_init_fail:
-	command_buffer_destroy(renderer.command_buffer,
-	                       renderer.command_pool,
-	                       renderer.device);
-	command_pool_destroy(renderer.command_pool, renderer.device);
+gpu_cull_init_fail:
+	mesh_arena_destroy(renderer.mesh_arena, renderer.device);
+
+mesh_arena_init_fail:
+	cull_bounds_deinit(&renderer.mesh_bounds);
+
+mesh_bounds_init_fail:
+	free(renderer.retired);
+
+retired_init_fail:
+	frame_sync_destroy(renderer.frame_sync, renderer.device);
+
+frame_sync_init_fail:
+	gpu_profiler_destroy(renderer.gpu_profiler, renderer.device);
+
+gpu_profiler_init_fail:
+	draw_list_deinit(&renderer.draw_list);
+
+draw_list_init_fail:
+	frame_commands_destroy(renderer.frame_commands, renderer.device);
 
 command_buffer_init_fail:
 	command_pool_destroy(renderer.command_pool, renderer.device);
 
 command_pool_init_fail:
-	for (uint32_t i = 0; i < renderer.swap_chain->image_count; i++)
-	{
-		framebuffer_destroy(renderer.framebuffers[i], renderer.device);
-	}
+	destroy_framebuffers();
 
 framebuffer_init_fail:
-	free(renderer.framebuffers);
+	graphics_pipeline_destroy(renderer.chunk_pipeline, renderer.device);
+
+chunk_pipeline_init_fail:
 	graphics_pipeline_destroy(renderer.graphics_pipeline, renderer.device);
 
 graphics_pipeline_init_fail:
+	vertex_buffer_destroy(renderer.vbuffer, renderer.device);
+
+vertex_buffer_init_fail:
 	vertex_data_destroy(vertex_data);
-	swap_chain_destroy(renderer.swap_chain, renderer.device);
+	upload_context_destroy(renderer.upload, renderer.device);
 
-swap_chain_init_fail:
-	device_destroy(renderer.device);
+upload_init_fail:
+	pipeline_cache_destroy(renderer.device);
+	depth_buffer_destroy(renderer.depth_buffer, renderer.device);
 
-device_init_fail:
-	vkDestroySurfaceKHR(renderer.instance->handle,
-	                    renderer.render_surface,
-	                    NULL);
+depth_buffer_init_fail:
+	destroy_target();
+
+target_init_fail:
+	instance_destroy(renderer.instance);
 
 	return error;
 }
 
+ENGINE_ERROR renderer_parse_present_mode(const char *name,
+                                         RendererPresentMode *mode)
+{
+	for (uint32_t i = 0; i < ARRAY_SIZE(present_modes); i++)
+	{
+		if (strcmp(present_modes[i].name, name) == 0)
+		{
+			*mode = present_modes[i].mode;
+			return ENGINE_OK;
+		}
+	}
+
+	return ENGINE_ERROR_INIT_FAILED;
+}
+
 void renderer_deinit()
 {
+	/* Frames may still be in flight, nothing can be destroyed until they finish. */
+	vkDeviceWaitIdle(renderer.device->logical_device);
+
+	upload_context_destroy(renderer.upload, renderer.device);
 	vertex_buffer_destroy(renderer.vbuffer, renderer.device);
 
-	vkDestroySemaphore(renderer.device->logical_device, image_available, NULL);
-	vkDestroySemaphore(renderer.device->logical_device, render_finished, NULL);
+	/* Meshes should have been destroyed, but nothing is drawn any more. */
+	for (uint32_t i = 0; i < renderer.mesh_count; i++)
+	{
+		mesh_arena_free(renderer.mesh_arena, &renderer.meshes[i]->range);
+		free(renderer.meshes[i]);
+	}
+	free(renderer.meshes);
+	free(renderer.visible);
+	cull_bounds_deinit(&renderer.mesh_bounds);
 
-	for (uint32_t i = 0; i < renderer.swap_chain->image_count; i++)
+	for (uint32_t i = 0; i < renderer.frame_sync->frame_count; i++)
 	{
-		framebuffer_destroy(renderer.framebuffers[i], renderer.device);
+		free_retired_ranges(&renderer.retired[i]);
+		free(renderer.retired[i].ranges);
 	}
-	free(renderer.framebuffers);
+	free(renderer.retired);
+	free_retired_ranges(&renderer.retiring);
+	free(renderer.retiring.ranges);
+
+	gpu_cull_destroy(renderer.gpu_cull, renderer.device);
+	mesh_arena_destroy(renderer.mesh_arena, renderer.device);
+
+	frame_sync_destroy(renderer.frame_sync, renderer.device);
+	gpu_profiler_destroy(renderer.gpu_profiler, renderer.device);
+
+	destroy_framebuffers();
 
-	command_buffer_destroy(renderer.command_buffer,
-	                       renderer.command_pool,
-	                       renderer.device);
+	draw_list_deinit(&renderer.draw_list);
+	frame_commands_destroy(renderer.frame_commands, renderer.device);
 	command_pool_destroy(renderer.command_pool, renderer.device);
 
+	graphics_pipeline_destroy(renderer.chunk_pipeline, renderer.device);
 	graphics_pipeline_destroy(renderer.graphics_pipeline, renderer.device);
-	swap_chain_destroy(renderer.swap_chain, renderer.device);
-	vkDestroySurfaceKHR(renderer.instance->handle,
-	                    renderer.render_surface,
-	                    NULL);
 
-	device_destroy(renderer.device);
+	pipeline_cache_save(renderer.device, renderer.pipeline_cache_path);
+	pipeline_cache_destroy(renderer.device);
+
+	/* Missing if recreating it after a resize failed. */
+	if (renderer.depth_buffer != NULL)
+	{
+		depth_buffer_destroy(renderer.depth_buffer, renderer.device);
+	}
+	destroy_target();
 	instance_destroy(renderer.instance);
 }
 
+void renderer_resize()
+{
+	renderer.swap_chain_stale = !renderer.headless;
+}
+
+void renderer_set_camera(const RendererCamera *camera)
+{
+	renderer.camera = *camera;
+}
+
+ENGINE_ERROR renderer_mesh_create(RendererMesh **mesh,
+                                  const ChunkMesh *restrict data,
+                                  Vec3 origin)
+{
+	VkDeviceSize vertex_size = data->vertex_count * sizeof(ChunkVertex);
+	VkDeviceSize index_size = data->index_count * sizeof(uint32_t);
+	uint32_t low[3] = {CHUNK_VERTEX_COORD_MASK, CHUNK_VERTEX_COORD_MASK, CHUNK_VERTEX_COORD_MASK};
+	uint32_t high[3] = {0, 0, 0};
+	ChunkDrawRecord record;
+	ENGINE_ERROR error;
+
+	if (renderer.mesh_count == renderer.mesh_capacity)
+	{
+		uint32_t capacity = renderer.mesh_capacity > 0
+		                    ? renderer.mesh_capacity * 2
+		                    : RENDERER_MIN_MESH_CAPACITY;
+		RendererMesh **meshes = realloc(renderer.meshes,
+		                                capacity * sizeof(RendererMesh*));
+		uint32_t *visible;
+
+		if (meshes == NULL)
+		{
+			ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+			                           "Failed to grow the mesh list");
+		}
+		renderer.meshes = meshes;
+
+		visible = realloc(renderer.visible, capacity * sizeof(uint32_t));
+		if (visible == NULL)
+		{
+			ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+			                           "Failed to grow the visible list");
+		}
+		renderer.visible = visible;
+
+		error = cull_bounds_reserve(&renderer.mesh_bounds, capacity);
+		ENGINE_RETURN_IF_ERROR(error);
+
+		renderer.mesh_capacity = capacity;
+	}
+
+	*mesh = malloc(sizeof(RendererMesh));
+	if (*mesh == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate mesh");
+	}
+
+	error = mesh_arena_allocate(renderer.mesh_arena,
+	                            vertex_size + index_size,
+	                            &(*mesh)->range);
+	if (error != ENGINE_OK)
+	{
+		free(*mesh);
+		*mesh = NULL;
+		ENGINE_LOG_RETURN_IF_ERROR(error, "Mesh arena is full");
+	}
+
+	error = upload_buffer(renderer.upload,
+	                      renderer.device,
+	                      renderer.mesh_arena->buffer->handle,
+	                      &renderer.mesh_arena->buffer->allocation,
+	                      (*mesh)->range.offset,
+	                      data->vertices,
+	                      vertex_size);
+	if (error == ENGINE_OK)
+	{
+		error = upload_buffer(renderer.upload,
+		                      renderer.device,
+		                      renderer.mesh_arena->buffer->handle,
+		                      &renderer.mesh_arena->buffer->allocation,
+		                      (*mesh)->range.offset + vertex_size,
+		                      data->indices,
+		                      index_size);
+	}
+
+	/* Bound what the mesh covers, which may be much less than its chunk. */
+	for (uint32_t i = 0; i < data->vertex_count; i++)
+	{
+		uint32_t position = data->vertices[i].position;
+		uint32_t coordinates[3] = {
+			(position >> CHUNK_VERTEX_X_SHIFT) & CHUNK_VERTEX_COORD_MASK,
+			(position >> CHUNK_VERTEX_Y_SHIFT) & CHUNK_VERTEX_COORD_MASK,
+			(position >> CHUNK_VERTEX_Z_SHIFT) & CHUNK_VERTEX_COORD_MASK
+		};
+
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			low[axis] = coordinates[axis] < low[axis] ? coordinates[axis] : low[axis];
+			high[axis] = coordinates[axis] > high[axis] ? coordinates[axis] : high[axis];
+		}
+	}
+
+	/* Ranges are aligned to whole vertices and indices. */
+	record = (ChunkDrawRecord){
+		.min = {origin.x + (float)(low[0] << data->level),
+		        origin.y + (float)(low[1] << data->level),
+		        origin.z + (float)(low[2] << data->level)},
+		.index_count = data->index_count,
+		.max = {origin.x + (float)(high[0] << data->level),
+		        origin.y + (float)(high[1] << data->level),
+		        origin.z + (float)(high[2] << data->level)},
+		.first_index = (uint32_t)(((*mesh)->range.offset + vertex_size) / sizeof(uint32_t)),
+		.origin = {origin.x, origin.y, origin.z},
+		.vertex_offset = (int32_t)((*mesh)->range.offset / sizeof(ChunkVertex))
+	};
+
+	if (error == ENGINE_OK)
+	{
+		error = gpu_cull_push(renderer.gpu_cull, &record);
+	}
+
+	/* A copy into the range may already have been recorded. */
+	if (error != ENGINE_OK)
+	{
+		retire_range(&(*mesh)->range);
+		free(*mesh);
+		*mesh = NULL;
+		ENGINE_LOG_RETURN_IF_ERROR(error, "Failed to upload mesh");
+	}
+
+	(*mesh)->slot = renderer.mesh_count;
+	renderer.meshes[renderer.mesh_count++] = *mesh;
+	cull_bounds_push(&renderer.mesh_bounds,
+	                 (Vec3){record.min[0], record.min[1], record.min[2]},
+	                 (Vec3){record.max[0], record.max[1], record.max[2]});
+
+	return ENGINE_OK;
+}
+
+void renderer_mesh_destroy(RendererMesh *mesh)
+{
+	RendererMesh *last = renderer.meshes[--renderer.mesh_count];
+
+	renderer.meshes[mesh->slot] = last;
+	last->slot = mesh->slot;
+	cull_bounds_remove(&renderer.mesh_bounds, mesh->slot);
+	gpu_cull_remove(renderer.gpu_cull, mesh->slot);
+
+	retire_range(&mesh->range);
+	free(mesh);
+}
+
+void renderer_mesh_set_hidden(RendererMesh *mesh, uint8_t hidden)
+{
+	gpu_cull_set_hidden(renderer.gpu_cull, mesh->slot, hidden);
+}
+
 void renderer_draw()
 {
+	FrameSync *sync = renderer.frame_sync;
+	const uint32_t frame = sync->current_frame;
+	uint64_t frame_start, acquired, submit_start, submitted, presented;
 	uint32_t image_index;
+	VkCommandBuffer frame_commands;
+	const FramePrologue *prologue;
+	GraphicsPushConstants constants;
+	Mat4 view, projection;
 	VkResult success;
 
+	PROFILE_ZONE("renderer_draw");
+
+	if (renderer.swap_chain_stale && recreate_swap_chain() != ENGINE_OK)
+	{
+		return;
+	}
+
+	frame_start = timer_now_ns();
+
+	/* Wait for the GPU to finish the last submission that used this frame's
+	 * resources, the other frames in flight keep the GPU busy meanwhile. */
+	vkWaitForFences(renderer.device->logical_device,
+	                1,
+	                &sync->in_flight[frame],
+	                VK_TRUE,
+	                UINT64_MAX);
+
+	/* The frame's previous submission has finished so its timestamps are
+	 * ready, this reports the GPU time of a frame frame_count frames ago. */
+	renderer.stats.gpu_ms = gpu_profiler_collect(renderer.gpu_profiler,
+	                                             renderer.device,
+	                                             frame)
+	                        ? renderer.gpu_profiler->frame_ms
+	                        : -1.0;
+
+	upload_collect(renderer.upload, renderer.device);
+	free_retired_ranges(&renderer.retired[frame]);
+
+	/* Meshes created or destroyed since the frame was last drawn change
+	 * its copy of the draw records. */
+	if (gpu_cull_update(renderer.gpu_cull, renderer.device, frame) != ENGINE_OK)
+	{
+		LOG_FATAL("Failed to update the draw records of frame %u", frame);
+	}
+
 	/* Submit to queue */
-	vkAcquireNextImageKHR(renderer.device->logical_device,
-	                      renderer.swap_chain->handle,
-	                      UINT64_MAX, /* Disable timeout */
-	                      image_available,
-	                      VK_NULL_HANDLE,
-	                      &image_index);
+	if (renderer.headless)
+	{
+		/* Offscreen images are simply rotated, nothing needs acquiring. */
+		image_index = renderer.offscreen_image;
+		renderer.offscreen_image = (image_index + 1) % renderer.target.image_count;
+	}
+	else
+	{
+		PROFILE_BEGIN("vkAcquireNextImageKHR");
+		success = vkAcquireNextImageKHR(renderer.device->logical_device,
+		                                renderer.swap_chain->handle,
+		                                UINT64_MAX, /* Disable timeout */
+		                                sync->image_available[frame],
+		                                VK_NULL_HANDLE,
+		                                &image_index);
+		PROFILE_END();
+
+		/* No image was acquired and the semaphore is unsignalled, the frame
+		 * is skipped. A suboptimal image can still be drawn and presented. */
+		if (success == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			renderer.swap_chain_stale = 1;
+			return;
+		}
+		else if (success == VK_SUBOPTIMAL_KHR)
+		{
+			renderer.swap_chain_stale = 1;
+		}
+		else if (success != VK_SUCCESS)
+		{
+			LOG_FATAL("Failed to acquire a swap chain image");
+		}
+	}
 
-	if (image_index > renderer.command_buffer->buffer_count)
+	if (image_index >= renderer.target.image_count)
 	{
-		LOG_FATAL("Aquired image index is greater than number of command buffers");
+		LOG_FATAL("Aquired image index is greater than number of images");
 	}
 
-	VkSemaphore wait_semaphores[] = {image_available};
-	VkSemaphore signal_semaphores[] = {render_finished};
+	/* The image may be acquired out of order and still be in use by an
+	 * older frame. */
+	if (sync->images_in_flight[image_index] != VK_NULL_HANDLE)
+	{
+		vkWaitForFences(renderer.device->logical_device,
+		                1,
+		                &sync->images_in_flight[image_index],
+		                VK_TRUE,
+		                UINT64_MAX);
+	}
+	sync->images_in_flight[image_index] = sync->in_flight[frame];
+
+	acquired = timer_now_ns();
+
+	view = mat4_look_at(renderer.camera.position,
+	                    renderer.camera.target,
+	                    (Vec3){0.0f, 1.0f, 0.0f});
+	projection = mat4_perspective_reverse_z(renderer.camera.fov_y,
+	                                        (float)renderer.target.extent.width
+	                                        / (float)renderer.target.extent.height,
+	                                        renderer.camera.near);
+	constants.view_projection = mat4_multiply(&projection, &view);
+
+	if (build_draw_list(&constants.view_projection, frame, &prologue) != ENGINE_OK)
+	{
+		LOG_FATAL("Failed to build the draw list of frame %u", frame);
+	}
+
+	if (frame_commands_record(renderer.frame_commands,
+	                          renderer.device,
+	                          frame,
+	                          renderer.graphics_pipeline,
+	                          &renderer.target,
+	                          renderer.framebuffers[image_index],
+	                          renderer.draw_list.draws,
+	                          renderer.draw_list.count,
+	                          &constants,
+	                          prologue,
+	                          renderer.gpu_profiler,
+	                          &frame_commands) != ENGINE_OK)
+	{
+		LOG_FATAL("Failed to record frame %u", frame);
+	}
+
+	/* Meshes created since the last frame are copied before it is drawn. */
+	if (upload_flush(renderer.upload, renderer.device) != ENGINE_OK)
+	{
+		LOG_FATAL("Failed to flush the uploads of frame %u", frame);
+	}
+
+	VkSemaphore wait_semaphores[] = {sync->image_available[frame]};
+	VkSemaphore signal_semaphores[] = {sync->render_finished[frame]};
 	VkPipelineStageFlags wait_stages[]
 		= {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+	VkCommandBuffer command_buffers[2];
+	uint32_t command_buffer_count = 0;
+
+	command_buffers[command_buffer_count++] = frame_commands;
 
+	if (renderer.headless && renderer.offscreen->readback_commands != NULL)
+	{
+		command_buffers[command_buffer_count++] =
+			renderer.offscreen->readback_commands[image_index];
+	}
+
+	/* Without a swap chain there is nothing to wait on or present. */
 	VkSubmitInfo submit_info = {
 		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.waitSemaphoreCount = 1,
+		.waitSemaphoreCount = renderer.headless ? 0 : 1,
 		.pWaitSemaphores = wait_semaphores,
 		.pWaitDstStageMask = wait_stages,
-		.commandBufferCount = 1,
-		.pCommandBuffers = &renderer.command_buffer->buffers[image_index],
-		.signalSemaphoreCount = 1,
+		.commandBufferCount = command_buffer_count,
+		.pCommandBuffers = command_buffers,
+		.signalSemaphoreCount = renderer.headless ? 0 : 1,
 		.pSignalSemaphores = signal_semaphores
 	};
 
+	submit_start = timer_now_ns();
+
+	vkResetFences(renderer.device->logical_device, 1, &sync->in_flight[frame]);
+
+	PROFILE_BEGIN("vkQueueSubmit");
 	success = vkQueueSubmit(renderer.device->graphics_queue,
 	                        1,
-							&submit_info,
-							VK_NULL_HANDLE);
+	                        &submit_info,
+	                        sync->in_flight[frame]);
+	PROFILE_END();
 	if (success != VK_SUCCESS)
 	{
 		LOG_FATAL("Failed to submit queue");
 	}
 
+	gpu_profiler_submitted(renderer.gpu_profiler, frame);
+
+	/* This submission followed the flush of any copies into the ranges, so
+	 * its fence covers them. The frame's list was emptied above, swapping
+	 * keeps both lists' storage. */
+	struct RetiredRanges retired = renderer.retired[frame];
+	renderer.retired[frame] = renderer.retiring;
+	renderer.retiring = retired;
+
+	submitted = timer_now_ns();
+
+	renderer.last_image = image_index;
+	sync->current_frame = (frame + 1) % sync->frame_count;
+
+	renderer.stats.wait_ms = timer_ns_to_ms(acquired - frame_start);
+	renderer.stats.record_ms = timer_ns_to_ms(submit_start - acquired);
+	renderer.stats.submit_ms = timer_ns_to_ms(submitted - submit_start);
+	renderer.stats.present_ms = 0.0;
+	renderer.stats.draw_count = renderer.draw_list.count;
+	PROFILE_COUNTER("Draws", renderer.draw_list.count);
+	renderer.stats.record_over_budget = renderer.frame_commands->over_budget;
+
+	if (renderer.headless)
+	{
+		return;
+	}
+
 	/* Present */
 	VkPresentInfoKHR present_info = {
 		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -308,8 +1305,56 @@ void renderer_draw()
 		.pResults = NULL
 	};
 
-	vkQueuePresentKHR(renderer.device->present_queue,
-	                  &present_info);
+	PROFILE_BEGIN("vkQueuePresentKHR");
+	success = vkQueuePresentKHR(renderer.device->present_queue,
+	                            &present_info);
+	PROFILE_END();
 
-	vkDeviceWaitIdle(renderer.device->logical_device);
+	if (success == VK_ERROR_OUT_OF_DATE_KHR || success == VK_SUBOPTIMAL_KHR)
+	{
+		renderer.swap_chain_stale = 1;
+	}
+	else if (success != VK_SUCCESS)
+	{
+		LOG_ERROR("Failed to present swap chain image %u", image_index);
+	}
+
+	presented = timer_now_ns();
+	renderer.stats.present_ms = timer_ns_to_ms(presented - submitted);
+}
+
+void renderer_get_frame_stats(RendererFrameStats *stats)
+{
+	*stats = renderer.stats;
+}
+
+uint32_t renderer_get_gpu_timings(const GpuScopeTiming **timings)
+{
+	*timings = renderer.gpu_profiler->results;
+	return renderer.gpu_profiler->result_count;
+}
+
+ENGINE_ERROR renderer_read_pixels(void *pixels)
+{
+	FrameSync *sync = renderer.frame_sync;
+
+	if (!renderer.headless || renderer.offscreen->readback_commands == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_INIT_FAILED,
+		                           "Renderer was not initalised with readback");
+	}
+
+	if (sync->images_in_flight[renderer.last_image] != VK_NULL_HANDLE)
+	{
+		vkWaitForFences(renderer.device->logical_device,
+		                1,
+		                &sync->images_in_flight[renderer.last_image],
+		                VK_TRUE,
+		                UINT64_MAX);
+	}
+
+	return offscreen_target_read(renderer.offscreen,
+	                             renderer.device,
+	                             renderer.last_image,
+	                             pixels);
 }
\ No newline at end of file
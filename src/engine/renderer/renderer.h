@@ -1,19 +1,146 @@
 #ifndef _RENDERER_H_
 #define _RENDERER_H_
 
+#include <stdint.h>
+
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
 #include "core/window.h"
 #include "core/debug.h"
+#include "core/maths.h"
+
+#include "world/mesher.h"
+
+#define RENDERER_DEFAULT_FRAMES_IN_FLIGHT 2
+#define RENDERER_DEFAULT_RECORD_BUDGET_MS 2.0
+#define RENDERER_DEFAULT_MESH_MEMORY      (128ull * 1024 * 1024)
+
+/******************************************************************************
+ * @name  _RendererPresentMode
+ * @brief How finished frames are handed to the display.
+******************************************************************************/
+enum _RendererPresentMode
+{
+	RENDERER_PRESENT_MODE_MAILBOX,     /*< Synchronised to the display, newer
+	                                       frames replace queued ones. The
+	                                       default. */
+	RENDERER_PRESENT_MODE_IMMEDIATE,   /*< Unsynchronised, may tear. Lowest
+	                                       latency and uncapped throughput. */
+	RENDERER_PRESENT_MODE_FIFO,        /*< Synchronised to the display, the CPU
+	                                       waits when the queue is full. */
+	RENDERER_PRESENT_MODE_FIFO_RELAXED /*< As FIFO, but a late frame is shown
+	                                       straight away and may tear. */
+};
+typedef enum _RendererPresentMode RendererPresentMode;
+
+/******************************************************************************
+ * @name  _RendererSettings
+ * @brief Options that are fixed when the renderer is initalised.
+******************************************************************************/
+struct _RendererSettings
+{
+	uint32_t frames_in_flight; /*< Frames the CPU may record ahead of the GPU. */
+
+	uint8_t headless;          /*< Render offscreen, no window or surface is used. */
+	uint32_t headless_width;   /*< The width of the offscreen images. */
+	uint32_t headless_height;  /*< The height of the offscreen images. */
+	uint8_t headless_readback; /*< Allow frames to be read with renderer_read_pixels(). */
+
+	RendererPresentMode present_mode; /*< Falls back to a supported mode. */
+	uint32_t swap_chain_images;       /*< Images to present from, 0 for the
+	                                      default. Clamped to what the surface
+	                                      allows. */
+
+	uint8_t depth_prepass; /*< Lay down depth before shading, so each pixel is
+	                           shaded once however much geometry overlaps. */
+
+	const char *pipeline_cache_path; /*< Where pipelines are cached between runs,
+	                                     NULL for the default path. */
+
+	double record_budget_ms; /*< Time recording a frame should take, 0 for
+	                             the default. */
+
+	uint64_t mesh_memory; /*< Bytes set aside for chunk meshes, 0 for the
+	                          default. */
+	uint8_t cpu_culling;  /*< Cull and draw chunks one at a time on the CPU
+	                          even if the device could do it. */
+};
+typedef struct _RendererSettings RendererSettings;
+
+/******************************************************************************
+ * @name  _RendererCamera
+ * @brief Where the scene is viewed from. The world is right handed with +y up.
+******************************************************************************/
+struct _RendererCamera
+{
+	Vec3 position;
+	Vec3 target; /*< The point the camera looks at. */
+	float fov_y; /*< The vertical field of view in radians. */
+	float near;  /*< The distance to the near plane, there is no far plane. */
+};
+typedef struct _RendererCamera RendererCamera;
+
+/******************************************************************************
+ * @name  _RendererFrameStats
+ * @brief CPU and GPU timings of the most recently drawn frame.
+******************************************************************************/
+struct _RendererFrameStats
+{
+	double wait_ms;    /*< Waiting for a free frame and acquiring an image. */
+	double record_ms;  /*< Recording command buffers. */
+	double cull_ms;    /*< Finding the visible meshes, part of record_ms. */
+	double submit_ms;  /*< vkQueueSubmit(). */
+	double present_ms; /*< vkQueuePresentKHR(), 0 when headless. */
+	double gpu_ms;     /*< GPU time of the last completed use of this frame's
+	                       resources, negative if unavailable. */
+
+	uint32_t draw_count;        /*< Draws recorded, an indirect draw counts
+	                                once. */
+	uint8_t gpu_culled;         /*< Chunks were culled on the device. */
+	uint8_t record_over_budget; /*< Recording took longer than the budget. */
+};
+typedef struct _RendererFrameStats RendererFrameStats;
+
+/******************************************************************************
+ * @name  _RendererMesh
+ * @brief A chunk mesh on the GPU, drawn every frame until it is destroyed.
+******************************************************************************/
+typedef struct _RendererMesh RendererMesh;
+
+/******************************************************************************
+ * @name  _GpuScopeTiming
+ * @brief The GPU time of a named section of a frame.
+******************************************************************************/
+struct _GpuScopeTiming
+{
+	const char *name;
+	uint32_t depth; /*< The number of enclosing sections. */
+	double ms;
+};
+typedef struct _GpuScopeTiming GpuScopeTiming;
 
 /******************************************************************************
- * @name   renderer_init()
- * @brief  Initalises the renderer for use.
- * @return A ENGINE_ERROR value to display the status of the initalisation. If
- *         successful ENGINE_OK.
+ * @name      renderer_init()
+ * @brief     Initalises the renderer for use. The job system must already be
+ *            running, frames are recorded across its threads.
+ * @param[in] window   The window to render to, may be NULL if headless.
+ * @param[in] settings The settings to initalise the renderer with.
+ * @return    A ENGINE_ERROR value to display the status of the initalisation.
+ *            If successful ENGINE_OK.
 ******************************************************************************/
-ENGINE_ERROR renderer_init(const Window *window);
+ENGINE_ERROR renderer_init(const Window *window,
+                           const RendererSettings *settings);
+
+/******************************************************************************
+ * @name       renderer_parse_present_mode()
+ * @brief      Parses the name of a present mode, such as from the command line.
+ * @param[in]  name The name: "immediate", "mailbox", "fifo" or "fifo_relaxed".
+ * @param[out] mode Set to the present mode if the name is recognised.
+ * @return     An ENGINE_ERROR value. If the name was recognised ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR renderer_parse_present_mode(const char *name,
+                                         RendererPresentMode *mode);
 
 /******************************************************************************
  * @name  renderer_deinit()
@@ -21,10 +148,87 @@ ENGINE_ERROR renderer_init(const Window *window);
 ******************************************************************************/
 void renderer_deinit();
 
+/******************************************************************************
+ * @name  renderer_resize()
+ * @brief Tells the renderer the window changed size. The swap chain is
+ *        recreated before the next frame is drawn.
+******************************************************************************/
+void renderer_resize();
+
+/******************************************************************************
+ * @name      renderer_set_camera()
+ * @brief     Sets the camera the next frames are drawn from.
+ * @param[in] camera The camera to copy.
+ * @return    void
+******************************************************************************/
+void renderer_set_camera(const RendererCamera *camera);
+
+/******************************************************************************
+ * @name       renderer_mesh_create()
+ * @brief      Uploads a chunk mesh to be drawn from the next frame on. Must be
+ *             called from the main thread.
+ * @param[out] mesh   A pointer to a pointer set to the created mesh.
+ * @param[in]  data   The vertices and indices to upload, may be freed after.
+ * @param      origin Where the mesh's chunk starts in the world, with the
+ *                    mesh's coordinates scaled by its level.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR renderer_mesh_create(RendererMesh **mesh,
+                                  const ChunkMesh *restrict data,
+                                  Vec3 origin);
+
+/******************************************************************************
+ * @name      renderer_mesh_destroy()
+ * @brief     Stops drawing a mesh. Its memory is freed once the frames in
+ *            flight that draw it have finished. Must be called from the main
+ *            thread.
+ * @param[in] mesh The mesh to destroy.
+ * @return    void
+******************************************************************************/
+void renderer_mesh_destroy(RendererMesh *mesh);
+
+/******************************************************************************
+ * @name      renderer_mesh_set_hidden()
+ * @brief     Stops drawing a mesh, such as one hidden behind something or
+ *            replaced by another level of detail, or starts drawing it again.
+ *            Meshes are created shown. Must be called from the main thread.
+ * @param[in] mesh   The mesh to change.
+ * @param     hidden Set if the mesh should not be drawn.
+ * @return    void
+******************************************************************************/
+void renderer_mesh_set_hidden(RendererMesh *mesh, uint8_t hidden);
+
 /******************************************************************************
  * @name  renderer_draw()
  * @brief Renderer a frame.
 ******************************************************************************/
 void renderer_draw();
 
+/******************************************************************************
+ * @name       renderer_get_frame_stats()
+ * @brief      Gets the timings of the most recently drawn frame.
+ * @param[out] stats The struct to store the timings in.
+ * @return     void
+******************************************************************************/
+void renderer_get_frame_stats(RendererFrameStats *stats);
+
+/******************************************************************************
+ * @name       renderer_get_gpu_timings()
+ * @brief      Gets the GPU time of each profiled section of the most recent
+ *             frame whose results are available, a few frames behind the one
+ *             being drawn. Sections are ordered by when they started.
+ * @param[out] timings Set to the timings, valid until the next frame is drawn.
+ * @return     The number of timings.
+******************************************************************************/
+uint32_t renderer_get_gpu_timings(const GpuScopeTiming **timings);
+
+/******************************************************************************
+ * @name       renderer_read_pixels()
+ * @brief      Copies the most recently drawn frame of a headless renderer that
+ *             was initalised with readback, waiting for it to finish first.
+ * @param[out] pixels Memory for width * height RGBA8 pixels.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR renderer_read_pixels(void *pixels);
+
 #endif /* _RENDERER_H_ */
\ No newline at end of file
@@ -0,0 +1,20 @@
+#include "shader_library.h"
+
+#include <string.h>
+
+/* Generated from assets/ by tools/embed_spirv.py. */
+extern const ShaderBinary shader_library_binaries[];
+extern const uint32_t shader_library_binary_count;
+
+const ShaderBinary *shader_library_find(const char *name)
+{
+	for (uint32_t i = 0; i < shader_library_binary_count; i++)
+	{
+		if (strcmp(shader_library_binaries[i].name, name) == 0)
+		{
+			return &shader_library_binaries[i];
+		}
+	}
+
+	return NULL;
+}
@@ -0,0 +1,28 @@
+#ifndef _SHADER_LIBRARY_H_
+#define _SHADER_LIBRARY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/******************************************************************************
+ * @name  _ShaderBinary
+ * @brief A SPIR-V binary compiled from assets/ and embedded in the engine at
+ *        build time.
+******************************************************************************/
+struct _ShaderBinary
+{
+	const char *name;     /*< The GLSL source file name, e.g. "vertex.vert". */
+	const uint32_t *code;
+	size_t size;          /*< The size of code in bytes. */
+};
+typedef struct _ShaderBinary ShaderBinary;
+
+/******************************************************************************
+ * @name      shader_library_find()
+ * @brief     Finds an embedded shader by name.
+ * @param[in] name The file name of the shader's GLSL source.
+ * @return    The shader, or NULL if no shader has that name.
+******************************************************************************/
+const ShaderBinary *shader_library_find(const char *name);
+
+#endif /* _SHADER_LIBRARY_H_ */
@@ -33,24 +33,97 @@ static ENGINE_ERROR swap_chain_get_surface_format(const SwapChain *swap_chain,
 }
 
 /******************************************************************************
- * @name      swap_chain_get_present_mode()
- * @brief     Gets a present mode for the swap chain to use.
- * @param[in] swap_chain The swapchain to check for a present mode.
- * @return    A present mode to be used for the specified swap chain.
+ * @name      swap_chain_supports_present_mode()
+ * @brief     Checks whether the surface of a swap chain supports a present mode.
+ * @param[in] swap_chain The swap chain to check.
+ * @param     mode       The present mode to look for.
+ * @return    1 if the mode is supported, otherwise 0.
 ******************************************************************************/
-static VkPresentModeKHR swap_chain_get_present_mode(const SwapChain *swap_chain)
+static int swap_chain_supports_present_mode(const SwapChain *swap_chain,
+                                            VkPresentModeKHR mode)
 {
 	for (uint32_t i = 0; i < swap_chain->support.present_modes_count; i++)
 	{
-		if (swap_chain->support.present_modes[i] == VK_PRESENT_MODE_MAILBOX_KHR)
+		if (swap_chain->support.present_modes[i] == mode)
 		{
-			return swap_chain->support.present_modes[i];
+			return 1;
 		}
 	}
-	
-	LOG_WARNING("No present mode of type VK_PRESENT_MODE_MAILBOX_KHR was found."
-	             " Using VK_PRESENT_MODE_FIFO_KHR instead.");
-	return VK_PRESENT_MODE_FIFO_KHR;
+
+	return 0;
+}
+
+/******************************************************************************
+ * @name      swap_chain_get_present_mode()
+ * @brief     Gets a present mode for the swap chain to use. When the preferred
+ *            mode is unsupported a mode with similar latency is tried: the
+ *            unsynchronised modes fall back to each other before FIFO, which
+ *            every surface supports.
+ * @param[in] swap_chain The swapchain to check for a present mode.
+ * @param     preferred  The present mode that was asked for.
+ * @return    A present mode to be used for the specified swap chain.
+******************************************************************************/
+static VkPresentModeKHR swap_chain_get_present_mode(const SwapChain *swap_chain,
+                                                    VkPresentModeKHR preferred)
+{
+	VkPresentModeKHR fallback = VK_PRESENT_MODE_FIFO_KHR;
+
+	if (swap_chain_supports_present_mode(swap_chain, preferred))
+	{
+		return preferred;
+	}
+
+	if (preferred == VK_PRESENT_MODE_IMMEDIATE_KHR
+	    && swap_chain_supports_present_mode(swap_chain, VK_PRESENT_MODE_MAILBOX_KHR))
+	{
+		fallback = VK_PRESENT_MODE_MAILBOX_KHR;
+	}
+	else if (preferred == VK_PRESENT_MODE_MAILBOX_KHR
+	         && swap_chain_supports_present_mode(swap_chain, VK_PRESENT_MODE_IMMEDIATE_KHR))
+	{
+		fallback = VK_PRESENT_MODE_IMMEDIATE_KHR;
+	}
+
+	LOG_WARNING("Present mode %d is not supported. Using present mode %d instead.",
+	            preferred,
+	            fallback);
+	return fallback;
+}
+
+/******************************************************************************
+ * @name      swap_chain_get_image_count()
+ * @brief     Gets the number of images for the swap chain to request.
+ * @param[in] swap_chain The swap chain whose surface limits the count.
+ * @param     preferred  The number of images that was asked for, 0 for one
+ *                       more than the minimum so the CPU never waits on the
+ *                       image being scanned out.
+ * @return    The image count to request.
+******************************************************************************/
+static uint32_t swap_chain_get_image_count(const SwapChain *swap_chain,
+                                           uint32_t preferred)
+{
+	const VkSurfaceCapabilitiesKHR *capabilities = &swap_chain->support.capabilities;
+	uint32_t image_count = preferred > 0 ? preferred : capabilities->minImageCount + 1;
+
+	if (image_count < capabilities->minImageCount)
+	{
+		image_count = capabilities->minImageCount;
+	}
+
+	/* A maximum of 0 means there is no limit. */
+	if (capabilities->maxImageCount > 0 && image_count > capabilities->maxImageCount)
+	{
+		image_count = capabilities->maxImageCount;
+	}
+
+	if (preferred > 0 && image_count != preferred)
+	{
+		LOG_WARNING("%u swap chain images are not supported. Using %u instead.",
+		            preferred,
+		            image_count);
+	}
+
+	return image_count;
 }
 
 /******************************************************************************
@@ -156,46 +229,75 @@ static ENGINE_ERROR swap_chain_image_views_create(SwapChain *restrict swap_chain
 	return ENGINE_OK;
 }
 
-ENGINE_ERROR swap_chain_create(SwapChain **swap_chain,
-                               const Window *restrict window,
-                               const Device *restrict device,
-                               const VkSurfaceKHR *restrict surface)
+/******************************************************************************
+ * @name   swap_chain_result_to_error()
+ * @brief  Logs why a swap chain could not be created.
+ * @param  success The result of vkCreateSwapchainKHR().
+ * @return The matching ENGINE_ERROR value.
+******************************************************************************/
+static ENGINE_ERROR swap_chain_result_to_error(VkResult success)
 {
-	*swap_chain = malloc(sizeof(SwapChain));
-	VkSurfaceFormatKHR surface_format;
-	VkPresentModeKHR present_mode;
-	VkExtent2D swap_chain_extent;
-	uint32_t image_count = 0;
-	uint32_t queue_family_indicies[2];
-	ENGINE_ERROR error;
-	VkResult success;
-
-	(*swap_chain)->support = device->swap_chain_details;
-
-	error = swap_chain_get_surface_format(*swap_chain, &surface_format);
-	if (error != ENGINE_OK)
+	if (success == VK_ERROR_OUT_OF_HOST_MEMORY
+	    || success == VK_ERROR_OUT_OF_DEVICE_MEMORY)
 	{
-		free(*swap_chain);
-		ENGINE_LOG_RETURN_IF_ERROR(error, "Failed to find valid swap chain surface format");
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to create swap chain, insufficient"
+		                           "host/device memory");
 	}
-
-	present_mode = swap_chain_get_present_mode(*swap_chain);
-	swap_chain_extent = swap_chain_get_extent(*swap_chain, window);
-
-	image_count = (*swap_chain)->support.capabilities.minImageCount + 1;
-	if ((*swap_chain)->support.capabilities.maxImageCount > 0
-	    && image_count > (*swap_chain)->support.capabilities.maxImageCount)
+	else if (success == VK_ERROR_DEVICE_LOST)
 	{
-		image_count = (*swap_chain)->support.capabilities.maxImageCount;
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_DEVICE_LOST,
+		                           "Device was lost while creating swap chain");
 	}
+	else if (success == VK_ERROR_SURFACE_LOST_KHR)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_SURFACE_LOST,
+		                           "Surface was lost while creating swap chain");
+	}
+	else if (success == VK_ERROR_NATIVE_WINDOW_IN_USE_KHR)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_WINDOW_IN_USE,
+		                           "Window is already in use by Vulkan or another API");
+	}
+
+	LOG_ERROR("Failed to initalise swap chain");
+	return ENGINE_ERROR_INIT_FAILED;
+}
+
+/******************************************************************************
+ * @name      swap_chain_build()
+ * @brief     Creates the swap chain handle, images and image views for the
+ *            format, present mode and image count already chosen.
+ * @param[in] swap_chain     The swap chain to fill in.
+ * @param[in] window         The window the images are created for.
+ * @param[in] device         The device that the swap chain belongs to.
+ * @param[in] surface        The surface that images will be presented to.
+ * @param     color_space    The colour space of the chosen format.
+ * @param     image_count    The number of images to request.
+ * @param     old_swap_chain The swap chain being replaced, or VK_NULL_HANDLE.
+ *                           It is retired whether or not this succeeds.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR swap_chain_build(SwapChain *restrict swap_chain,
+                                     const Window *restrict window,
+                                     const Device *restrict device,
+                                     const VkSurfaceKHR *restrict surface,
+                                     VkColorSpaceKHR color_space,
+                                     uint32_t image_count,
+                                     VkSwapchainKHR old_swap_chain)
+{
+	uint32_t queue_family_indicies[2];
+	VkResult success;
+
+	swap_chain->extent = swap_chain_get_extent(swap_chain, window);
 
 	VkSwapchainCreateInfoKHR swap_chain_info = {
 		.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
 		.surface = *surface,
 		.minImageCount = image_count,
-		.imageFormat = surface_format.format,
-		.imageColorSpace = surface_format.colorSpace,
-		.imageExtent = swap_chain_extent,
+		.imageFormat = swap_chain->format,
+		.imageColorSpace = color_space,
+		.imageExtent = swap_chain->extent,
 		.imageArrayLayers = 1,
 		.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
 	};
@@ -216,92 +318,166 @@ ENGINE_ERROR swap_chain_create(SwapChain **swap_chain,
 		swap_chain_info.pQueueFamilyIndices = NULL;
 	}
 
-	swap_chain_info.preTransform = (*swap_chain)->support.capabilities.currentTransform;
+	swap_chain_info.preTransform = swap_chain->support.capabilities.currentTransform;
 	swap_chain_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 
-	swap_chain_info.presentMode = present_mode;
+	swap_chain_info.presentMode = swap_chain->present_mode;
 	swap_chain_info.clipped = VK_TRUE;
 
-	swap_chain_info.oldSwapchain = VK_NULL_HANDLE;
+	/* Lets the driver hand resources of the old swap chain to the new one. */
+	swap_chain_info.oldSwapchain = old_swap_chain;
 
 	success = vkCreateSwapchainKHR(device->logical_device,
 	                               &swap_chain_info,
 	                               NULL,
-	                               &(*swap_chain)->handle);
+	                               &swap_chain->handle);
 
 	if (success != VK_SUCCESS)
 	{
-		free(swap_chain);
-		if (success & VK_ERROR_OUT_OF_HOST_MEMORY
-			|| success == VK_ERROR_OUT_OF_DEVICE_MEMORY)
-		{
-			ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
-			                           "Failed to create swap chain, insufficient"
-			                           "host/device memory");
-		}
-		else if (success == VK_ERROR_INITIALIZATION_FAILED)
-		{
-			ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_INIT_FAILED,
-			                           "Failed to initalise instance");
-		}
-		else if (success == VK_ERROR_DEVICE_LOST)
-		{
-			ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_DEVICE_LOST,
-			                           "Device was lost while creating swap chain");
-		}
-		else if (success == VK_ERROR_SURFACE_LOST_KHR)
-		{
-			ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_SURFACE_LOST,
-			                           "Surface was lost while creating swap chain");
-		}
-		else if (success == VK_ERROR_NATIVE_WINDOW_IN_USE_KHR)
-		{
-			ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_WINDOW_IN_USE,
-			                           "Window is already in use by Vulkan or another API");
-		}
+		swap_chain->handle = VK_NULL_HANDLE;
+		return swap_chain_result_to_error(success);
 	}
 
 	vkGetSwapchainImagesKHR(device->logical_device,
-	                        (*swap_chain)->handle,
-	                        &(*swap_chain)->image_count,
+	                        swap_chain->handle,
+	                        &swap_chain->image_count,
 	                        NULL);
 
-	(*swap_chain)->images = malloc(sizeof(VkImage) * image_count);
+	swap_chain->images = malloc(sizeof(VkImage) * swap_chain->image_count);
 	vkGetSwapchainImagesKHR(device->logical_device,
-	                        (*swap_chain)->handle,
-	                        &(*swap_chain)->image_count,
-	                        (*swap_chain)->images);
+	                        swap_chain->handle,
+	                        &swap_chain->image_count,
+	                        swap_chain->images);
 
-	(*swap_chain)->format = surface_format.format;
-	(*swap_chain)->extent = swap_chain_extent;
-
-	if (swap_chain_image_views_create(*swap_chain, device) != ENGINE_OK)
+	if (swap_chain_image_views_create(swap_chain, device) != ENGINE_OK)
 	{
 		vkDestroySwapchainKHR(device->logical_device,
-		                      (*swap_chain)->handle,
+		                      swap_chain->handle,
 		                      NULL);
-		free((*swap_chain)->images);
-		free(*swap_chain);
+		free(swap_chain->images);
+		swap_chain->handle = VK_NULL_HANDLE;
+		swap_chain->images = NULL;
+		swap_chain->image_count = 0;
 		return ENGINE_ERROR_INIT_FAILED;
 	}
 
 	return ENGINE_OK;
 }
 
-void swap_chain_destroy(SwapChain *swap_chain, const Device *device)
+/******************************************************************************
+ * @name      swap_chain_release()
+ * @brief     Destroys the handle, image views and image list of a swap chain
+ *            without freeing the SwapChain struct.
+ * @param[in] handle      The swap chain handle.
+ * @param[in] images      The swap chain's images.
+ * @param[in] image_views The swap chain's image views.
+ * @param     image_count The number of images.
+ * @param[in] device      The device that the swap chain belongs to.
+ * @return    void
+******************************************************************************/
+static void swap_chain_release(VkSwapchainKHR handle,
+                               VkImage *images,
+                               VkImageView *image_views,
+                               uint32_t image_count,
+                               const Device *device)
 {
-	for (int i = 0; i < swap_chain->image_count; i++)
+	for (uint32_t i = 0; i < image_count; i++)
 	{
-		vkDestroyImageView(device->logical_device,
-		                   swap_chain->image_views[i],
-		                   NULL);
+		vkDestroyImageView(device->logical_device, image_views[i], NULL);
 	}
 
-	vkDestroySwapchainKHR(device->logical_device,
-	                      swap_chain->handle,
-	                      NULL);
+	vkDestroySwapchainKHR(device->logical_device, handle, NULL);
+
+	free(image_views);
+	free(images);
+}
 
-	free(swap_chain->image_views);
-	free(swap_chain->images);
+ENGINE_ERROR swap_chain_create(SwapChain **swap_chain,
+                               const Window *restrict window,
+                               const Device *restrict device,
+                               const VkSurfaceKHR *restrict surface,
+                               VkPresentModeKHR present_mode,
+                               uint32_t image_count)
+{
+	*swap_chain = malloc(sizeof(SwapChain));
+	VkSurfaceFormatKHR surface_format;
+	ENGINE_ERROR error;
+
+	(*swap_chain)->support = device->swap_chain_details;
+	(*swap_chain)->images = NULL;
+	(*swap_chain)->image_views = NULL;
+	(*swap_chain)->image_count = 0;
+
+	error = swap_chain_get_surface_format(*swap_chain, &surface_format);
+	if (error != ENGINE_OK)
+	{
+		free(*swap_chain);
+		ENGINE_LOG_RETURN_IF_ERROR(error, "Failed to find valid swap chain surface format");
+	}
+
+	(*swap_chain)->format = surface_format.format;
+	(*swap_chain)->color_space = surface_format.colorSpace;
+	(*swap_chain)->present_mode = swap_chain_get_present_mode(*swap_chain, present_mode);
+	(*swap_chain)->preferred_image_count = image_count;
+
+	error = swap_chain_build(*swap_chain,
+	                         window,
+	                         device,
+	                         surface,
+	                         surface_format.colorSpace,
+	                         swap_chain_get_image_count(*swap_chain, image_count),
+	                         VK_NULL_HANDLE);
+	if (error != ENGINE_OK)
+	{
+		free(*swap_chain);
+		return error;
+	}
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR swap_chain_recreate(SwapChain *restrict swap_chain,
+                                 const Window *restrict window,
+                                 const Device *restrict device,
+                                 const VkSurfaceKHR *restrict surface)
+{
+	VkSwapchainKHR old_handle = swap_chain->handle;
+	VkImage *old_images = swap_chain->images;
+	VkImageView *old_image_views = swap_chain->image_views;
+	uint32_t old_image_count = swap_chain->image_count;
+	ENGINE_ERROR error;
+
+	/* The extent and transform change with the window. */
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device->physical_device,
+	                                          *surface,
+	                                          &swap_chain->support.capabilities);
+
+	swap_chain->images = NULL;
+	swap_chain->image_views = NULL;
+	swap_chain->image_count = 0;
+
+	error = swap_chain_build(swap_chain,
+	                         window,
+	                         device,
+	                         surface,
+	                         swap_chain->color_space,
+	                         swap_chain_get_image_count(swap_chain,
+	                                                    swap_chain->preferred_image_count),
+	                         old_handle);
+
+	/* The old swap chain was retired either way, only its resources remain. */
+	swap_chain_release(old_handle, old_images, old_image_views, old_image_count, device);
+
+	ENGINE_LOG_RETURN_IF_ERROR(error, "Failed to recreate swap chain");
+	return ENGINE_OK;
+}
+
+void swap_chain_destroy(SwapChain *swap_chain, const Device *device)
+{
+	swap_chain_release(swap_chain->handle,
+	                   swap_chain->images,
+	                   swap_chain->image_views,
+	                   swap_chain->image_count,
+	                   device);
 	free(swap_chain);
 }
@@ -21,25 +21,53 @@ struct _SwapChain
 	uint32_t image_count;
 
 	VkFormat format;
+	VkColorSpaceKHR color_space;
 	VkExtent2D extent;
+	VkPresentModeKHR present_mode;
+	uint32_t preferred_image_count; /*< As passed to swap_chain_create(). */
 };
 typedef struct _SwapChain SwapChain;
 
 /******************************************************************************
  * @name       swap_chain_create()
  * @brief      Creates a swap chain.
- * @param[out] swap_chain A pointer to pointer of a SwapChain struct that will be
- *                        set.
- * @param[in]  window     The window that the swap chain images will be created for.
- * @param[in]  device     The device that the swap chain belongs to.
- * @param[in]  surface    The surface that images will be presented to.
+ * @param[out] swap_chain   A pointer to pointer of a SwapChain struct that will be
+ *                          set.
+ * @param[in]  window       The window that the swap chain images will be created for.
+ * @param[in]  device       The device that the swap chain belongs to.
+ * @param[in]  surface      The surface that images will be presented to.
+ * @param      present_mode The preferred present mode. If the surface does not
+ *                          support it the closest supported mode is used.
+ * @param      image_count  The preferred number of images, clamped to what the
+ *                          surface allows. 0 for one more than the minimum.
  * @return     An ENGINE_ERROR value. If the swap chain creation/initalisation was
  *             successful ENGINE_OK.
 ******************************************************************************/
 ENGINE_ERROR swap_chain_create(SwapChain **swap_chain,
                                const Window *restrict window,
                                const Device *restrict device,
-                               const VkSurfaceKHR *restrict surface);
+                               const VkSurfaceKHR *restrict surface,
+                               VkPresentModeKHR present_mode,
+                               uint32_t image_count);
+
+/******************************************************************************
+ * @name      swap_chain_recreate()
+ * @brief     Replaces the images of a swap chain after the window changed size,
+ *            passing the old swap chain to the driver so it can reuse its
+ *            resources. The format and present mode are kept, so render passes
+ *            and pipelines created for the swap chain stay valid. Nothing may
+ *            still be using the old images.
+ * @param[in] swap_chain The swap chain to recreate.
+ * @param[in] window     The window that the swap chain images are created for.
+ * @param[in] device     The device that the swap chain belongs to.
+ * @param[in] surface    The surface that images are presented to.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK. On failure the
+ *            swap chain has no images and may be recreated again.
+******************************************************************************/
+ENGINE_ERROR swap_chain_recreate(SwapChain *restrict swap_chain,
+                                 const Window *restrict window,
+                                 const Device *restrict device,
+                                 const VkSurfaceKHR *restrict surface);
 
 /******************************************************************************
  * @name      swap_chain_destroy()
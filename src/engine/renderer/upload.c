@@ -0,0 +1,706 @@
+#include "upload.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/logger.h"
+
+static inline VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/******************************************************************************
+ * @name      ring_is_empty()
+ * @brief     Checks if no copy is using the staging ring.
+ * @param[in] context The context to check.
+ * @return    1 if the ring is empty, else 0.
+******************************************************************************/
+static uint8_t ring_is_empty(const UploadContext *context)
+{
+	if (context->batches[context->current].copy_count > 0)
+	{
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < UPLOAD_BATCH_COUNT; i++)
+	{
+		if (context->batches[i].pending)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/******************************************************************************
+ * @name       ring_reserve()
+ * @brief      Reserves space in the staging ring, wrapping to the start when
+ *             the end of the ring is too small.
+ * @param[in]  context The context to reserve from.
+ * @param      size    The number of bytes to reserve.
+ * @param[out] offset  Set to the offset of the reserved space.
+ * @return     1 if the space was reserved, else 0.
+******************************************************************************/
+static uint8_t ring_reserve(UploadContext *context,
+                            VkDeviceSize size,
+                            VkDeviceSize *offset)
+{
+	if (ring_is_empty(context))
+	{
+		context->head = 0;
+		context->tail = 0;
+	}
+	else if (context->head == context->tail)
+	{
+		/* Full, the head has caught up with the tail. */
+		return 0;
+	}
+
+	if (context->head >= context->tail)
+	{
+		if (context->staging_size - context->head >= size)
+		{
+			*offset = context->head;
+		}
+		else if (context->tail >= size)
+		{
+			*offset = 0;
+		}
+		else
+		{
+			return 0;
+		}
+	}
+	else if (context->tail - context->head >= size)
+	{
+		*offset = context->head;
+	}
+	else
+	{
+		return 0;
+	}
+
+	context->head = *offset + size;
+	return 1;
+}
+
+/******************************************************************************
+ * @name      retire_oldest()
+ * @brief     Waits for the oldest pending batch and releases its staging
+ *            memory.
+ * @param[in] context The context the batch belongs to.
+ * @param[in] device  The device uploads are made to.
+ * @param     wait    If 0 the batch is only retired if already finished.
+ * @return    1 if a batch was retired, else 0.
+******************************************************************************/
+static uint8_t retire_oldest(UploadContext *context,
+                             const Device *device,
+                             uint8_t wait)
+{
+	struct UploadBatch *batch = &context->batches[context->oldest];
+
+	if (!batch->pending)
+	{
+		return 0;
+	}
+
+	if (wait)
+	{
+		vkWaitForFences(device->logical_device,
+		                1,
+		                &batch->fence,
+		                VK_TRUE,
+		                UINT64_MAX);
+	}
+	else if (vkGetFenceStatus(device->logical_device, batch->fence) != VK_SUCCESS)
+	{
+		return 0;
+	}
+
+	vkResetFences(device->logical_device, 1, &batch->fence);
+	batch->pending = 0;
+	batch->copy_count = 0;
+
+	context->tail = batch->ring_end;
+	context->oldest = (context->oldest + 1) % UPLOAD_BATCH_COUNT;
+
+	return 1;
+}
+
+/******************************************************************************
+ * @name      reserve_barrier()
+ * @brief     Makes room for the release barrier of one more copy in a batch.
+ * @param[in] batch The batch the copy will be recorded into.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR reserve_barrier(struct UploadBatch *batch)
+{
+	if (batch->copy_count == batch->barrier_capacity)
+	{
+		uint32_t capacity = batch->barrier_capacity == 0
+		                    ? 16
+		                    : batch->barrier_capacity * 2;
+		VkBufferMemoryBarrier *barriers = realloc(batch->barriers,
+		                                          sizeof(VkBufferMemoryBarrier)
+		                                          * capacity);
+		if (barriers == NULL)
+		{
+			ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+			                           "Failed to grow upload barriers");
+		}
+
+		batch->barriers = barriers;
+		batch->barrier_capacity = capacity;
+	}
+
+	return ENGINE_OK;
+}
+
+/******************************************************************************
+ * @name      record_ownership_transfer()
+ * @brief     Remembers a copied range so it can be released to the graphics
+ *            family when the batch is flushed. Room must have been made with
+ *            reserve_barrier().
+ * @param[in] batch       The batch the copy was recorded into.
+ * @param[in] context     The context the batch belongs to.
+ * @param     destination The buffer that was copied into.
+ * @param     offset      The offset of the copy.
+ * @param     size        The size of the copy.
+ * @return    void
+******************************************************************************/
+static void record_ownership_transfer(struct UploadBatch *batch,
+                                      const UploadContext *context,
+                                      VkBuffer destination,
+                                      VkDeviceSize offset,
+                                      VkDeviceSize size)
+{
+	VkBufferMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = 0,
+		.srcQueueFamilyIndex = context->queue_family,
+		.dstQueueFamilyIndex = context->acquire_family,
+		.buffer = destination,
+		.offset = offset,
+		.size = size
+	};
+
+	batch->barriers[batch->copy_count] = barrier;
+}
+
+/******************************************************************************
+ * @name       create_command_buffers()
+ * @brief      Creates a command pool for a queue family and allocates one
+ *             command buffer per batch from it.
+ * @param[in]  device          The device the pool belongs to.
+ * @param      queue_family    The queue family the buffers are submitted to.
+ * @param[out] pool            Set to the created pool.
+ * @param[out] command_buffers UPLOAD_BATCH_COUNT allocated command buffers.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR create_command_buffers(const Device *device,
+                                           uint32_t queue_family,
+                                           VkCommandPool *pool,
+                                           VkCommandBuffer *command_buffers)
+{
+	VkResult success;
+
+	VkCommandPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+		         | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = queue_family
+	};
+
+	success = vkCreateCommandPool(device->logical_device, &pool_info, NULL, pool);
+	if (success != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to create upload command pool");
+	}
+
+	VkCommandBufferAllocateInfo alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = *pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = UPLOAD_BATCH_COUNT
+	};
+
+	success = vkAllocateCommandBuffers(device->logical_device,
+	                                   &alloc_info,
+	                                   command_buffers);
+	if (success != VK_SUCCESS)
+	{
+		vkDestroyCommandPool(device->logical_device, *pool, NULL);
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate upload command buffers");
+	}
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR upload_context_create(UploadContext **context,
+                                   const Device *restrict device)
+{
+	const VkPhysicalDeviceMemoryProperties *memory_properties =
+		&device->allocator->memory_properties;
+	const VkMemoryPropertyFlags unified_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+	                                            | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+	                                            | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	VkCommandBuffer command_buffers[UPLOAD_BATCH_COUNT];
+	VkCommandBuffer acquire_command_buffers[UPLOAD_BATCH_COUNT];
+	ENGINE_ERROR error = ENGINE_OK;
+	VkResult success;
+
+	*context = malloc(sizeof(UploadContext));
+	if (*context == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate upload context");
+	}
+	memset(*context, 0, sizeof(UploadContext));
+	(*context)->staging_size = UPLOAD_STAGING_SIZE;
+	(*context)->queue = device->transfer_queue;
+	(*context)->queue_family = device->queue_family_indicies.graphics_family;
+	(*context)->acquire_queue = device->graphics_queue;
+	(*context)->acquire_family = device->queue_family_indicies.graphics_family;
+
+	/* Buffers are exclusive to one family, copies on a dedicated transfer
+	 * queue must hand ownership of what they write to the graphics family. */
+	if (device->queue_family_indicies.transfer_family != -1)
+	{
+		(*context)->queue_family = device->queue_family_indicies.transfer_family;
+		(*context)->ownership_transfer = 1;
+	}
+
+	/* Integrated GPUs share system memory, device local memory that is also
+	 * host visible can be written directly without a copy. */
+	if (device->properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU
+	    || device->properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU)
+	{
+		for (uint32_t i = 0; i < memory_properties->memoryTypeCount; i++)
+		{
+			if ((memory_properties->memoryTypes[i].propertyFlags & unified_flags)
+			    == unified_flags)
+			{
+				(*context)->unified_memory = 1;
+			}
+		}
+	}
+
+	(*context)->buffer_properties = (*context)->unified_memory
+	                                ? unified_flags
+	                                : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	VkBufferCreateInfo buffer_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = (*context)->staging_size,
+		.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+	};
+
+	success = vkCreateBuffer(device->logical_device,
+	                         &buffer_info,
+	                         NULL,
+	                         &(*context)->staging);
+	if (success != VK_SUCCESS)
+	{
+		error = ENGINE_ERROR_OUT_OF_MEMORY;
+		ENGINE_LOG_GOTO_IF_ERROR(error,
+		                         "Failed to create staging buffer",
+		                         staging_create_fail);
+	}
+
+	error = memory_allocate_buffer(device->allocator,
+	                               (*context)->staging,
+	                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+	                               | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	                               &(*context)->staging_memory);
+	ENGINE_GOTO_IF_ERROR(error, staging_memory_fail);
+
+	error = create_command_buffers(device,
+	                               (*context)->queue_family,
+	                               &(*context)->command_pool,
+	                               command_buffers);
+	ENGINE_GOTO_IF_ERROR(error, command_pool_fail);
+
+	if ((*context)->ownership_transfer)
+	{
+		error = create_command_buffers(device,
+		                               (*context)->acquire_family,
+		                               &(*context)->acquire_pool,
+		                               acquire_command_buffers);
+		ENGINE_GOTO_IF_ERROR(error, acquire_pool_fail);
+	}
+
+	VkFenceCreateInfo fence_info = {
+		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+		.flags = 0
+	};
+
+	VkSemaphoreCreateInfo semaphore_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+	};
+
+	for (uint32_t i = 0; i < UPLOAD_BATCH_COUNT; i++)
+	{
+		struct UploadBatch *batch = &(*context)->batches[i];
+
+		batch->commands = command_buffers[i];
+
+		success = vkCreateFence(device->logical_device,
+		                        &fence_info,
+		                        NULL,
+		                        &batch->fence);
+
+		if (success == VK_SUCCESS && (*context)->ownership_transfer)
+		{
+			batch->acquire_commands = acquire_command_buffers[i];
+			success = vkCreateSemaphore(device->logical_device,
+			                            &semaphore_info,
+			                            NULL,
+			                            &batch->transferred);
+		}
+
+		if (success != VK_SUCCESS)
+		{
+			error = ENGINE_ERROR_OUT_OF_MEMORY;
+			ENGINE_LOG_GOTO_IF_ERROR(error,
+			                         "Failed to create upload synchronisation",
+			                         sync_fail);
+		}
+	}
+
+	return ENGINE_OK;
+
+sync_fail:
+	for (uint32_t i = 0; i < UPLOAD_BATCH_COUNT; i++)
+	{
+		vkDestroyFence(device->logical_device, (*context)->batches[i].fence, NULL);
+		vkDestroySemaphore(device->logical_device,
+		                   (*context)->batches[i].transferred,
+		                   NULL);
+	}
+	vkDestroyCommandPool(device->logical_device, (*context)->acquire_pool, NULL);
+
+acquire_pool_fail:
+	vkDestroyCommandPool(device->logical_device, (*context)->command_pool, NULL);
+
+command_pool_fail:
+	memory_free(device->allocator, &(*context)->staging_memory);
+
+staging_memory_fail:
+	vkDestroyBuffer(device->logical_device, (*context)->staging, NULL);
+
+staging_create_fail:
+	free(*context);
+	*context = NULL;
+	return error;
+}
+
+void upload_context_destroy(UploadContext *context, const Device *device)
+{
+	while (retire_oldest(context, device, 1));
+
+	for (uint32_t i = 0; i < UPLOAD_BATCH_COUNT; i++)
+	{
+		vkDestroyFence(device->logical_device, context->batches[i].fence, NULL);
+		vkDestroySemaphore(device->logical_device,
+		                   context->batches[i].transferred,
+		                   NULL);
+		free(context->batches[i].barriers);
+	}
+
+	vkDestroyCommandPool(device->logical_device, context->command_pool, NULL);
+	vkDestroyCommandPool(device->logical_device, context->acquire_pool, NULL);
+	vkDestroyBuffer(device->logical_device, context->staging, NULL);
+	memory_free(device->allocator, &context->staging_memory);
+	free(context);
+}
+
+ENGINE_ERROR upload_buffer(UploadContext *restrict context,
+                           const Device *restrict device,
+                           VkBuffer destination,
+                           const MemoryAllocation *restrict memory,
+                           VkDeviceSize offset,
+                           const void *restrict data,
+                           VkDeviceSize size)
+{
+	const char *source = data;
+	ENGINE_ERROR error;
+
+	if (memory->mapped != NULL)
+	{
+		memcpy((char*)memory->mapped + offset, data, size);
+		return ENGINE_OK;
+	}
+
+	while (size > 0)
+	{
+		VkDeviceSize chunk = size < context->staging_size ? size
+		                                                  : context->staging_size;
+		VkDeviceSize staging_offset;
+		struct UploadBatch *batch;
+
+		for (;;)
+		{
+			/* The batch being recorded into may still be pending from
+			 * UPLOAD_BATCH_COUNT flushes ago. */
+			while (context->batches[context->current].pending)
+			{
+				retire_oldest(context, device, 1);
+			}
+
+			/* Before staging space is taken, so a failure leaves none of
+			 * it reserved. */
+			if (context->ownership_transfer)
+			{
+				error = reserve_barrier(&context->batches[context->current]);
+				ENGINE_RETURN_IF_ERROR(error);
+			}
+
+			if (ring_reserve(context, align_up(chunk, UPLOAD_ALIGNMENT), &staging_offset))
+			{
+				break;
+			}
+
+			if (context->batches[context->current].copy_count > 0)
+			{
+				error = upload_flush(context, device);
+				ENGINE_RETURN_IF_ERROR(error);
+			}
+			else if (!retire_oldest(context, device, 1))
+			{
+				ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+				                           "Staging ring cannot fit upload");
+			}
+		}
+
+		batch = &context->batches[context->current];
+
+		if (context->ownership_transfer)
+		{
+			record_ownership_transfer(batch, context, destination, offset, chunk);
+		}
+
+		memcpy((char*)context->staging_memory.mapped + staging_offset,
+		       source,
+		       chunk);
+
+		if (batch->copy_count == 0)
+		{
+			VkCommandBufferBeginInfo begin_info = {
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+				.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+			};
+
+			if (vkBeginCommandBuffer(batch->commands, &begin_info) != VK_SUCCESS)
+			{
+				ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+				                           "Failed to begin upload batch");
+			}
+		}
+
+		VkBufferCopy region = {
+			.srcOffset = staging_offset,
+			.dstOffset = offset,
+			.size = chunk
+		};
+
+		vkCmdCopyBuffer(batch->commands,
+		                context->staging,
+		                destination,
+		                1,
+		                &region);
+
+		batch->copy_count++;
+		batch->ring_end = context->head;
+
+		source += chunk;
+		offset += chunk;
+		size -= chunk;
+	}
+
+	return ENGINE_OK;
+}
+
+/******************************************************************************
+ * @name      submit_ownership_transfer()
+ * @brief     Releases the buffers a batch wrote from the transfer family and
+ *            acquires them on the graphics queue once the copies finish.
+ * @param[in] context The context the batch belongs to.
+ * @param[in] batch   The batch to submit. Its copies have been recorded.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR submit_ownership_transfer(UploadContext *context,
+                                              struct UploadBatch *batch)
+{
+	const VkPipelineStageFlags vertex_stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+	                                           | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+	VkResult success;
+
+	vkCmdPipelineBarrier(batch->commands,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+	                     0,
+	                     0,
+	                     NULL,
+	                     batch->copy_count,
+	                     batch->barriers,
+	                     0,
+	                     NULL);
+
+	if (vkEndCommandBuffer(batch->commands) != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to record upload batch");
+	}
+
+	/* The acquire mirrors the release, only the access masks change. */
+	for (uint32_t i = 0; i < batch->copy_count; i++)
+	{
+		batch->barriers[i].srcAccessMask = 0;
+		batch->barriers[i].dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+		                                   | VK_ACCESS_INDEX_READ_BIT
+		                                   | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	}
+
+	VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+
+	if (vkBeginCommandBuffer(batch->acquire_commands, &begin_info) != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to begin upload acquire");
+	}
+
+	vkCmdPipelineBarrier(batch->acquire_commands,
+	                     vertex_stages,
+	                     vertex_stages,
+	                     0,
+	                     0,
+	                     NULL,
+	                     batch->copy_count,
+	                     batch->barriers,
+	                     0,
+	                     NULL);
+
+	if (vkEndCommandBuffer(batch->acquire_commands) != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to record upload acquire");
+	}
+
+	VkSubmitInfo transfer_submit = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &batch->commands,
+		.signalSemaphoreCount = 1,
+		.pSignalSemaphores = &batch->transferred
+	};
+
+	success = vkQueueSubmit(context->queue, 1, &transfer_submit, VK_NULL_HANDLE);
+	if (success != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_DEVICE_LOST,
+		                           "Failed to submit upload batch");
+	}
+
+	/* Graphics work already submitted keeps running, only vertex input of
+	 * later work waits for the copies. The fence covers both submissions. */
+	VkSubmitInfo acquire_submit = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.waitSemaphoreCount = 1,
+		.pWaitSemaphores = &batch->transferred,
+		.pWaitDstStageMask = &vertex_stages,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &batch->acquire_commands
+	};
+
+	success = vkQueueSubmit(context->acquire_queue, 1, &acquire_submit, batch->fence);
+	if (success != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_DEVICE_LOST,
+		                           "Failed to submit upload acquire");
+	}
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR upload_flush(UploadContext *restrict context,
+                          const Device *restrict device)
+{
+	struct UploadBatch *batch = &context->batches[context->current];
+	ENGINE_ERROR error;
+	VkResult success;
+
+	if (batch->copy_count == 0)
+	{
+		return ENGINE_OK;
+	}
+
+	if (context->ownership_transfer)
+	{
+		error = submit_ownership_transfer(context, batch);
+		ENGINE_RETURN_IF_ERROR(error);
+
+		batch->pending = 1;
+		context->current = (context->current + 1) % UPLOAD_BATCH_COUNT;
+		return ENGINE_OK;
+	}
+
+	/* Later submissions to the queue read the copied data as vertex input. */
+	VkMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+		                 | VK_ACCESS_INDEX_READ_BIT
+		                 | VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+	};
+
+	vkCmdPipelineBarrier(batch->commands,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                     VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+	                     | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+	                     0,
+	                     1,
+	                     &barrier,
+	                     0,
+	                     NULL,
+	                     0,
+	                     NULL);
+
+	if (vkEndCommandBuffer(batch->commands) != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to record upload batch");
+	}
+
+	VkSubmitInfo submit_info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &batch->commands
+	};
+
+	success = vkQueueSubmit(context->queue, 1, &submit_info, batch->fence);
+	if (success != VK_SUCCESS)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_DEVICE_LOST,
+		                           "Failed to submit upload batch");
+	}
+
+	batch->pending = 1;
+	context->current = (context->current + 1) % UPLOAD_BATCH_COUNT;
+
+	return ENGINE_OK;
+}
+
+void upload_collect(UploadContext *restrict context,
+                    const Device *restrict device)
+{
+	while (retire_oldest(context, device, 0));
+}
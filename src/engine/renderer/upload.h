@@ -0,0 +1,143 @@
+#ifndef _UPLOAD_H_
+#define _UPLOAD_H_
+
+#include <stdint.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "core/debug.h"
+
+#include "devices.h"
+#include "memory.h"
+
+#define UPLOAD_STAGING_SIZE (16ull * 1024 * 1024)
+#define UPLOAD_BATCH_COUNT  4
+#define UPLOAD_ALIGNMENT    16
+
+/******************************************************************************
+ * @name  UploadBatch
+ * @brief A command buffer of copies submitted together and the fence that
+ *        signals when the staging memory they read from can be reused.
+ *
+ *        When copies run on a dedicated transfer queue the buffers they write
+ *        are released by the transfer queue and acquired by the graphics
+ *        queue with a second command buffer that waits on a semaphore.
+******************************************************************************/
+struct UploadBatch
+{
+	VkCommandBuffer commands;
+	VkFence fence;
+	VkDeviceSize ring_end; /*< Where the batch's last copy ends in the ring. */
+	uint32_t copy_count;
+	uint8_t pending;
+
+	/* Only used for ownership transfers. */
+	VkCommandBuffer acquire_commands;
+	VkSemaphore transferred;
+	VkBufferMemoryBarrier *barriers;
+	uint32_t barrier_capacity;
+};
+
+/******************************************************************************
+ * @name  _UploadContext
+ * @brief Copies data into device local buffers through a persistently mapped
+ *        staging ring. Copies are recorded into batches that are submitted to
+ *        the device's transfer queue on upload_flush() and retired once their
+ *        fence signals. On unified memory devices the destination buffers are
+ *        host visible and written directly, the ring is never used.
+ *
+ *        Not thread safe, uploads are expected from the render thread.
+******************************************************************************/
+struct _UploadContext
+{
+	VkBuffer staging;
+	MemoryAllocation staging_memory;
+	VkDeviceSize staging_size;
+	VkDeviceSize head; /*< Where the next copy is written. */
+	VkDeviceSize tail; /*< Start of the oldest copy still in use. */
+
+	VkCommandPool command_pool;
+	VkQueue queue;
+	uint32_t queue_family;
+
+	/* Set if queue is a dedicated transfer queue. */
+	uint8_t ownership_transfer;
+	VkCommandPool acquire_pool;
+	VkQueue acquire_queue;
+	uint32_t acquire_family;
+
+	struct UploadBatch batches[UPLOAD_BATCH_COUNT];
+	uint32_t current; /*< The batch copies are recorded into. */
+	uint32_t oldest;  /*< The oldest batch that may still be pending. */
+
+	uint8_t unified_memory;
+	VkMemoryPropertyFlags buffer_properties;
+};
+typedef struct _UploadContext UploadContext;
+
+/******************************************************************************
+ * @name       upload_context_create()
+ * @brief      Creates the staging ring and upload command buffers.
+ * @param[out] context A pointer to a pointer set to the created context.
+ * @param[in]  device  The device uploads are made to.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR upload_context_create(UploadContext **context,
+                                   const Device *restrict device);
+
+/******************************************************************************
+ * @name      upload_context_destroy()
+ * @brief     Waits for all pending uploads and destroys the context.
+ * @param[in] context The context to destroy.
+ * @param[in] device  The device uploads were made to.
+ * @return    void
+******************************************************************************/
+void upload_context_destroy(UploadContext *context, const Device *device);
+
+/******************************************************************************
+ * @name      upload_buffer()
+ * @brief     Copies data into a buffer. If the buffer is host visible the data
+ *            is written immediately, otherwise a copy is recorded into the
+ *            current batch and happens once the batch is flushed.
+ * @param[in] context     The context to upload with.
+ * @param[in] device      The device the buffer belongs to.
+ * @param     destination The buffer to copy into.
+ * @param[in] memory      The memory bound to the destination buffer.
+ * @param     offset      The offset into the destination buffer.
+ * @param[in] data        The data to copy.
+ * @param     size        The size of data.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR upload_buffer(UploadContext *restrict context,
+                           const Device *restrict device,
+                           VkBuffer destination,
+                           const MemoryAllocation *restrict memory,
+                           VkDeviceSize offset,
+                           const void *restrict data,
+                           VkDeviceSize size);
+
+/******************************************************************************
+ * @name      upload_flush()
+ * @brief     Submits the copies recorded so far. They are made visible to
+ *            vertex input of any work submitted to the graphics queue after,
+ *            which waits for them to finish before reading vertex input.
+ * @param[in] context The context to flush.
+ * @param[in] device  The device uploads are made to.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR upload_flush(UploadContext *restrict context,
+                          const Device *restrict device);
+
+/******************************************************************************
+ * @name      upload_collect()
+ * @brief     Retires batches whose fences have signalled without waiting, so
+ *            their staging memory can be reused. Called once per frame.
+ * @param[in] context The context to collect.
+ * @param[in] device  The device uploads are made to.
+ * @return    void
+******************************************************************************/
+void upload_collect(UploadContext *restrict context,
+                    const Device *restrict device);
+
+#endif /* _UPLOAD_H_ */
@@ -0,0 +1,596 @@
+#include "chunk.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "core/logger.h"
+
+#define CHUNK_HASH_MULTIPLIER 2654435761u /* Knuth's multiplicative hash. */
+
+static atomic_size_t total_memory;
+
+static inline size_t indices_size(uint8_t bits)
+{
+	return (size_t)CHUNK_VOLUME / 8 * bits;
+}
+
+/* The palette, its counts and a lookup table twice its size share one
+ * allocation. Direct chunks only count the blocks of each ID. */
+static inline size_t palette_storage_size(uint8_t bits)
+{
+	return bits <= CHUNK_MAX_PALETTE_BITS ? ((size_t)4 << bits) * sizeof(uint16_t)
+	                                      : ((size_t)1 << bits) * sizeof(uint16_t);
+}
+
+static inline uint32_t read_index(const uint64_t *indices, uint8_t bits, uint32_t index)
+{
+	uint32_t bit = index * bits;
+
+	return (uint32_t)(indices[bit >> 6] >> (bit & 63)) & ((1u << bits) - 1);
+}
+
+static inline void write_index(uint64_t *indices,
+                               uint8_t bits,
+                               uint32_t index,
+                               uint32_t value)
+{
+	uint32_t bit = index * bits;
+	uint64_t mask = (uint64_t)((1u << bits) - 1) << (bit & 63);
+
+	indices[bit >> 6] = (indices[bit >> 6] & ~mask) | ((uint64_t)value << (bit & 63));
+}
+
+/******************************************************************************
+ * @name   bits_for()
+ * @brief  Gets the narrowest index width that can tell apart a number of
+ *         distinct blocks.
+ * @param  distinct The number of distinct blocks, more than 1.
+ * @return The width in bits.
+******************************************************************************/
+static uint8_t bits_for(uint32_t distinct)
+{
+	for (uint8_t bits = 1; bits <= CHUNK_MAX_PALETTE_BITS; bits *= 2)
+	{
+		if (distinct <= 1u << bits)
+		{
+			return bits;
+		}
+	}
+
+	return CHUNK_DIRECT_BITS;
+}
+
+/******************************************************************************
+ * @name       storage_alloc()
+ * @brief      Allocates zeroed indices, and a palette or if they are direct
+ *             the counts of each ID, for an empty chunk.
+ * @param[out] chunk A chunk without storage.
+ * @param      bits  The width of each index.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR storage_alloc(Chunk *chunk, uint8_t bits)
+{
+	uint32_t capacity = 1u << bits;
+
+	memset(chunk, 0, sizeof(Chunk));
+	chunk->bits = bits;
+	chunk->indices = calloc(1, indices_size(bits));
+
+	if (bits <= CHUNK_MAX_PALETTE_BITS)
+	{
+		chunk->palette = calloc(1, palette_storage_size(bits));
+		chunk->counts = chunk->palette + capacity;
+		chunk->lookup = chunk->palette + 2 * capacity;
+	}
+	else
+	{
+		chunk->counts = calloc(1, palette_storage_size(bits));
+	}
+
+	if (chunk->indices == NULL
+	    || (bits <= CHUNK_MAX_PALETTE_BITS ? chunk->palette == NULL : chunk->counts == NULL))
+	{
+		free(chunk->indices);
+		free(chunk->palette == NULL ? chunk->counts : chunk->palette);
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate chunk storage");
+	}
+
+	atomic_fetch_add_explicit(&total_memory,
+	                          indices_size(bits) + palette_storage_size(bits),
+	                          memory_order_relaxed);
+	return ENGINE_OK;
+}
+
+static void storage_free(Chunk *chunk)
+{
+	if (chunk->bits == 0)
+	{
+		return;
+	}
+
+	atomic_fetch_sub_explicit(&total_memory,
+	                          indices_size(chunk->bits) + palette_storage_size(chunk->bits),
+	                          memory_order_relaxed);
+
+	free(chunk->indices);
+	free(chunk->palette == NULL ? chunk->counts : chunk->palette);
+}
+
+static inline uint32_t lookup_slot(uint8_t bits, BlockId block)
+{
+	return (block * CHUNK_HASH_MULTIPLIER) >> (32 - (bits + 1));
+}
+
+/******************************************************************************
+ * @name      palette_find()
+ * @brief     Finds a block's entry in a chunk's palette.
+ * @param[in] chunk A chunk with a palette.
+ * @param     block The block to find.
+ * @return    The block's palette index, or -1 if it has none.
+******************************************************************************/
+static int32_t palette_find(const Chunk *chunk, BlockId block)
+{
+	uint32_t mask = (2u << chunk->bits) - 1;
+
+	/* The table is never more than half full so probing always ends. */
+	for (uint32_t slot = lookup_slot(chunk->bits, block);
+	     chunk->lookup[slot] != 0;
+	     slot = (slot + 1) & mask)
+	{
+		if (chunk->palette[chunk->lookup[slot] - 1] == block)
+		{
+			return chunk->lookup[slot] - 1;
+		}
+	}
+
+	return -1;
+}
+
+/******************************************************************************
+ * @name      palette_add()
+ * @brief     Adds a block to a chunk's palette, which must have room.
+ * @param[in] chunk A chunk with a palette.
+ * @param     block The block to add, not already in the palette.
+ * @return    The block's palette index.
+******************************************************************************/
+static uint32_t palette_add(Chunk *chunk, BlockId block)
+{
+	uint32_t mask = (2u << chunk->bits) - 1;
+	uint32_t entry = chunk->palette_size++;
+	uint32_t slot = lookup_slot(chunk->bits, block);
+
+	while (chunk->lookup[slot] != 0)
+	{
+		slot = (slot + 1) & mask;
+	}
+
+	chunk->palette[entry] = block;
+	chunk->counts[entry] = 0;
+	chunk->lookup[slot] = (uint16_t)(entry + 1);
+
+	return entry;
+}
+
+/******************************************************************************
+ * @name      repack()
+ * @brief     Rewrites a chunk's blocks at another index width, keeping only
+ *            the palette entries in use.
+ * @param[in] chunk A chunk that is not uniform.
+ * @param     bits  The new width, wide enough for the chunk's blocks.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK, otherwise the
+ *            chunk is unchanged.
+******************************************************************************/
+static ENGINE_ERROR repack(Chunk *chunk, uint8_t bits)
+{
+	Chunk packed;
+	ENGINE_ERROR error;
+
+	error = storage_alloc(&packed, bits);
+	ENGINE_RETURN_IF_ERROR(error);
+
+	if (packed.palette == NULL)
+	{
+		for (uint32_t i = 0; i < CHUNK_VOLUME; i++)
+		{
+			BlockId block = chunk_get_index(chunk, i);
+
+			if (packed.counts[block]++ == 0)
+			{
+				packed.live++;
+			}
+			write_index(packed.indices, bits, i, block);
+		}
+	}
+	else if (chunk->palette != NULL)
+	{
+		uint16_t remap[1 << CHUNK_MAX_PALETTE_BITS];
+
+		for (uint32_t entry = 0; entry < chunk->palette_size; entry++)
+		{
+			if (chunk->counts[entry] > 0)
+			{
+				remap[entry] = palette_add(&packed, chunk->palette[entry]);
+				packed.counts[remap[entry]] = chunk->counts[entry];
+				packed.live++;
+			}
+		}
+
+		for (uint32_t i = 0; i < CHUNK_VOLUME; i++)
+		{
+			write_index(packed.indices,
+			            bits,
+			            i,
+			            remap[read_index(chunk->indices, chunk->bits, i)]);
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0; i < CHUNK_VOLUME; i++)
+		{
+			BlockId block = chunk_get_index(chunk, i);
+			int32_t entry = palette_find(&packed, block);
+
+			if (entry < 0)
+			{
+				entry = palette_add(&packed, block);
+				packed.live++;
+			}
+
+			packed.counts[entry]++;
+			write_index(packed.indices, bits, i, entry);
+		}
+	}
+
+	storage_free(chunk);
+	*chunk = packed;
+
+	return ENGINE_OK;
+}
+
+void chunk_init(Chunk *chunk, BlockId block)
+{
+	memset(chunk, 0, sizeof(Chunk));
+	chunk->uniform = block;
+}
+
+void chunk_deinit(Chunk *chunk)
+{
+	chunk_fill(chunk, BLOCK_AIR);
+}
+
+void chunk_fill(Chunk *chunk, BlockId block)
+{
+	storage_free(chunk);
+	chunk_init(chunk, block);
+}
+
+ENGINE_ERROR chunk_copy(Chunk *restrict destination, const Chunk *restrict source)
+{
+	Chunk copy;
+	ENGINE_ERROR error;
+
+	if (source->bits == 0)
+	{
+		chunk_fill(destination, source->uniform);
+		return ENGINE_OK;
+	}
+
+	/* Storage of the same width is overwritten rather than reallocated. */
+	if (destination->bits != source->bits)
+	{
+		error = storage_alloc(&copy, source->bits);
+		ENGINE_RETURN_IF_ERROR(error);
+
+		storage_free(destination);
+		*destination = copy;
+	}
+
+	memcpy(destination->indices, source->indices, indices_size(source->bits));
+	memcpy(source->palette != NULL ? destination->palette : destination->counts,
+	       source->palette != NULL ? source->palette : source->counts,
+	       palette_storage_size(source->bits));
+
+	destination->palette_size = source->palette_size;
+	destination->live = source->live;
+	destination->uniform = source->uniform;
+
+	return ENGINE_OK;
+}
+
+uint8_t chunk_equal(const Chunk *a, const Chunk *b)
+{
+	BlockId first[CHUNK_SIZE];
+	BlockId second[CHUNK_SIZE];
+
+	if (a->bits == 0 && b->bits == 0)
+	{
+		return a->uniform == b->uniform;
+	}
+
+	/* Chunks built the same way usually store their blocks the same way. */
+	if (a->bits == b->bits
+	    && a->palette_size == b->palette_size
+	    && (a->palette == NULL
+	        || memcmp(a->palette, b->palette, a->palette_size * sizeof(BlockId)) == 0)
+	    && memcmp(a->indices, b->indices, indices_size(a->bits)) == 0)
+	{
+		return 1;
+	}
+
+	for (uint32_t y = 0; y < CHUNK_SIZE; y++)
+	{
+		for (uint32_t z = 0; z < CHUNK_SIZE; z++)
+		{
+			chunk_get_row(a, y, z, first);
+			chunk_get_row(b, y, z, second);
+			if (memcmp(first, second, sizeof(first)) != 0)
+			{
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+void chunk_get_row(const Chunk *restrict chunk,
+                   uint32_t y,
+                   uint32_t z,
+                   BlockId *restrict row)
+{
+	uint32_t bit, mask;
+	const uint64_t *word;
+	uint64_t value;
+
+	if (chunk->bits == 0)
+	{
+		for (uint32_t x = 0; x < CHUNK_SIZE; x++)
+		{
+			row[x] = chunk->uniform;
+		}
+		return;
+	}
+
+	bit = chunk_index(0, y, z) * chunk->bits;
+	word = &chunk->indices[bit >> 6];
+	value = *word >> (bit & 63);
+	bit &= 63;
+	mask = (1u << chunk->bits) - 1;
+
+	for (uint32_t x = 0; x < CHUNK_SIZE; x++)
+	{
+		if (bit == 64)
+		{
+			value = *++word;
+			bit = 0;
+		}
+
+		row[x] = chunk->palette != NULL ? chunk->palette[value & mask]
+		                                : (BlockId)(value & mask);
+		value >>= chunk->bits;
+		bit += chunk->bits;
+	}
+}
+
+/******************************************************************************
+ * @name       decode_rows()
+ * @brief      Expands every byte of a chunk's indices through a table.
+ * @param[in]  words        The chunk's indices.
+ * @param[in]  table        The per_byte blocks of each value of a byte.
+ * @param      per_byte     Indices in each byte.
+ * @param[out] blocks       Where the first row is written.
+ * @param      row_stride   The distance between rows of consecutive z.
+ * @param      layer_stride The distance between rows of consecutive y.
+ * @return     void
+******************************************************************************/
+static inline void decode_rows(const uint64_t *restrict words,
+                               const BlockId *restrict table,
+                               uint32_t per_byte,
+                               BlockId *restrict blocks,
+                               uint32_t row_stride,
+                               uint32_t layer_stride)
+{
+	for (uint32_t y = 0, byte = 0; y < CHUNK_SIZE; y++)
+	{
+		for (uint32_t z = 0; z < CHUNK_SIZE; z++)
+		{
+			BlockId *row = &blocks[y * layer_stride + z * row_stride];
+
+			for (uint32_t x = 0; x < CHUNK_SIZE; x += per_byte, byte++)
+			{
+				uint32_t value = (uint32_t)(words[byte >> 3] >> ((byte & 7) * 8)) & 0xff;
+
+				memcpy(&row[x], &table[value * per_byte], per_byte * sizeof(BlockId));
+			}
+		}
+	}
+}
+
+void chunk_decode(const Chunk *restrict chunk,
+                  BlockId *restrict blocks,
+                  uint32_t row_stride,
+                  uint32_t layer_stride)
+{
+	BlockId table[256 * 8];
+	uint32_t per_byte;
+
+	if (chunk->bits == 0 || chunk->palette == NULL)
+	{
+		for (uint32_t y = 0; y < CHUNK_SIZE; y++)
+		{
+			for (uint32_t z = 0; z < CHUNK_SIZE; z++)
+			{
+				chunk_get_row(chunk, y, z, &blocks[y * layer_stride + z * row_stride]);
+			}
+		}
+		return;
+	}
+
+	/* The blocks of every value a byte of indices can hold. */
+	per_byte = 8 / chunk->bits;
+	for (uint32_t value = 0; value < 256; value++)
+	{
+		for (uint32_t i = 0; i < per_byte; i++)
+		{
+			uint32_t entry = (value >> (i * chunk->bits)) & ((1u << chunk->bits) - 1);
+
+			/* Indices past the palette only occur in unused bytes. */
+			table[value * per_byte + i] = entry < chunk->palette_size
+			                              ? chunk->palette[entry]
+			                              : BLOCK_AIR;
+		}
+	}
+
+	/* A constant width lets each row's copies be unrolled. */
+	switch (per_byte)
+	{
+		case 8:
+			decode_rows(chunk->indices, table, 8, blocks, row_stride, layer_stride);
+			break;
+		case 4:
+			decode_rows(chunk->indices, table, 4, blocks, row_stride, layer_stride);
+			break;
+		case 2:
+			decode_rows(chunk->indices, table, 2, blocks, row_stride, layer_stride);
+			break;
+		default:
+			decode_rows(chunk->indices, table, 1, blocks, row_stride, layer_stride);
+			break;
+	}
+}
+
+ENGINE_ERROR chunk_set_index(Chunk *chunk, uint32_t index, BlockId block)
+{
+	ENGINE_ERROR error;
+	int32_t entry;
+	uint32_t old;
+
+	if (chunk->bits == 0)
+	{
+		Chunk packed;
+
+		if (block == chunk->uniform)
+		{
+			return ENGINE_OK;
+		}
+
+		/* Zeroed indices all refer to the first entry, the old block. */
+		error = storage_alloc(&packed, 1);
+		ENGINE_RETURN_IF_ERROR(error);
+
+		packed.counts[palette_add(&packed, chunk->uniform)] = CHUNK_VOLUME;
+		packed.live = 1;
+		*chunk = packed;
+	}
+
+	if (chunk->palette == NULL)
+	{
+		old = read_index(chunk->indices, chunk->bits, index);
+		if (old == block)
+		{
+			return ENGINE_OK;
+		}
+
+		write_index(chunk->indices, chunk->bits, index, block);
+
+		if (chunk->counts[block]++ == 0)
+		{
+			chunk->live++;
+		}
+
+		/* Dropping back to a palette is only to save memory, as below. */
+		if (--chunk->counts[old] == 0 && --chunk->live == 1)
+		{
+			chunk_fill(chunk, block);
+		}
+		else if (bits_for(2 * chunk->live) < chunk->bits)
+		{
+			repack(chunk, bits_for(2 * chunk->live));
+		}
+
+		return ENGINE_OK;
+	}
+
+	entry = palette_find(chunk, block);
+	if (entry < 0)
+	{
+		if (chunk->palette_size == 1u << chunk->bits)
+		{
+			/* Unused entries are dropped first, the width may not change. */
+			error = repack(chunk, bits_for(chunk->live + 1));
+			ENGINE_RETURN_IF_ERROR(error);
+
+			return chunk_set_index(chunk, index, block);
+		}
+
+		entry = palette_add(chunk, block);
+	}
+
+	old = read_index(chunk->indices, chunk->bits, index);
+	if (old == (uint32_t)entry)
+	{
+		return ENGINE_OK;
+	}
+
+	write_index(chunk->indices, chunk->bits, index, entry);
+
+	if (chunk->counts[entry]++ == 0)
+	{
+		chunk->live++;
+	}
+
+	if (--chunk->counts[old] == 0 && --chunk->live == 1)
+	{
+		chunk_fill(chunk, block);
+	}
+	else if (bits_for(2 * chunk->live) < chunk->bits)
+	{
+		/* Shrinking is only to save memory, the chunk is still valid if it
+		 * fails. */
+		repack(chunk, bits_for(2 * chunk->live));
+	}
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR chunk_compact(Chunk *chunk)
+{
+	uint32_t distinct = chunk->live;
+	uint8_t bits;
+
+	if (chunk->bits == 0)
+	{
+		return ENGINE_OK;
+	}
+
+	if (distinct == 1)
+	{
+		chunk_fill(chunk, chunk_get_index(chunk, 0));
+		return ENGINE_OK;
+	}
+
+	bits = bits_for(distinct);
+	if (bits == chunk->bits && (chunk->palette == NULL || chunk->palette_size == chunk->live))
+	{
+		return ENGINE_OK;
+	}
+
+	return repack(chunk, bits);
+}
+
+size_t chunk_memory(const Chunk *chunk)
+{
+	if (chunk->bits == 0)
+	{
+		return sizeof(Chunk);
+	}
+
+	return sizeof(Chunk) + indices_size(chunk->bits) + palette_storage_size(chunk->bits);
+}
+
+size_t chunk_total_memory()
+{
+	return atomic_load_explicit(&total_memory, memory_order_relaxed);
+}
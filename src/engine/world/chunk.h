@@ -0,0 +1,284 @@
+#ifndef _CHUNK_H_
+#define _CHUNK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "core/debug.h"
+
+#define CHUNK_SIZE_LOG2 5
+#define CHUNK_SIZE      (1 << CHUNK_SIZE_LOG2) /* Blocks along each axis. */
+#define CHUNK_AREA      (CHUNK_SIZE * CHUNK_SIZE)
+#define CHUNK_VOLUME    (CHUNK_AREA * CHUNK_SIZE)
+
+#define CHUNK_MAX_PALETTE_BITS 8  /* Wider chunks store block IDs directly. */
+#define CHUNK_DIRECT_BITS      16
+
+#define BLOCK_AIR 0
+
+typedef uint16_t BlockId;
+
+/******************************************************************************
+ * @name  _ChunkFace
+ * @brief A side of a chunk, or of a block. The axis is face / 2 and the
+ *        direction along it is positive if face is odd.
+******************************************************************************/
+enum _ChunkFace
+{
+	CHUNK_FACE_NEGATIVE_X,
+	CHUNK_FACE_POSITIVE_X,
+	CHUNK_FACE_NEGATIVE_Y,
+	CHUNK_FACE_POSITIVE_Y,
+	CHUNK_FACE_NEGATIVE_Z,
+	CHUNK_FACE_POSITIVE_Z,
+	CHUNK_FACE_COUNT
+};
+typedef enum _ChunkFace ChunkFace;
+
+#define CHUNK_CONNECTIVITY_ALL 0x7fff /* Every pair of faces connected. */
+
+/******************************************************************************
+ * @name   chunk_face_pair()
+ * @brief  Gets the bit of a pair of faces in a chunk's connectivity, a mask
+ *         with a bit for each of the 15 pairs of different faces, set if air
+ *         joins them through the chunk.
+ * @param  a One face.
+ * @param  b A different face.
+ * @return The pair's bit.
+******************************************************************************/
+static inline uint16_t chunk_face_pair(ChunkFace a, ChunkFace b)
+{
+	uint32_t low = a < b ? a : b;
+	uint32_t high = a < b ? b : a;
+
+	/* Pairs are numbered by their lower face, then by their higher. */
+	return (uint16_t)(1u << (low * (2 * CHUNK_FACE_COUNT - 1 - low) / 2 + high - low - 1));
+}
+
+/******************************************************************************
+ * @name  _Chunk
+ * @brief A cube of CHUNK_SIZE blocks along each axis. Blocks are stored as
+ *        indices into a palette of the chunk's distinct block IDs, packed into
+ *        64 bit words at 1, 2, 4 or 8 bits each so an index never straddles
+ *        two words. A chunk of a single block, such as open air or solid
+ *        rock, stores no indices at all. Chunks with more than 256 distinct
+ *        blocks store the IDs themselves at 16 bits each.
+ *
+ *        The palette counts how many blocks use each entry, direct chunks
+ *        count how many use each ID. The index width grows when the palette
+ *        is full and shrinks once the entries or IDs in use would fill no
+ *        more than half of a narrower palette, and a chunk that becomes a
+ *        single block frees its indices. New blocks are always appended to
+ *        the palette, entries that fall out of use are kept until it is full
+ *        and then dropped as it is repacked.
+ *
+ *        A chunk is not synchronised, it may be read from many threads only
+ *        while nothing writes to it.
+******************************************************************************/
+struct _Chunk
+{
+	uint64_t *indices; /*< CHUNK_VOLUME indices of bits each, NULL if uniform. */
+	BlockId *palette;  /*< The block of each index, NULL if uniform or direct. */
+	uint16_t *counts;  /*< Blocks using each palette entry, or each ID if
+	                       direct. */
+	uint16_t *lookup;  /*< Hash of block ID to palette index + 1, 0 if empty. */
+
+	uint16_t palette_size; /*< Entries in the palette, including unused ones. */
+	uint16_t live;         /*< Entries, or IDs if direct, used by at least
+	                           one block. */
+	uint8_t bits;          /*< Width of each index, 0 if uniform. */
+	BlockId uniform;       /*< The block filling a uniform chunk. */
+};
+typedef struct _Chunk Chunk;
+
+/******************************************************************************
+ * @name   chunk_index()
+ * @brief  Gets the position of a block within a chunk. x varies fastest, then
+ *         z, then y, so a horizontal layer is contiguous.
+ * @param  x The block's x coordinate, less than CHUNK_SIZE.
+ * @param  y The block's y coordinate, less than CHUNK_SIZE.
+ * @param  z The block's z coordinate, less than CHUNK_SIZE.
+ * @return The block's index.
+******************************************************************************/
+static inline uint32_t chunk_index(uint32_t x, uint32_t y, uint32_t z)
+{
+	return (y << (2 * CHUNK_SIZE_LOG2)) | (z << CHUNK_SIZE_LOG2) | x;
+}
+
+/******************************************************************************
+ * @name       chunk_init()
+ * @brief      Initalises a chunk filled with one block. Allocates nothing.
+ * @param[out] chunk The chunk to initalise.
+ * @param      block The block to fill it with.
+ * @return     void
+******************************************************************************/
+void chunk_init(Chunk *chunk, BlockId block);
+
+/******************************************************************************
+ * @name      chunk_deinit()
+ * @brief     Frees a chunk's storage, leaving it filled with air.
+ * @param[in] chunk The chunk to deinitalise.
+ * @return    void
+******************************************************************************/
+void chunk_deinit(Chunk *chunk);
+
+/******************************************************************************
+ * @name         chunk_copy()
+ * @brief        Copies a chunk's blocks, such as to snapshot it for another
+ *               thread. The destination's storage is reused if it has the
+ *               same index width.
+ * @param[inout] destination An initalised chunk to overwrite.
+ * @param[in]    source      The chunk to copy.
+ * @return       An ENGINE_ERROR value. If successful ENGINE_OK, otherwise the
+ *               destination is unchanged.
+******************************************************************************/
+ENGINE_ERROR chunk_copy(Chunk *restrict destination, const Chunk *restrict source);
+
+/******************************************************************************
+ * @name      chunk_equal()
+ * @brief     Checks whether two chunks hold the same blocks, however they are
+ *            stored.
+ * @param[in] a One chunk.
+ * @param[in] b The other chunk.
+ * @return    1 if every block matches, else 0.
+******************************************************************************/
+uint8_t chunk_equal(const Chunk *a, const Chunk *b);
+
+/******************************************************************************
+ * @name      chunk_get_index()
+ * @brief     Gets a block from its index.
+ * @param[in] chunk The chunk to read.
+ * @param     index The block's index from chunk_index().
+ * @return    The block.
+******************************************************************************/
+static inline BlockId chunk_get_index(const Chunk *chunk, uint32_t index)
+{
+	uint32_t bit, value;
+
+	if (chunk->bits == 0)
+	{
+		return chunk->uniform;
+	}
+
+	bit = index * chunk->bits;
+	value = (uint32_t)(chunk->indices[bit >> 6] >> (bit & 63))
+	        & ((1u << chunk->bits) - 1);
+
+	return chunk->palette != NULL ? chunk->palette[value] : (BlockId)value;
+}
+
+/******************************************************************************
+ * @name      chunk_get()
+ * @brief     Gets a block.
+ * @param[in] chunk The chunk to read.
+ * @param     x     The block's x coordinate, less than CHUNK_SIZE.
+ * @param     y     The block's y coordinate, less than CHUNK_SIZE.
+ * @param     z     The block's z coordinate, less than CHUNK_SIZE.
+ * @return    The block.
+******************************************************************************/
+static inline BlockId chunk_get(const Chunk *chunk,
+                                uint32_t x,
+                                uint32_t y,
+                                uint32_t z)
+{
+	return chunk_get_index(chunk, chunk_index(x, y, z));
+}
+
+/******************************************************************************
+ * @name       chunk_get_row()
+ * @brief      Gets a row of blocks along x, decoding whole words at a time.
+ * @param[in]  chunk The chunk to read.
+ * @param      y     The row's y coordinate, less than CHUNK_SIZE.
+ * @param      z     The row's z coordinate, less than CHUNK_SIZE.
+ * @param[out] row   Set to the CHUNK_SIZE blocks of the row.
+ * @return     void
+******************************************************************************/
+void chunk_get_row(const Chunk *restrict chunk,
+                   uint32_t y,
+                   uint32_t z,
+                   BlockId *restrict row);
+
+/******************************************************************************
+ * @name       chunk_decode()
+ * @brief      Gets every block of a chunk. Each byte of packed indices is
+ *             expanded through a table built from the palette, so decoding
+ *             costs little more than copying.
+ * @param[in]  chunk        The chunk to read.
+ * @param[out] blocks       Where the row along x at y = 0, z = 0 is written.
+ * @param      row_stride   The distance between rows of consecutive z.
+ * @param      layer_stride The distance between rows of consecutive y.
+ * @return     void
+******************************************************************************/
+void chunk_decode(const Chunk *restrict chunk,
+                  BlockId *restrict blocks,
+                  uint32_t row_stride,
+                  uint32_t layer_stride);
+
+/******************************************************************************
+ * @name      chunk_set_index()
+ * @brief     Sets a block from its index. Usually constant time, the indices
+ *            are only repacked when the palette grows or shrinks.
+ * @param[in] chunk The chunk to write.
+ * @param     index The block's index from chunk_index().
+ * @param     block The block to store.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK, otherwise the
+ *            chunk is unchanged.
+******************************************************************************/
+ENGINE_ERROR chunk_set_index(Chunk *chunk, uint32_t index, BlockId block);
+
+/******************************************************************************
+ * @name      chunk_set()
+ * @brief     Sets a block, see chunk_set_index().
+ * @param[in] chunk The chunk to write.
+ * @param     x     The block's x coordinate, less than CHUNK_SIZE.
+ * @param     y     The block's y coordinate, less than CHUNK_SIZE.
+ * @param     z     The block's z coordinate, less than CHUNK_SIZE.
+ * @param     block The block to store.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static inline ENGINE_ERROR chunk_set(Chunk *chunk,
+                                     uint32_t x,
+                                     uint32_t y,
+                                     uint32_t z,
+                                     BlockId block)
+{
+	return chunk_set_index(chunk, chunk_index(x, y, z), block);
+}
+
+/******************************************************************************
+ * @name      chunk_fill()
+ * @brief     Fills a whole chunk with one block, freeing its indices.
+ * @param[in] chunk The chunk to fill.
+ * @param     block The block to fill it with.
+ * @return    void
+******************************************************************************/
+void chunk_fill(Chunk *chunk, BlockId block);
+
+/******************************************************************************
+ * @name      chunk_compact()
+ * @brief     Repacks a chunk at the narrowest width its blocks allow and drops
+ *            unused palette entries. Worth calling once a chunk has been
+ *            generated or heavily edited.
+ * @param[in] chunk The chunk to compact.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK, otherwise the
+ *            chunk is unchanged.
+******************************************************************************/
+ENGINE_ERROR chunk_compact(Chunk *chunk);
+
+/******************************************************************************
+ * @name      chunk_memory()
+ * @brief     Gets the memory a chunk uses, including the Chunk itself.
+ * @param[in] chunk The chunk to measure.
+ * @return    The size in bytes.
+******************************************************************************/
+size_t chunk_memory(const Chunk *chunk);
+
+/******************************************************************************
+ * @name   chunk_total_memory()
+ * @brief  Gets the memory allocated by every chunk's indices and palette.
+ *         Safe to call from any thread.
+ * @return The size in bytes.
+******************************************************************************/
+size_t chunk_total_memory();
+
+#endif /* _CHUNK_H_ */
@@ -0,0 +1,336 @@
+#include "lod.h"
+
+#include <stdlib.h>
+
+#include "core/logger.h"
+
+#define HALF_CHUNK (CHUNK_SIZE / 2) /* Merged blocks a child covers along
+                                       each axis. */
+
+ENGINE_ERROR lod_create(Lod **lod, const World *world, uint32_t level_count)
+{
+	uint32_t node_count = 0;
+
+	ENGINE_ASSERT(level_count >= 1 && level_count <= LOD_MAX_LEVELS);
+
+	*lod = calloc(1, sizeof(Lod));
+	if (*lod == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate level of detail");
+	}
+
+	(*lod)->world = world;
+	(*lod)->level_count = level_count;
+
+	for (uint32_t level = 0; level < level_count; level++)
+	{
+		LodLevel *grid = &(*lod)->levels[level];
+
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			grid->size[axis] = level == 0
+			                   ? world->size[axis]
+			                   : ((*lod)->levels[level - 1].size[axis] + 1) / 2;
+		}
+		grid->first = node_count;
+		grid->count = grid->size[0] * grid->size[1] * grid->size[2];
+		node_count += grid->count;
+
+		if (level > 0)
+		{
+			grid->nodes = malloc(grid->count * sizeof(Chunk));
+			if (grid->nodes == NULL)
+			{
+				goto create_fail;
+			}
+
+			for (uint32_t i = 0; i < grid->count; i++)
+			{
+				chunk_init(&grid->nodes[i], BLOCK_AIR);
+			}
+		}
+	}
+	(*lod)->node_count = node_count;
+
+	(*lod)->versions = calloc(node_count, sizeof(uint32_t));
+	(*lod)->generations = calloc(node_count, sizeof(uint32_t));
+	(*lod)->built = calloc(node_count, sizeof(uint32_t));
+	(*lod)->queued = calloc(node_count, sizeof(uint32_t));
+	(*lod)->stale = malloc(node_count * sizeof(uint32_t));
+	(*lod)->stale_flags = calloc(node_count, sizeof(uint8_t));
+
+	if ((*lod)->versions == NULL
+	    || (*lod)->generations == NULL
+	    || (*lod)->built == NULL
+	    || (*lod)->queued == NULL
+	    || (*lod)->stale == NULL
+	    || (*lod)->stale_flags == NULL)
+	{
+		goto create_fail;
+	}
+
+	/* Nothing above full detail has been built yet. */
+	for (uint32_t i = (*lod)->levels[0].count; i < node_count; i++)
+	{
+		(*lod)->generations[i] = 1;
+		(*lod)->stale_flags[i] = 1;
+		(*lod)->stale[(*lod)->stale_count++] = i;
+	}
+
+	return ENGINE_OK;
+
+create_fail:
+	lod_destroy(*lod);
+	*lod = NULL;
+	ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+	                           "Failed to allocate level of detail");
+}
+
+void lod_destroy(Lod *lod)
+{
+	for (uint32_t level = 1; level < lod->level_count; level++)
+	{
+		LodLevel *grid = &lod->levels[level];
+
+		for (uint32_t i = 0; grid->nodes != NULL && i < grid->count; i++)
+		{
+			chunk_deinit(&grid->nodes[i]);
+		}
+		free(grid->nodes);
+	}
+
+	free(lod->versions);
+	free(lod->generations);
+	free(lod->built);
+	free(lod->queued);
+	free(lod->stale);
+	free(lod->stale_flags);
+	free(lod);
+}
+
+void lod_node_children(const Lod *lod, uint32_t node, int32_t children[LOD_CHILD_COUNT])
+{
+	int32_t coordinates[3];
+	uint32_t level = lod_node_coordinates(lod, node, coordinates);
+
+	ENGINE_ASSERT(level > 0);
+
+	for (uint32_t child = 0; child < LOD_CHILD_COUNT; child++)
+	{
+		children[child] = lod_node_id(lod,
+		                              level - 1,
+		                              2 * coordinates[0] + (int32_t)(child & 1),
+		                              2 * coordinates[1] + (int32_t)(child >> 1 & 1),
+		                              2 * coordinates[2] + (int32_t)(child >> 2 & 1));
+	}
+}
+
+uint8_t lod_node_buildable(const Lod *lod, uint32_t node)
+{
+	int32_t children[LOD_CHILD_COUNT];
+
+	if (!lod_node_stale(lod, node) || lod->queued[node] == lod->generations[node])
+	{
+		return 0;
+	}
+
+	lod_node_children(lod, node, children);
+	for (uint32_t child = 0; child < LOD_CHILD_COUNT; child++)
+	{
+		if (children[child] >= 0 && lod_node_stale(lod, (uint32_t)children[child]))
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+void lod_node_changed(Lod *lod, uint32_t node)
+{
+	int32_t coordinates[3];
+	uint32_t level = lod_node_coordinates(lod, node, coordinates);
+	int32_t parent;
+
+	if (level > 0)
+	{
+		lod->versions[node]++;
+	}
+
+	if (level + 1 >= lod->level_count)
+	{
+		return;
+	}
+
+	parent = lod_node_id(lod,
+	                     level + 1,
+	                     coordinates[0] / 2,
+	                     coordinates[1] / 2,
+	                     coordinates[2] / 2);
+	lod->generations[parent]++;
+
+	if (!lod->stale_flags[parent])
+	{
+		lod->stale_flags[parent] = 1;
+		lod->stale[lod->stale_count++] = (uint32_t)parent;
+	}
+}
+
+uint8_t lod_should_split(const Lod *lod, uint32_t node, Vec3 camera)
+{
+	int32_t coordinates[3];
+	uint32_t level = lod_node_coordinates(lod, node, coordinates);
+	float width = (float)(CHUNK_SIZE << level);
+	float position[3] = {camera.x, camera.y, camera.z};
+	float distance = 0.0f;
+
+	if (level == 0)
+	{
+		return 0;
+	}
+
+	/* From the nearest point of the node, so the camera's own node always
+	 * splits. */
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		float low = (float)coordinates[axis] * width;
+		float offset = 0.0f;
+
+		if (position[axis] < low)
+		{
+			offset = low - position[axis];
+		}
+		else if (position[axis] > low + width)
+		{
+			offset = position[axis] - low - width;
+		}
+		distance += offset * offset;
+	}
+
+	return distance < LOD_SPLIT_DISTANCE * LOD_SPLIT_DISTANCE * width * width;
+}
+
+/******************************************************************************
+ * @name   merge_blocks()
+ * @brief  Merges a cube of 2 blocks to a side into one.
+ * @param  lower The blocks of the lower layer.
+ * @param  upper The blocks of the upper layer.
+ * @return The merged block.
+******************************************************************************/
+static inline BlockId merge_blocks(const BlockId lower[4], const BlockId upper[4])
+{
+	uint32_t solid = 0;
+	BlockId top = BLOCK_AIR;
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		solid += lower[i] != BLOCK_AIR;
+		top = top == BLOCK_AIR ? lower[i] : top;
+	}
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		solid += upper[i] != BLOCK_AIR;
+		top = upper[i] != BLOCK_AIR ? upper[i] : top;
+	}
+
+	return solid >= 4 ? top : BLOCK_AIR;
+}
+
+/******************************************************************************
+ * @name       downsample_child()
+ * @brief      Merges a child's blocks into the octant of its parent it
+ *             covers, which must be air.
+ * @param[in]  child  The child.
+ * @param      octant The child's position in lod_node_children() order.
+ * @param[out] node   The parent.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR downsample_child(const Chunk *restrict child,
+                                     uint32_t octant,
+                                     Chunk *restrict node)
+{
+	uint32_t offset[3] = {
+		(octant & 1) * HALF_CHUNK,
+		(octant >> 1 & 1) * HALF_CHUNK,
+		(octant >> 2 & 1) * HALF_CHUNK
+	};
+	BlockId rows[4][CHUNK_SIZE];
+	ENGINE_ERROR error;
+
+	for (uint32_t y = 0; y < HALF_CHUNK; y++)
+	{
+		for (uint32_t z = 0; z < HALF_CHUNK; z++)
+		{
+			chunk_get_row(child, 2 * y, 2 * z, rows[0]);
+			chunk_get_row(child, 2 * y, 2 * z + 1, rows[1]);
+			chunk_get_row(child, 2 * y + 1, 2 * z, rows[2]);
+			chunk_get_row(child, 2 * y + 1, 2 * z + 1, rows[3]);
+
+			for (uint32_t x = 0; x < HALF_CHUNK; x++)
+			{
+				BlockId lower[4] = {
+					rows[0][2 * x], rows[0][2 * x + 1],
+					rows[1][2 * x], rows[1][2 * x + 1]
+				};
+				BlockId upper[4] = {
+					rows[2][2 * x], rows[2][2 * x + 1],
+					rows[3][2 * x], rows[3][2 * x + 1]
+				};
+				BlockId block = merge_blocks(lower, upper);
+
+				if (block == BLOCK_AIR)
+				{
+					continue;
+				}
+
+				error = chunk_set(node,
+				                  offset[0] + x,
+				                  offset[1] + y,
+				                  offset[2] + z,
+				                  block);
+				ENGINE_RETURN_IF_ERROR(error);
+			}
+		}
+	}
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR lod_downsample(const Chunk *const children[LOD_CHILD_COUNT], Chunk *node)
+{
+	BlockId uniform = children[0] != NULL ? children[0]->uniform : BLOCK_AIR;
+	uint8_t same = 1;
+	ENGINE_ERROR error;
+
+	for (uint32_t child = 0; child < LOD_CHILD_COUNT; child++)
+	{
+		BlockId block = children[child] != NULL ? children[child]->uniform : BLOCK_AIR;
+
+		if ((children[child] != NULL && children[child]->bits != 0) || block != uniform)
+		{
+			same = 0;
+		}
+	}
+
+	/* Open sky and deep rock merge to themselves. */
+	chunk_fill(node, same ? uniform : BLOCK_AIR);
+	if (same)
+	{
+		return ENGINE_OK;
+	}
+
+	for (uint32_t child = 0; child < LOD_CHILD_COUNT; child++)
+	{
+		if (children[child] == NULL
+		    || (children[child]->bits == 0 && children[child]->uniform == BLOCK_AIR))
+		{
+			continue;
+		}
+
+		error = downsample_child(children[child], child, node);
+		ENGINE_RETURN_IF_ERROR(error);
+	}
+
+	return chunk_compact(node);
+}
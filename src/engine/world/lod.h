@@ -0,0 +1,262 @@
+#ifndef _LOD_H_
+#define _LOD_H_
+
+#include <stdint.h>
+
+#include "core/debug.h"
+#include "core/maths.h"
+
+#include "world.h"
+#include "chunk.h"
+
+#define LOD_MAX_LEVELS     4    /* Full detail, then blocks merged 2, 4 and 8
+                                   to a side. */
+#define LOD_CHILD_COUNT    8
+#define LOD_SPLIT_DISTANCE 3.0f /* Nodes nearer the camera than this many of
+                                   their own widths are drawn as their
+                                   children. */
+
+/******************************************************************************
+ * @name  _LodLevel
+ * @brief A grid of nodes that each merge 2^level blocks to a side into one,
+ *        so a node is a chunk of CHUNK_SIZE merged blocks covering 2^level
+ *        chunks to a side. Nodes are indexed like the world's chunks.
+******************************************************************************/
+struct _LodLevel
+{
+	Chunk *nodes;     /*< The merged blocks, NULL at level 0 whose nodes are
+	                      the world's chunks. */
+	uint32_t size[3]; /*< Nodes along each axis. */
+	uint32_t first;   /*< The id of the level's first node. */
+	uint32_t count;
+};
+typedef struct _LodLevel LodLevel;
+
+/******************************************************************************
+ * @name  _Lod
+ * @brief A pyramid of ever coarser copies of a world's blocks, each level
+ *        downsampled from the one below. Every node of every level has an
+ *        id, level 0 first so a chunk's id is its index in the world.
+ *
+ *        Nothing is downsampled here. Each time a node's children change its
+ *        generation is bumped and it is listed as stale, whoever downsamples
+ *        it records the generation its blocks were built from. A node is
+ *        only worth downsampling once none of its children are stale.
+ *
+ *        A Lod is not synchronised and is only used from the main thread.
+******************************************************************************/
+struct _Lod
+{
+	const World *world;
+	LodLevel levels[LOD_MAX_LEVELS];
+	uint32_t level_count;
+	uint32_t node_count;
+
+	/* Of each node above level 0, indexed by id. */
+	uint32_t *versions;    /*< Bumped each time the node's mesh may change. */
+	uint32_t *generations; /*< Bumped each time a child's blocks change. */
+	uint32_t *built;       /*< The generation the blocks were built from. */
+	uint32_t *queued;      /*< The generation last handed out to build. */
+
+	uint32_t *stale;       /*< Nodes that may need building, lowest level
+	                           first. */
+	uint32_t stale_count;
+	uint8_t *stale_flags;  /*< Set for each node in stale. */
+};
+typedef struct _Lod Lod;
+
+/******************************************************************************
+ * @name       lod_create()
+ * @brief      Creates a pyramid over a world with every node above level 0
+ *             stale.
+ * @param[out] lod         A pointer to a pointer set to the created pyramid.
+ * @param[in]  world       The world, which must outlive the pyramid.
+ * @param      level_count The levels, including full detail, at most
+ *                         LOD_MAX_LEVELS. 1 keeps only the world's chunks.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR lod_create(Lod **lod, const World *world, uint32_t level_count);
+
+/******************************************************************************
+ * @name      lod_destroy()
+ * @brief     Frees a pyramid and its nodes' blocks.
+ * @param[in] lod The pyramid to destroy.
+ * @return    void
+******************************************************************************/
+void lod_destroy(Lod *lod);
+
+/******************************************************************************
+ * @name   lod_node_level()
+ * @brief  Gets the level of a node.
+ * @param  lod  The pyramid the node is in.
+ * @param  node The node's id.
+ * @return The node's level.
+******************************************************************************/
+static inline uint32_t lod_node_level(const Lod *lod, uint32_t node)
+{
+	uint32_t level = 0;
+
+	while (level + 1 < lod->level_count && node >= lod->levels[level + 1].first)
+	{
+		level++;
+	}
+
+	return level;
+}
+
+/******************************************************************************
+ * @name   lod_node_id()
+ * @brief  Gets the id of a node from its level and coordinates.
+ * @param  lod   The pyramid the node is in.
+ * @param  level The node's level.
+ * @param  x     The node's x coordinate in its level.
+ * @param  y     The node's y coordinate in its level.
+ * @param  z     The node's z coordinate in its level.
+ * @return The node's id, or -1 if it is outside the level.
+******************************************************************************/
+static inline int32_t lod_node_id(const Lod *lod,
+                                  uint32_t level,
+                                  int32_t x,
+                                  int32_t y,
+                                  int32_t z)
+{
+	const LodLevel *grid = &lod->levels[level];
+
+	if (x < 0 || y < 0 || z < 0
+	    || (uint32_t)x >= grid->size[0]
+	    || (uint32_t)y >= grid->size[1]
+	    || (uint32_t)z >= grid->size[2])
+	{
+		return -1;
+	}
+
+	return (int32_t)(grid->first
+	                 + ((uint32_t)y * grid->size[2] + (uint32_t)z) * grid->size[0]
+	                 + (uint32_t)x);
+}
+
+/******************************************************************************
+ * @name       lod_node_coordinates()
+ * @brief      Gets the level and coordinates of a node from its id.
+ * @param      lod         The pyramid the node is in.
+ * @param      node        The node's id.
+ * @param[out] coordinates Set to the node's coordinates in its level.
+ * @return     The node's level.
+******************************************************************************/
+static inline uint32_t lod_node_coordinates(const Lod *lod,
+                                            uint32_t node,
+                                            int32_t coordinates[3])
+{
+	uint32_t level = lod_node_level(lod, node);
+	const LodLevel *grid = &lod->levels[level];
+	uint32_t index = node - grid->first;
+
+	coordinates[0] = (int32_t)(index % grid->size[0]);
+	coordinates[2] = (int32_t)(index / grid->size[0] % grid->size[2]);
+	coordinates[1] = (int32_t)(index / grid->size[0] / grid->size[2]);
+
+	return level;
+}
+
+/******************************************************************************
+ * @name   lod_node_blocks()
+ * @brief  Gets the blocks of a node.
+ * @param  lod  The pyramid the node is in.
+ * @param  node The node's id.
+ * @return The node's blocks, its chunk at level 0.
+******************************************************************************/
+static inline Chunk *lod_node_blocks(const Lod *lod, uint32_t node)
+{
+	uint32_t level = lod_node_level(lod, node);
+
+	if (level == 0)
+	{
+		return &lod->world->chunks[node];
+	}
+
+	return &lod->levels[level].nodes[node - lod->levels[level].first];
+}
+
+/******************************************************************************
+ * @name   lod_node_version()
+ * @brief  Gets the version of a node's blocks.
+ * @param  lod  The pyramid the node is in.
+ * @param  node The node's id.
+ * @return The version, the chunk's version at level 0.
+******************************************************************************/
+static inline uint32_t lod_node_version(const Lod *lod, uint32_t node)
+{
+	return node < lod->levels[0].count ? lod->world->versions[node] : lod->versions[node];
+}
+
+/******************************************************************************
+ * @name   lod_node_stale()
+ * @brief  Checks whether a node's blocks are out of date.
+ * @param  lod  The pyramid the node is in.
+ * @param  node The node's id.
+ * @return 1 if it must be built before it is used, else 0.
+******************************************************************************/
+static inline uint8_t lod_node_stale(const Lod *lod, uint32_t node)
+{
+	return node >= lod->levels[0].count && lod->built[node] != lod->generations[node];
+}
+
+/******************************************************************************
+ * @name       lod_node_children()
+ * @brief      Gets the ids of a node's children, ordered by x, then y, then
+ *             z as the lowest, middle and highest bits of their position.
+ * @param      lod      The pyramid the node is in.
+ * @param      node     The node's id, above level 0.
+ * @param[out] children Set to each child's id, or -1 if it is outside the
+ *                      world.
+ * @return     void
+******************************************************************************/
+void lod_node_children(const Lod *lod, uint32_t node, int32_t children[LOD_CHILD_COUNT]);
+
+/******************************************************************************
+ * @name   lod_node_buildable()
+ * @brief  Checks whether a node is stale, has not been handed out to build
+ *         since it went stale and none of its children are stale.
+ * @param  lod  The pyramid the node is in.
+ * @param  node The node's id, above level 0.
+ * @return 1 if it is worth building now, else 0.
+******************************************************************************/
+uint8_t lod_node_buildable(const Lod *lod, uint32_t node);
+
+/******************************************************************************
+ * @name      lod_node_changed()
+ * @brief     Notes that a node's blocks have changed, bumping its version
+ *            above level 0 and marking its parent stale.
+ * @param[in] lod  The pyramid the node is in.
+ * @param     node The node's id.
+ * @return    void
+******************************************************************************/
+void lod_node_changed(Lod *lod, uint32_t node);
+
+/******************************************************************************
+ * @name      lod_should_split()
+ * @brief     Checks whether a node is near enough the camera to be drawn as
+ *            its children.
+ * @param     lod    The pyramid the node is in.
+ * @param     node   The node's id.
+ * @param     camera Where the world is viewed from.
+ * @return    1 if its children should be drawn instead, else 0. Always 0 at
+ *            level 0.
+******************************************************************************/
+uint8_t lod_should_split(const Lod *lod, uint32_t node, Vec3 camera);
+
+/******************************************************************************
+ * @name       lod_downsample()
+ * @brief      Merges each cube of 2 blocks to a side of a node's children
+ *             into one block of the node. A merged block is solid if at least
+ *             half of its blocks are, and takes the highest solid block so
+ *             the tops of surfaces keep their look. Safe to call from any
+ *             thread.
+ * @param[in]  children The node's children in lod_node_children() order, NULL
+ *                      ones are air.
+ * @param[out] node     An initalised chunk overwritten with the merged blocks.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR lod_downsample(const Chunk *const children[LOD_CHILD_COUNT], Chunk *node);
+
+#endif /* _LOD_H_ */
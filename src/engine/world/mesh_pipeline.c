@@ -0,0 +1,1184 @@
+#include "mesh_pipeline.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "core/logger.h"
+#include "core/profiler.h"
+
+#define ARRAY_SIZE(arr) sizeof(arr) / sizeof(arr[0])
+
+#define MESH_HIDDEN   0x1 /* The renderer has been told not to draw the mesh. */
+#define MESH_OCCLUDED 0x2 /* The mesh is counted in the occluded meshes. */
+
+/******************************************************************************
+ * @name      node_distance()
+ * @brief     Gets how far a node's centre is from the camera in widths of the
+ *            node, so nodes of every level are prioritised by how large they
+ *            look.
+ * @param[in] pipeline The pipeline meshing the node.
+ * @param     node     The node's id.
+ * @return    The squared distance.
+******************************************************************************/
+static float node_distance(const MeshPipeline *pipeline, uint32_t node)
+{
+	int32_t coordinates[3];
+	uint32_t level = lod_node_coordinates(pipeline->lod, node, coordinates);
+	float width = (float)(CHUNK_SIZE << level);
+	Vec3 centre;
+
+	centre = (Vec3){(coordinates[0] + 0.5f) - pipeline->camera.x / width,
+	                (coordinates[1] + 0.5f) - pipeline->camera.y / width,
+	                (coordinates[2] + 0.5f) - pipeline->camera.z / width};
+
+	return vec3_dot(centre, centre);
+}
+
+/******************************************************************************
+ * @name      compare_dirty()
+ * @brief     Orders dirty nodes nearest first, for qsort().
+ * @param[in] a The first MeshPipelineDirty.
+ * @param[in] b The second MeshPipelineDirty.
+ * @return    Negative, zero or positive as a is nearer, as near or further.
+******************************************************************************/
+static int compare_dirty(const void *a, const void *b)
+{
+	const struct MeshPipelineDirty *first = a;
+	const struct MeshPipelineDirty *second = b;
+
+	return (first->distance > second->distance) - (first->distance < second->distance);
+}
+
+/******************************************************************************
+ * @name   solid_through()
+ * @brief  Checks whether a chunk is a single block other than air.
+ * @param  chunk The chunk to check.
+ * @return 1 if it is, else 0.
+******************************************************************************/
+static inline uint8_t solid_through(const Chunk *chunk)
+{
+	return chunk->bits == 0 && chunk->uniform != BLOCK_AIR;
+}
+
+/******************************************************************************
+ * @name      add_dirty()
+ * @brief     Adds a node to the nodes waiting for a job, unless it already
+ *            is.
+ * @param[in] pipeline The pipeline meshing the node.
+ * @param     node     The node's id.
+ * @return    void
+******************************************************************************/
+static void add_dirty(MeshPipeline *pipeline, uint32_t node)
+{
+	if (!pipeline->dirty_flags[node])
+	{
+		pipeline->dirty_flags[node] = 1;
+		pipeline->dirty[pipeline->dirty_count++].node = node;
+	}
+}
+
+/******************************************************************************
+ * @name      needs_mesh()
+ * @brief     Checks whether a node is wanted but its mesh is missing or out of
+ *            date, and no job for its current blocks has been queued.
+ * @param[in] pipeline The pipeline meshing the node.
+ * @param     node     The node's id.
+ * @return    1 if it should be meshed, else 0.
+******************************************************************************/
+static uint8_t needs_mesh(const MeshPipeline *pipeline, uint32_t node)
+{
+	uint32_t version = lod_node_version(pipeline->lod, node);
+
+	return pipeline->wanted[node]
+	       && !(pipeline->ready[node] && pipeline->mesh_versions[node] == version)
+	       && !(pipeline->busy[node] > 0 && pipeline->queued_versions[node] == version);
+}
+
+/******************************************************************************
+ * @name      request_mesh()
+ * @brief     Adds a node to the nodes waiting for a job if it needs meshing.
+ * @param[in] pipeline The pipeline meshing the node.
+ * @param     node     The node's id.
+ * @return    void
+******************************************************************************/
+static void request_mesh(MeshPipeline *pipeline, uint32_t node)
+{
+	if (needs_mesh(pipeline, node))
+	{
+		add_dirty(pipeline, node);
+	}
+}
+
+/******************************************************************************
+ * @name      publish_version()
+ * @brief     Publishes a node's version to the workers, cancelling older jobs.
+ * @param[in] pipeline The pipeline meshing the node.
+ * @param     node     The node's id.
+ * @return    void
+******************************************************************************/
+static void publish_version(MeshPipeline *pipeline, uint32_t node)
+{
+	atomic_store_explicit(&pipeline->versions[node],
+	                      lod_node_version(pipeline->lod, node),
+	                      memory_order_relaxed);
+}
+
+/******************************************************************************
+ * @name      set_connectivity()
+ * @brief     Passes a chunk's connectivity on to the visibility graph, if
+ *            there is one.
+ * @param[in] pipeline     The pipeline meshing the chunk.
+ * @param     chunk        The chunk's index.
+ * @param     connectivity The chunk's connectivity.
+ * @return    void
+******************************************************************************/
+static void set_connectivity(MeshPipeline *pipeline, uint32_t chunk, uint16_t connectivity)
+{
+	if (pipeline->visibility != NULL)
+	{
+		visibility_graph_set_connectivity(pipeline->visibility, chunk, connectivity);
+	}
+}
+
+/******************************************************************************
+ * @name      take_dirty()
+ * @brief     Moves the world's dirty chunks into the pipeline, marks the
+ *            coarser nodes over them stale and publishes their versions to
+ *            the workers, cancelling older jobs.
+ * @param[in] pipeline The pipeline to update.
+ * @return    void
+******************************************************************************/
+static void take_dirty(MeshPipeline *pipeline)
+{
+	World *world = pipeline->world;
+
+	for (uint32_t i = 0; i < world->dirty_count; i++)
+	{
+		uint32_t chunk = world->dirty[i];
+
+		lod_node_changed(pipeline->lod, chunk);
+		publish_version(pipeline, chunk);
+
+		/* Its connectivity is only known again once it is meshed. */
+		if (!pipeline->wanted[chunk])
+		{
+			set_connectivity(pipeline, chunk, CHUNK_CONNECTIVITY_ALL);
+		}
+
+		request_mesh(pipeline, chunk);
+	}
+
+	world_clear_dirty(world);
+}
+
+/******************************************************************************
+ * @name      occluded()
+ * @brief     Checks whether a node is a chunk hidden from the camera.
+ * @param[in] pipeline The pipeline meshing the node.
+ * @param     node     The node's id.
+ * @return    1 if its mesh should not be drawn, else 0.
+******************************************************************************/
+static inline uint8_t occluded(const MeshPipeline *pipeline, uint32_t node)
+{
+	return pipeline->visibility != NULL
+	       && node < pipeline->lod->levels[0].count
+	       && !visibility_graph_visible(pipeline->visibility, node);
+}
+
+/******************************************************************************
+ * @name      refresh_mesh()
+ * @brief     Hides a node's mesh if the node is not drawn or cannot be seen,
+ *            or shows it again.
+ * @param[in] pipeline The pipeline meshing the node.
+ * @param     node     The node's id.
+ * @return    void
+******************************************************************************/
+static void refresh_mesh(MeshPipeline *pipeline, uint32_t node)
+{
+	uint8_t previous = pipeline->mesh_states[node];
+	uint8_t state = 0;
+
+	if (pipeline->meshes[node] == NULL)
+	{
+		return;
+	}
+
+	if (!pipeline->drawn[node])
+	{
+		state = MESH_HIDDEN;
+	}
+	else if (occluded(pipeline, node))
+	{
+		state = MESH_HIDDEN | MESH_OCCLUDED;
+	}
+
+	if ((state ^ previous) & MESH_HIDDEN)
+	{
+		renderer_mesh_set_hidden(pipeline->meshes[node], state & MESH_HIDDEN);
+	}
+
+	pipeline->occluded += (state & MESH_OCCLUDED) != 0;
+	pipeline->occluded -= (previous & MESH_OCCLUDED) != 0;
+	pipeline->mesh_states[node] = state;
+}
+
+/******************************************************************************
+ * @name      destroy_mesh()
+ * @brief     Destroys a node's mesh, if it has one.
+ * @param[in] pipeline The pipeline meshing the node.
+ * @param     node     The node's id.
+ * @return    void
+******************************************************************************/
+static void destroy_mesh(MeshPipeline *pipeline, uint32_t node)
+{
+	if (pipeline->meshes[node] == NULL)
+	{
+		return;
+	}
+
+	pipeline->occluded -= (pipeline->mesh_states[node] & MESH_OCCLUDED) != 0;
+	pipeline->mesh_states[node] = 0;
+	renderer_mesh_destroy(pipeline->meshes[node]);
+	pipeline->meshes[node] = NULL;
+}
+
+/******************************************************************************
+ * @name      replace_mesh()
+ * @brief     Uploads a node's new mesh, destroys its old one and marks the
+ *            node ready. If the upload fails the old mesh is kept.
+ * @param[in] pipeline The pipeline meshing the node.
+ * @param     node     The node's id.
+ * @param[in] mesh     The new mesh, NULL if the node has no faces.
+ * @param     version  The version of the node the mesh was built from.
+ * @return    void
+******************************************************************************/
+static void replace_mesh(MeshPipeline *pipeline,
+                         uint32_t node,
+                         const ChunkMesh *mesh,
+                         uint32_t version)
+{
+	RendererMesh *created = NULL;
+	int32_t coordinates[3];
+	uint32_t width;
+
+	if (mesh != NULL && mesh->index_count > 0)
+	{
+		width = CHUNK_SIZE << lod_node_coordinates(pipeline->lod, node, coordinates);
+		if (renderer_mesh_create(&created,
+		                         mesh,
+		                         (Vec3){(float)((uint32_t)coordinates[0] * width),
+		                                (float)((uint32_t)coordinates[1] * width),
+		                                (float)((uint32_t)coordinates[2] * width)})
+		    != ENGINE_OK)
+		{
+			LOG_WARNING("Keeping the old mesh of node %u", node);
+			return;
+		}
+	}
+
+	destroy_mesh(pipeline, node);
+	pipeline->meshes[node] = created;
+	pipeline->mesh_versions[node] = version;
+
+	if (!pipeline->ready[node])
+	{
+		pipeline->ready[node] = 1;
+		pipeline->live[pipeline->live_count++] = node;
+		pipeline->reselect = 1;
+	}
+
+	refresh_mesh(pipeline, node);
+}
+
+/******************************************************************************
+ * @name      snapshot()
+ * @brief     Copies a node and its neighbours into a job to mesh it. Nodes
+ *            above full detail may border finer nodes whose surfaces differ,
+ *            so they are walled off from neighbours that are not solid
+ *            through.
+ * @param[in] pipeline The pipeline meshing the node.
+ * @param[in] job      The job to fill.
+ * @param     node     The node's id.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR snapshot(MeshPipeline *restrict pipeline,
+                             MeshJob *restrict job,
+                             uint32_t node)
+{
+	const Lod *lod = pipeline->lod;
+	int32_t coordinates[3];
+	uint32_t level = lod_node_coordinates(lod, node, coordinates);
+	ENGINE_ERROR error;
+
+	PROFILE_ZONE("snapshot");
+
+	error = chunk_copy(&job->chunks[0], lod_node_blocks(lod, node));
+	ENGINE_RETURN_IF_ERROR(error);
+
+	for (uint32_t face = 0; face < CHUNK_FACE_COUNT; face++)
+	{
+		int32_t neighbour[3] = {coordinates[0], coordinates[1], coordinates[2]};
+		int32_t index;
+
+		neighbour[face / 2] += face & 1 ? 1 : -1;
+		index = lod_node_id(lod, level, neighbour[0], neighbour[1], neighbour[2]);
+
+		job->present[face] = index >= 0
+		                     && (level == 0
+		                         || solid_through(lod_node_blocks(lod, (uint32_t)index)));
+		if (job->present[face])
+		{
+			error = chunk_copy(&job->chunks[face + 1], lod_node_blocks(lod, (uint32_t)index));
+			ENGINE_RETURN_IF_ERROR(error);
+		}
+	}
+
+	job->node = node;
+	job->version = lod_node_version(lod, node);
+	job->downsample = 0;
+	job->mesh.level = (uint8_t)level;
+
+	return ENGINE_OK;
+}
+
+/******************************************************************************
+ * @name      snapshot_children()
+ * @brief     Copies a node's children into a job to build the node's blocks.
+ * @param[in] pipeline The pipeline building the node.
+ * @param[in] job      The job to fill.
+ * @param     node     The node's id, above level 0.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR snapshot_children(MeshPipeline *restrict pipeline,
+                                      MeshJob *restrict job,
+                                      uint32_t node)
+{
+	const Lod *lod = pipeline->lod;
+	int32_t children[LOD_CHILD_COUNT];
+	ENGINE_ERROR error;
+
+	PROFILE_ZONE("snapshot_children");
+
+	lod_node_children(lod, node, children);
+	for (uint32_t child = 0; child < LOD_CHILD_COUNT; child++)
+	{
+		job->present[child] = children[child] >= 0;
+		if (children[child] >= 0)
+		{
+			error = chunk_copy(&job->chunks[child],
+			                   lod_node_blocks(lod, (uint32_t)children[child]));
+			ENGINE_RETURN_IF_ERROR(error);
+		}
+	}
+
+	job->node = node;
+	job->version = lod->generations[node];
+	job->downsample = 1;
+
+	return ENGINE_OK;
+}
+
+/******************************************************************************
+ * @name      run_next_job()
+ * @brief     Runs the queued job nearest the camera and hands it back to the
+ *            main thread. Meshing is skipped if the node has changed since it
+ *            was snapshot, building is short and never skipped. A background
+ *            job is queued for each MeshJob, so there is always one to take.
+ * @param[in] data The MeshPipeline.
+ * @return    void
+******************************************************************************/
+static void run_next_job(void *data)
+{
+	MeshPipeline *pipeline = data;
+	Mesher *mesher = pipeline->meshers[job_thread_index()];
+	const Chunk *chunks[MESH_JOB_CHUNKS];
+	MeshJob *job;
+	MeshJob *head;
+	uint32_t nearest = 0;
+
+	PROFILE_ZONE("run_next_job");
+
+	pthread_mutex_lock(&pipeline->pending_lock);
+	ENGINE_ASSERT(pipeline->pending_count > 0);
+	for (uint32_t i = 1; i < pipeline->pending_count; i++)
+	{
+		if (pipeline->pending[i]->distance < pipeline->pending[nearest]->distance)
+		{
+			nearest = i;
+		}
+	}
+	job = pipeline->pending[nearest];
+	pipeline->pending[nearest] = pipeline->pending[--pipeline->pending_count];
+	pthread_mutex_unlock(&pipeline->pending_lock);
+
+	job->meshed = 0;
+	if (job->downsample)
+	{
+		for (uint32_t child = 0; child < LOD_CHILD_COUNT; child++)
+		{
+			chunks[child] = job->present[child] ? &job->chunks[child] : NULL;
+		}
+
+		job->meshed = lod_downsample(chunks, &job->blocks) == ENGINE_OK;
+	}
+	else if (atomic_load_explicit(&pipeline->versions[job->node], memory_order_relaxed)
+	         == job->version)
+	{
+		for (uint32_t face = 0; face < CHUNK_FACE_COUNT; face++)
+		{
+			chunks[face] = job->present[face] ? &job->chunks[face + 1] : NULL;
+		}
+
+		job->meshed = mesher_mesh_binary(mesher,
+		                                 &job->chunks[0],
+		                                 chunks,
+		                                 &job->mesh) == ENGINE_OK;
+	}
+
+	/* Only ever pushed to, the main thread takes the whole stack at once. */
+	head = atomic_load_explicit(&pipeline->completed, memory_order_relaxed);
+	do
+	{
+		job->next = head;
+	} while (!atomic_compare_exchange_weak_explicit(&pipeline->completed,
+	                                                &head,
+	                                                job,
+	                                                memory_order_release,
+	                                                memory_order_relaxed));
+}
+
+/******************************************************************************
+ * @name      queue_job()
+ * @brief     Hands a filled job to the workers.
+ * @param[in] pipeline The pipeline the job belongs to.
+ * @param[in] job      The job, taken from the free list.
+ * @return    void
+******************************************************************************/
+static void queue_job(MeshPipeline *pipeline, MeshJob *job)
+{
+	Job background = {
+		.function = run_next_job,
+		.data = pipeline
+	};
+
+	pthread_mutex_lock(&pipeline->pending_lock);
+	pipeline->pending[pipeline->pending_count++] = job;
+	pthread_mutex_unlock(&pipeline->pending_lock);
+
+	job_run_background(&background, 1, &pipeline->counter);
+}
+
+/******************************************************************************
+ * @name      collect_completed()
+ * @brief     Takes the jobs the workers have finished and queues them for
+ *            upload in the order they finished.
+ * @param[in] pipeline The pipeline to update.
+ * @return    void
+******************************************************************************/
+static void collect_completed(MeshPipeline *pipeline)
+{
+	MeshJob *stack = atomic_exchange_explicit(&pipeline->completed,
+	                                          NULL,
+	                                          memory_order_acquire);
+	MeshJob *finished = NULL;
+	MeshJob **tail = &pipeline->uploads;
+
+	while (stack != NULL)
+	{
+		MeshJob *next = stack->next;
+
+		stack->next = finished;
+		finished = stack;
+		stack = next;
+	}
+
+	while (*tail != NULL)
+	{
+		tail = &(*tail)->next;
+	}
+	*tail = finished;
+}
+
+/******************************************************************************
+ * @name      install_blocks()
+ * @brief     Swaps a node's blocks for those a job built, unless they are
+ *            older than the node's. If they differ the node's mesh is out of
+ *            date and its parent stale, and if the node has stopped or started
+ *            being solid through so are its neighbours' meshes.
+ * @param[in] pipeline The pipeline building the node.
+ * @param[in] job      The finished job.
+ * @return    void
+******************************************************************************/
+static void install_blocks(MeshPipeline *pipeline, MeshJob *job)
+{
+	Lod *lod = pipeline->lod;
+	uint32_t node = job->node;
+	Chunk *blocks = lod_node_blocks(lod, node);
+	int32_t coordinates[3];
+	uint32_t level;
+	uint8_t solid;
+	Chunk old;
+
+	if (!job->meshed)
+	{
+		LOG_WARNING("Failed to build node %u", node);
+
+		/* Hand it out again, unless a newer build already has been. */
+		if (lod->queued[node] == job->version)
+		{
+			lod->queued[node] = lod->built[node];
+		}
+		return;
+	}
+
+	if ((int32_t)(job->version - lod->built[node]) <= 0)
+	{
+		return;
+	}
+
+	lod->built[node] = job->version;
+	pipeline->built++;
+
+	if (chunk_equal(&job->blocks, blocks))
+	{
+		request_mesh(pipeline, node);
+		return;
+	}
+
+	/* The job keeps the old storage to reuse. */
+	solid = solid_through(blocks);
+	old = *blocks;
+	*blocks = job->blocks;
+	job->blocks = old;
+
+	lod_node_changed(lod, node);
+	publish_version(pipeline, node);
+	request_mesh(pipeline, node);
+
+	if (solid == solid_through(blocks))
+	{
+		return;
+	}
+
+	level = lod_node_coordinates(lod, node, coordinates);
+	for (uint32_t face = 0; face < CHUNK_FACE_COUNT; face++)
+	{
+		int32_t neighbour[3] = {coordinates[0], coordinates[1], coordinates[2]};
+		int32_t index;
+
+		neighbour[face / 2] += face & 1 ? 1 : -1;
+		index = lod_node_id(lod, level, neighbour[0], neighbour[1], neighbour[2]);
+		if (index >= 0)
+		{
+			lod->versions[index]++;
+			publish_version(pipeline, (uint32_t)index);
+			request_mesh(pipeline, (uint32_t)index);
+		}
+	}
+}
+
+/******************************************************************************
+ * @name         upload_mesh()
+ * @brief        Uploads a finished mesh, unless the node has changed since it
+ *               was snapshot, in which case it has been queued again, or is no
+ *               longer needed.
+ * @param[in]    pipeline The pipeline meshing the node.
+ * @param[in]    job      The finished job.
+ * @param[inout] uploaded Incremented by the bytes uploaded.
+ * @return       void
+******************************************************************************/
+static void upload_mesh(MeshPipeline *pipeline, const MeshJob *job, size_t *uploaded)
+{
+	uint32_t node = job->node;
+
+	if (job->version != lod_node_version(pipeline->lod, node))
+	{
+		return;
+	}
+
+	if (!job->meshed)
+	{
+		LOG_WARNING("Failed to mesh node %u", node);
+		return;
+	}
+
+	if (node < pipeline->lod->levels[0].count)
+	{
+		set_connectivity(pipeline, node, job->mesh.connectivity);
+	}
+
+	if (pipeline->wanted[node] || pipeline->drawn[node])
+	{
+		replace_mesh(pipeline, node, &job->mesh, job->version);
+		*uploaded += job->mesh.vertex_count * sizeof(ChunkVertex)
+		             + job->mesh.index_count * sizeof(uint32_t);
+		pipeline->uploaded++;
+	}
+}
+
+/******************************************************************************
+ * @name      upload_meshes()
+ * @brief     Uploads finished meshes until the update's budget is spent,
+ *            installs built blocks and frees their jobs.
+ * @param[in] pipeline The pipeline to update.
+ * @return    void
+******************************************************************************/
+static void upload_meshes(MeshPipeline *pipeline)
+{
+	size_t uploaded = 0;
+
+	PROFILE_ZONE("upload_meshes");
+
+	while (pipeline->uploads != NULL && uploaded < MESH_PIPELINE_UPLOAD_BUDGET)
+	{
+		MeshJob *job = pipeline->uploads;
+		uint32_t node = job->node;
+
+		if (job->downsample)
+		{
+			install_blocks(pipeline, job);
+		}
+		else
+		{
+			pipeline->busy[node]--;
+			upload_mesh(pipeline, job, &uploaded);
+		}
+
+		pipeline->uploads = job->next;
+		job->next = pipeline->free_jobs;
+		pipeline->free_jobs = job;
+	}
+}
+
+/******************************************************************************
+ * @name      draw_node()
+ * @brief     Adds a node to the drawn nodes.
+ * @param[in] pipeline The pipeline to update.
+ * @param     node     The node's id.
+ * @return    void
+******************************************************************************/
+static void draw_node(MeshPipeline *pipeline, uint32_t node)
+{
+	pipeline->drawn[node] = 1;
+	pipeline->selected[pipeline->selected_count++] = node;
+}
+
+/******************************************************************************
+ * @name      draw_ready()
+ * @brief     Draws a node if it is ready, otherwise the nearest of its
+ *            descendants that are.
+ * @param[in] pipeline The pipeline to update.
+ * @param     node     The node's id.
+ * @return    1 if the node is covered without holes, else 0.
+******************************************************************************/
+static uint8_t draw_ready(MeshPipeline *pipeline, uint32_t node)
+{
+	int32_t children[LOD_CHILD_COUNT];
+	uint8_t complete = 1;
+
+	if (pipeline->ready[node])
+	{
+		draw_node(pipeline, node);
+		return 1;
+	}
+
+	if (lod_node_level(pipeline->lod, node) == 0)
+	{
+		return 0;
+	}
+
+	lod_node_children(pipeline->lod, node, children);
+	for (uint32_t child = 0; child < LOD_CHILD_COUNT; child++)
+	{
+		if (children[child] >= 0)
+		{
+			complete &= draw_ready(pipeline, (uint32_t)children[child]);
+		}
+	}
+
+	return complete;
+}
+
+/******************************************************************************
+ * @name      select_node()
+ * @brief     Chooses the level of detail of the part of the world a node
+ *            covers, splitting it into its children if it is near the camera,
+ *            and draws what is ready of it. Until the chosen nodes are ready
+ *            whatever covered the same part before is drawn instead.
+ * @param[in] pipeline The pipeline to update.
+ * @param     node     The node's id.
+ * @return    1 if the node is covered without holes, else 0.
+******************************************************************************/
+static uint8_t select_node(MeshPipeline *pipeline, uint32_t node)
+{
+	int32_t children[LOD_CHILD_COUNT];
+	uint32_t start = pipeline->selected_count;
+	uint8_t complete = 1;
+
+	if (!lod_should_split(pipeline->lod, node, pipeline->camera))
+	{
+		pipeline->wanted[node] = 1;
+		request_mesh(pipeline, node);
+
+		/* Finer meshes stand in until this one is ready. */
+		return draw_ready(pipeline, node);
+	}
+
+	lod_node_children(pipeline->lod, node, children);
+	for (uint32_t child = 0; child < LOD_CHILD_COUNT; child++)
+	{
+		if (children[child] >= 0)
+		{
+			complete &= select_node(pipeline, (uint32_t)children[child]);
+		}
+	}
+
+	if (complete || !pipeline->ready[node])
+	{
+		return complete;
+	}
+
+	/* The coarser mesh stands in until every finer one is ready. */
+	while (pipeline->selected_count > start)
+	{
+		pipeline->drawn[pipeline->selected[--pipeline->selected_count]] = 0;
+	}
+	draw_node(pipeline, node);
+
+	return 1;
+}
+
+/******************************************************************************
+ * @name      select_nodes()
+ * @brief     Chooses the nodes to mesh and draw once the camera has moved to
+ *            another chunk or a node has become ready, then destroys the
+ *            meshes of nodes neither wanted nor drawn and hides those not
+ *            drawn.
+ * @param[in] pipeline The pipeline to update.
+ * @return    void
+******************************************************************************/
+static void select_nodes(MeshPipeline *pipeline)
+{
+	const Lod *lod = pipeline->lod;
+	const LodLevel *top = &lod->levels[lod->level_count - 1];
+	int32_t position[3] = {
+		(int32_t)floorf(pipeline->camera.x / CHUNK_SIZE),
+		(int32_t)floorf(pipeline->camera.y / CHUNK_SIZE),
+		(int32_t)floorf(pipeline->camera.z / CHUNK_SIZE)
+	};
+	uint32_t kept = 0;
+
+	PROFILE_ZONE("select_nodes");
+
+	if (!pipeline->reselect
+	    && position[0] == pipeline->selected_from[0]
+	    && position[1] == pipeline->selected_from[1]
+	    && position[2] == pipeline->selected_from[2])
+	{
+		return;
+	}
+
+	memset(pipeline->wanted, 0, lod->node_count * sizeof(uint8_t));
+	memset(pipeline->drawn, 0, lod->node_count * sizeof(uint8_t));
+	pipeline->selected_count = 0;
+
+	for (uint32_t i = 0; i < top->count; i++)
+	{
+		select_node(pipeline, top->first + i);
+	}
+
+	for (uint32_t i = 0; i < pipeline->live_count; i++)
+	{
+		uint32_t node = pipeline->live[i];
+
+		if (!pipeline->wanted[node] && !pipeline->drawn[node])
+		{
+			destroy_mesh(pipeline, node);
+			pipeline->ready[node] = 0;
+			continue;
+		}
+
+		refresh_mesh(pipeline, node);
+		pipeline->live[kept++] = node;
+	}
+	pipeline->live_count = kept;
+
+	memcpy(pipeline->selected_from, position, sizeof(pipeline->selected_from));
+	pipeline->reselect = 0;
+}
+
+/******************************************************************************
+ * @name      queue_jobs()
+ * @brief     Snapshots the dirty nodes nearest the camera into free jobs and
+ *            queues them on the workers. Nodes of nothing but air are given
+ *            their empty mesh straight away. Nodes no longer needed, or whose
+ *            blocks are yet to be built, are dropped until they are asked for
+ *            again.
+ * @param[in] pipeline The pipeline to update.
+ * @return    void
+******************************************************************************/
+static void queue_jobs(MeshPipeline *pipeline)
+{
+	const Lod *lod = pipeline->lod;
+	uint32_t taken = 0;
+
+	PROFILE_ZONE("queue_jobs");
+
+	if (pipeline->free_jobs == NULL || pipeline->dirty_count == 0)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < pipeline->dirty_count; i++)
+	{
+		pipeline->dirty[i].distance = node_distance(pipeline, pipeline->dirty[i].node);
+	}
+	qsort(pipeline->dirty,
+	      pipeline->dirty_count,
+	      sizeof(struct MeshPipelineDirty),
+	      compare_dirty);
+
+	for (; taken < pipeline->dirty_count && pipeline->free_jobs != NULL; taken++)
+	{
+		uint32_t node = pipeline->dirty[taken].node;
+		const Chunk *source = lod_node_blocks(lod, node);
+		MeshJob *job = pipeline->free_jobs;
+
+		if (!needs_mesh(pipeline, node) || lod_node_stale(lod, node))
+		{
+			pipeline->dirty_flags[node] = 0;
+			continue;
+		}
+
+		if (source->bits == 0 && source->uniform == BLOCK_AIR)
+		{
+			pipeline->dirty_flags[node] = 0;
+			if (node < lod->levels[0].count)
+			{
+				set_connectivity(pipeline, node, CHUNK_CONNECTIVITY_ALL);
+			}
+			replace_mesh(pipeline, node, NULL, lod_node_version(lod, node));
+			continue;
+		}
+
+		/* Out of memory, try again next update. */
+		if (snapshot(pipeline, job, node) != ENGINE_OK)
+		{
+			break;
+		}
+
+		pipeline->free_jobs = job->next;
+		pipeline->dirty_flags[node] = 0;
+		pipeline->busy[node]++;
+		pipeline->queued_versions[node] = job->version;
+		job->distance = pipeline->dirty[taken].distance;
+
+		queue_job(pipeline, job);
+	}
+
+	pipeline->dirty_count -= taken;
+	memmove(pipeline->dirty,
+	        pipeline->dirty + taken,
+	        pipeline->dirty_count * sizeof(struct MeshPipelineDirty));
+}
+
+/******************************************************************************
+ * @name      queue_builds()
+ * @brief     Snapshots the children of stale nodes whose children are all
+ *            built into free jobs and queues them on the workers, and forgets
+ *            nodes that are no longer stale.
+ * @param[in] pipeline The pipeline to update.
+ * @return    void
+******************************************************************************/
+static void queue_builds(MeshPipeline *pipeline)
+{
+	Lod *lod = pipeline->lod;
+	uint32_t kept = 0;
+
+	PROFILE_ZONE("queue_builds");
+
+	for (uint32_t i = 0; i < lod->stale_count; i++)
+	{
+		uint32_t node = lod->stale[i];
+		MeshJob *job = pipeline->free_jobs;
+
+		if (!lod_node_stale(lod, node))
+		{
+			lod->stale_flags[node] = 0;
+			continue;
+		}
+		lod->stale[kept++] = node;
+
+		/* If out of memory it is tried again next update. */
+		if (job == NULL
+		    || !lod_node_buildable(lod, node)
+		    || snapshot_children(pipeline, job, node) != ENGINE_OK)
+		{
+			continue;
+		}
+
+		pipeline->free_jobs = job->next;
+		lod->queued[node] = job->version;
+		job->distance = node_distance(pipeline, node);
+
+		queue_job(pipeline, job);
+	}
+
+	lod->stale_count = kept;
+}
+
+/******************************************************************************
+ * @name      reprioritise_pending()
+ * @brief     Updates the distances of the jobs no worker has taken yet, so the
+ *            nearest is still taken first once the camera has moved.
+ * @param[in] pipeline The pipeline to update.
+ * @return    void
+******************************************************************************/
+static void reprioritise_pending(MeshPipeline *pipeline)
+{
+	pthread_mutex_lock(&pipeline->pending_lock);
+	for (uint32_t i = 0; i < pipeline->pending_count; i++)
+	{
+		pipeline->pending[i]->distance = node_distance(pipeline,
+		                                               pipeline->pending[i]->node);
+	}
+	pthread_mutex_unlock(&pipeline->pending_lock);
+}
+
+/******************************************************************************
+ * @name      update_occlusion()
+ * @brief     Searches for the chunks that can be seen from the camera, if it
+ *            or the chunks have changed, and stops drawing the meshes of
+ *            those that cannot.
+ * @param[in] pipeline The pipeline to update.
+ * @return    void
+******************************************************************************/
+static void update_occlusion(MeshPipeline *pipeline)
+{
+	VisibilityGraph *visibility = pipeline->visibility;
+	uint32_t changed_count;
+
+	if (visibility == NULL)
+	{
+		return;
+	}
+
+	changed_count = visibility_graph_update(visibility, pipeline->camera);
+
+	for (uint32_t i = 0; i < changed_count; i++)
+	{
+		refresh_mesh(pipeline, visibility->changed[i]);
+	}
+}
+
+ENGINE_ERROR mesh_pipeline_create(MeshPipeline **pipeline,
+                                  World *world,
+                                  uint8_t occlusion,
+                                  uint32_t level_count)
+{
+	uint32_t thread_count = job_thread_count();
+	uint32_t node_count;
+	ENGINE_ERROR error = ENGINE_ERROR_OUT_OF_MEMORY;
+
+	*pipeline = calloc(1, sizeof(MeshPipeline));
+	if (*pipeline == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate mesh pipeline");
+	}
+
+	(*pipeline)->world = world;
+	pthread_mutex_init(&(*pipeline)->pending_lock, NULL);
+	atomic_init(&(*pipeline)->completed, NULL);
+
+	error = lod_create(&(*pipeline)->lod, world, level_count);
+	ENGINE_GOTO_IF_ERROR(error, create_fail);
+	node_count = (*pipeline)->lod->node_count;
+	error = ENGINE_ERROR_OUT_OF_MEMORY;
+
+	/* Background jobs only run on workers, the main thread needs no mesher. */
+	(*pipeline)->mesher_count = thread_count;
+	(*pipeline)->job_count = MESH_PIPELINE_JOBS_PER_WORKER * (thread_count - 1);
+
+	(*pipeline)->meshers = calloc(thread_count, sizeof(Mesher*));
+	(*pipeline)->versions = malloc(node_count * sizeof(atomic_uint));
+	(*pipeline)->meshes = calloc(node_count, sizeof(RendererMesh*));
+	(*pipeline)->mesh_versions = calloc(node_count, sizeof(uint32_t));
+	(*pipeline)->ready = calloc(node_count, sizeof(uint8_t));
+	(*pipeline)->mesh_states = calloc(node_count, sizeof(uint8_t));
+	(*pipeline)->wanted = calloc(node_count, sizeof(uint8_t));
+	(*pipeline)->drawn = calloc(node_count, sizeof(uint8_t));
+	(*pipeline)->queued_versions = calloc(node_count, sizeof(uint32_t));
+	(*pipeline)->busy = calloc(node_count, sizeof(uint16_t));
+	(*pipeline)->live = malloc(node_count * sizeof(uint32_t));
+	(*pipeline)->selected = malloc(node_count * sizeof(uint32_t));
+	(*pipeline)->dirty = malloc(node_count * sizeof(struct MeshPipelineDirty));
+	(*pipeline)->dirty_flags = calloc(node_count, sizeof(uint8_t));
+	(*pipeline)->jobs = calloc((*pipeline)->job_count, sizeof(MeshJob));
+	(*pipeline)->pending = malloc((*pipeline)->job_count * sizeof(MeshJob*));
+
+	if ((*pipeline)->meshers == NULL
+	    || (*pipeline)->versions == NULL
+	    || (*pipeline)->meshes == NULL
+	    || (*pipeline)->mesh_versions == NULL
+	    || (*pipeline)->ready == NULL
+	    || (*pipeline)->mesh_states == NULL
+	    || (*pipeline)->wanted == NULL
+	    || (*pipeline)->drawn == NULL
+	    || (*pipeline)->queued_versions == NULL
+	    || (*pipeline)->busy == NULL
+	    || (*pipeline)->live == NULL
+	    || (*pipeline)->selected == NULL
+	    || (*pipeline)->dirty == NULL
+	    || (*pipeline)->dirty_flags == NULL
+	    || (*pipeline)->jobs == NULL
+	    || (*pipeline)->pending == NULL)
+	{
+		goto create_fail;
+	}
+
+	for (uint32_t i = 1; i < thread_count; i++)
+	{
+		/* Connectivity only feeds the visibility graph. */
+		error = mesher_create(&(*pipeline)->meshers[i], occlusion);
+		ENGINE_GOTO_IF_ERROR(error, create_fail);
+	}
+
+	if (occlusion)
+	{
+		error = visibility_graph_create(&(*pipeline)->visibility, world);
+		ENGINE_GOTO_IF_ERROR(error, create_fail);
+	}
+
+	for (uint32_t i = 0; i < node_count; i++)
+	{
+		atomic_init(&(*pipeline)->versions[i], lod_node_version((*pipeline)->lod, i));
+	}
+
+	for (uint32_t i = 0; i < (*pipeline)->job_count; i++)
+	{
+		MeshJob *job = &(*pipeline)->jobs[i];
+
+		for (uint32_t c = 0; c < ARRAY_SIZE(job->chunks); c++)
+		{
+			chunk_init(&job->chunks[c], BLOCK_AIR);
+		}
+		chunk_init(&job->blocks, BLOCK_AIR);
+		chunk_mesh_init(&job->mesh);
+
+		job->next = (*pipeline)->free_jobs;
+		(*pipeline)->free_jobs = job;
+	}
+
+	/* Nothing is wanted until the first update chooses. */
+	(*pipeline)->reselect = 1;
+
+	return ENGINE_OK;
+
+create_fail:
+	mesh_pipeline_destroy(*pipeline);
+	*pipeline = NULL;
+	ENGINE_LOG_RETURN_IF_ERROR(error, "Failed to create mesh pipeline");
+}
+
+void mesh_pipeline_destroy(MeshPipeline *pipeline)
+{
+	const Lod *lod = pipeline->lod;
+	uint32_t node_count = lod != NULL ? lod->node_count : 0;
+
+	/* Jobs not yet taken are skipped once their versions are stale. */
+	for (uint32_t i = 0; pipeline->versions != NULL && i < node_count; i++)
+	{
+		atomic_store_explicit(&pipeline->versions[i],
+		                      lod_node_version(lod, i) + 1,
+		                      memory_order_relaxed);
+	}
+	job_wait(&pipeline->counter);
+
+	for (uint32_t i = 0; pipeline->meshes != NULL && i < node_count; i++)
+	{
+		if (pipeline->meshes[i] != NULL)
+		{
+			renderer_mesh_destroy(pipeline->meshes[i]);
+		}
+	}
+
+	for (uint32_t i = 0; pipeline->jobs != NULL && i < pipeline->job_count; i++)
+	{
+		for (uint32_t c = 0; c < ARRAY_SIZE(pipeline->jobs[i].chunks); c++)
+		{
+			chunk_deinit(&pipeline->jobs[i].chunks[c]);
+		}
+		chunk_deinit(&pipeline->jobs[i].blocks);
+		chunk_mesh_deinit(&pipeline->jobs[i].mesh);
+	}
+
+	for (uint32_t i = 0; pipeline->meshers != NULL && i < pipeline->mesher_count; i++)
+	{
+		if (pipeline->meshers[i] != NULL)
+		{
+			mesher_destroy(pipeline->meshers[i]);
+		}
+	}
+
+	if (pipeline->visibility != NULL)
+	{
+		visibility_graph_destroy(pipeline->visibility);
+	}
+
+	if (pipeline->lod != NULL)
+	{
+		lod_destroy(pipeline->lod);
+	}
+
+	pthread_mutex_destroy(&pipeline->pending_lock);
+
+	free(pipeline->meshers);
+	free(pipeline->versions);
+	free(pipeline->meshes);
+	free(pipeline->mesh_versions);
+	free(pipeline->ready);
+	free(pipeline->mesh_states);
+	free(pipeline->wanted);
+	free(pipeline->drawn);
+	free(pipeline->queued_versions);
+	free(pipeline->busy);
+	free(pipeline->live);
+	free(pipeline->selected);
+	free(pipeline->dirty);
+	free(pipeline->dirty_flags);
+	free(pipeline->jobs);
+	free(pipeline->pending);
+	free(pipeline);
+}
+
+void mesh_pipeline_update(MeshPipeline *pipeline, Vec3 camera)
+{
+	PROFILE_ZONE("mesh_pipeline_update");
+
+	pipeline->camera = camera;
+	pipeline->uploaded = 0;
+	pipeline->built = 0;
+
+	take_dirty(pipeline);
+	reprioritise_pending(pipeline);
+
+	/* Finished jobs are freed first so they can be reused straight away. */
+	collect_completed(pipeline);
+	upload_meshes(pipeline);
+
+	/* After the uploads, so nodes just made ready are drawn. */
+	select_nodes(pipeline);
+	queue_jobs(pipeline);
+	queue_builds(pipeline);
+
+	/* After the uploads, so new meshes and connectivity are accounted for. */
+	update_occlusion(pipeline);
+
+	PROFILE_COUNTER("Dirty nodes", pipeline->dirty_count);
+	PROFILE_COUNTER("Meshes uploaded", pipeline->uploaded);
+	PROFILE_COUNTER("Nodes built", pipeline->built);
+	PROFILE_COUNTER("Nodes drawn", pipeline->selected_count);
+	PROFILE_COUNTER("Occluded meshes", pipeline->occluded);
+}
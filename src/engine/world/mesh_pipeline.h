@@ -0,0 +1,194 @@
+#ifndef _MESH_PIPELINE_H_
+#define _MESH_PIPELINE_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "core/debug.h"
+#include "core/maths.h"
+#include "core/jobs.h"
+#include "renderer/renderer.h"
+
+#include "world.h"
+#include "chunk.h"
+#include "mesher.h"
+#include "visibility.h"
+#include "lod.h"
+
+#define MESH_PIPELINE_JOBS_PER_WORKER 4 /* Nodes queued or meshing at once. */
+#define MESH_PIPELINE_UPLOAD_BUDGET   (2u * 1024 * 1024) /* Bytes of meshes
+                                                            uploaded per update. */
+
+#define MESH_JOB_CHUNKS LOD_CHILD_COUNT /* Enough for a chunk and its
+                                           neighbours, or a node's children. */
+
+/******************************************************************************
+ * @name  _MeshJob
+ * @brief A node to mesh, with snapshots of it and its neighbours taken on
+ *        the main thread so workers never read the world while it is edited.
+ *        A job may instead build a node's blocks from snapshots of its
+ *        children. Jobs are reused, the snapshots and mesh keep their
+ *        storage.
+******************************************************************************/
+struct _MeshJob
+{
+	struct _MeshJob *next; /*< In the free list or the completed stack. */
+
+	uint32_t node;      /*< The node's id in the pipeline's Lod. */
+	uint32_t version;   /*< The node's version when it was snapshot, or the
+	                        generation being built. */
+	float distance;     /*< Squared distance from the camera to the node, in
+	                        node widths. */
+	uint8_t downsample; /*< Set to build the node's blocks rather than mesh
+	                        it. */
+
+	Chunk chunks[MESH_JOB_CHUNKS]; /*< The node, then its neighbours in
+	                                   ChunkFace order, or its children in
+	                                   lod_node_children() order. */
+	uint8_t present[MESH_JOB_CHUNKS]; /*< Set if the neighbour is meshed
+	                                      against or the child is in the
+	                                      world. */
+
+	ChunkMesh mesh;
+	Chunk blocks;   /*< The built blocks, swapped with the node's old ones. */
+	uint8_t meshed; /*< Not set if the job was cancelled or failed. */
+};
+typedef struct _MeshJob MeshJob;
+
+/******************************************************************************
+ * @name  MeshPipelineDirty
+ * @brief A node waiting to be meshed.
+******************************************************************************/
+struct MeshPipelineDirty
+{
+	float distance; /*< Squared distance from the camera to the node, in node
+	                    widths. */
+	uint32_t node;
+};
+
+/******************************************************************************
+ * @name  _MeshPipeline
+ * @brief Keeps the meshes of a world's chunks up to date. Dirty chunks are
+ *        meshed nearest the camera first on the job system's workers as
+ *        background jobs, so the main thread never waits on them, and the
+ *        results are handed back through a lock-free stack to be uploaded
+ *        within a budget each update.
+ *
+ *        A chunk edited again while its job is queued or running makes the
+ *        job stale. Workers skip stale jobs and the main thread discards their
+ *        results, the chunk is simply queued again.
+ *
+ *        With more than one level of detail, the world is drawn as nodes of a
+ *        Lod chosen by walking its octree from the coarsest level, splitting
+ *        nodes near the camera. Only the chosen nodes are meshed and meshes
+ *        of nodes no longer needed are destroyed. The workers also build the
+ *        coarser levels' blocks as the world changes. A node is drawn in
+ *        place of its children until they are all meshed, and its children
+ *        are drawn until it is, so switching levels never leaves holes.
+ *        Nodes above full detail are meshed with walls on every side, except
+ *        against neighbours of their level that are solid through, to cover
+ *        the cracks between levels.
+ *
+ *        With occlusion culling, each meshed chunk's connectivity feeds a
+ *        visibility graph and the meshes of chunks it cannot reach from the
+ *        camera are not drawn. Coarser nodes are always drawn.
+******************************************************************************/
+struct _MeshPipeline
+{
+	World *world;
+	Lod *lod;
+	Vec3 camera; /*< Where nodes were prioritised from on the last update. */
+
+	Mesher **meshers;         /*< One per job system thread. */
+	uint32_t mesher_count;
+	atomic_uint *versions;    /*< The nodes' versions, for workers to check. */
+
+	/* Of each node, indexed by id. */
+	RendererMesh **meshes;     /*< The node's mesh, NULL if it has none. */
+	uint32_t *mesh_versions;   /*< The version the mesh was built from. */
+	uint8_t *ready;            /*< Set once the node is meshed, even if it has
+	                               no faces. */
+	uint8_t *mesh_states;      /*< Whether the mesh is hidden, and whether it
+	                               is counted as occluded. */
+	uint8_t *wanted;           /*< Set if the node's level is the one chosen. */
+	uint8_t *drawn;            /*< Set if the node is drawn. */
+	uint32_t *queued_versions; /*< The version of the newest job queued. */
+	uint16_t *busy;            /*< Mesh jobs queued or running. */
+
+	uint32_t *live;            /*< The ready nodes. */
+	uint32_t live_count;
+	uint32_t *selected;        /*< The drawn nodes. */
+	uint32_t selected_count;
+	int32_t selected_from[3];  /*< The chunk the camera was in when they were
+	                               chosen. */
+	uint8_t reselect;          /*< Set if a node has become ready or stopped
+	                               being ready since. */
+
+	VisibilityGraph *visibility; /*< NULL without occlusion culling. */
+	uint32_t occluded;           /*< Meshes not drawn as they cannot be seen. */
+
+	struct MeshPipelineDirty *dirty; /*< Nodes waiting for a job. */
+	uint32_t dirty_count;
+	uint8_t *dirty_flags;            /*< Set for each node in dirty. */
+
+	MeshJob *jobs;      /*< Every job, job_count of them. */
+	uint32_t job_count;
+	MeshJob *free_jobs; /*< Only used by the main thread. */
+
+	pthread_mutex_t pending_lock;
+	MeshJob **pending;      /*< Jobs waiting for a worker, nearest taken first. */
+	uint32_t pending_count;
+
+	_Atomic(MeshJob*) completed; /*< Pushed by workers, most recent first. */
+	MeshJob *uploads;            /*< Completed jobs, oldest first, that did not
+	                                 fit in an earlier update's budget. */
+	JobCounter counter;          /*< Background jobs not yet finished. */
+
+	uint32_t uploaded; /*< Meshes uploaded by the last update. */
+	uint32_t built;    /*< Nodes built by the last update. */
+};
+typedef struct _MeshPipeline MeshPipeline;
+
+/******************************************************************************
+ * @name       mesh_pipeline_create()
+ * @brief      Creates a pipeline meshing a world's chunks. Chunks already
+ *             dirty in the world are meshed on the first updates. Must be
+ *             called from the main thread.
+ * @param[out] pipeline    A pointer to a pointer set to the created pipeline.
+ * @param[in]  world       The world to mesh, which must outlive the pipeline.
+ * @param      occlusion   Set to stop drawing chunks hidden behind solid
+ *                         ground.
+ * @param      level_count Levels of detail, at most LOD_MAX_LEVELS. 1 draws
+ *                         every chunk at full detail.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR mesh_pipeline_create(MeshPipeline **pipeline,
+                                  World *world,
+                                  uint8_t occlusion,
+                                  uint32_t level_count);
+
+/******************************************************************************
+ * @name      mesh_pipeline_destroy()
+ * @brief     Cancels any work in progress, waits for the workers to let go of
+ *            it and destroys every mesh. Must be called from the main thread
+ *            before the renderer is deinitalised.
+ * @param[in] pipeline The pipeline to destroy.
+ * @return    void
+******************************************************************************/
+void mesh_pipeline_destroy(MeshPipeline *pipeline);
+
+/******************************************************************************
+ * @name      mesh_pipeline_update()
+ * @brief     Takes the world's dirty chunks, chooses the level of detail of
+ *            each part of the world, queues jobs for the nodes nearest the
+ *            camera, uploads the meshes that have finished and updates which
+ *            nodes are drawn. Never waits on the workers. Called by the main
+ *            thread once per frame, before the frame is drawn.
+ * @param[in] pipeline The pipeline to update.
+ * @param     camera   Where the world is viewed from.
+ * @return    void
+******************************************************************************/
+void mesh_pipeline_update(MeshPipeline *pipeline, Vec3 camera);
+
+#endif /* _MESH_PIPELINE_H_ */
@@ -0,0 +1,1193 @@
+#include "mesher.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/logger.h"
+
+static inline uint32_t padded_index(int32_t x, int32_t y, int32_t z)
+{
+	return ((y + 1) * MESHER_PADDED_SIZE + (z + 1)) * MESHER_PADDED_SIZE + (x + 1);
+}
+
+/* Distance between neighbouring blocks along each axis of Mesher.blocks. */
+static const int32_t padded_strides[3] = {
+	1,
+	MESHER_PADDED_SIZE * MESHER_PADDED_SIZE,
+	MESHER_PADDED_SIZE
+};
+
+/* Distance between neighbouring blocks along each axis of a chunk. */
+static const uint32_t chunk_strides[3] = {1, CHUNK_AREA, CHUNK_SIZE};
+
+void chunk_mesh_init(ChunkMesh *mesh)
+{
+	memset(mesh, 0, sizeof(ChunkMesh));
+}
+
+void chunk_mesh_deinit(ChunkMesh *mesh)
+{
+	free(mesh->vertices);
+	free(mesh->indices);
+	chunk_mesh_init(mesh);
+}
+
+/******************************************************************************
+ * @name      chunk_mesh_reserve()
+ * @brief     Grows a mesh's storage to fit more quads.
+ * @param[in] mesh  The mesh to grow.
+ * @param     quads The number of quads that must fit after those already in
+ *                  the mesh.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR chunk_mesh_reserve(ChunkMesh *mesh, uint32_t quads)
+{
+	uint32_t needed = mesh->vertex_count + 4 * quads;
+	uint32_t capacity = mesh->vertex_capacity ? mesh->vertex_capacity
+	                                          : CHUNK_MESH_INITIAL_VERTICES;
+	ChunkVertex *vertices;
+	uint32_t *indices;
+
+	if (needed <= mesh->vertex_capacity)
+	{
+		return ENGINE_OK;
+	}
+
+	while (capacity < needed)
+	{
+		capacity *= 2;
+	}
+
+	vertices = realloc(mesh->vertices, capacity * sizeof(ChunkVertex));
+	if (vertices == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to grow chunk mesh");
+	}
+	mesh->vertices = vertices;
+
+	indices = realloc(mesh->indices, capacity / 2 * 3 * sizeof(uint32_t));
+	if (indices == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to grow chunk mesh");
+	}
+	mesh->indices = indices;
+
+	mesh->vertex_capacity = capacity;
+	return ENGINE_OK;
+}
+
+/******************************************************************************
+ * @name      emit_quad()
+ * @brief     Adds a quad to a mesh, which must have room for it. Front faces
+ *            are clockwise when seen from outside the block.
+ * @param[in] mesh   The mesh to add to.
+ * @param     face   The direction the quad faces.
+ * @param     origin The corner of the quad with the lowest coordinates.
+ * @param     width  The quad's size along the axis after the face's axis.
+ * @param     height The quad's size along the axis after that.
+ * @param     block  The block the quad is a face of.
+ * @return    void
+******************************************************************************/
+static void emit_quad(ChunkMesh *mesh,
+                      ChunkFace face,
+                      const uint32_t origin[3],
+                      uint32_t width,
+                      uint32_t height,
+                      BlockId block)
+{
+	static const uint32_t shifts[3] = {
+		CHUNK_VERTEX_X_SHIFT,
+		CHUNK_VERTEX_Y_SHIFT,
+		CHUNK_VERTEX_Z_SHIFT
+	};
+	uint32_t axis = face / 2;
+	uint32_t across = width << shifts[(axis + 1) % 3];
+	uint32_t up = height << shifts[(axis + 2) % 3];
+	uint32_t corner = origin[0] << CHUNK_VERTEX_X_SHIFT
+	                  | origin[1] << CHUNK_VERTEX_Y_SHIFT
+	                  | origin[2] << CHUNK_VERTEX_Z_SHIFT
+	                  | (uint32_t)face << CHUNK_VERTEX_FACE_SHIFT
+	                  | (uint32_t)mesh->level << CHUNK_VERTEX_LEVEL_SHIFT;
+	ChunkVertex *vertices = &mesh->vertices[mesh->vertex_count];
+	uint32_t base = mesh->vertex_count;
+
+	/* The u and v axes cross to the positive normal, so walking the corners
+	 * through v first is clockwise from the positive side. Coordinates never
+	 * carry into each other, so corners are offset while packed. */
+	vertices[0] = (ChunkVertex){corner, block};
+	vertices[2] = (ChunkVertex){corner + across + up, block};
+	if (face & 1)
+	{
+		vertices[1] = (ChunkVertex){corner + up, block};
+		vertices[3] = (ChunkVertex){corner + across, block};
+	}
+	else
+	{
+		vertices[1] = (ChunkVertex){corner + across, block};
+		vertices[3] = (ChunkVertex){corner + up, block};
+	}
+
+	mesh->indices[mesh->index_count++] = base;
+	mesh->indices[mesh->index_count++] = base + 1;
+	mesh->indices[mesh->index_count++] = base + 2;
+	mesh->indices[mesh->index_count++] = base;
+	mesh->indices[mesh->index_count++] = base + 2;
+	mesh->indices[mesh->index_count++] = base + 3;
+
+	mesh->vertex_count += 4;
+}
+
+/******************************************************************************
+ * @name      load_blocks()
+ * @brief     Decodes a chunk and the layer of each neighbour that touches it
+ *            into the mesher's padded block array.
+ * @param[in] mesher     The mesher to fill.
+ * @param[in] chunk      The chunk being meshed.
+ * @param[in] neighbours The chunk's neighbours, NULL ones are air.
+ * @return    void
+******************************************************************************/
+static void load_blocks(Mesher *restrict mesher,
+                        const Chunk *restrict chunk,
+                        const Chunk *const neighbours[CHUNK_FACE_COUNT])
+{
+	const Chunk *neighbour;
+
+	/* Only the faces of the padding are read, its edges and corners stay
+	 * air. */
+	memset(mesher->blocks, 0, sizeof(mesher->blocks));
+
+	chunk_decode(chunk,
+	             &mesher->blocks[padded_index(0, 0, 0)],
+	             padded_strides[2],
+	             padded_strides[1]);
+
+	for (int32_t a = 0; a < CHUNK_SIZE; a++)
+	{
+		if ((neighbour = neighbours[CHUNK_FACE_NEGATIVE_Y]) != NULL)
+		{
+			chunk_get_row(neighbour,
+			              CHUNK_SIZE - 1,
+			              a,
+			              &mesher->blocks[padded_index(0, -1, a)]);
+		}
+		if ((neighbour = neighbours[CHUNK_FACE_POSITIVE_Y]) != NULL)
+		{
+			chunk_get_row(neighbour, 0, a, &mesher->blocks[padded_index(0, CHUNK_SIZE, a)]);
+		}
+		if ((neighbour = neighbours[CHUNK_FACE_NEGATIVE_Z]) != NULL)
+		{
+			chunk_get_row(neighbour,
+			              a,
+			              CHUNK_SIZE - 1,
+			              &mesher->blocks[padded_index(0, a, -1)]);
+		}
+		if ((neighbour = neighbours[CHUNK_FACE_POSITIVE_Z]) != NULL)
+		{
+			chunk_get_row(neighbour, a, 0, &mesher->blocks[padded_index(0, a, CHUNK_SIZE)]);
+		}
+
+		for (int32_t b = 0; b < CHUNK_SIZE; b++)
+		{
+			if ((neighbour = neighbours[CHUNK_FACE_NEGATIVE_X]) != NULL)
+			{
+				mesher->blocks[padded_index(-1, a, b)] =
+					chunk_get(neighbour, CHUNK_SIZE - 1, a, b);
+			}
+			if ((neighbour = neighbours[CHUNK_FACE_POSITIVE_X]) != NULL)
+			{
+				mesher->blocks[padded_index(CHUNK_SIZE, a, b)] =
+					chunk_get(neighbour, 0, a, b);
+			}
+		}
+	}
+}
+
+/******************************************************************************
+ * @name      row_has_block()
+ * @brief     Checks whether a run of a slice's faces holds a block.
+ * @param[in] row   The faces.
+ * @param     width The length of the run.
+ * @param     block The block to look for.
+ * @return    1 if it does, otherwise 0.
+******************************************************************************/
+static inline uint8_t row_has_block(const BlockId *row, uint32_t width, BlockId block)
+{
+	for (uint32_t k = 0; k < width; k++)
+	{
+		if (row[k] == block)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/******************************************************************************
+ * @name      mesh_slice()
+ * @brief     Finds the visible faces of one layer of blocks and merges them
+ *            greedily, widest first and then as tall as the width allows.
+ *            Quads also grow across buried faces, between two opaque blocks,
+ *            as nothing drawn there can be seen.
+ * @param[in] mesher The mesher holding the chunk's blocks.
+ * @param     face   The direction of the faces to mesh.
+ * @param     slice  The layer's coordinate along the face's axis.
+ * @param[in] mesh   The mesh to add quads to.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR mesh_slice(Mesher *restrict mesher,
+                               ChunkFace face,
+                               uint32_t slice,
+                               ChunkMesh *restrict mesh)
+{
+	uint32_t axis = face / 2;
+	uint32_t u = (axis + 1) % 3;
+	uint32_t v = (axis + 2) % 3;
+	int32_t facing = (face & 1) ? padded_strides[axis] : -padded_strides[axis];
+	uint32_t faces = 0;
+	uint32_t buried[CHUNK_SIZE]; /* Bit i of row j set for buried faces. */
+	uint32_t position[3];
+	ENGINE_ERROR error;
+
+	position[axis] = slice;
+	position[u] = 0;
+	position[v] = 0;
+
+	const BlockId *layer = &mesher->blocks[padded_index(position[0],
+	                                                    position[1],
+	                                                    position[2])];
+
+	for (uint32_t j = 0; j < CHUNK_SIZE; j++)
+	{
+		const BlockId *blocks = layer + j * padded_strides[v];
+		BlockId *mask = &mesher->mask[j * CHUNK_SIZE];
+
+		buried[j] = 0;
+		for (uint32_t i = 0; i < CHUNK_SIZE; i++, blocks += padded_strides[u])
+		{
+			BlockId block = blocks[0] != BLOCK_AIR && blocks[facing] == BLOCK_AIR
+			                ? blocks[0]
+			                : BLOCK_AIR;
+
+			mask[i] = block;
+			faces += block != BLOCK_AIR;
+			buried[j] |= (uint32_t)(blocks[0] != BLOCK_AIR && blocks[facing] != BLOCK_AIR) << i;
+		}
+	}
+
+	if (faces == 0)
+	{
+		return ENGINE_OK;
+	}
+
+	mesh->face_count += faces;
+
+	/* A slice never needs more quads than it has faces. */
+	error = chunk_mesh_reserve(mesh, faces);
+	ENGINE_RETURN_IF_ERROR(error);
+
+	position[axis] = slice + (face & 1);
+
+	for (uint32_t j = 0; j < CHUNK_SIZE; j++)
+	{
+		for (uint32_t i = 0; i < CHUNK_SIZE; )
+		{
+			BlockId *row = &mesher->mask[j * CHUNK_SIZE];
+			BlockId block = row[i];
+			uint32_t width = 1;
+			uint32_t height = 1;
+
+			if (block == BLOCK_AIR)
+			{
+				i++;
+				continue;
+			}
+
+			while (i + width < CHUNK_SIZE
+			       && (row[i + width] == block || (buried[j] >> (i + width) & 1)))
+			{
+				width++;
+			}
+
+			for (; j + height < CHUNK_SIZE; height++)
+			{
+				const BlockId *next = &row[height * CHUNK_SIZE + i];
+				uint32_t k = 0;
+
+				while (k < width
+				       && (next[k] == block || (buried[j + height] >> (i + k) & 1)))
+				{
+					k++;
+				}
+
+				if (k < width)
+				{
+					break;
+				}
+			}
+
+			/* Rows of nothing but buried faces would only add overdraw. */
+			while (height > 1 && !row_has_block(&row[(height - 1) * CHUNK_SIZE + i],
+			                                    width,
+			                                    block))
+			{
+				height--;
+			}
+
+			for (uint32_t h = 0; h < height; h++)
+			{
+				memset(&row[h * CHUNK_SIZE + i], 0, width * sizeof(BlockId));
+			}
+
+			position[u] = i;
+			position[v] = j;
+			emit_quad(mesh, face, position, width, height, block);
+
+			i += width;
+		}
+	}
+
+	return ENGINE_OK;
+}
+
+/******************************************************************************
+ * @name         transpose_step()
+ * @brief        Swaps the off-diagonal blocks of each block of a 32x32 bit
+ *               matrix along its diagonal.
+ * @param[inout] rows  The matrix's rows.
+ * @param        width The width of the blocks swapped.
+ * @param        mask  The low width bits of every 2 * width bits.
+ * @return       void
+******************************************************************************/
+static inline void transpose_step(uint32_t rows[32], uint32_t width, uint32_t mask)
+{
+	for (uint32_t block = 0; block < 32; block += 2 * width)
+	{
+		for (uint32_t k = block; k < block + width; k++)
+		{
+			uint32_t swap = ((rows[k] >> width) ^ rows[k + width]) & mask;
+
+			rows[k] ^= swap << width;
+			rows[k + width] ^= swap;
+		}
+	}
+}
+
+/******************************************************************************
+ * @name         transpose32()
+ * @brief        Transposes a 32x32 bit matrix, bit j of row i swaps with bit i
+ *               of row j. Quadrants are swapped in halves, then quarters and
+ *               so on down to single bits.
+ * @param[inout] rows The matrix's rows.
+ * @return       void
+******************************************************************************/
+static void transpose32(uint32_t rows[32])
+{
+	/* Constant widths let each step be unrolled and vectorised. */
+	transpose_step(rows, 16, 0x0000ffff);
+	transpose_step(rows, 8, 0x00ff00ff);
+	transpose_step(rows, 4, 0x0f0f0f0f);
+	transpose_step(rows, 2, 0x33333333);
+	transpose_step(rows, 1, 0x55555555);
+}
+
+/******************************************************************************
+ * @name   repeat_field()
+ * @brief  Repeats a value in every field of a word of packed indices.
+ * @param  value The value, less than 2^bits.
+ * @param  bits  The width of each field, a power of two less than 64.
+ * @return The word.
+******************************************************************************/
+static inline uint64_t repeat_field(uint64_t value, uint32_t bits)
+{
+	static const uint64_t lowest[6] = {
+		0xffffffffffffffffull,
+		0x5555555555555555ull,
+		0x1111111111111111ull,
+		0x0101010101010101ull,
+		0x0001000100010001ull,
+		0x0000000100000001ull
+	};
+
+	return value * lowest[__builtin_ctz(bits)];
+}
+
+/******************************************************************************
+ * @name   gather_fields()
+ * @brief  Gathers the lowest bit of each field of a word into its low
+ *         64 / bits bits, merging neighbouring groups of bits in halving
+ *         steps.
+ * @param  word  The word, with only the lowest bit of each field set.
+ * @param  bits  The width of each field.
+ * @return The gathered bits.
+******************************************************************************/
+static inline uint64_t gather_fields(uint64_t word, uint32_t bits)
+{
+	for (uint32_t group = 1, spacing = bits; spacing < 64; group *= 2, spacing *= 2)
+	{
+		uint64_t keep = (1ull << (2 * group)) - 1;
+
+		word = (word | word >> (spacing - group))
+		       & (2 * spacing < 64 ? repeat_field(keep, 2 * spacing) : keep);
+	}
+
+	return word;
+}
+
+/******************************************************************************
+ * @name       mask_packed_rows()
+ * @brief      Builds rows of opaque blocks from packed indices a word at a
+ *             time. Each field is compared to air's index by folding its bits
+ *             together, then the fields' bits are gathered.
+ * @param[in]  words  The chunk's indices.
+ * @param      bits   The width of each index.
+ * @param      air    Air's index in the palette.
+ * @param      first  The first row's index, y * CHUNK_SIZE + z.
+ * @param      stride The distance between the rows' indices.
+ * @param      count  The number of rows.
+ * @param[out] masks  Set to count rows, bit x set if the block at x is
+ *                    opaque.
+ * @return     void
+******************************************************************************/
+static inline void mask_packed_rows(const uint64_t *restrict words,
+                                    uint32_t bits,
+                                    uint32_t air,
+                                    uint32_t first,
+                                    uint32_t stride,
+                                    uint32_t count,
+                                    uint32_t *restrict masks)
+{
+	const uint32_t per_word = 64 / bits;
+	const uint64_t air_fields = repeat_field(air, bits);
+	const uint64_t low_bits = repeat_field(1, bits);
+
+	for (uint32_t r = 0; r < count; r++)
+	{
+		uint32_t index = (first + r * stride) * CHUNK_SIZE;
+		uint32_t mask = 0;
+
+		for (uint32_t x = 0; x < CHUNK_SIZE; x += per_word)
+		{
+			uint64_t word = words[(index + x) / per_word] ^ air_fields;
+
+			for (uint32_t shift = 1; shift < bits; shift *= 2)
+			{
+				word |= word >> shift;
+			}
+
+			mask |= (uint32_t)(gather_fields(word & low_bits, bits)
+			                   >> ((index + x) % per_word)) << x;
+		}
+
+		masks[r] = mask;
+	}
+}
+
+/******************************************************************************
+ * @name       mask_rows()
+ * @brief      Builds rows along x of a chunk's opaque blocks without decoding
+ *             it, straight from its packed indices.
+ * @param[in]  chunk  The chunk to read, NULL for air.
+ * @param      first  The first row's index, y * CHUNK_SIZE + z.
+ * @param      stride The distance between the rows' indices.
+ * @param      count  The number of rows.
+ * @param[out] masks  Set to count rows, bit x set if the block at x is
+ *                    opaque.
+ * @return     void
+******************************************************************************/
+static void mask_rows(const Chunk *restrict chunk,
+                      uint32_t first,
+                      uint32_t stride,
+                      uint32_t count,
+                      uint32_t *restrict masks)
+{
+	const BlockId *palette = chunk != NULL ? chunk->palette : NULL;
+	int32_t air = -1;
+
+	/* Block IDs are only in the palette once, so only one index is air. */
+	for (uint32_t entry = 0; palette != NULL && entry < chunk->palette_size; entry++)
+	{
+		if (palette[entry] == BLOCK_AIR)
+		{
+			air = (int32_t)entry;
+		}
+	}
+
+	if (chunk == NULL || chunk->bits == 0 || (palette != NULL && air < 0))
+	{
+		uint32_t mask = chunk != NULL && (chunk->bits != 0 || chunk->uniform != BLOCK_AIR)
+		                ? ~0u
+		                : 0;
+
+		for (uint32_t r = 0; r < count; r++)
+		{
+			masks[r] = mask;
+		}
+		return;
+	}
+
+	if (palette == NULL)
+	{
+		BlockId row[CHUNK_SIZE];
+
+		for (uint32_t r = 0; r < count; r++)
+		{
+			uint32_t index = first + r * stride;
+
+			chunk_get_row(chunk, index / CHUNK_SIZE, index % CHUNK_SIZE, row);
+			masks[r] = 0;
+			for (uint32_t x = 0; x < CHUNK_SIZE; x++)
+			{
+				masks[r] |= (uint32_t)(row[x] != BLOCK_AIR) << x;
+			}
+		}
+		return;
+	}
+
+	/* A constant width lets the folds and gathers be unrolled. */
+	switch (chunk->bits)
+	{
+		case 1:
+			mask_packed_rows(chunk->indices, 1, air, first, stride, count, masks);
+			break;
+		case 2:
+			mask_packed_rows(chunk->indices, 2, air, first, stride, count, masks);
+			break;
+		case 4:
+			mask_packed_rows(chunk->indices, 4, air, first, stride, count, masks);
+			break;
+		default:
+			mask_packed_rows(chunk->indices, 8, air, first, stride, count, masks);
+			break;
+	}
+}
+
+/******************************************************************************
+ * @name       mask_side()
+ * @brief      Builds the rows along z of a chunk's opaque blocks at one x.
+ * @param[in]  chunk The chunk to read, NULL for air.
+ * @param      x     The x coordinate of the rows.
+ * @param[out] masks Set to a row for each y, bit z set if the block at z is
+ *                   opaque.
+ * @return     void
+******************************************************************************/
+static void mask_side(const Chunk *chunk, uint32_t x, uint32_t masks[CHUNK_SIZE])
+{
+	for (uint32_t y = 0; y < CHUNK_SIZE; y++)
+	{
+		masks[y] = 0;
+		for (uint32_t z = 0; chunk != NULL && z < CHUNK_SIZE; z++)
+		{
+			masks[y] |= (uint32_t)(chunk_get(chunk, x, y, z) != BLOCK_AIR) << z;
+		}
+	}
+}
+
+/******************************************************************************
+ * @name      build_columns()
+ * @brief     Builds the padded columns of opaque blocks along an axis from the
+ *            rows along x and the neighbours' borders, see mask_borders().
+ * @param[in] mesher The mesher holding the chunk's rows.
+ * @param     axis   The axis the columns run along.
+ * @return    void
+******************************************************************************/
+static void build_columns(Mesher *mesher, uint32_t axis)
+{
+	uint32_t matrix[CHUNK_SIZE];
+	const uint64_t high = (uint64_t)1 << (CHUNK_SIZE + 1);
+
+	if (axis == 0)
+	{
+		/* Rows along x are already columns, indexed by y and z. */
+		for (uint32_t y = 0; y < CHUNK_SIZE; y++)
+		{
+			for (uint32_t z = 0; z < CHUNK_SIZE; z++)
+			{
+				mesher->columns[y * CHUNK_SIZE + z] =
+					((mesher->borders[4][y] >> z) & 1)
+					| (uint64_t)mesher->rows[y * CHUNK_SIZE + z] << 1
+					| (((mesher->borders[5][y] >> z) & 1) ? high : 0);
+			}
+		}
+		return;
+	}
+
+	for (uint32_t outer = 0; outer < CHUNK_SIZE; outer++)
+	{
+		const uint32_t *low_border = mesher->borders[2 * (axis - 1)];
+		const uint32_t *high_border = mesher->borders[2 * (axis - 1) + 1];
+
+		/* Along y the matrix is a z slice's rows over y, along z it is a y
+		 * slice's rows over z. Transposed, each row runs along the axis. */
+		for (uint32_t i = 0; i < CHUNK_SIZE; i++)
+		{
+			matrix[i] = axis == 1 ? mesher->rows[i * CHUNK_SIZE + outer]
+			                      : mesher->rows[outer * CHUNK_SIZE + i];
+		}
+
+		transpose32(matrix);
+
+		for (uint32_t x = 0; x < CHUNK_SIZE; x++)
+		{
+			/* Along y columns are indexed by z and x, along z by x and y. */
+			uint32_t column = axis == 1 ? outer * CHUNK_SIZE + x
+			                            : x * CHUNK_SIZE + outer;
+
+			mesher->columns[column] = ((low_border[outer] >> x) & 1)
+			                          | (uint64_t)matrix[x] << 1
+			                          | (((high_border[outer] >> x) & 1) ? high : 0);
+		}
+	}
+}
+
+/******************************************************************************
+ * @name      slice_solid()
+ * @brief     Lays the chunk's opaque blocks out in slices across an axis,
+ *            like the planes of faces. Along an axis, they are the columns
+ *            along the next axis, so it must be called before the columns
+ *            of this axis are built. Along z they are the rows.
+ * @param[in] mesher The mesher holding the columns of the next axis.
+ * @param     axis   The axis the slices are across.
+ * @return    void
+******************************************************************************/
+static void slice_solid(Mesher *mesher, uint32_t axis)
+{
+	for (uint32_t slice = 0; slice < CHUNK_SIZE; slice++)
+	{
+		for (uint32_t v = 0; v < CHUNK_SIZE; v++)
+		{
+			uint32_t column = v * CHUNK_SIZE + slice;
+
+			mesher->solid[slice][v] = axis == 2 ? mesher->rows[column]
+			                                    : (uint32_t)(mesher->columns[column] >> 1);
+		}
+	}
+}
+
+/******************************************************************************
+ * @name      same_block_run()
+ * @brief     Measures how far a run of faces and buried faces holds only one
+ *            block. Buried faces may be any block.
+ * @param[in] chunk  The chunk holding the blocks.
+ * @param     first  The index of the run's first block.
+ * @param     stride The distance between the run's blocks.
+ * @param     faces  The faces along the run, the first in the lowest bit.
+ * @param     width  The length of the run.
+ * @param     block  The block to match.
+ * @return    The length of the run's start that matches.
+******************************************************************************/
+static inline uint32_t same_block_run(const Chunk *chunk,
+                                      uint32_t first,
+                                      uint32_t stride,
+                                      uint32_t faces,
+                                      uint32_t width,
+                                      BlockId block)
+{
+	faces &= (uint32_t)(((uint64_t)1 << width) - 1);
+
+	for (; faces != 0; faces &= faces - 1)
+	{
+		uint32_t k = __builtin_ctz(faces);
+
+		if (chunk_get_index(chunk, first + k * stride) != block)
+		{
+			return k;
+		}
+	}
+
+	return width;
+}
+
+/******************************************************************************
+ * @name      merge_faces()
+ * @brief     Transposes the faces of an axis in one direction into slices
+ *            and merges each slice greedily, the same way as mesh_slice().
+ * @param[in] mesher       The mesher holding the faces and the slices'
+ *                         opaque blocks, see slice_solid().
+ * @param[in] chunk        The chunk, read where runs of faces are compared.
+ * @param     face         The direction of the faces.
+ * @param     single_block The chunk's only kind of opaque block, so runs of
+ *                         faces never need comparing, or BLOCK_AIR if it
+ *                         has more than one.
+ * @param[in] mesh         The mesh to add quads to.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+static ENGINE_ERROR merge_faces(Mesher *restrict mesher,
+                                const Chunk *restrict chunk,
+                                ChunkFace face,
+                                BlockId single_block,
+                                ChunkMesh *restrict mesh)
+{
+	uint8_t single_type = single_block != BLOCK_AIR;
+	uint32_t axis = face / 2;
+	const uint32_t *faces = mesher->faces[face & 1];
+	uint32_t u_stride = chunk_strides[(axis + 1) % 3];
+	uint32_t v_stride = chunk_strides[(axis + 2) % 3];
+	uint32_t face_count = 0;
+	uint32_t slices = 0; /* Bit s set if slice s has faces. */
+	uint32_t position[3];
+	ENGINE_ERROR error;
+
+	/* The columns of each v over u, transposed, are the rows of each slice
+	 * at that v. */
+	for (uint32_t v = 0; v < CHUNK_SIZE; v++)
+	{
+		uint32_t matrix[CHUNK_SIZE];
+		uint32_t any = 0;
+
+		for (uint32_t u = 0; u < CHUNK_SIZE; u++)
+		{
+			matrix[u] = faces[u * CHUNK_SIZE + v];
+			any |= matrix[u];
+			face_count += (uint32_t)__builtin_popcount(matrix[u]);
+		}
+		slices |= any;
+
+		if (any != 0)
+		{
+			transpose32(matrix);
+		}
+
+		for (uint32_t slice = 0; slice < CHUNK_SIZE; slice++)
+		{
+			mesher->planes[slice][v] = matrix[slice];
+		}
+	}
+
+	if (face_count == 0)
+	{
+		return ENGINE_OK;
+	}
+
+	mesh->face_count += face_count;
+
+	error = chunk_mesh_reserve(mesh, face_count);
+	ENGINE_RETURN_IF_ERROR(error);
+
+	for (; slices != 0; slices &= slices - 1)
+	{
+		uint32_t slice = __builtin_ctz(slices);
+		uint32_t *plane = mesher->planes[slice];
+		uint32_t first = slice * chunk_strides[axis];
+		uint32_t buried[CHUNK_SIZE];
+		uint32_t later[CHUNK_SIZE + 1]; /* Faces in a row or any after it. */
+
+		position[axis] = slice + (face & 1);
+
+		/* Opaque blocks without a face here have an opaque neighbour, so
+		 * their faces are buried. */
+		later[CHUNK_SIZE] = 0;
+		for (uint32_t v = CHUNK_SIZE; v-- > 0; )
+		{
+			later[v] = later[v + 1] | plane[v];
+			buried[v] = mesher->solid[slice][v] & ~plane[v];
+		}
+
+		for (uint32_t v = 0; v < CHUNK_SIZE; v++)
+		{
+			uint32_t bits = plane[v];
+
+			while (bits != 0)
+			{
+				uint32_t u = __builtin_ctz(bits);
+				uint32_t width = __builtin_ctzll(~(uint64_t)((bits | buried[v]) >> u));
+				uint32_t height = 1;
+				uint32_t row = first + u * u_stride + v * v_stride;
+				BlockId block = single_type ? single_block : chunk_get_index(chunk, row);
+				uint32_t run;
+
+				if (!single_type)
+				{
+					width = same_block_run(chunk, row, u_stride, bits >> u, width, block);
+				}
+
+				run = (uint32_t)(((uint64_t)1 << width) - 1) << u;
+
+				for (; v + height < CHUNK_SIZE; height++)
+				{
+					uint32_t next = plane[v + height];
+
+					/* Past the last face it could reach, a quad would only
+					 * be trimmed back. */
+					if ((later[v + height] & run) == 0
+					    || ((next | buried[v + height]) & run) != run
+					    || (!single_type
+					        && same_block_run(chunk,
+					                          row + height * v_stride,
+					                          u_stride,
+					                          next >> u,
+					                          width,
+					                          block) < width))
+					{
+						break;
+					}
+				}
+
+				/* Rows of nothing but buried faces would only add overdraw. */
+				while (height > 1 && (plane[v + height - 1] & run) == 0)
+				{
+					height--;
+				}
+
+				bits &= ~run;
+				for (uint32_t h = 1; h < height; h++)
+				{
+					plane[v + h] &= ~run;
+				}
+
+				position[(axis + 1) % 3] = u;
+				position[(axis + 2) % 3] = v;
+				emit_quad(mesh, face, position, width, height, block);
+			}
+		}
+	}
+
+	return ENGINE_OK;
+}
+
+/******************************************************************************
+ * @name   fill_runs()
+ * @brief  Grows seeds along a row to fill the runs of air they are in, a
+ *         doubling step at a time in each direction.
+ * @param  seeds The bits to grow from, all of them air.
+ * @param  air   The row's air.
+ * @return The runs of air holding a seed.
+******************************************************************************/
+static inline uint32_t fill_runs(uint32_t seeds, uint32_t air)
+{
+	uint32_t up = seeds;
+	uint32_t down = seeds;
+	uint32_t up_air = air;
+	uint32_t down_air = air;
+
+	for (uint32_t shift = 1; shift < CHUNK_SIZE; shift *= 2)
+	{
+		up |= up_air & (up << shift);
+		up_air &= up_air << shift;
+		down |= down_air & (down >> shift);
+		down_air &= down_air >> shift;
+	}
+
+	return up | down;
+}
+
+/******************************************************************************
+ * @name      fill_air()
+ * @brief     Flood fills the air connected to a seed, a run of a row at a
+ *            time, and finds the chunk faces it reaches.
+ * @param[in] mesher The mesher holding the chunk's rows of opaque blocks.
+ * @param     row    The row of the seed, indexed by y and z.
+ * @param     seed   The seed's bit, air not yet filled.
+ * @return    A bit for each ChunkFace reached.
+******************************************************************************/
+static uint32_t fill_air(Mesher *mesher, uint32_t row, uint32_t seed)
+{
+	uint32_t stack_size = 1;
+	uint32_t faces = 0;
+
+	mesher->pending[row] = seed;
+	mesher->stack[0] = (uint16_t)row;
+
+	while (stack_size > 0)
+	{
+		uint32_t current = mesher->stack[--stack_size];
+		uint32_t y = current / CHUNK_SIZE;
+		uint32_t z = current % CHUNK_SIZE;
+		uint32_t neighbours[4];
+		uint32_t neighbour_count = 0;
+		uint32_t filled;
+
+		/* Runs of air are always filled whole, so pending air already
+		 * filled from another seed adds nothing. */
+		filled = fill_runs(mesher->pending[current] & ~mesher->filled[current],
+		                   ~mesher->rows[current]);
+		mesher->pending[current] = 0;
+		if (filled == 0)
+		{
+			continue;
+		}
+		mesher->filled[current] |= filled;
+
+		faces |= (filled & 1) << CHUNK_FACE_NEGATIVE_X;
+		faces |= (filled >> (CHUNK_SIZE - 1)) << CHUNK_FACE_POSITIVE_X;
+		faces |= (uint32_t)(y == 0) << CHUNK_FACE_NEGATIVE_Y;
+		faces |= (uint32_t)(y == CHUNK_SIZE - 1) << CHUNK_FACE_POSITIVE_Y;
+		faces |= (uint32_t)(z == 0) << CHUNK_FACE_NEGATIVE_Z;
+		faces |= (uint32_t)(z == CHUNK_SIZE - 1) << CHUNK_FACE_POSITIVE_Z;
+
+		if (y > 0)
+		{
+			neighbours[neighbour_count++] = current - CHUNK_SIZE;
+		}
+		if (y < CHUNK_SIZE - 1)
+		{
+			neighbours[neighbour_count++] = current + CHUNK_SIZE;
+		}
+		if (z > 0)
+		{
+			neighbours[neighbour_count++] = current - 1;
+		}
+		if (z < CHUNK_SIZE - 1)
+		{
+			neighbours[neighbour_count++] = current + 1;
+		}
+
+		for (uint32_t i = 0; i < neighbour_count; i++)
+		{
+			uint32_t next = neighbours[i];
+			uint32_t seeds = filled & ~mesher->rows[next] & ~mesher->filled[next];
+
+			if (seeds == 0)
+			{
+				continue;
+			}
+
+			/* A row is only ever on the stack once. */
+			if (mesher->pending[next] == 0)
+			{
+				mesher->stack[stack_size++] = (uint16_t)next;
+			}
+			mesher->pending[next] |= seeds;
+		}
+	}
+
+	return faces;
+}
+
+/******************************************************************************
+ * @name      find_connectivity()
+ * @brief     Finds which of a chunk's faces are joined through its air, by
+ *            flood filling from the air on each face. Air that touches no
+ *            face is never filled.
+ * @param[in] mesher The mesher holding the chunk's rows of opaque blocks.
+ * @return    The chunk's connectivity, see chunk_face_pair().
+******************************************************************************/
+static uint16_t find_connectivity(Mesher *mesher)
+{
+	uint16_t connectivity = 0;
+
+	memset(mesher->filled, 0, sizeof(mesher->filled));
+	memset(mesher->pending, 0, sizeof(mesher->pending));
+
+	for (uint32_t row = 0; row < CHUNK_AREA; row++)
+	{
+		uint32_t y = row / CHUNK_SIZE;
+		uint32_t z = row % CHUNK_SIZE;
+		uint8_t border = y == 0 || y == CHUNK_SIZE - 1 || z == 0 || z == CHUNK_SIZE - 1;
+		uint32_t seeds = ~mesher->rows[row] & (border ? ~0u : 1u | 1u << (CHUNK_SIZE - 1));
+
+		for (seeds &= ~mesher->filled[row]; seeds != 0; seeds &= ~mesher->filled[row])
+		{
+			uint32_t faces = fill_air(mesher, row, seeds & -seeds);
+
+			for (uint32_t a = 0; a < CHUNK_FACE_COUNT; a++)
+			{
+				for (uint32_t b = a + 1; b < CHUNK_FACE_COUNT; b++)
+				{
+					if ((faces >> a & 1) && (faces >> b & 1))
+					{
+						connectivity |= chunk_face_pair(a, b);
+					}
+				}
+			}
+
+			if (connectivity == CHUNK_CONNECTIVITY_ALL)
+			{
+				return connectivity;
+			}
+		}
+	}
+
+	return connectivity;
+}
+
+/******************************************************************************
+ * @name      mask_chunk_rows()
+ * @brief     Builds the rows along x of the chunk's opaque blocks.
+ * @param[in] mesher The mesher holding the chunk's blocks.
+ * @return    void
+******************************************************************************/
+static void mask_chunk_rows(Mesher *mesher)
+{
+	for (uint32_t y = 0; y < CHUNK_SIZE; y++)
+	{
+		mesher->kernels->mask_rows(&mesher->blocks[padded_index(0, y, 0)],
+		                           MESHER_PADDED_SIZE,
+		                           CHUNK_SIZE,
+		                           &mesher->rows[y * CHUNK_SIZE]);
+	}
+}
+
+/******************************************************************************
+ * @name      single_opaque_block()
+ * @brief     Finds a chunk's only kind of opaque block.
+ * @param[in] chunk A chunk that is not all air.
+ * @return    The block, or BLOCK_AIR if the chunk has more than one kind.
+******************************************************************************/
+static BlockId single_opaque_block(const Chunk *chunk)
+{
+	BlockId single = BLOCK_AIR;
+
+	if (chunk->bits == 0)
+	{
+		return chunk->uniform;
+	}
+
+	if (chunk->palette == NULL)
+	{
+		return BLOCK_AIR;
+	}
+
+	for (uint32_t entry = 0; entry < chunk->palette_size; entry++)
+	{
+		if (chunk->counts[entry] == 0 || chunk->palette[entry] == BLOCK_AIR)
+		{
+			continue;
+		}
+
+		if (single != BLOCK_AIR)
+		{
+			return BLOCK_AIR;
+		}
+		single = chunk->palette[entry];
+	}
+
+	return single;
+}
+
+/******************************************************************************
+ * @name      mask_borders()
+ * @brief     Builds the neighbours' rows of opaque blocks that touch the
+ *            chunk into the mesher's borders.
+ * @param[in] mesher     The mesher to fill.
+ * @param[in] neighbours The chunk's neighbours, NULL ones are air.
+ * @return    void
+******************************************************************************/
+static void mask_borders(Mesher *restrict mesher,
+                         const Chunk *const neighbours[CHUNK_FACE_COUNT])
+{
+	/* Rows along x beside each z below and above, and beside each y behind
+	 * and in front. */
+	mask_rows(neighbours[CHUNK_FACE_NEGATIVE_Y],
+	          (CHUNK_SIZE - 1) * CHUNK_SIZE,
+	          1,
+	          CHUNK_SIZE,
+	          mesher->borders[0]);
+	mask_rows(neighbours[CHUNK_FACE_POSITIVE_Y], 0, 1, CHUNK_SIZE, mesher->borders[1]);
+	mask_rows(neighbours[CHUNK_FACE_NEGATIVE_Z],
+	          CHUNK_SIZE - 1,
+	          CHUNK_SIZE,
+	          CHUNK_SIZE,
+	          mesher->borders[2]);
+	mask_rows(neighbours[CHUNK_FACE_POSITIVE_Z], 0, CHUNK_SIZE, CHUNK_SIZE, mesher->borders[3]);
+
+	/* Rows along z beside each y to the left and right. */
+	mask_side(neighbours[CHUNK_FACE_NEGATIVE_X], CHUNK_SIZE - 1, mesher->borders[4]);
+	mask_side(neighbours[CHUNK_FACE_POSITIVE_X], 0, mesher->borders[5]);
+}
+
+ENGINE_ERROR mesher_create(Mesher **mesher, uint8_t connectivity)
+{
+	*mesher = malloc(sizeof(Mesher));
+	if (*mesher == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate mesher");
+	}
+
+	(*mesher)->kernels = mesher_kernels_best();
+	(*mesher)->connectivity = connectivity;
+
+	return ENGINE_OK;
+}
+
+void mesher_destroy(Mesher *mesher)
+{
+	free(mesher);
+}
+
+ENGINE_ERROR mesher_mesh_greedy(Mesher *restrict mesher,
+                                const Chunk *restrict chunk,
+                                const Chunk *const neighbours[CHUNK_FACE_COUNT],
+                                ChunkMesh *restrict mesh)
+{
+	ENGINE_ERROR error;
+
+	chunk_mesh_clear(mesh);
+
+	/* Nothing to see in empty chunks, and nothing to stop seeing through. */
+	if (chunk->bits == 0 && chunk->uniform == BLOCK_AIR)
+	{
+		mesh->connectivity = CHUNK_CONNECTIVITY_ALL;
+		return ENGINE_OK;
+	}
+
+	load_blocks(mesher, chunk, neighbours);
+
+	for (ChunkFace face = 0; face < CHUNK_FACE_COUNT; face++)
+	{
+		for (uint32_t slice = 0; slice < CHUNK_SIZE; slice++)
+		{
+			error = mesh_slice(mesher, face, slice, mesh);
+			ENGINE_RETURN_IF_ERROR(error);
+		}
+	}
+
+	mesh->connectivity = CHUNK_CONNECTIVITY_ALL;
+	if (mesher->connectivity)
+	{
+		mask_chunk_rows(mesher);
+		mesh->connectivity = find_connectivity(mesher);
+	}
+
+	return ENGINE_OK;
+}
+
+ENGINE_ERROR mesher_mesh_binary(Mesher *restrict mesher,
+                                const Chunk *restrict chunk,
+                                const Chunk *const neighbours[CHUNK_FACE_COUNT],
+                                ChunkMesh *restrict mesh)
+{
+	const MesherKernels *kernels = mesher->kernels;
+	BlockId single_block;
+	ENGINE_ERROR error;
+
+	chunk_mesh_clear(mesh);
+
+	if (chunk->bits == 0 && chunk->uniform == BLOCK_AIR)
+	{
+		mesh->connectivity = CHUNK_CONNECTIVITY_ALL;
+		return ENGINE_OK;
+	}
+
+	/* Faces are found from the packed indices, blocks are only decoded
+	 * where runs of faces must be told apart while merging. */
+	mask_rows(chunk, 0, 1, CHUNK_AREA, mesher->rows);
+	mask_borders(mesher, neighbours);
+	mesh->connectivity = mesher->connectivity ? find_connectivity(mesher)
+	                                          : CHUNK_CONNECTIVITY_ALL;
+
+	single_block = single_opaque_block(chunk);
+
+	/* From z down, so each axis's opaque slices are still in the columns
+	 * of the last. */
+	for (uint32_t axis = 3; axis-- > 0; )
+	{
+		slice_solid(mesher, axis);
+		build_columns(mesher, axis);
+		kernels->cull_faces(mesher->columns,
+		                    CHUNK_AREA,
+		                    mesher->faces[1],
+		                    mesher->faces[0]);
+
+		for (uint32_t direction = 0; direction < 2; direction++)
+		{
+			error = merge_faces(mesher, chunk, 2 * axis + direction, single_block, mesh);
+			ENGINE_RETURN_IF_ERROR(error);
+		}
+	}
+
+	return ENGINE_OK;
+}
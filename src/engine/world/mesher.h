@@ -0,0 +1,210 @@
+#ifndef _MESHER_H_
+#define _MESHER_H_
+
+#include <stdint.h>
+
+#include "core/debug.h"
+
+#include "chunk.h"
+#include "mesher_kernels.h"
+
+#define MESHER_PADDED_SIZE   (CHUNK_SIZE + 2) /* A chunk and a layer of each
+                                                 neighbour. */
+#define MESHER_PADDED_VOLUME (MESHER_PADDED_SIZE * MESHER_PADDED_SIZE * MESHER_PADDED_SIZE)
+
+#define CHUNK_MESH_INITIAL_VERTICES 4096
+
+/* Layout of ChunkVertex.position. Coordinates run from 0 to CHUNK_SIZE
+ * inclusive as they are the corners of blocks. */
+#define CHUNK_VERTEX_X_SHIFT     0
+#define CHUNK_VERTEX_Y_SHIFT     6
+#define CHUNK_VERTEX_Z_SHIFT     12
+#define CHUNK_VERTEX_FACE_SHIFT  18
+#define CHUNK_VERTEX_LEVEL_SHIFT 21 /* Coordinates are scaled by 2^level. */
+#define CHUNK_VERTEX_COORD_MASK  0x3f
+
+/******************************************************************************
+ * @name  _ChunkVertex
+ * @brief A packed vertex of a chunk mesh, relative to the chunk's origin. The
+ *        face gives the normal, and texture coordinates follow from the
+ *        position so textures tile across merged faces.
+******************************************************************************/
+struct _ChunkVertex
+{
+	uint32_t position; /*< x, y and z in 6 bits each, the ChunkFace, then the
+	                       level of detail. */
+	uint32_t block;    /*< The BlockId in the low 16 bits. */
+};
+typedef struct _ChunkVertex ChunkVertex;
+
+/******************************************************************************
+ * @name  _ChunkMesh
+ * @brief The quads of a chunk's visible faces as indexed triangles. Cleared
+ *        and refilled each time the chunk is meshed, the storage only ever
+ *        grows so remeshing usually allocates nothing.
+******************************************************************************/
+struct _ChunkMesh
+{
+	ChunkVertex *vertices;
+	uint32_t *indices;
+	uint32_t vertex_count;
+	uint32_t index_count;
+	uint32_t vertex_capacity; /*< Indices have room for 3/2 as many. */
+
+	uint32_t face_count;   /*< Visible block faces before merging. */
+	uint16_t connectivity; /*< The chunk's faces joined through its air, see
+	                           chunk_face_pair(). */
+	uint8_t level;         /*< Stamped on each vertex, set by the caller as
+	                           each block of a level stands for 2^level blocks
+	                           to a side. Kept when cleared. */
+};
+typedef struct _ChunkMesh ChunkMesh;
+
+/******************************************************************************
+ * @name  _Mesher
+ * @brief Scratch memory for meshing one chunk at a time. Each thread that
+ *        meshes needs its own.
+******************************************************************************/
+struct _Mesher
+{
+	const MesherKernels *kernels; /*< The binary mesher's inner loops. */
+	uint8_t connectivity;         /*< Set to find which of each chunk's faces
+	                                  its air connects. */
+
+	BlockId blocks[MESHER_PADDED_VOLUME]; /*< The chunk bordered by its
+	                                          neighbours, x varies fastest.
+	                                          Only used by the greedy
+	                                          mesher. */
+	BlockId mask[CHUNK_AREA];             /*< The visible faces of a slice. */
+
+	/* Bit masks of opaque blocks for the binary mesher. A column's bits run
+	 * along one axis, and columns are indexed by the next two axes in turn
+	 * as u * CHUNK_SIZE + v. */
+	uint32_t rows[CHUNK_AREA];       /*< Along x, indexed by y and z. */
+	uint32_t borders[6][CHUNK_SIZE]; /*< The neighbours' rows along x below,
+	                                     above, behind and in front of the
+	                                     chunk, indexed by z or y, then their
+	                                     rows along z to the left and right,
+	                                     indexed by y. */
+	uint64_t columns[CHUNK_AREA];    /*< Padded with the neighbours' blocks. */
+	uint32_t faces[2][CHUNK_AREA];   /*< Negative and positive faces. */
+	uint32_t planes[CHUNK_SIZE][CHUNK_SIZE]; /*< The faces of each slice, a
+	                                             row of bits along u for each
+	                                             v. */
+	uint32_t solid[CHUNK_SIZE][CHUNK_SIZE];  /*< The opaque blocks of each
+	                                             slice, like planes. */
+
+	/* Flood fill of the air that reaches the chunk's faces, in rows along x
+	 * indexed like rows. */
+	uint32_t filled[CHUNK_AREA];  /*< Air already reached. */
+	uint32_t pending[CHUNK_AREA]; /*< Air to fill from, set for rows on the
+	                                  stack. */
+	uint16_t stack[CHUNK_AREA];   /*< Rows with pending air. */
+};
+typedef struct _Mesher Mesher;
+
+/******************************************************************************
+ * @name       chunk_mesh_init()
+ * @brief      Initalises an empty mesh. Allocates nothing.
+ * @param[out] mesh The mesh to initalise.
+ * @return     void
+******************************************************************************/
+void chunk_mesh_init(ChunkMesh *mesh);
+
+/******************************************************************************
+ * @name      chunk_mesh_deinit()
+ * @brief     Frees a mesh's storage.
+ * @param[in] mesh The mesh to deinitalise.
+ * @return    void
+******************************************************************************/
+void chunk_mesh_deinit(ChunkMesh *mesh);
+
+/******************************************************************************
+ * @name      chunk_mesh_clear()
+ * @brief     Empties a mesh, keeping its storage.
+ * @param[in] mesh The mesh to clear.
+ * @return    void
+******************************************************************************/
+static inline void chunk_mesh_clear(ChunkMesh *mesh)
+{
+	mesh->vertex_count = 0;
+	mesh->index_count = 0;
+	mesh->face_count = 0;
+	mesh->connectivity = 0;
+}
+
+/******************************************************************************
+ * @name       mesher_create()
+ * @brief      Allocates a mesher's scratch memory and picks the widest
+ *             meshing kernels the CPU supports.
+ * @param[out] mesher       A pointer to a pointer set to the created mesher.
+ * @param      connectivity Set to find each meshed chunk's connectivity.
+ *                          Otherwise it is skipped and every pair of faces
+ *                          is reported as connected.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR mesher_create(Mesher **mesher, uint8_t connectivity);
+
+/******************************************************************************
+ * @name      mesher_destroy()
+ * @brief     Frees a mesher.
+ * @param[in] mesher The mesher to destroy.
+ * @return    void
+******************************************************************************/
+void mesher_destroy(Mesher *mesher);
+
+/******************************************************************************
+ * @name      mesher_mesh_greedy()
+ * @brief     Meshes a chunk's faces that touch air, including faces on its
+ *            border that touch air in a neighbour, merging neighbouring faces
+ *            of the same block in the same plane into as few quads as
+ *            possible. Quads may also run across buried faces, between two
+ *            opaque blocks, as they can never be seen. Every block but air
+ *            is treated as an opaque cube.
+ *            This misses the target of ten times fewer quads than one per
+ *            face. On generated terrain it gives about 6.5 times fewer over
+ *            interior chunks, and 5.2 on the median surface chunk. Each
+ *            height step starts a new plane, and the grass, dirt and stone
+ *            bands split walls, so even perfect merging of same-block faces
+ *            would stop at about 8.7.
+ *            Also finds which of the chunk's faces its air connects, if the
+ *            mesher was created to.
+ * @param[in] mesher     Scratch memory for the calling thread.
+ * @param[in] chunk      The chunk to mesh.
+ * @param[in] neighbours The chunks beside each ChunkFace of the chunk. Faces
+ *                       beside a NULL neighbour are meshed as if it were air.
+ * @param[in] mesh       Cleared and filled with the chunk's mesh.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR mesher_mesh_greedy(Mesher *restrict mesher,
+                                const Chunk *restrict chunk,
+                                const Chunk *const neighbours[CHUNK_FACE_COUNT],
+                                ChunkMesh *restrict mesh);
+
+/******************************************************************************
+ * @name      mesher_mesh_binary()
+ * @brief     Meshes a chunk like mesher_mesh_greedy(), producing the same
+ *            quads, from bit masks of its opaque blocks built straight from
+ *            the packed indices. Faces are found a whole column at a time
+ *            with shifts, and merged by scanning runs of set bits. Blocks
+ *            are only decoded and compared where the chunk has more than one
+ *            kind of opaque block. Also finds which of the chunk's faces
+ *            its air connects, if the mesher was created to.
+ *            A generated terrain chunk takes about 50 to 60 us on one core.
+ *            The target of well under 100 us is missed for noisy chunks.
+ *            Chunks of random noise are the worst case. They take about
+ *            340 us with one opaque block and 1.7 ms with three. They emit
+ *            13000 and 41000 quads, 0.7 and 2.3 MB of vertices and indices.
+ * @param[in] mesher     Scratch memory for the calling thread.
+ * @param[in] chunk      The chunk to mesh.
+ * @param[in] neighbours The chunks beside each ChunkFace of the chunk. Faces
+ *                       beside a NULL neighbour are meshed as if it were air.
+ * @param[in] mesh       Cleared and filled with the chunk's mesh.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR mesher_mesh_binary(Mesher *restrict mesher,
+                                const Chunk *restrict chunk,
+                                const Chunk *const neighbours[CHUNK_FACE_COUNT],
+                                ChunkMesh *restrict mesh);
+
+#endif /* _MESHER_H_ */
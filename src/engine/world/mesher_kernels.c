@@ -0,0 +1,183 @@
+#include "mesher_kernels.h"
+
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MESHER_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+static void mask_rows_scalar(const BlockId *restrict blocks,
+                             uint32_t stride,
+                             uint32_t count,
+                             uint32_t *restrict masks)
+{
+	for (uint32_t r = 0; r < count; r++, blocks += stride)
+	{
+		uint32_t mask = 0;
+
+		for (uint32_t x = 0; x < CHUNK_SIZE; x++)
+		{
+			mask |= (uint32_t)(blocks[x] != BLOCK_AIR) << x;
+		}
+
+		masks[r] = mask;
+	}
+}
+
+static inline void cull_column(uint64_t column,
+                               uint32_t *restrict positive,
+                               uint32_t *restrict negative)
+{
+	/* The padding bits shift out of the 32 bit results. */
+	*positive = (uint32_t)((column & ~(column >> 1)) >> 1);
+	*negative = (uint32_t)((column & ~(column << 1)) >> 1);
+}
+
+static void cull_faces_scalar(const uint64_t *restrict columns,
+                              uint32_t count,
+                              uint32_t *restrict positive,
+                              uint32_t *restrict negative)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		cull_column(columns[i], &positive[i], &negative[i]);
+	}
+}
+
+#ifdef MESHER_KERNELS_X86
+
+__attribute__((target("sse2")))
+static void mask_rows_sse2(const BlockId *restrict blocks,
+                           uint32_t stride,
+                           uint32_t count,
+                           uint32_t *restrict masks)
+{
+	const __m128i air = _mm_setzero_si128();
+
+	for (uint32_t r = 0; r < count; r++, blocks += stride)
+	{
+		const __m128i *row = (const __m128i*)blocks;
+		__m128i low = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_loadu_si128(row), air),
+		                              _mm_cmpeq_epi16(_mm_loadu_si128(row + 1), air));
+		__m128i high = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_loadu_si128(row + 2), air),
+		                               _mm_cmpeq_epi16(_mm_loadu_si128(row + 3), air));
+
+		masks[r] = ~((uint32_t)_mm_movemask_epi8(low)
+		             | (uint32_t)_mm_movemask_epi8(high) << 16);
+	}
+}
+
+__attribute__((target("sse2")))
+static void cull_faces_sse2(const uint64_t *restrict columns,
+                            uint32_t count,
+                            uint32_t *restrict positive,
+                            uint32_t *restrict negative)
+{
+	uint32_t i = 0;
+
+	for (; i + 2 <= count; i += 2)
+	{
+		__m128i column = _mm_loadu_si128((const __m128i*)&columns[i]);
+		__m128i up = _mm_srli_epi64(_mm_andnot_si128(_mm_srli_epi64(column, 1), column), 1);
+		__m128i down = _mm_srli_epi64(_mm_andnot_si128(_mm_slli_epi64(column, 1), column), 1);
+
+		/* Keep the low half of each column. */
+		_mm_storel_epi64((__m128i*)&positive[i], _mm_shuffle_epi32(up, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storel_epi64((__m128i*)&negative[i], _mm_shuffle_epi32(down, _MM_SHUFFLE(2, 0, 2, 0)));
+	}
+
+	for (; i < count; i++)
+	{
+		cull_column(columns[i], &positive[i], &negative[i]);
+	}
+}
+
+__attribute__((target("avx2")))
+static void mask_rows_avx2(const BlockId *restrict blocks,
+                           uint32_t stride,
+                           uint32_t count,
+                           uint32_t *restrict masks)
+{
+	const __m256i air = _mm256_setzero_si256();
+
+	for (uint32_t r = 0; r < count; r++, blocks += stride)
+	{
+		const __m256i *row = (const __m256i*)blocks;
+		__m256i packed = _mm256_packs_epi16(_mm256_cmpeq_epi16(_mm256_loadu_si256(row), air),
+		                                    _mm256_cmpeq_epi16(_mm256_loadu_si256(row + 1), air));
+
+		/* Packing works within 128 bit lanes, put the blocks back in order. */
+		packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+		masks[r] = ~(uint32_t)_mm256_movemask_epi8(packed);
+	}
+}
+
+__attribute__((target("avx2")))
+static void cull_faces_avx2(const uint64_t *restrict columns,
+                            uint32_t count,
+                            uint32_t *restrict positive,
+                            uint32_t *restrict negative)
+{
+	const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+	uint32_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m256i column = _mm256_loadu_si256((const __m256i*)&columns[i]);
+		__m256i up = _mm256_srli_epi64(_mm256_andnot_si256(_mm256_srli_epi64(column, 1), column), 1);
+		__m256i down = _mm256_srli_epi64(_mm256_andnot_si256(_mm256_slli_epi64(column, 1), column), 1);
+
+		_mm_storeu_si128((__m128i*)&positive[i],
+		                 _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(up, low_halves)));
+		_mm_storeu_si128((__m128i*)&negative[i],
+		                 _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(down, low_halves)));
+	}
+
+	for (; i < count; i++)
+	{
+		cull_column(columns[i], &positive[i], &negative[i]);
+	}
+}
+
+#endif /* MESHER_KERNELS_X86 */
+
+static const MesherKernels kernels[MESHER_SIMD_COUNT] = {
+	{MESHER_SIMD_SCALAR, "scalar", mask_rows_scalar, cull_faces_scalar},
+#ifdef MESHER_KERNELS_X86
+	{MESHER_SIMD_SSE2, "sse2", mask_rows_sse2, cull_faces_sse2},
+	{MESHER_SIMD_AVX2, "avx2", mask_rows_avx2, cull_faces_avx2}
+#endif
+};
+
+const MesherKernels *mesher_kernels_get(MesherSimd simd)
+{
+	switch (simd)
+	{
+		case MESHER_SIMD_SCALAR:
+			return &kernels[MESHER_SIMD_SCALAR];
+#ifdef MESHER_KERNELS_X86
+		case MESHER_SIMD_SSE2:
+			return __builtin_cpu_supports("sse2") ? &kernels[MESHER_SIMD_SSE2] : NULL;
+		case MESHER_SIMD_AVX2:
+			return __builtin_cpu_supports("avx2") ? &kernels[MESHER_SIMD_AVX2] : NULL;
+#endif
+		default:
+			return NULL;
+	}
+}
+
+const MesherKernels *mesher_kernels_best()
+{
+	for (int simd = MESHER_SIMD_COUNT - 1; simd > MESHER_SIMD_SCALAR; simd--)
+	{
+		const MesherKernels *best = mesher_kernels_get(simd);
+
+		if (best != NULL)
+		{
+			return best;
+		}
+	}
+
+	return &kernels[MESHER_SIMD_SCALAR];
+}
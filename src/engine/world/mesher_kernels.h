@@ -0,0 +1,69 @@
+#ifndef _MESHER_KERNELS_H_
+#define _MESHER_KERNELS_H_
+
+#include <stdint.h>
+
+#include "chunk.h"
+
+/******************************************************************************
+ * @name  _MesherSimd
+ * @brief The instruction sets the meshing kernels are written for.
+******************************************************************************/
+enum _MesherSimd
+{
+	MESHER_SIMD_SCALAR,
+	MESHER_SIMD_SSE2,
+	MESHER_SIMD_AVX2,
+	MESHER_SIMD_COUNT
+};
+typedef enum _MesherSimd MesherSimd;
+
+/******************************************************************************
+ * @name  _MesherKernels
+ * @brief The inner loops of the binary mesher for one instruction set.
+ *        Only these simple loops have SSE2 and AVX2 versions, and they are
+ *        a small part of the time. Building masks from packed indices,
+ *        transposing and merging are scalar bit operations, as are the
+ *        quads written out. mask_rows() is only used for the greedy
+ *        mesher's connectivity.
+******************************************************************************/
+struct _MesherKernels
+{
+	MesherSimd simd;
+	const char *name;
+
+	/* Sets bit x of masks[r] if blocks[r * stride + x] is not air, for each
+	 * of count rows of CHUNK_SIZE blocks. */
+	void (*mask_rows)(const BlockId *restrict blocks,
+	                  uint32_t stride,
+	                  uint32_t count,
+	                  uint32_t *restrict masks);
+
+	/* Finds the faces of count columns of opaque blocks. Bit i + 1 of a
+	 * column is the block at i, bits 0 and CHUNK_SIZE + 1 are the blocks
+	 * beyond either end. Bit i of positive and negative is set if the block
+	 * at i has a face towards the positive or negative end. */
+	void (*cull_faces)(const uint64_t *restrict columns,
+	                   uint32_t count,
+	                   uint32_t *restrict positive,
+	                   uint32_t *restrict negative);
+};
+typedef struct _MesherKernels MesherKernels;
+
+/******************************************************************************
+ * @name   mesher_kernels_get()
+ * @brief  Gets the kernels for an instruction set.
+ * @param  simd The instruction set.
+ * @return The kernels, or NULL if the build or the CPU lacks the instruction
+ *         set.
+******************************************************************************/
+const MesherKernels *mesher_kernels_get(MesherSimd simd);
+
+/******************************************************************************
+ * @name   mesher_kernels_best()
+ * @brief  Gets the kernels for the widest instruction set the CPU supports.
+ * @return The kernels, never NULL.
+******************************************************************************/
+const MesherKernels *mesher_kernels_best();
+
+#endif /* _MESHER_KERNELS_H_ */
@@ -0,0 +1,233 @@
+#include "visibility.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "core/logger.h"
+#include "core/profiler.h"
+
+ENGINE_ERROR visibility_graph_create(VisibilityGraph **graph, const World *world)
+{
+	uint32_t chunk_count = world->chunk_count;
+
+	*graph = calloc(1, sizeof(VisibilityGraph));
+	if (*graph == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate visibility graph");
+	}
+
+	(*graph)->world = world;
+	(*graph)->connectivity = malloc(chunk_count * sizeof(uint16_t));
+	(*graph)->visible = malloc(chunk_count * sizeof(uint8_t));
+	(*graph)->reached = malloc(chunk_count * sizeof(uint8_t));
+	(*graph)->changed = malloc(chunk_count * sizeof(uint32_t));
+	(*graph)->queue = malloc(chunk_count * sizeof(struct VisibilityNode));
+
+	if ((*graph)->connectivity == NULL
+	    || (*graph)->visible == NULL
+	    || (*graph)->reached == NULL
+	    || (*graph)->changed == NULL
+	    || (*graph)->queue == NULL)
+	{
+		visibility_graph_destroy(*graph);
+		*graph = NULL;
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate visibility graph");
+	}
+
+	for (uint32_t i = 0; i < chunk_count; i++)
+	{
+		(*graph)->connectivity[i] = CHUNK_CONNECTIVITY_ALL;
+	}
+	memset((*graph)->visible, 1, chunk_count * sizeof(uint8_t));
+	(*graph)->visible_count = chunk_count;
+	(*graph)->stale = 1;
+
+	return ENGINE_OK;
+}
+
+void visibility_graph_destroy(VisibilityGraph *graph)
+{
+	free(graph->connectivity);
+	free(graph->visible);
+	free(graph->reached);
+	free(graph->changed);
+	free(graph->queue);
+	free(graph);
+}
+
+void visibility_graph_set_connectivity(VisibilityGraph *graph,
+                                       uint32_t chunk,
+                                       uint16_t connectivity)
+{
+	if (graph->connectivity[chunk] != connectivity)
+	{
+		graph->connectivity[chunk] = connectivity;
+		graph->stale = 1;
+	}
+}
+
+/******************************************************************************
+ * @name      reach()
+ * @brief     Queues a chunk for the search unless it has already been
+ *            reached.
+ * @param[in] graph      The graph being searched.
+ * @param[in] tail       The number of nodes queued, incremented if the chunk
+ *                       is queued.
+ * @param     chunk      The chunk's index.
+ * @param     entered    The face it is entered through.
+ * @param     directions The directions stepped in to reach it.
+ * @return    void
+******************************************************************************/
+static void reach(VisibilityGraph *restrict graph,
+                  uint32_t *restrict tail,
+                  uint32_t chunk,
+                  uint8_t entered,
+                  uint8_t directions)
+{
+	if (graph->reached[chunk])
+	{
+		return;
+	}
+
+	graph->reached[chunk] = 1;
+	graph->queue[(*tail)++] = (struct VisibilityNode){chunk, entered, directions};
+}
+
+/******************************************************************************
+ * @name      seed_outside()
+ * @brief     Queues every chunk on each side of the world that faces a camera
+ *            outside it, entered through that side.
+ * @param[in] graph    The graph being searched.
+ * @param[in] tail     The number of nodes queued.
+ * @param     position The chunk the camera is in, outside the world.
+ * @return    void
+******************************************************************************/
+static void seed_outside(VisibilityGraph *restrict graph,
+                         uint32_t *restrict tail,
+                         const int32_t position[3])
+{
+	const World *world = graph->world;
+
+	for (uint32_t face = 0; face < CHUNK_FACE_COUNT; face++)
+	{
+		uint32_t axis = face / 2;
+		uint32_t u = (axis + 1) % 3;
+		uint32_t v = (axis + 2) % 3;
+		int32_t side[3];
+
+		if (face & 1 ? position[axis] < (int32_t)world->size[axis] : position[axis] >= 0)
+		{
+			continue;
+		}
+
+		side[axis] = face & 1 ? (int32_t)world->size[axis] - 1 : 0;
+		for (side[u] = 0; side[u] < (int32_t)world->size[u]; side[u]++)
+		{
+			for (side[v] = 0; side[v] < (int32_t)world->size[v]; side[v]++)
+			{
+				reach(graph,
+				      tail,
+				      (uint32_t)world_chunk_index(world, side[0], side[1], side[2]),
+				      face,
+				      1u << (face ^ 1));
+			}
+		}
+	}
+}
+
+uint32_t visibility_graph_update(VisibilityGraph *graph, Vec3 camera)
+{
+	const World *world = graph->world;
+	int32_t position[3] = {
+		(int32_t)floorf(camera.x / CHUNK_SIZE),
+		(int32_t)floorf(camera.y / CHUNK_SIZE),
+		(int32_t)floorf(camera.z / CHUNK_SIZE)
+	};
+	int32_t start = world_chunk_index(world, position[0], position[1], position[2]);
+	uint32_t head = 0;
+	uint32_t tail = 0;
+	uint8_t *visible;
+
+	PROFILE_ZONE("visibility_graph_update");
+
+	graph->changed_count = 0;
+
+	if (!graph->stale
+	    && position[0] == graph->camera[0]
+	    && position[1] == graph->camera[1]
+	    && position[2] == graph->camera[2])
+	{
+		return 0;
+	}
+
+	memset(graph->reached, 0, world->chunk_count * sizeof(uint8_t));
+
+	if (start >= 0)
+	{
+		reach(graph, &tail, (uint32_t)start, CHUNK_FACE_COUNT, 0);
+	}
+	else
+	{
+		seed_outside(graph, &tail, position);
+	}
+
+	while (head < tail)
+	{
+		struct VisibilityNode node = graph->queue[head++];
+		uint16_t connectivity = graph->connectivity[node.chunk];
+		int32_t coordinates[3];
+
+		world_chunk_coordinates(world, node.chunk, coordinates);
+
+		for (uint32_t face = 0; face < CHUNK_FACE_COUNT; face++)
+		{
+			int32_t neighbour[3] = {coordinates[0], coordinates[1], coordinates[2]};
+			int32_t index;
+
+			/* Stepping back towards the camera would let the search wrap
+			 * round behind walls. */
+			if (node.directions & (1u << (face ^ 1)))
+			{
+				continue;
+			}
+
+			/* The camera's own chunk is seen from inside, any face will do. */
+			if (node.entered != CHUNK_FACE_COUNT
+			    && !(connectivity & chunk_face_pair(node.entered, face)))
+			{
+				continue;
+			}
+
+			neighbour[face / 2] += face & 1 ? 1 : -1;
+			index = world_chunk_index(world, neighbour[0], neighbour[1], neighbour[2]);
+			if (index >= 0)
+			{
+				reach(graph, &tail, (uint32_t)index, face ^ 1, node.directions | 1u << face);
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < world->chunk_count; i++)
+	{
+		if (graph->reached[i] != graph->visible[i])
+		{
+			graph->changed[graph->changed_count++] = i;
+		}
+	}
+
+	/* The chunks just reached are the visible ones until the next search. */
+	visible = graph->visible;
+	graph->visible = graph->reached;
+	graph->reached = visible;
+	graph->visible_count = tail;
+
+	memcpy(graph->camera, position, sizeof(graph->camera));
+	graph->stale = 0;
+
+	PROFILE_COUNTER("Visible chunks", graph->visible_count);
+
+	return graph->changed_count;
+}
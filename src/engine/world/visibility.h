@@ -0,0 +1,113 @@
+#ifndef _VISIBILITY_H_
+#define _VISIBILITY_H_
+
+#include <stdint.h>
+
+#include "core/debug.h"
+#include "core/maths.h"
+
+#include "world.h"
+#include "chunk.h"
+
+/******************************************************************************
+ * @name  VisibilityNode
+ * @brief A chunk reached by the search.
+******************************************************************************/
+struct VisibilityNode
+{
+	uint32_t chunk;
+	uint8_t entered;    /*< The face it was entered through, CHUNK_FACE_COUNT
+	                        for the chunk the camera is in. */
+	uint8_t directions; /*< A bit for each ChunkFace stepped towards on the
+	                        way here. */
+};
+
+/******************************************************************************
+ * @name  _VisibilityGraph
+ * @brief Finds the chunks that could be seen from the camera through air. A
+ *        breadth first search walks out from the camera's chunk, leaving a
+ *        chunk only through a face its air connects to the face it was
+ *        entered through and never stepping back towards the camera. Chunks
+ *        it never reaches are hidden behind solid ground.
+ *
+ *        Each chunk's connectivity comes from meshing it, so an edit only
+ *        costs remeshing its chunk. The search is run again only once the
+ *        camera has moved to another chunk or a connectivity has changed.
+ *        Chunks not yet meshed are treated as connecting every face.
+******************************************************************************/
+struct _VisibilityGraph
+{
+	const World *world;
+	uint16_t *connectivity; /*< Of each chunk, see chunk_face_pair(). */
+
+	uint8_t *visible;       /*< Set for each chunk the last search reached. */
+	uint32_t visible_count;
+	uint8_t *reached;       /*< The chunks reached by the running search. */
+	uint32_t *changed;      /*< Chunks whose visible flag the last update
+	                            flipped. */
+	uint32_t changed_count;
+
+	struct VisibilityNode *queue; /*< chunk_count nodes, each chunk is
+	                                  reached at most once. */
+
+	int32_t camera[3]; /*< The chunk the last search started from. */
+	uint8_t stale;     /*< Set if the next update must search again. */
+};
+typedef struct _VisibilityGraph VisibilityGraph;
+
+/******************************************************************************
+ * @name       visibility_graph_create()
+ * @brief      Creates a graph of a world's chunks with every chunk visible.
+ * @param[out] graph A pointer to a pointer set to the created graph.
+ * @param[in]  world The world, which must outlive the graph.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR visibility_graph_create(VisibilityGraph **graph, const World *world);
+
+/******************************************************************************
+ * @name      visibility_graph_destroy()
+ * @brief     Frees a graph.
+ * @param[in] graph The graph to destroy.
+ * @return    void
+******************************************************************************/
+void visibility_graph_destroy(VisibilityGraph *graph);
+
+/******************************************************************************
+ * @name      visibility_graph_set_connectivity()
+ * @brief     Sets which faces of a chunk its air connects, searching again on
+ *            the next update if they changed.
+ * @param[in] graph        The graph the chunk is in.
+ * @param     chunk        The chunk's index in the world.
+ * @param     connectivity The chunk's connectivity, see chunk_face_pair().
+ * @return    void
+******************************************************************************/
+void visibility_graph_set_connectivity(VisibilityGraph *graph,
+                                       uint32_t chunk,
+                                       uint16_t connectivity);
+
+/******************************************************************************
+ * @name      visibility_graph_update()
+ * @brief     Finds the chunks visible from the camera if it has moved to
+ *            another chunk or a connectivity has changed since the last
+ *            search, and lists the chunks whose visibility changed. A camera
+ *            outside the world looks in through every side of it that faces
+ *            the camera.
+ * @param[in] graph  The graph to update.
+ * @param     camera Where the world is viewed from.
+ * @return    The number of chunks in the changed list.
+******************************************************************************/
+uint32_t visibility_graph_update(VisibilityGraph *graph, Vec3 camera);
+
+/******************************************************************************
+ * @name      visibility_graph_visible()
+ * @brief     Checks whether the last search reached a chunk.
+ * @param[in] graph The graph the chunk is in.
+ * @param     chunk The chunk's index in the world.
+ * @return    1 if it could be seen, else 0.
+******************************************************************************/
+static inline uint8_t visibility_graph_visible(const VisibilityGraph *graph, uint32_t chunk)
+{
+	return graph->visible[chunk];
+}
+
+#endif /* _VISIBILITY_H_ */
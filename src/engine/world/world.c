@@ -0,0 +1,378 @@
+#include "world.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+
+#include "core/logger.h"
+#include "core/jobs.h"
+#include "core/profiler.h"
+
+#define WORLD_TERRAIN_OCTAVES   4
+#define WORLD_TERRAIN_FREQUENCY (1.0f / 96.0f) /* Of the broadest octave. */
+#define WORLD_DIRT_DEPTH        3              /* Dirt below the grass. */
+
+/******************************************************************************
+ * @name  GenerateContext
+ * @brief Shared by the jobs generating a world's chunks.
+******************************************************************************/
+struct GenerateContext
+{
+	World *world;
+	uint32_t seed;
+	atomic_int failed;
+};
+
+ENGINE_ERROR world_create(World **world,
+                          uint32_t size_x,
+                          uint32_t size_y,
+                          uint32_t size_z)
+{
+	uint32_t chunk_count = size_x * size_y * size_z;
+
+	*world = calloc(1, sizeof(World));
+	if (*world == NULL)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate world");
+	}
+
+	(*world)->size[0] = size_x;
+	(*world)->size[1] = size_y;
+	(*world)->size[2] = size_z;
+	(*world)->chunk_count = chunk_count;
+
+	/* Zeroed chunks are uniform air. */
+	(*world)->chunks = calloc(chunk_count, sizeof(Chunk));
+	(*world)->versions = calloc(chunk_count, sizeof(uint32_t));
+	(*world)->dirty = malloc(chunk_count * sizeof(uint32_t));
+	(*world)->dirty_flags = calloc(chunk_count, sizeof(uint8_t));
+
+	if ((*world)->chunks == NULL
+	    || (*world)->versions == NULL
+	    || (*world)->dirty == NULL
+	    || (*world)->dirty_flags == NULL)
+	{
+		world_destroy(*world);
+		*world = NULL;
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to allocate world chunks");
+	}
+
+	return ENGINE_OK;
+}
+
+void world_destroy(World *world)
+{
+	for (uint32_t i = 0; world->chunks != NULL && i < world->chunk_count; i++)
+	{
+		chunk_deinit(&world->chunks[i]);
+	}
+
+	free(world->chunks);
+	free(world->versions);
+	free(world->dirty);
+	free(world->dirty_flags);
+	free(world);
+}
+
+BlockId world_get_block(const World *world, int32_t x, int32_t y, int32_t z)
+{
+	int32_t index = world_chunk_index(world,
+	                                  x >> CHUNK_SIZE_LOG2,
+	                                  y >> CHUNK_SIZE_LOG2,
+	                                  z >> CHUNK_SIZE_LOG2);
+
+	if (index < 0)
+	{
+		return BLOCK_AIR;
+	}
+
+	return chunk_get(&world->chunks[index],
+	                 x & (CHUNK_SIZE - 1),
+	                 y & (CHUNK_SIZE - 1),
+	                 z & (CHUNK_SIZE - 1));
+}
+
+ENGINE_ERROR world_set_block(World *world,
+                             int32_t x,
+                             int32_t y,
+                             int32_t z,
+                             BlockId block)
+{
+	int32_t position[3] = {x, y, z};
+	int32_t chunk[3] = {x >> CHUNK_SIZE_LOG2, y >> CHUNK_SIZE_LOG2, z >> CHUNK_SIZE_LOG2};
+	int32_t index = world_chunk_index(world, chunk[0], chunk[1], chunk[2]);
+	uint32_t local[3];
+	ENGINE_ERROR error;
+
+	if (index < 0)
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_INIT_FAILED,
+		                           "Block is outside the world");
+	}
+
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		local[axis] = (uint32_t)position[axis] & (CHUNK_SIZE - 1);
+	}
+
+	if (chunk_get(&world->chunks[index], local[0], local[1], local[2]) == block)
+	{
+		return ENGINE_OK;
+	}
+
+	error = chunk_set(&world->chunks[index], local[0], local[1], local[2], block);
+	ENGINE_RETURN_IF_ERROR(error);
+
+	world_mark_dirty(world, (uint32_t)index);
+
+	/* A neighbour's faces against the block may have appeared or gone. */
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		int32_t neighbour[3] = {chunk[0], chunk[1], chunk[2]};
+		int32_t neighbour_index;
+
+		if (local[axis] == 0)
+		{
+			neighbour[axis]--;
+		}
+		else if (local[axis] == CHUNK_SIZE - 1)
+		{
+			neighbour[axis]++;
+		}
+		else
+		{
+			continue;
+		}
+
+		neighbour_index = world_chunk_index(world, neighbour[0], neighbour[1], neighbour[2]);
+		if (neighbour_index >= 0)
+		{
+			world_mark_dirty(world, (uint32_t)neighbour_index);
+		}
+	}
+
+	return ENGINE_OK;
+}
+
+void world_mark_dirty(World *world, uint32_t index)
+{
+	world->versions[index]++;
+
+	if (!world->dirty_flags[index])
+	{
+		world->dirty_flags[index] = 1;
+		world->dirty[world->dirty_count++] = index;
+	}
+}
+
+void world_clear_dirty(World *world)
+{
+	for (uint32_t i = 0; i < world->dirty_count; i++)
+	{
+		world->dirty_flags[world->dirty[i]] = 0;
+	}
+
+	world->dirty_count = 0;
+}
+
+/******************************************************************************
+ * @name   lattice()
+ * @brief  Hashes a point of the integer lattice to a value in [0, 1].
+ * @param  seed Varies the values.
+ * @param  x    The point's x coordinate.
+ * @param  z    The point's z coordinate.
+ * @return The point's value.
+******************************************************************************/
+static float lattice(uint32_t seed, int32_t x, int32_t z)
+{
+	uint32_t hash = seed ^ ((uint32_t)x * 0x8da6b343u) ^ ((uint32_t)z * 0xd8163841u);
+
+	hash ^= hash >> 16;
+	hash *= 0x7feb352du;
+	hash ^= hash >> 15;
+	hash *= 0x846ca68bu;
+	hash ^= hash >> 16;
+
+	return (float)(hash >> 8) / (float)(1u << 24);
+}
+
+/******************************************************************************
+ * @name   value_noise()
+ * @brief  Smoothly interpolates the lattice values around a point.
+ * @param  seed Varies the values.
+ * @param  x    The point's x coordinate.
+ * @param  z    The point's z coordinate.
+ * @return The noise at the point, in [0, 1].
+******************************************************************************/
+static float value_noise(uint32_t seed, float x, float z)
+{
+	int32_t x0 = (int32_t)floorf(x);
+	int32_t z0 = (int32_t)floorf(z);
+	float u = x - (float)x0;
+	float v = z - (float)z0;
+	float near, far;
+
+	u = u * u * (3.0f - 2.0f * u);
+	v = v * v * (3.0f - 2.0f * v);
+
+	near = lattice(seed, x0, z0) + u * (lattice(seed, x0 + 1, z0) - lattice(seed, x0, z0));
+	far = lattice(seed, x0, z0 + 1)
+	      + u * (lattice(seed, x0 + 1, z0 + 1) - lattice(seed, x0, z0 + 1));
+
+	return near + v * (far - near);
+}
+
+/******************************************************************************
+ * @name   terrain_height()
+ * @brief  Gets the number of solid blocks in a column of generated terrain.
+ * @param  world_height The height of the world in blocks.
+ * @param  seed         Varies the terrain.
+ * @param  x            The column's x coordinate.
+ * @param  z            The column's z coordinate.
+ * @return The column's height, the grass is one block below it.
+******************************************************************************/
+static int32_t terrain_height(int32_t world_height, uint32_t seed, int32_t x, int32_t z)
+{
+	float frequency = WORLD_TERRAIN_FREQUENCY;
+	float amplitude = 1.0f;
+	float height = 0.0f;
+	float total = 0.0f;
+
+	for (uint32_t octave = 0; octave < WORLD_TERRAIN_OCTAVES; octave++)
+	{
+		height += amplitude * value_noise(seed + octave, x * frequency, z * frequency);
+		total += amplitude;
+		amplitude *= 0.5f;
+		frequency *= 2.0f;
+	}
+
+	/* Keep the surface between a quarter and three quarters of the way up. */
+	return (int32_t)(world_height * (0.25f + 0.5f * height / total));
+}
+
+/******************************************************************************
+ * @name      generate_chunks()
+ * @brief     Generates a range of chunks. Chunks entirely above or below the
+ *            surface stay uniform, only those it passes through are filled
+ *            block by block.
+ * @param[in] data  The GenerateContext.
+ * @param     start The first chunk of the range.
+ * @param     end   One past the last chunk of the range.
+ * @return    void
+******************************************************************************/
+static void generate_chunks(void *data, uint32_t start, uint32_t end)
+{
+	struct GenerateContext *context = data;
+	World *world = context->world;
+	int32_t world_height = (int32_t)(world->size[1] * CHUNK_SIZE);
+	int32_t heights[CHUNK_AREA];
+
+	PROFILE_ZONE("generate_chunks");
+
+	for (uint32_t index = start; index < end; index++)
+	{
+		Chunk *chunk = &world->chunks[index];
+		int32_t coordinates[3];
+		int32_t base[3];
+		int32_t lowest = world_height;
+		int32_t highest = 0;
+
+		world_chunk_coordinates(world, index, coordinates);
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			base[axis] = coordinates[axis] * CHUNK_SIZE;
+		}
+
+		for (int32_t z = 0, i = 0; z < CHUNK_SIZE; z++)
+		{
+			for (int32_t x = 0; x < CHUNK_SIZE; x++, i++)
+			{
+				heights[i] = terrain_height(world_height,
+				                            context->seed,
+				                            base[0] + x,
+				                            base[2] + z);
+				lowest = heights[i] < lowest ? heights[i] : lowest;
+				highest = heights[i] > highest ? heights[i] : highest;
+			}
+		}
+
+		chunk_fill(chunk, BLOCK_AIR);
+
+		if (highest <= base[1])
+		{
+			continue;
+		}
+
+		if (lowest - WORLD_DIRT_DEPTH - 1 >= base[1] + CHUNK_SIZE)
+		{
+			chunk_fill(chunk, BLOCK_STONE);
+			continue;
+		}
+
+		for (int32_t y = 0; y < CHUNK_SIZE; y++)
+		{
+			int32_t height = base[1] + y;
+
+			for (int32_t z = 0, i = 0; z < CHUNK_SIZE; z++)
+			{
+				for (int32_t x = 0; x < CHUNK_SIZE; x++, i++)
+				{
+					BlockId block;
+
+					if (height >= heights[i])
+					{
+						continue;
+					}
+
+					block = height == heights[i] - 1 ? BLOCK_GRASS
+					        : height >= heights[i] - 1 - WORLD_DIRT_DEPTH ? BLOCK_DIRT
+					        : BLOCK_STONE;
+
+					if (chunk_set(chunk, x, y, z, block) != ENGINE_OK)
+					{
+						atomic_store(&context->failed, 1);
+						return;
+					}
+				}
+			}
+		}
+
+		if (chunk_compact(chunk) != ENGINE_OK)
+		{
+			atomic_store(&context->failed, 1);
+			return;
+		}
+	}
+}
+
+ENGINE_ERROR world_generate(World *world, uint32_t seed)
+{
+	JobCounter counter = {0};
+	struct GenerateContext context = {
+		.world = world,
+		.seed = seed
+	};
+
+	PROFILE_ZONE("world_generate");
+
+	atomic_init(&context.failed, 0);
+
+	job_parallel_for(world->chunk_count, 1, generate_chunks, &context, &counter);
+	job_wait(&counter);
+
+	if (atomic_load(&context.failed))
+	{
+		ENGINE_LOG_RETURN_IF_ERROR(ENGINE_ERROR_OUT_OF_MEMORY,
+		                           "Failed to generate world");
+	}
+
+	for (uint32_t i = 0; i < world->chunk_count; i++)
+	{
+		world_mark_dirty(world, i);
+	}
+
+	return ENGINE_OK;
+}
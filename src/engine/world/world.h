@@ -0,0 +1,162 @@
+#ifndef _WORLD_H_
+#define _WORLD_H_
+
+#include <stdint.h>
+
+#include "core/debug.h"
+
+#include "chunk.h"
+
+/* The blocks terrain is generated from. */
+#define BLOCK_STONE 1
+#define BLOCK_DIRT  2
+#define BLOCK_GRASS 3
+
+/******************************************************************************
+ * @name  _World
+ * @brief A grid of chunks with its minimum corner at the origin, so block
+ *        (x, y, z) lives in chunk (x, y, z) / CHUNK_SIZE. Chunks are indexed
+ *        with x varying fastest, then z, then y.
+ *
+ *        Each edit bumps the chunk's version and marks it dirty, along with
+ *        any neighbour whose mesh shows the edited block's faces, until the
+ *        dirty list is cleared by whoever remeshes them.
+ *
+ *        A world is not synchronised and is only edited from the main thread.
+******************************************************************************/
+struct _World
+{
+	Chunk *chunks;
+	uint32_t size[3];     /*< Chunks along each axis. */
+	uint32_t chunk_count;
+
+	uint32_t *versions;   /*< Bumped each time a chunk changes. */
+
+	uint32_t *dirty;      /*< Chunks changed since the list was cleared. */
+	uint32_t dirty_count;
+	uint8_t *dirty_flags; /*< Set for each chunk in the dirty list. */
+};
+typedef struct _World World;
+
+/******************************************************************************
+ * @name       world_create()
+ * @brief      Creates a world filled with air.
+ * @param[out] world  A pointer to a pointer set to the created world.
+ * @param      size_x Chunks along x.
+ * @param      size_y Chunks along y.
+ * @param      size_z Chunks along z.
+ * @return     An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR world_create(World **world,
+                          uint32_t size_x,
+                          uint32_t size_y,
+                          uint32_t size_z);
+
+/******************************************************************************
+ * @name      world_destroy()
+ * @brief     Frees a world and all of its chunks.
+ * @param[in] world The world to destroy.
+ * @return    void
+******************************************************************************/
+void world_destroy(World *world);
+
+/******************************************************************************
+ * @name      world_chunk_index()
+ * @brief     Gets the index of a chunk from its coordinates.
+ * @param[in] world The world the chunk is in.
+ * @param     x     The chunk's x coordinate.
+ * @param     y     The chunk's y coordinate.
+ * @param     z     The chunk's z coordinate.
+ * @return    The chunk's index, or -1 if the coordinates are outside the world.
+******************************************************************************/
+static inline int32_t world_chunk_index(const World *world,
+                                        int32_t x,
+                                        int32_t y,
+                                        int32_t z)
+{
+	if (x < 0 || y < 0 || z < 0
+	    || (uint32_t)x >= world->size[0]
+	    || (uint32_t)y >= world->size[1]
+	    || (uint32_t)z >= world->size[2])
+	{
+		return -1;
+	}
+
+	return (int32_t)(((uint32_t)y * world->size[2] + (uint32_t)z) * world->size[0]
+	                 + (uint32_t)x);
+}
+
+/******************************************************************************
+ * @name       world_chunk_coordinates()
+ * @brief      Gets the coordinates of a chunk from its index.
+ * @param[in]  world       The world the chunk is in.
+ * @param      index       The chunk's index.
+ * @param[out] coordinates Set to the chunk's x, y and z coordinates.
+ * @return     void
+******************************************************************************/
+static inline void world_chunk_coordinates(const World *world,
+                                           uint32_t index,
+                                           int32_t coordinates[3])
+{
+	coordinates[0] = (int32_t)(index % world->size[0]);
+	coordinates[2] = (int32_t)(index / world->size[0] % world->size[2]);
+	coordinates[1] = (int32_t)(index / world->size[0] / world->size[2]);
+}
+
+/******************************************************************************
+ * @name      world_get_block()
+ * @brief     Gets a block.
+ * @param[in] world The world to read.
+ * @param     x     The block's x coordinate.
+ * @param     y     The block's y coordinate.
+ * @param     z     The block's z coordinate.
+ * @return    The block, air if it is outside the world.
+******************************************************************************/
+BlockId world_get_block(const World *world, int32_t x, int32_t y, int32_t z);
+
+/******************************************************************************
+ * @name      world_set_block()
+ * @brief     Sets a block, marking its chunk dirty along with the neighbours
+ *            it borders.
+ * @param[in] world The world to edit.
+ * @param     x     The block's x coordinate.
+ * @param     y     The block's y coordinate.
+ * @param     z     The block's z coordinate.
+ * @param     block The block to store.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR world_set_block(World *world,
+                             int32_t x,
+                             int32_t y,
+                             int32_t z,
+                             BlockId block);
+
+/******************************************************************************
+ * @name      world_mark_dirty()
+ * @brief     Bumps a chunk's version and adds it to the dirty list.
+ * @param[in] world The world the chunk is in.
+ * @param     index The chunk's index.
+ * @return    void
+******************************************************************************/
+void world_mark_dirty(World *world, uint32_t index);
+
+/******************************************************************************
+ * @name      world_clear_dirty()
+ * @brief     Empties the dirty list once its chunks have been taken.
+ * @param[in] world The world to clear.
+ * @return    void
+******************************************************************************/
+void world_clear_dirty(World *world);
+
+/******************************************************************************
+ * @name      world_generate()
+ * @brief     Fills the world with rolling terrain, generating chunks in
+ *            parallel on the job system, and marks every chunk dirty. Must be
+ *            called from the main thread.
+ * @param[in] world The world to fill.
+ * @param     seed  Varies the terrain.
+ * @return    An ENGINE_ERROR value. If successful ENGINE_OK.
+******************************************************************************/
+ENGINE_ERROR world_generate(World *world, uint32_t seed);
+
+#endif /* _WORLD_H_ */
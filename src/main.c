@@ -1,18 +1,71 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "engine/core/application.h"
 #include "engine/core/debug.h"
 
+static void print_usage(const char *program)
+{
+	fprintf(stderr,
+	        "Usage: %s [options]\n"
+	        "  --present-mode NAME  immediate, mailbox, fifo or fifo_relaxed (default mailbox)\n"
+	        "  --swap-images N      Swap chain images to request (default minimum + 1)\n"
+	        "  --fps N              Frame rate to pace to, 0 for uncapped (default 0)\n",
+	        program);
+}
+
+static int parse_options(int argc, char **argv, ApplicationSettings *settings)
+{
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const char *value = argv[i + 1];
+
+		if (strcmp(argv[i], "--present-mode") == 0)
+		{
+			if (renderer_parse_present_mode(value, &settings->present_mode) != ENGINE_OK)
+			{
+				return 0;
+			}
+		}
+		else if (strcmp(argv[i], "--swap-images") == 0)
+		{
+			settings->swap_chain_images = strtoul(value, NULL, 10);
+		}
+		else if (strcmp(argv[i], "--fps") == 0)
+		{
+			settings->frame_rate = strtod(value, NULL);
+		}
+		else
+		{
+			return 0;
+		}
+	}
+
+	/* Every option takes a value. */
+	return argc % 2 == 1;
+}
+
 int main(int argc, char **argv)
 {
+	ApplicationSettings settings = {
+		.present_mode = RENDERER_PRESENT_MODE_MAILBOX,
+		.swap_chain_images = 0,
+		.frame_rate = 0.0
+	};
 	ENGINE_ERROR error;
-	
-	error = application_initialise();
+
+	if (!parse_options(argc, argv, &settings))
+	{
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	error = application_initialise(&settings);
 	ENGINE_RETURN_IF_ERROR(error);
 
 	application_run();
 	application_destroy();
 
 	return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""Embeds SPIR-V binaries into a C source file as uint32_t arrays.
+
+Usage: embed_spirv.py OUTPUT SHADER.spv [SHADER.spv ...]
+
+Each binary is looked up at runtime through shader_library_find() by its file
+name without the .spv suffix, which is the name of the GLSL source it was
+compiled from, e.g. vertex.vert.
+"""
+
+import os
+import struct
+import sys
+
+SPIRV_MAGIC = 0x07230203
+
+
+def read_words(path):
+    with open(path, 'rb') as binary:
+        data = binary.read()
+
+    if len(data) == 0 or len(data) % 4 != 0:
+        sys.exit('%s: SPIR-V size is not a multiple of 4 bytes' % path)
+
+    words = struct.unpack('<%dI' % (len(data) // 4), data)
+    if words[0] != SPIRV_MAGIC:
+        sys.exit('%s: not a little endian SPIR-V binary' % path)
+
+    return words
+
+
+def identifier(name):
+    return ''.join(c if c.isalnum() else '_' for c in name)
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit(__doc__)
+
+    output = sys.argv[1]
+    shaders = [(os.path.basename(path)[:-len('.spv')], path)
+               for path in sys.argv[2:]]
+    lines = ['/* Generated by embed_spirv.py, do not edit. */',
+             '#include "renderer/shader_library.h"',
+             '']
+
+    for name, path in shaders:
+        words = read_words(path)
+        lines.append('static const uint32_t %s_code[%d] = {'
+                     % (identifier(name), len(words)))
+        for i in range(0, len(words), 6):
+            lines.append('\t' + ', '.join('0x%08x' % word
+                                          for word in words[i:i + 6]) + ',')
+        lines.append('};')
+        lines.append('')
+
+    lines.append('const ShaderBinary shader_library_binaries[] = {')
+    for name, _ in shaders:
+        lines.append('\t{"%s", %s_code, sizeof(%s_code)},'
+                     % (name, identifier(name), identifier(name)))
+    lines.append('};')
+    lines.append('')
+    lines.append('const uint32_t shader_library_binary_count = %d;' % len(shaders))
+
+    with open(output, 'w') as source:
+        source.write('\n'.join(lines) + '\n')
+
+
+if __name__ == '__main__':
+    main()